@@ -3,6 +3,13 @@
 
 #include "sky/sky_string.h"
 #include "sky/sky_cursor.h"
+#include "sky/hll.h"
+#include "sky/tdigest.h"
+#include "sky/groups.h"
+#include "sky/funnel.h"
+#include "sky/retention.h"
+#include "sky/paths.h"
+#include "sky/expiry.h"
 
 #endif
 
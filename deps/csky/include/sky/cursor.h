@@ -5,6 +5,8 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include "sky/timestamp.h"
+
 
 //==============================================================================
 //
@@ -15,6 +17,15 @@
 #define sky_event_flag_t uint8_t
 #define EVENT_FLAG       0x92
 
+// The session fields that the cursor can compute for each event.
+#define SKY_SESSION_FIELD_INDEX        0
+#define SKY_SESSION_FIELD_EVENT_INDEX  1
+#define SKY_SESSION_FIELD_START        2
+#define SKY_SESSION_FIELD_GAP          3
+#define SKY_SESSION_FIELD_LENGTH       4
+
+#define SKY_SESSION_FIELD_COUNT        5
+
 
 //==============================================================================
 //
@@ -31,6 +42,21 @@ typedef void (*sky_property_descriptor_clear_func)(void *target);
 
 typedef struct { uint16_t ts_offset; uint16_t timestamp_offset;} sky_timestamp_descriptor;
 
+// The offsets of the time bucket fields in the data object. Only buckets in
+// the mask are computed.
+typedef struct {
+    uint16_t offsets[SKY_TIME_BUCKET_COUNT];
+    uint32_t mask;
+    sky_timezone timezone;
+} sky_time_bucket_descriptor;
+
+// The offsets of the session fields in the data object. Only fields in the
+// mask are computed.
+typedef struct {
+    uint16_t offsets[SKY_SESSION_FIELD_COUNT];
+    uint32_t mask;
+} sky_session_descriptor;
+
 typedef struct {
     int64_t property_id;
     uint16_t offset;
@@ -40,10 +66,15 @@ typedef struct {
 
 struct sky_cursor {
     void *data;
+    void *state;
     uint32_t data_sz;
     uint32_t action_data_sz;
 
     int32_t session_event_index;
+    void *objectptr;
+    size_t object_sz;
+    void *key;
+    size_t key_sz;
     void *startptr;
     void *nextptr;
     void *endptr;
@@ -52,8 +83,14 @@ struct sky_cursor {
     bool in_session;
     uint32_t last_timestamp;
     uint32_t session_idle_in_sec;
+    int32_t session_index;
+    uint32_t session_start;
+    uint32_t session_length;
+    uint32_t prev_timestamp;
 
     sky_timestamp_descriptor timestamp_descriptor;
+    sky_time_bucket_descriptor time_bucket_descriptor;
+    sky_session_descriptor session_descriptor;
     sky_property_descriptor *property_descriptors;
     sky_property_descriptor *property_zero_descriptor;
     uint32_t property_count;
@@ -92,10 +129,18 @@ void sky_cursor_set_value(sky_cursor *cursor,
 
 void sky_cursor_set_data_sz(sky_cursor *cursor, uint32_t sz);
 
+void sky_cursor_enable_state(sky_cursor *cursor);
+
 void sky_cursor_set_timestamp_offset(sky_cursor *cursor, uint32_t offset);
 
 void sky_cursor_set_ts_offset(sky_cursor *cursor, uint32_t offset);
 
+void sky_cursor_set_time_bucket_offset(sky_cursor *cursor, uint32_t unit, uint32_t offset);
+
+int sky_cursor_set_timezone(sky_cursor *cursor, uint32_t count, int64_t *starts, int32_t *offsets);
+
+void sky_cursor_set_session_field_offset(sky_cursor *cursor, uint32_t field, uint32_t offset);
+
 void sky_cursor_set_property(sky_cursor *cursor,
   int64_t property_id, uint32_t offset, uint32_t sz, const char *data_type);
 
@@ -112,6 +157,14 @@ bool sky_cursor_next_object(sky_cursor *cursor);
 
 void sky_cursor_set_ptr(sky_cursor *cursor, void *ptr, size_t sz);
 
+void sky_cursor_rewind(sky_cursor *cursor);
+
+void sky_cursor_set_key(sky_cursor *cursor, void *ptr, size_t sz);
+
+void *sky_cursor_key(sky_cursor *cursor);
+
+uint32_t sky_cursor_key_sz(sky_cursor *cursor);
+
 void sky_cursor_next_event(sky_cursor *cursor);
 
 bool sky_lua_cursor_next_event(sky_cursor *cursor);
@@ -126,6 +179,15 @@ void sky_cursor_next_session(sky_cursor *cursor);
 
 bool sky_lua_cursor_next_session(sky_cursor *cursor);
 
+
+//--------------------------------------
+// State
+//--------------------------------------
+
+bool sky_cursor_read_state(sky_cursor *cursor, void *target);
+
+bool sky_cursor_next_state(sky_cursor *cursor);
+
 void sky_cursor_clear_data(sky_cursor *cursor);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef _sky_expiry_h
+#define _sky_expiry_h
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// The retention period of a table and the events expired from it so far.
+typedef struct {
+    char *name;
+    uint32_t name_length;
+    int64_t retention;
+    uint64_t trimmed_events;
+    uint64_t trimmed_bytes;
+} sky_expiry_table;
+
+// Expires events older than the retention period of their table from object
+// values as LevelDB compacts them. Tables without a retention period keep
+// every event. The expiry is shared by the compactions of every servlet so
+// the table list is guarded by a mutex.
+typedef struct sky_expiry {
+    pthread_mutex_t mutex;
+    uint32_t table_count;
+    sky_expiry_table *tables;
+    int64_t now;
+} sky_expiry;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_expiry *sky_expiry_new();
+
+void sky_expiry_free(sky_expiry *expiry);
+
+
+//--------------------------------------
+// Tables
+//--------------------------------------
+
+int sky_expiry_set_retention(sky_expiry *expiry, const char *name, uint32_t name_length, int64_t retention);
+
+void sky_expiry_stats(sky_expiry *expiry, const char *name, uint32_t name_length, uint64_t *events, uint64_t *bytes);
+
+
+//--------------------------------------
+// Trimming
+//--------------------------------------
+
+bool sky_expiry_trim(void *ptr, size_t sz, int64_t horizon, size_t *state_sz, size_t *trimmed_sz, uint32_t *count);
+
+bool sky_expiry_rewrite(void *ptr, size_t sz, size_t state_sz, size_t trimmed_sz, void *new_ptr, size_t *new_sz);
+
+
+//--------------------------------------
+// Compaction Filter
+//--------------------------------------
+
+unsigned char sky_expiry_filter(void *state, int level,
+    const char *key, size_t key_length,
+    const char *value, size_t value_length,
+    char **new_value, size_t *new_value_length,
+    unsigned char *value_changed);
+
+const char *sky_expiry_name(void *state);
+
+void sky_expiry_destroy(void *state);
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef _sky_funnel_h
+#define _sky_funnel_h
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+
+//==============================================================================
+//
+// Constants
+//
+//==============================================================================
+
+#define SKY_FUNNEL_MAX_STEPS     32
+
+#define SKY_FUNNEL_UNIT_STEPS    0
+#define SKY_FUNNEL_UNIT_SECONDS  1
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A queue of positions at which a partial match of a step ended. Positions
+// are measured in the units of the next step's window and only increase.
+typedef struct {
+    int64_t *positions;
+    uint32_t head;
+    uint32_t count;
+    uint32_t capacity;
+} sky_funnel_queue;
+
+// A window that a step must match within, relative to the event that
+// matched the previous step.
+typedef struct {
+    uint8_t unit;
+    int64_t start;
+    int64_t end;
+} sky_funnel_window;
+
+// A funnel matcher that evaluates an ordered list of steps as an NFA in a
+// single pass over an object's events. Each event is pushed with a bitmask
+// of the step predicates it matches. The depth is the number of steps that
+// have been reached by a chain of matches so far. The first field is read
+// directly by generated Lua code.
+typedef struct sky_funnel {
+    uint32_t depth;
+
+    uint32_t step_count;
+    int64_t index;
+    sky_funnel_window windows[SKY_FUNNEL_MAX_STEPS];
+    sky_funnel_queue queues[SKY_FUNNEL_MAX_STEPS];
+} sky_funnel;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_funnel *sky_funnel_new(uint32_t step_count);
+
+void sky_funnel_free(sky_funnel *funnel);
+
+
+//--------------------------------------
+// Windows
+//--------------------------------------
+
+int sky_funnel_set_window(sky_funnel *funnel, uint32_t step, uint8_t unit,
+  int64_t start, int64_t end);
+
+
+//--------------------------------------
+// Matching
+//--------------------------------------
+
+void sky_funnel_reset(sky_funnel *funnel);
+
+uint32_t sky_funnel_push(sky_funnel *funnel, uint32_t mask, uint32_t timestamp);
+
+#endif
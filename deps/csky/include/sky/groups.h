@@ -0,0 +1,72 @@
+#ifndef _sky_groups_h
+#define _sky_groups_h
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A hash table of aggregation groups keyed by a tuple of dimension values.
+// Each group has a fixed-width slot of doubles for its aggregate state. The
+// key for a lookup is built up one dimension value at a time and then probed
+// once. The first three fields are read directly by generated Lua code.
+typedef struct sky_groups {
+    uint32_t width;
+    uint32_t count;
+    double *values;
+
+    double *initial;
+    uint32_t capacity;
+    uint32_t bucket_count;
+    int32_t *buckets;
+    uint64_t *hashes;
+    size_t *key_offsets;
+    uint32_t *key_sizes;
+    char *keys;
+    size_t keys_sz;
+    size_t keys_capacity;
+    char *key;
+    size_t key_sz;
+    size_t key_capacity;
+} sky_groups;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_groups *sky_groups_new(uint32_t width, double *initial);
+
+void sky_groups_free(sky_groups *groups);
+
+
+//--------------------------------------
+// Keys
+//--------------------------------------
+
+void sky_groups_key_reset(sky_groups *groups);
+
+int sky_groups_key_add_double(sky_groups *groups, double value);
+
+int sky_groups_key_add_string(sky_groups *groups, void *ptr, size_t sz);
+
+
+//--------------------------------------
+// Lookup
+//--------------------------------------
+
+int32_t sky_groups_lookup(sky_groups *groups);
+
+#endif
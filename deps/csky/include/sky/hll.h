@@ -0,0 +1,81 @@
+#ifndef _sky_hll_h
+#define _sky_hll_h
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+
+//==============================================================================
+//
+// Constants
+//
+//==============================================================================
+
+#define SKY_HLL_MIN_PRECISION  4
+#define SKY_HLL_MAX_PRECISION  16
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A HyperLogLog sketch. The struct is laid out contiguously so that its raw
+// memory can be used as its serialized form.
+typedef struct sky_hll {
+    uint8_t precision;
+    uint8_t registers[];
+} sky_hll;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_hll *sky_hll_new(uint8_t precision);
+
+void sky_hll_free(sky_hll *hll);
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+size_t sky_hll_sizeof(sky_hll *hll);
+
+bool sky_hll_validate(void *ptr, size_t sz);
+
+
+//--------------------------------------
+// Values
+//--------------------------------------
+
+void sky_hll_add_hash(sky_hll *hll, uint64_t hash);
+
+void sky_hll_add_double(sky_hll *hll, double value);
+
+void sky_hll_add_string(sky_hll *hll, void *ptr, size_t sz);
+
+
+//--------------------------------------
+// Merge
+//--------------------------------------
+
+int sky_hll_merge(sky_hll *hll, void *ptr, size_t sz);
+
+
+//--------------------------------------
+// Estimation
+//--------------------------------------
+
+double sky_hll_estimate(sky_hll *hll);
+
+#endif
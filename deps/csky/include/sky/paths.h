@@ -0,0 +1,122 @@
+#ifndef _sky_paths_h
+#define _sky_paths_h
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+
+//==============================================================================
+//
+// Constants
+//
+//==============================================================================
+
+#define SKY_PATHS_MAX_STEPS     8
+#define SKY_PATHS_MAX_CAPACITY  1024
+
+// The dimensions of the count-min sketch.
+#define SKY_PATHS_SKETCH_DEPTH  4
+#define SKY_PATHS_SKETCH_WIDTH  2048
+
+// Whether paths follow or lead up to each anchor event.
+#define SKY_PATHS_NEXT          0
+#define SKY_PATHS_PREVIOUS      1
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A path of up to SKY_PATHS_MAX_STEPS values and its estimated count.
+typedef struct {
+    uint64_t hash;
+    uint32_t count;
+    uint32_t length;
+    int64_t values[SKY_PATHS_MAX_STEPS];
+} sky_path;
+
+// The header of serialized paths. It is followed by the counts of the sketch
+// and then by each heavy hitter.
+typedef struct {
+    uint32_t steps;
+    uint32_t direction;
+    uint32_t capacity;
+    uint32_t path_count;
+} sky_paths_header;
+
+// Counts the paths of values that follow or lead up to anchor events. Every
+// path is counted in a count-min sketch and the most frequent paths are kept
+// in a fixed size list of heavy hitters so memory is bounded regardless of
+// the number of distinct paths.
+typedef struct sky_paths {
+    uint32_t steps;
+    uint32_t direction;
+    uint32_t capacity;
+    uint32_t path_count;
+    uint32_t *sketch;
+    sky_path *paths;
+
+    uint32_t event_count;
+    int64_t history[SKY_PATHS_MAX_STEPS + 1];
+    bool anchors[SKY_PATHS_MAX_STEPS + 1];
+} sky_paths;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_paths *sky_paths_new(uint32_t steps, uint32_t direction, uint32_t capacity);
+
+void sky_paths_free(sky_paths *paths);
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+size_t sky_paths_sizeof(sky_paths *paths);
+
+void sky_paths_pack(sky_paths *paths, void *ptr);
+
+sky_paths *sky_paths_unpack(void *ptr, size_t sz);
+
+
+//--------------------------------------
+// Objects
+//--------------------------------------
+
+void sky_paths_begin(sky_paths *paths);
+
+void sky_paths_push(sky_paths *paths, bool anchor, int64_t value);
+
+void sky_paths_end(sky_paths *paths);
+
+
+//--------------------------------------
+// Counting
+//--------------------------------------
+
+void sky_paths_add(sky_paths *paths, int64_t *values, uint32_t length);
+
+uint32_t sky_paths_estimate(sky_paths *paths, int64_t *values, uint32_t length);
+
+
+//--------------------------------------
+// Merge
+//--------------------------------------
+
+int sky_paths_merge(sky_paths *paths, void *ptr, size_t sz);
+
+void sky_paths_sort(sky_paths *paths);
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef _sky_retention_h
+#define _sky_retention_h
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+
+//==============================================================================
+//
+// Constants
+//
+//==============================================================================
+
+#define SKY_RETENTION_MAX_PERIODS  1024
+
+// Flags passed with each event.
+#define SKY_RETENTION_COHORT       1
+#define SKY_RETENTION_ACTIVE       2
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// The header of a serialized matrix. It is followed by the cohort of each
+// row and then by the counts of each row.
+typedef struct {
+    uint32_t period;
+    uint32_t offset;
+    uint32_t periods;
+    uint32_t row_count;
+} sky_retention_header;
+
+// A cohort retention matrix. Each object is assigned to the cohort of the
+// period that contains its first cohort event. Each row counts the objects
+// of a cohort that were active in each of the following periods. Rows are
+// kept sorted by cohort.
+typedef struct sky_retention {
+    uint32_t period;
+    uint32_t offset;
+    uint32_t periods;
+    uint32_t row_count;
+    uint32_t row_capacity;
+    int64_t *cohorts;
+    uint32_t *counts;
+
+    bool in_cohort;
+    int64_t cohort;
+    uint64_t *active;
+} sky_retention;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_retention *sky_retention_new(uint32_t period, uint32_t offset, uint32_t periods);
+
+void sky_retention_free(sky_retention *retention);
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+size_t sky_retention_sizeof(sky_retention *retention);
+
+void sky_retention_pack(sky_retention *retention, void *ptr);
+
+sky_retention *sky_retention_unpack(void *ptr, size_t sz);
+
+
+//--------------------------------------
+// Objects
+//--------------------------------------
+
+void sky_retention_begin(sky_retention *retention);
+
+void sky_retention_push(sky_retention *retention, uint32_t flags, uint32_t timestamp);
+
+int sky_retention_end(sky_retention *retention);
+
+
+//--------------------------------------
+// Merge
+//--------------------------------------
+
+int sky_retention_merge(sky_retention *retention, void *ptr, size_t sz);
+
+
+//--------------------------------------
+// Rows
+//--------------------------------------
+
+int64_t sky_retention_cohort_timestamp(sky_retention *retention, uint32_t row);
+
+uint32_t sky_retention_count(sky_retention *retention, uint32_t row, uint32_t period);
+
+#endif
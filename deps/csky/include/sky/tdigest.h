@@ -0,0 +1,105 @@
+#ifndef _sky_tdigest_h
+#define _sky_tdigest_h
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+
+//==============================================================================
+//
+// Constants
+//
+//==============================================================================
+
+#define SKY_TDIGEST_MIN_COMPRESSION  10
+#define SKY_TDIGEST_MAX_COMPRESSION  1000
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+typedef struct {
+    double mean;
+    double weight;
+} sky_tdigest_centroid;
+
+// The header of a serialized digest. It is followed by the centroids.
+typedef struct {
+    double compression;
+    double min;
+    double max;
+    uint32_t count;
+    uint32_t reserved;
+} sky_tdigest_header;
+
+// A t-digest for estimating quantiles of a stream of values. New values are
+// buffered and periodically merged into a bounded set of centroids that are
+// smaller near the tails so that extreme quantiles stay accurate.
+typedef struct sky_tdigest {
+    double compression;
+    double min;
+    double max;
+    uint32_t merged_count;
+    uint32_t unmerged_count;
+    uint32_t capacity;
+    sky_tdigest_centroid *centroids;
+} sky_tdigest;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_tdigest *sky_tdigest_new(double compression);
+
+void sky_tdigest_free(sky_tdigest *tdigest);
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+size_t sky_tdigest_sizeof(sky_tdigest *tdigest);
+
+void sky_tdigest_pack(sky_tdigest *tdigest, void *ptr);
+
+sky_tdigest *sky_tdigest_unpack(void *ptr, size_t sz);
+
+
+//--------------------------------------
+// Values
+//--------------------------------------
+
+void sky_tdigest_add(sky_tdigest *tdigest, double value);
+
+void sky_tdigest_add_weighted(sky_tdigest *tdigest, double value, double weight);
+
+void sky_tdigest_compress(sky_tdigest *tdigest);
+
+
+//--------------------------------------
+// Merge
+//--------------------------------------
+
+int sky_tdigest_merge(sky_tdigest *tdigest, void *ptr, size_t sz);
+
+
+//--------------------------------------
+// Estimation
+//--------------------------------------
+
+double sky_tdigest_count(sky_tdigest *tdigest);
+
+double sky_tdigest_quantile(sky_tdigest *tdigest, double q);
+
+#endif
@@ -3,6 +3,38 @@
 
 #include <inttypes.h>
 
+//==============================================================================
+//
+// Constants
+//
+//==============================================================================
+
+// The units that timestamps can be bucketed by.
+#define SKY_TIME_BUCKET_MINUTE  0
+#define SKY_TIME_BUCKET_HOUR    1
+#define SKY_TIME_BUCKET_DAY     2
+#define SKY_TIME_BUCKET_WEEK    3
+#define SKY_TIME_BUCKET_MONTH   4
+
+#define SKY_TIME_BUCKET_COUNT   5
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A timezone stored as a list of transitions sorted by start time. Each
+// transition sets the offset from UTC, in seconds, until the next one. Times
+// before the first transition and timezones without transitions use UTC.
+typedef struct {
+    uint32_t count;
+    int64_t *starts;
+    int32_t *offsets;
+} sky_timezone;
+
+
 //==============================================================================
 //
 // Functions
@@ -19,5 +51,14 @@ int64_t sky_timestamp_unshift(int64_t value);
 
 int64_t sky_timestamp_to_seconds(int64_t value);
 
+
+//--------------------------------------
+// Bucketing
+//--------------------------------------
+
+int32_t sky_timezone_offset(sky_timezone *timezone, int64_t seconds);
+
+int64_t sky_timestamp_bucket(sky_timezone *timezone, int64_t seconds, uint32_t unit);
+
 #endif
 
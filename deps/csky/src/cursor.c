@@ -64,6 +64,31 @@ void sky_clear_double(void *target);
 void sky_clear_boolean(void *target);
 
 
+//--------------------------------------
+// Time Buckets
+//--------------------------------------
+
+void sky_cursor_set_time_buckets(sky_cursor *cursor, uint32_t timestamp);
+
+
+//--------------------------------------
+// Sessions
+//--------------------------------------
+
+bool sky_cursor_is_session_boundary(sky_cursor *cursor, uint32_t last_timestamp, uint32_t timestamp);
+
+void sky_cursor_set_session_fields(sky_cursor *cursor, uint32_t timestamp);
+
+uint32_t sky_cursor_session_end(sky_cursor *cursor, uint32_t timestamp);
+
+
+//--------------------------------------
+// Properties
+//--------------------------------------
+
+size_t sky_cursor_read_properties(sky_cursor *cursor, void *target, void *ptr);
+
+
 //==============================================================================
 //
 // Functions
@@ -115,6 +140,8 @@ void sky_cursor_free(sky_cursor *cursor)
         cursor->property_count = 0;
 
         if(cursor->data != NULL) free(cursor->data);
+        if(cursor->state != NULL) free(cursor->state);
+        sky_cursor_set_timezone(cursor, 0, NULL, NULL);
 
         free(cursor);
     }
@@ -141,6 +168,19 @@ void sky_cursor_set_data_sz(sky_cursor *cursor, uint32_t sz) {
     cursor->data_sz = sz;
     if(cursor->data != NULL) free(cursor->data);
     cursor->data = calloc(1, sz);
+    if(cursor->state != NULL) {
+        free(cursor->state);
+        cursor->state = calloc(1, sz);
+    }
+}
+
+// Enables decoding of each object's current state into a second data object
+// when the cursor moves to the object. The state data object has the same
+// layout as the event data object.
+void sky_cursor_enable_state(sky_cursor *cursor) {
+    if(cursor->state == NULL) {
+        cursor->state = calloc(1, cursor->data_sz);
+    }
 }
 
 void sky_cursor_set_timestamp_offset(sky_cursor *cursor, uint32_t offset) {
@@ -151,6 +191,56 @@ void sky_cursor_set_ts_offset(sky_cursor *cursor, uint32_t offset) {
     cursor->timestamp_descriptor.ts_offset = offset;
 }
 
+// Sets the offset of a time bucket field. The bucket is computed for each
+// event from then on.
+void sky_cursor_set_time_bucket_offset(sky_cursor *cursor, uint32_t unit, uint32_t offset) {
+    if(unit < SKY_TIME_BUCKET_COUNT) {
+        cursor->time_bucket_descriptor.offsets[unit] = offset;
+        cursor->time_bucket_descriptor.mask |= (1 << unit);
+    }
+}
+
+// Sets the offset of a session field. The field is computed for each event
+// from then on.
+void sky_cursor_set_session_field_offset(sky_cursor *cursor, uint32_t field, uint32_t offset) {
+    if(field < SKY_SESSION_FIELD_COUNT) {
+        cursor->session_descriptor.offsets[field] = offset;
+        cursor->session_descriptor.mask |= (1 << field);
+    }
+}
+
+// Sets the timezone that time buckets are aligned to. The transitions are
+// copied into the cursor. Passing no transitions resets the timezone to UTC.
+//
+// cursor  - The cursor.
+// count   - The number of transitions.
+// starts  - The start of each transition in seconds since the epoch, sorted.
+// offsets - The offset from UTC of each transition, in seconds.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_cursor_set_timezone(sky_cursor *cursor, uint32_t count, int64_t *starts, int32_t *offsets) {
+    sky_timezone *timezone = &cursor->time_bucket_descriptor.timezone;
+    if(timezone->starts != NULL) free(timezone->starts);
+    if(timezone->offsets != NULL) free(timezone->offsets);
+    timezone->count = 0;
+    timezone->starts = NULL;
+    timezone->offsets = NULL;
+    if(count == 0) {
+        return 0;
+    }
+
+    timezone->starts = malloc(count * sizeof(int64_t));
+    timezone->offsets = malloc(count * sizeof(int32_t));
+    if(timezone->starts == NULL || timezone->offsets == NULL) {
+        sky_cursor_set_timezone(cursor, 0, NULL, NULL);
+        return -1;
+    }
+    memcpy(timezone->starts, starts, count * sizeof(int64_t));
+    memcpy(timezone->offsets, offsets, count * sizeof(int32_t));
+    timezone->count = count;
+    return 0;
+}
+
 // Sets the data type and offset for a given property id.
 void sky_cursor_set_property(sky_cursor *cursor, int64_t property_id,
                              uint32_t offset, uint32_t sz, const char *data_type)
@@ -208,6 +298,10 @@ bool sky_cursor_next_object(sky_cursor *cursor)
 
 void sky_cursor_set_ptr(sky_cursor *cursor, void *ptr, size_t sz)
 {
+    // Save the object so the cursor can be rewound to it later.
+    cursor->objectptr  = ptr;
+    cursor->object_sz  = sz;
+
     // Set the start of the path and the length of the data.
     cursor->startptr   = ptr;
     cursor->nextptr    = ptr;
@@ -217,10 +311,17 @@ void sky_cursor_set_ptr(sky_cursor *cursor, void *ptr, size_t sz)
     cursor->last_timestamp      = 0;
     cursor->session_idle_in_sec = 0;
     cursor->session_event_index = -1;
+    cursor->session_index       = -1;
+    cursor->prev_timestamp      = 0;
     cursor->eof        = !(ptr != NULL && cursor->startptr < cursor->endptr);
     
     // Clear the data object if set.
     memset(cursor->data, 0, cursor->data_sz);
+
+    // Decode the current state if it is being used.
+    if(cursor->state != NULL) {
+        sky_cursor_read_state(cursor, cursor->state);
+    }
     
     // The first item is the current state so skip it.
     if(cursor->startptr != NULL && minipack_is_raw(cursor->startptr)) {
@@ -229,6 +330,33 @@ void sky_cursor_set_ptr(sky_cursor *cursor, void *ptr, size_t sz)
     }
 }
 
+// Moves the cursor back to the beginning of the current object so that
+// another pass can be made over the same events.
+void sky_cursor_rewind(sky_cursor *cursor)
+{
+    sky_cursor_set_ptr(cursor, cursor->objectptr, cursor->object_sz);
+}
+
+// Sets the key of the current object. The key is not copied so it must
+// remain valid until the cursor moves to the next object.
+void sky_cursor_set_key(sky_cursor *cursor, void *ptr, size_t sz)
+{
+    cursor->key    = ptr;
+    cursor->key_sz = sz;
+}
+
+// Retrieves a pointer to the key of the current object.
+void *sky_cursor_key(sky_cursor *cursor)
+{
+    return cursor->key;
+}
+
+// Retrieves the length of the key of the current object.
+uint32_t sky_cursor_key_sz(sky_cursor *cursor)
+{
+    return (uint32_t)cursor->key_sz;
+}
+
 void sky_cursor_next_event(sky_cursor *cursor)
 {
     // Ignore any calls when the cursor is out of session or EOF.
@@ -265,66 +393,145 @@ void sky_cursor_next_event(sky_cursor *cursor)
         uint32_t timestamp = sky_timestamp_to_seconds(ts);
         ptr += sz;
 
-        // Check for session boundry. This only applies if this is not the
-        // first event in the session and a session idle time has been set.
-        if(cursor->last_timestamp > 0 && cursor->session_idle_in_sec > 0) {
-            // If the elapsed time is greater than the idle time then rewind
-            // back to the event we started on at the beginning of the function
-            // and mark the cursor as being "out of session".
-            if(timestamp - cursor->last_timestamp >= cursor->session_idle_in_sec) {
-                cursor->ptr = prevptr;
-                cursor->in_session = false;
-            }
+        // Check for a session boundary. If the elapsed time is greater than
+        // the idle time then rewind back to the event we started on at the
+        // beginning of the function and mark the cursor as being "out of
+        // session".
+        if(sky_cursor_is_session_boundary(cursor, cursor->last_timestamp, timestamp)) {
+            cursor->ptr = prevptr;
+            cursor->in_session = false;
         }
         cursor->last_timestamp = timestamp;
 
         // Only process the event if we're still in session.
         if(cursor->in_session) {
             cursor->session_event_index++;
+            if(cursor->session_event_index == 0) {
+                cursor->session_index++;
+                cursor->session_start = timestamp;
+            }
             
             // Set timestamp.
             int64_t *data_ts = (int64_t*)(cursor->data + cursor->timestamp_descriptor.ts_offset);
             uint32_t *data_timestamp = (uint32_t*)(cursor->data + cursor->timestamp_descriptor.timestamp_offset);
             *data_ts = ts;
             *data_timestamp = timestamp;
+
+            // Set time buckets.
+            if(cursor->time_bucket_descriptor.mask != 0) {
+                sky_cursor_set_time_buckets(cursor, timestamp);
+            }
             
             // Clear old action data.
             if(cursor->action_data_sz > 0) {
               memset(cursor->data, 0, cursor->action_data_sz);
             }
 
-            // Read msgpack map!
-            uint32_t count = minipack_unpack_map(ptr, &sz);
-            if(sz == 0) {
-              minipack_unpack_nil(ptr, &sz);
-              if(sz == 0) {
-                badcursordata("datamap", ptr);
-              }
-            }
+            // Read property values.
+            sz = sky_cursor_read_properties(cursor, cursor->data, ptr);
+            if(sz == 0) badcursordata("datamap", ptr);
             ptr += sz;
 
-            // Loop over key/value pairs.
-            uint32_t i;
-            for(i=0; i<count; i++) {
-                // Read property id (key).
-                int64_t property_id = minipack_unpack_int(ptr, &sz);
-                if(sz == 0) badcursordata("key", ptr);
-                ptr += sz;
-
-                // Read property value and set it on the data object.
-                sky_cursor_set_value(cursor, cursor->data, property_id, ptr, &sz);
-                if(sz == 0) {
-                  debug("[invalid read, skipping]");
-                  sz = minipack_sizeof_elem_and_data(ptr);
-                }
-                ptr += sz;
+            cursor->nextptr = ptr;
+
+            // Set session fields once the end of the event is known.
+            if(cursor->session_descriptor.mask != 0) {
+                sky_cursor_set_session_fields(cursor, timestamp);
             }
+        }
+    }
+}
 
-            cursor->nextptr = ptr;
+// Writes the start of each enabled time bucket containing the current
+// event into the data object.
+void sky_cursor_set_time_buckets(sky_cursor *cursor, uint32_t timestamp)
+{
+    uint32_t unit;
+    sky_time_bucket_descriptor *descriptor = &cursor->time_bucket_descriptor;
+    sky_timezone *timezone = (descriptor->timezone.count > 0 ? &descriptor->timezone : NULL);
+    for(unit=0; unit<SKY_TIME_BUCKET_COUNT; unit++) {
+        if(descriptor->mask & (1 << unit)) {
+            uint32_t *data_bucket = (uint32_t*)(cursor->data + descriptor->offsets[unit]);
+            *data_bucket = (uint32_t)sky_timestamp_bucket(timezone, timestamp, unit);
         }
     }
 }
 
+// Checks if an event starts a new session. This only applies if this is not
+// the first event in the session and a session idle time has been set.
+bool sky_cursor_is_session_boundary(sky_cursor *cursor, uint32_t last_timestamp, uint32_t timestamp)
+{
+    return (last_timestamp > 0 && cursor->session_idle_in_sec > 0 &&
+        timestamp - last_timestamp >= cursor->session_idle_in_sec);
+}
+
+// Writes each enabled session field of the current event into the data
+// object. The length of a session is found when its first event is read by
+// looking ahead to the session's last event.
+void sky_cursor_set_session_fields(sky_cursor *cursor, uint32_t timestamp)
+{
+    sky_session_descriptor *descriptor = &cursor->session_descriptor;
+    bool first = (cursor->session_event_index == 0);
+    if(first && (descriptor->mask & (1 << SKY_SESSION_FIELD_LENGTH))) {
+        cursor->session_length = sky_cursor_session_end(cursor, timestamp) - timestamp;
+    }
+
+    uint32_t values[SKY_SESSION_FIELD_COUNT];
+    values[SKY_SESSION_FIELD_INDEX] = (uint32_t)cursor->session_index;
+    values[SKY_SESSION_FIELD_EVENT_INDEX] = (uint32_t)cursor->session_event_index;
+    values[SKY_SESSION_FIELD_START] = cursor->session_start;
+    values[SKY_SESSION_FIELD_GAP] = ((first && cursor->session_index == 0) ? 0 : timestamp - cursor->prev_timestamp);
+    values[SKY_SESSION_FIELD_LENGTH] = cursor->session_length;
+
+    uint32_t field;
+    for(field=0; field<SKY_SESSION_FIELD_COUNT; field++) {
+        if(descriptor->mask & (1 << field)) {
+            *((uint32_t*)(cursor->data + descriptor->offsets[field])) = values[field];
+        }
+    }
+    cursor->prev_timestamp = timestamp;
+}
+
+// Finds the time of the last event in the current session by reading ahead
+// from the current event. Only event timestamps are read; the data of each
+// event is skipped.
+//
+// cursor    - The cursor.
+// timestamp - The time of the current event, in seconds.
+//
+// Returns the time of the last event in the session, in seconds.
+uint32_t sky_cursor_session_end(sky_cursor *cursor, uint32_t timestamp)
+{
+    size_t sz;
+    void *ptr = cursor->nextptr;
+    while(ptr < cursor->endptr) {
+        // Read the flag and timestamp.
+        if(*((sky_event_flag_t*)ptr) != EVENT_FLAG) break;
+        ptr += sizeof(sky_event_flag_t);
+        int64_t ts = minipack_unpack_int(ptr, &sz);
+        if(sz == 0) break;
+        ptr += sz;
+
+        uint32_t next_timestamp = sky_timestamp_to_seconds(ts);
+        if(sky_cursor_is_session_boundary(cursor, timestamp, next_timestamp)) break;
+        timestamp = next_timestamp;
+
+        // Skip over the event's data map.
+        uint32_t i, count = minipack_unpack_map(ptr, &sz);
+        if(sz == 0) {
+            minipack_unpack_nil(ptr, &sz);
+            if(sz == 0) break;
+        }
+        ptr += sz;
+        for(i=0; i<count*2 && sz > 0; i++) {
+            sz = minipack_sizeof_elem_and_data(ptr);
+            ptr += sz;
+        }
+        if(sz == 0) break;
+    }
+    return timestamp;
+}
+
 bool sky_lua_cursor_next_event(sky_cursor *cursor)
 {
     sky_cursor_next_event(cursor);
@@ -367,6 +574,112 @@ bool sky_lua_cursor_next_session(sky_cursor *cursor)
 
 
 
+//--------------------------------------
+// State
+//--------------------------------------
+
+// Decodes the current state of the object into a data object. The state is
+// stored at the beginning of each object as a raw element wrapping a single
+// event that holds the latest value of every permanent property. The data
+// object is cleared first. Returns true if the object has a valid state.
+bool sky_cursor_read_state(sky_cursor *cursor, void *target)
+{
+    size_t sz;
+    void *ptr = cursor->objectptr;
+    memset(target, 0, cursor->data_sz);
+    if(ptr == NULL || cursor->object_sz == 0 || !minipack_is_raw(ptr)) {
+        return false;
+    }
+
+    // Find the bounds of the state event.
+    uint32_t length = minipack_unpack_raw(ptr, &sz);
+    if(sz == 0 || length == 0 || sz + length > cursor->object_sz) {
+        return false;
+    }
+    ptr += sz;
+
+    // Read the flag and timestamp.
+    if(*((sky_event_flag_t*)ptr) != EVENT_FLAG) {
+        return false;
+    }
+    ptr += sizeof(sky_event_flag_t);
+    int64_t ts = minipack_unpack_int(ptr, &sz);
+    if(sz == 0) {
+        return false;
+    }
+    ptr += sz;
+    *((int64_t*)(target + cursor->timestamp_descriptor.ts_offset)) = ts;
+    *((uint32_t*)(target + cursor->timestamp_descriptor.timestamp_offset)) = sky_timestamp_to_seconds(ts);
+
+    // Read property values.
+    return (sky_cursor_read_properties(cursor, target, ptr) > 0);
+}
+
+// Moves the cursor to the current state of the object without reading any
+// events. The state is decoded into the event data object and the cursor is
+// then set to EOF so the event stream is never read. Returns true if the
+// object has a valid state.
+bool sky_cursor_next_state(sky_cursor *cursor)
+{
+    if(cursor->eof) {
+        return false;
+    }
+    cursor->eof = true;
+    cursor->in_session = false;
+
+    if(!sky_cursor_read_state(cursor, cursor->data)) {
+        return false;
+    }
+    if(cursor->time_bucket_descriptor.mask != 0) {
+        sky_cursor_set_time_buckets(cursor, *((uint32_t*)(cursor->data + cursor->timestamp_descriptor.timestamp_offset)));
+    }
+    return true;
+}
+
+
+//--------------------------------------
+// Properties
+//--------------------------------------
+
+// Reads a map of property ids and values into a data object. Values that
+// cannot be read are skipped. Returns the number of bytes read or zero if
+// the map is invalid.
+size_t sky_cursor_read_properties(sky_cursor *cursor, void *target, void *ptr)
+{
+    size_t sz;
+    void *start = ptr;
+
+    // Read msgpack map!
+    uint32_t count = minipack_unpack_map(ptr, &sz);
+    if(sz == 0) {
+        minipack_unpack_nil(ptr, &sz);
+        if(sz == 0) {
+            return 0;
+        }
+    }
+    ptr += sz;
+
+    // Loop over key/value pairs.
+    uint32_t i;
+    for(i=0; i<count; i++) {
+        // Read property id (key).
+        int64_t property_id = minipack_unpack_int(ptr, &sz);
+        if(sz == 0) return 0;
+        ptr += sz;
+
+        // Read property value and set it on the data object.
+        sky_cursor_set_value(cursor, target, property_id, ptr, &sz);
+        if(sz == 0) {
+            debug("[invalid read, skipping]");
+            sz = minipack_sizeof_elem_and_data(ptr);
+        }
+        ptr += sz;
+    }
+
+    return (size_t)(ptr - start);
+}
+
+
 //--------------------------------------
 // Setters
 //--------------------------------------
@@ -0,0 +1,417 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sky/expiry.h"
+#include "sky/cursor.h"
+#include "sky/minipack.h"
+#include "sky/timestamp.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+sky_expiry_table *sky_expiry_find(sky_expiry *expiry, const char *name, uint32_t name_length);
+
+size_t sky_expiry_sizeof_event(void *ptr, void *endptr, int64_t *timestamp);
+
+void *sky_expiry_event_map(void *ptr, uint32_t *count, size_t *sz);
+
+size_t sky_expiry_sizeof_pair(void *ptr);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an expiry without any tables.
+sky_expiry *sky_expiry_new()
+{
+    sky_expiry *expiry = calloc(1, sizeof(sky_expiry));
+    if(expiry == NULL) return NULL;
+    if(pthread_mutex_init(&expiry->mutex, NULL) != 0) {
+        free(expiry);
+        return NULL;
+    }
+    return expiry;
+}
+
+// Removes an expiry from memory.
+void sky_expiry_free(sky_expiry *expiry)
+{
+    if(expiry) {
+        uint32_t i;
+        for(i=0; i<expiry->table_count; i++) {
+            free(expiry->tables[i].name);
+        }
+        if(expiry->tables != NULL) free(expiry->tables);
+        pthread_mutex_destroy(&expiry->mutex);
+        free(expiry);
+    }
+}
+
+
+//--------------------------------------
+// Tables
+//--------------------------------------
+
+// Finds a table by name. The mutex must be held.
+sky_expiry_table *sky_expiry_find(sky_expiry *expiry, const char *name, uint32_t name_length)
+{
+    uint32_t i;
+    for(i=0; i<expiry->table_count; i++) {
+        sky_expiry_table *table = &expiry->tables[i];
+        if(table->name_length == name_length && memcmp(table->name, name, name_length) == 0) {
+            return table;
+        }
+    }
+    return NULL;
+}
+
+// Sets the retention period of a table.
+//
+// name        - The table name.
+// name_length - The length of the table name.
+// retention   - The number of seconds events are kept for or zero to keep
+//               every event.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_expiry_set_retention(sky_expiry *expiry, const char *name, uint32_t name_length, int64_t retention)
+{
+    if(retention < 0) return -1;
+
+    int rc = 0;
+    pthread_mutex_lock(&expiry->mutex);
+    sky_expiry_table *table = sky_expiry_find(expiry, name, name_length);
+    if(table == NULL) {
+        sky_expiry_table *tables = realloc(expiry->tables, (expiry->table_count + 1) * sizeof(sky_expiry_table));
+        char *copy = malloc(name_length > 0 ? name_length : 1);
+        if(tables != NULL) expiry->tables = tables;
+        if(tables == NULL || copy == NULL) {
+            free(copy);
+            rc = -1;
+        } else {
+            memcpy(copy, name, name_length);
+            table = &expiry->tables[expiry->table_count++];
+            memset(table, 0, sizeof(*table));
+            table->name = copy;
+            table->name_length = name_length;
+        }
+    }
+    if(table != NULL) {
+        table->retention = retention;
+    }
+    pthread_mutex_unlock(&expiry->mutex);
+    return rc;
+}
+
+// Retrieves the number of events and bytes expired from a table.
+void sky_expiry_stats(sky_expiry *expiry, const char *name, uint32_t name_length, uint64_t *events, uint64_t *bytes)
+{
+    pthread_mutex_lock(&expiry->mutex);
+    sky_expiry_table *table = sky_expiry_find(expiry, name, name_length);
+    *events = (table != NULL ? table->trimmed_events : 0);
+    *bytes = (table != NULL ? table->trimmed_bytes : 0);
+    pthread_mutex_unlock(&expiry->mutex);
+}
+
+
+//--------------------------------------
+// Trimming
+//--------------------------------------
+
+// Calculates the size of the event at the given position and reads its
+// timestamp. Returns zero if the event is invalid.
+size_t sky_expiry_sizeof_event(void *ptr, void *endptr, int64_t *timestamp)
+{
+    size_t sz;
+    void *start = ptr;
+
+    if(*((sky_event_flag_t*)ptr) != EVENT_FLAG) return 0;
+    ptr += sizeof(sky_event_flag_t);
+    if(ptr >= endptr) return 0;
+
+    *timestamp = minipack_unpack_int(ptr, &sz);
+    if(sz == 0) return 0;
+    ptr += sz;
+    if(ptr >= endptr) return 0;
+
+    // Skip over the map of property values.
+    uint32_t count = minipack_unpack_map(ptr, &sz);
+    if(sz == 0) {
+        minipack_unpack_nil(ptr, &sz);
+        if(sz == 0) return 0;
+    }
+    ptr += sz;
+
+    uint32_t i;
+    for(i=0; i<count*2; i++) {
+        if(ptr >= endptr) return 0;
+        sz = minipack_sizeof_elem_and_data(ptr);
+        if(sz == 0) return 0;
+        ptr += sz;
+    }
+    if(ptr > endptr) return 0;
+
+    return (size_t)(ptr - start);
+}
+
+// Finds the property map of a valid event.
+//
+// ptr   - A pointer to the event.
+// count - Returns the number of properties in the map.
+// sz    - Returns the size of the map header.
+//
+// Returns a pointer to the map header.
+void *sky_expiry_event_map(void *ptr, uint32_t *count, size_t *sz)
+{
+    ptr += sizeof(sky_event_flag_t);
+    minipack_unpack_int(ptr, sz);
+    ptr += *sz;
+    *count = minipack_unpack_map(ptr, sz);
+    if(*sz == 0) {
+        *count = 0;
+        minipack_unpack_nil(ptr, sz);
+    }
+    return ptr;
+}
+
+// Calculates the size of a property id and value pair in a valid event.
+size_t sky_expiry_sizeof_pair(void *ptr)
+{
+    size_t sz = minipack_sizeof_elem_and_data(ptr);
+    return sz + minipack_sizeof_elem_and_data(ptr + sz);
+}
+
+// Finds the events of an object that are older than a horizon. Events are
+// stored in timestamp order after the object's state so the expired events
+// are the ones between the state and the first event at or after the
+// horizon.
+//
+// ptr        - A pointer to the object's value.
+// sz         - The size of the value.
+// horizon    - The number of seconds since the epoch that events are kept
+//              from.
+// state_sz   - Returns the size of the state at the start of the value.
+// trimmed_sz - Returns the size of the expired events.
+// count      - Returns the number of expired events.
+//
+// Returns true if the value was read, otherwise returns false.
+bool sky_expiry_trim(void *ptr, size_t sz, int64_t horizon, size_t *state_sz, size_t *trimmed_sz, uint32_t *count)
+{
+    void *endptr = ptr + sz;
+    *state_sz = 0;
+    *trimmed_sz = 0;
+    *count = 0;
+
+    if(sz > 0 && minipack_is_raw(ptr)) {
+        *state_sz = minipack_sizeof_elem_and_data(ptr);
+        if(*state_sz == 0 || *state_sz > sz) return false;
+        ptr += *state_sz;
+    }
+
+    while(ptr < endptr) {
+        int64_t timestamp;
+        size_t event_sz = sky_expiry_sizeof_event(ptr, endptr, &timestamp);
+        if(event_sz == 0) return false;
+        if(sky_timestamp_to_seconds(timestamp) >= horizon) break;
+        ptr += event_sz;
+        *trimmed_sz += event_sz;
+        (*count)++;
+    }
+
+    return true;
+}
+
+
+// Writes an object value without its expired events. Events only store the
+// permanent property values that differ from the ones before them and the
+// cursor carries permanent values forward from event to event, so the last
+// permanent values set by the expired events are folded into the first
+// event that is kept unless it sets them itself.
+//
+// ptr        - A pointer to the object's value.
+// sz         - The size of the value.
+// state_sz   - The size of the state at the start of the value.
+// trimmed_sz - The size of the expired events after the state.
+// new_ptr    - A buffer for the new value of at least sz + 5 bytes. The
+//              folded values never take more space than the expired
+//              events but the map header of the first kept event may grow.
+// new_sz     - Returns the size of the new value.
+//
+// Returns true if successful, otherwise returns false.
+bool sky_expiry_rewrite(void *ptr, size_t sz, size_t state_sz, size_t trimmed_sz, void *new_ptr, size_t *new_sz)
+{
+    void *endptr = ptr + sz;
+    void *start = new_ptr;
+    memcpy(new_ptr, ptr, state_sz);
+    new_ptr += state_sz;
+    ptr += state_sz;
+
+    // Find the last value of each permanent property set by the expired
+    // events. Permanent properties have positive ids.
+    void **values = NULL;
+    uint32_t value_count = 0;
+    void *keptptr = ptr + trimmed_sz;
+    while(ptr < keptptr) {
+        int64_t timestamp;
+        size_t event_sz = sky_expiry_sizeof_event(ptr, endptr, &timestamp);
+        uint32_t i, j, count;
+        size_t map_sz;
+        void *pair = sky_expiry_event_map(ptr, &count, &map_sz) + map_sz;
+        for(i=0; i<count; i++) {
+            size_t key_sz, value_key_sz;
+            int64_t key = minipack_unpack_int(pair, &key_sz);
+            if(key_sz > 0 && key > 0) {
+                for(j=0; j<value_count; j++) {
+                    if(minipack_unpack_int(values[j], &value_key_sz) == key) break;
+                }
+                if(j == value_count) {
+                    void **new_values = realloc(values, (value_count + 1) * sizeof(*values));
+                    if(new_values == NULL) {
+                        free(values);
+                        return false;
+                    }
+                    values = new_values;
+                    value_count++;
+                }
+                values[j] = pair;
+            }
+            pair += sky_expiry_sizeof_pair(pair);
+        }
+        ptr += event_sz;
+    }
+
+    // Drop the values that the first kept event sets itself and write it
+    // with the rest of the values added to its map.
+    if(ptr < endptr && value_count > 0) {
+        uint32_t i, j, count;
+        size_t map_sz, key_sz, value_key_sz;
+        void *mapptr = sky_expiry_event_map(ptr, &count, &map_sz);
+        void *pairsptr = mapptr + map_sz;
+        void *pair = pairsptr;
+        uint32_t folded_count = value_count;
+        for(i=0; i<count; i++) {
+            int64_t key = minipack_unpack_int(pair, &key_sz);
+            for(j=0; key_sz > 0 && j<value_count; j++) {
+                if(values[j] != NULL && minipack_unpack_int(values[j], &value_key_sz) == key) {
+                    values[j] = NULL;
+                    folded_count--;
+                }
+            }
+            pair += sky_expiry_sizeof_pair(pair);
+        }
+
+        memcpy(new_ptr, ptr, mapptr - ptr);
+        new_ptr += mapptr - ptr;
+        minipack_pack_map(new_ptr, count + folded_count, &map_sz);
+        new_ptr += map_sz;
+        memcpy(new_ptr, pairsptr, pair - pairsptr);
+        new_ptr += pair - pairsptr;
+        ptr = pair;
+        for(j=0; j<value_count; j++) {
+            if(values[j] != NULL) {
+                size_t pair_sz = sky_expiry_sizeof_pair(values[j]);
+                memcpy(new_ptr, values[j], pair_sz);
+                new_ptr += pair_sz;
+            }
+        }
+    }
+    free(values);
+
+    memcpy(new_ptr, ptr, endptr - ptr);
+    new_ptr += endptr - ptr;
+    *new_sz = (size_t)(new_ptr - start);
+    return true;
+}
+
+
+//--------------------------------------
+// Compaction Filter
+//--------------------------------------
+
+// A LevelDB compaction filter that removes expired events from each object
+// value. The key of an object is a msgpack array of its table name and
+// object id. Keys are never removed so the state of an object outlives its
+// events.
+unsigned char sky_expiry_filter(void *state, int level,
+    const char *key, size_t key_length,
+    const char *value, size_t value_length,
+    char **new_value, size_t *new_value_length,
+    unsigned char *value_changed)
+{
+    ((void)(level));
+    sky_expiry *expiry = (sky_expiry*)state;
+    void *ptr = (void*)key;
+    size_t sz;
+
+    // Read the table name from the key.
+    if(key_length < 2 || minipack_unpack_fixarray(ptr, &sz) != 2 || sz == 0) {
+        return 0;
+    }
+    ptr += sz;
+    uint32_t name_length = minipack_unpack_raw(ptr, &sz);
+    if(sz == 0 || 1 + sz + name_length > key_length) {
+        return 0;
+    }
+    const char *name = (const char*)(ptr + sz);
+
+    pthread_mutex_lock(&expiry->mutex);
+    sky_expiry_table *table = sky_expiry_find(expiry, name, name_length);
+    int64_t retention = (table != NULL ? table->retention : 0);
+    int64_t now = (expiry->now != 0 ? expiry->now : (int64_t)time(NULL));
+    pthread_mutex_unlock(&expiry->mutex);
+    if(retention == 0) {
+        return 0;
+    }
+
+    size_t state_sz, trimmed_sz;
+    uint32_t count;
+    if(!sky_expiry_trim((void*)value, value_length, now - retention, &state_sz, &trimmed_sz, &count) || count == 0) {
+        return 0;
+    }
+
+    *new_value = malloc(value_length + 5);
+    if(*new_value == NULL) {
+        return 0;
+    }
+    if(!sky_expiry_rewrite((void*)value, value_length, state_sz, trimmed_sz, *new_value, new_value_length)) {
+        free(*new_value);
+        *new_value = NULL;
+        return 0;
+    }
+    *value_changed = 1;
+
+    pthread_mutex_lock(&expiry->mutex);
+    table = sky_expiry_find(expiry, name, name_length);
+    if(table != NULL) {
+        table->trimmed_events += count;
+        table->trimmed_bytes += value_length - *new_value_length;
+    }
+    pthread_mutex_unlock(&expiry->mutex);
+
+    return 0;
+}
+
+// The name of the compaction filter.
+const char *sky_expiry_name(void *state)
+{
+    ((void)(state));
+    return "sky.expiry";
+}
+
+// Removes the expiry from memory when LevelDB destroys its compaction
+// filter.
+void sky_expiry_destroy(void *state)
+{
+    sky_expiry_free((sky_expiry*)state);
+}
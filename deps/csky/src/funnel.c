@@ -0,0 +1,198 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "sky/funnel.h"
+
+
+//==============================================================================
+//
+// Constants
+//
+//==============================================================================
+
+// The initial number of positions in each step's queue.
+#define INITIAL_QUEUE_CAPACITY  16
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_funnel_queue_push(sky_funnel_queue *queue, int64_t position);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a funnel matcher. Every step after the first defaults to matching
+// any later event.
+//
+// step_count - The number of steps in the funnel.
+//
+// Returns a new funnel or NULL if the step count is out of range.
+sky_funnel *sky_funnel_new(uint32_t step_count)
+{
+    if(step_count == 0 || step_count > SKY_FUNNEL_MAX_STEPS) {
+        return NULL;
+    }
+
+    sky_funnel *funnel = calloc(1, sizeof(sky_funnel));
+    if(funnel == NULL) return NULL;
+    funnel->step_count = step_count;
+
+    uint32_t i;
+    for(i=0; i<step_count; i++) {
+        funnel->windows[i].unit = SKY_FUNNEL_UNIT_STEPS;
+        funnel->windows[i].start = 1;
+        funnel->windows[i].end = INT64_MAX;
+    }
+    return funnel;
+}
+
+// Removes a funnel matcher from memory.
+void sky_funnel_free(sky_funnel *funnel)
+{
+    if(funnel) {
+        uint32_t i;
+        for(i=0; i<SKY_FUNNEL_MAX_STEPS; i++) {
+            if(funnel->queues[i].positions != NULL) free(funnel->queues[i].positions);
+        }
+        free(funnel);
+    }
+}
+
+
+//--------------------------------------
+// Windows
+//--------------------------------------
+
+// Sets the window that a step must match within. The window is relative to
+// the event that matched the previous step so the first step has no window.
+//
+// funnel - The funnel.
+// step   - The index of the step.
+// unit   - The unit of the window, in events or seconds.
+// start  - The minimum distance from the previous step's event.
+// end    - The maximum distance from the previous step's event.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_funnel_set_window(sky_funnel *funnel, uint32_t step, uint8_t unit,
+                          int64_t start, int64_t end)
+{
+    if(step == 0 || step >= funnel->step_count) return -1;
+    if(unit != SKY_FUNNEL_UNIT_STEPS && unit != SKY_FUNNEL_UNIT_SECONDS) return -1;
+    if(start < 0 || start > end) return -1;
+
+    funnel->windows[step].unit = unit;
+    funnel->windows[step].start = start;
+    funnel->windows[step].end = end;
+    return 0;
+}
+
+
+//--------------------------------------
+// Matching
+//--------------------------------------
+
+// Clears all partial matches so the funnel can be run against a new object.
+void sky_funnel_reset(sky_funnel *funnel)
+{
+    uint32_t i;
+    for(i=0; i<funnel->step_count; i++) {
+        funnel->queues[i].head = 0;
+        funnel->queues[i].count = 0;
+    }
+    funnel->depth = 0;
+    funnel->index = 0;
+}
+
+// Advances the funnel by one event. Every partial match is tracked at once
+// by keeping, for each step, the positions of the events that completed it.
+// Positions that have fallen out of the next step's window are dropped so a
+// step only has to look at its oldest remaining position. Steps are checked
+// in order so that one event can match consecutive steps when a window
+// starts at zero.
+//
+// funnel    - The funnel.
+// mask      - A bitmask of the step predicates that the event matches.
+// timestamp - The time of the event, in seconds.
+//
+// Returns the number of steps reached so far.
+uint32_t sky_funnel_push(sky_funnel *funnel, uint32_t mask, uint32_t timestamp)
+{
+    int64_t index = funnel->index++;
+    uint32_t i;
+    for(i=0; i<funnel->step_count && mask != 0; i++) {
+        if((mask & ((uint32_t)1 << i)) == 0) continue;
+
+        // Check for a previous step that ended within this step's window.
+        if(i > 0) {
+            sky_funnel_queue *queue = &funnel->queues[i-1];
+            sky_funnel_window *window = &funnel->windows[i];
+            int64_t position = (window->unit == SKY_FUNNEL_UNIT_SECONDS ? (int64_t)timestamp : index);
+            while(queue->count > 0 && queue->positions[queue->head] < position - window->end) {
+                queue->head = (queue->head + 1) % queue->capacity;
+                queue->count--;
+            }
+            if(queue->count == 0 || queue->positions[queue->head] > position - window->start) {
+                continue;
+            }
+        }
+
+        if(i + 1 > funnel->depth) {
+            funnel->depth = i + 1;
+        }
+
+        // Record where this step ended for the next step. If the queue
+        // cannot grow then the match is dropped.
+        if(i + 1 < funnel->step_count) {
+            sky_funnel_window *next = &funnel->windows[i+1];
+            int64_t position = (next->unit == SKY_FUNNEL_UNIT_SECONDS ? (int64_t)timestamp : index);
+            sky_funnel_queue_push(&funnel->queues[i], position);
+        }
+    }
+
+    return funnel->depth;
+}
+
+// Appends a position to a queue unless it is the same as the last position.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_funnel_queue_push(sky_funnel_queue *queue, int64_t position)
+{
+    if(queue->count > 0) {
+        uint32_t last = (queue->head + queue->count - 1) % queue->capacity;
+        if(queue->positions[last] == position) {
+            return 0;
+        }
+    }
+
+    // Grow the ring buffer and unwrap it to start at zero.
+    if(queue->count == queue->capacity) {
+        uint32_t capacity = (queue->capacity > 0 ? queue->capacity * 2 : INITIAL_QUEUE_CAPACITY);
+        int64_t *positions = malloc(capacity * sizeof(int64_t));
+        if(positions == NULL) return -1;
+
+        uint32_t i;
+        for(i=0; i<queue->count; i++) {
+            positions[i] = queue->positions[(queue->head + i) % queue->capacity];
+        }
+        if(queue->positions != NULL) free(queue->positions);
+        queue->positions = positions;
+        queue->head = 0;
+        queue->capacity = capacity;
+    }
+
+    queue->positions[(queue->head + queue->count) % queue->capacity] = position;
+    queue->count++;
+    return 0;
+}
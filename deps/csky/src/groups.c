@@ -0,0 +1,286 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "sky/groups.h"
+
+
+//==============================================================================
+//
+// Constants
+//
+//==============================================================================
+
+// The initial number of groups and hash buckets.
+#define INITIAL_CAPACITY   16
+#define INITIAL_BUCKETS    32
+
+// The tags that prefix each value in a packed key.
+#define KEY_TAG_DOUBLE     'd'
+#define KEY_TAG_STRING     's'
+
+// The FNV-1a 64-bit offset basis and prime.
+#define FNV_OFFSET_BASIS   0xcbf29ce484222325ULL
+#define FNV_PRIME          0x100000001b3ULL
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_groups_key_append(sky_groups *groups, void *ptr, size_t sz);
+
+uint64_t sky_groups_hash(void *ptr, size_t sz);
+
+int sky_groups_grow(sky_groups *groups);
+
+int sky_groups_rehash(sky_groups *groups, uint32_t bucket_count);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a group table.
+//
+// width   - The number of doubles in each group's slot.
+// initial - The values that each new slot starts with.
+//
+// Returns a new group table or NULL if memory could not be allocated.
+sky_groups *sky_groups_new(uint32_t width, double *initial)
+{
+    sky_groups *groups = calloc(1, sizeof(sky_groups));
+    if(groups == NULL) return NULL;
+    groups->width = width;
+
+    groups->initial = calloc(width > 0 ? width : 1, sizeof(double));
+    if(groups->initial == NULL) goto error;
+    if(width > 0 && initial != NULL) {
+        memcpy(groups->initial, initial, width * sizeof(double));
+    }
+
+    groups->capacity = INITIAL_CAPACITY;
+    groups->values = calloc(groups->capacity * (width > 0 ? width : 1), sizeof(double));
+    groups->hashes = calloc(groups->capacity, sizeof(uint64_t));
+    groups->key_offsets = calloc(groups->capacity, sizeof(size_t));
+    groups->key_sizes = calloc(groups->capacity, sizeof(uint32_t));
+    if(groups->values == NULL || groups->hashes == NULL || groups->key_offsets == NULL || groups->key_sizes == NULL) goto error;
+
+    if(sky_groups_rehash(groups, INITIAL_BUCKETS) != 0) goto error;
+    return groups;
+
+error:
+    sky_groups_free(groups);
+    return NULL;
+}
+
+// Removes a group table from memory.
+void sky_groups_free(sky_groups *groups)
+{
+    if(groups) {
+        if(groups->values != NULL) free(groups->values);
+        if(groups->initial != NULL) free(groups->initial);
+        if(groups->buckets != NULL) free(groups->buckets);
+        if(groups->hashes != NULL) free(groups->hashes);
+        if(groups->key_offsets != NULL) free(groups->key_offsets);
+        if(groups->key_sizes != NULL) free(groups->key_sizes);
+        if(groups->keys != NULL) free(groups->keys);
+        if(groups->key != NULL) free(groups->key);
+        free(groups);
+    }
+}
+
+
+//--------------------------------------
+// Keys
+//--------------------------------------
+
+// Clears the key being built for the next lookup.
+void sky_groups_key_reset(sky_groups *groups)
+{
+    groups->key_sz = 0;
+}
+
+// Appends a numeric dimension value to the key.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_groups_key_add_double(sky_groups *groups, double value)
+{
+    // Negative zero should match zero.
+    if(value == 0) {
+        value = 0;
+    }
+
+    char buffer[1 + sizeof(double)];
+    buffer[0] = KEY_TAG_DOUBLE;
+    memcpy(&buffer[1], &value, sizeof(double));
+    return sky_groups_key_append(groups, buffer, sizeof(buffer));
+}
+
+// Appends a string dimension value to the key. The length is included so
+// that adjacent strings cannot run together.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_groups_key_add_string(sky_groups *groups, void *ptr, size_t sz)
+{
+    char buffer[1 + sizeof(uint32_t)];
+    uint32_t length = (uint32_t)sz;
+    buffer[0] = KEY_TAG_STRING;
+    memcpy(&buffer[1], &length, sizeof(uint32_t));
+    if(sky_groups_key_append(groups, buffer, sizeof(buffer)) != 0) {
+        return -1;
+    }
+    return sky_groups_key_append(groups, ptr, sz);
+}
+
+// Appends raw bytes to the key, growing the key buffer if needed.
+int sky_groups_key_append(sky_groups *groups, void *ptr, size_t sz)
+{
+    if(groups->key_sz + sz > groups->key_capacity) {
+        size_t capacity = (groups->key_capacity > 0 ? groups->key_capacity : 64);
+        while(groups->key_sz + sz > capacity) capacity *= 2;
+        char *key = realloc(groups->key, capacity);
+        if(key == NULL) return -1;
+        groups->key = key;
+        groups->key_capacity = capacity;
+    }
+    if(sz > 0) {
+        memcpy(groups->key + groups->key_sz, ptr, sz);
+    }
+    groups->key_sz += sz;
+    return 0;
+}
+
+// Hashes a key with FNV-1a followed by the MurmurHash3 finalizer so that
+// the low bits used for bucket selection are well distributed.
+uint64_t sky_groups_hash(void *ptr, size_t sz)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    uint8_t *data = (uint8_t*)ptr;
+    size_t i;
+    for(i=0; i<sz; i++) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+
+//--------------------------------------
+// Lookup
+//--------------------------------------
+
+// Finds the group for the current key using linear probing. A new group is
+// created with the initial slot values if the key has not been seen before.
+//
+// Returns the index of the group or -1 if memory could not be allocated.
+int32_t sky_groups_lookup(sky_groups *groups)
+{
+    uint64_t hash = sky_groups_hash(groups->key, groups->key_sz);
+    uint32_t mask = groups->bucket_count - 1;
+    uint32_t bucket = (uint32_t)hash & mask;
+
+    while(groups->buckets[bucket] != -1) {
+        int32_t index = groups->buckets[bucket];
+        if(groups->hashes[index] == hash && groups->key_sizes[index] == groups->key_sz &&
+           memcmp(groups->keys + groups->key_offsets[index], groups->key, groups->key_sz) == 0)
+        {
+            return index;
+        }
+        bucket = (bucket + 1) & mask;
+    }
+
+    // Add a new group.
+    if(groups->count == groups->capacity && sky_groups_grow(groups) != 0) {
+        return -1;
+    }
+    if(groups->keys_sz + groups->key_sz > groups->keys_capacity) {
+        size_t capacity = (groups->keys_capacity > 0 ? groups->keys_capacity : 256);
+        while(groups->keys_sz + groups->key_sz > capacity) capacity *= 2;
+        char *keys = realloc(groups->keys, capacity);
+        if(keys == NULL) return -1;
+        groups->keys = keys;
+        groups->keys_capacity = capacity;
+    }
+
+    int32_t index = (int32_t)groups->count;
+    if(groups->key_sz > 0) {
+        memcpy(groups->keys + groups->keys_sz, groups->key, groups->key_sz);
+    }
+    groups->key_offsets[index] = groups->keys_sz;
+    groups->key_sizes[index] = (uint32_t)groups->key_sz;
+    groups->keys_sz += groups->key_sz;
+    groups->hashes[index] = hash;
+    memcpy(&groups->values[index * groups->width], groups->initial, groups->width * sizeof(double));
+    groups->buckets[bucket] = index;
+    groups->count++;
+
+    // Keep the load factor at or below one half.
+    if(groups->count * 2 > groups->bucket_count) {
+        if(sky_groups_rehash(groups, groups->bucket_count * 2) != 0) {
+            return -1;
+        }
+    }
+    return index;
+}
+
+// Doubles the number of groups that can be stored.
+int sky_groups_grow(sky_groups *groups)
+{
+    uint32_t capacity = groups->capacity * 2;
+    uint32_t width = (groups->width > 0 ? groups->width : 1);
+
+    double *values = realloc(groups->values, (size_t)capacity * width * sizeof(double));
+    if(values == NULL) return -1;
+    groups->values = values;
+
+    uint64_t *hashes = realloc(groups->hashes, capacity * sizeof(uint64_t));
+    if(hashes == NULL) return -1;
+    groups->hashes = hashes;
+
+    size_t *key_offsets = realloc(groups->key_offsets, capacity * sizeof(size_t));
+    if(key_offsets == NULL) return -1;
+    groups->key_offsets = key_offsets;
+
+    uint32_t *key_sizes = realloc(groups->key_sizes, capacity * sizeof(uint32_t));
+    if(key_sizes == NULL) return -1;
+    groups->key_sizes = key_sizes;
+
+    groups->capacity = capacity;
+    return 0;
+}
+
+// Rebuilds the hash buckets with a new bucket count. The bucket count must
+// be a power of two.
+int sky_groups_rehash(sky_groups *groups, uint32_t bucket_count)
+{
+    int32_t *buckets = malloc(bucket_count * sizeof(int32_t));
+    if(buckets == NULL) return -1;
+    memset(buckets, 0xFF, bucket_count * sizeof(int32_t));
+
+    uint32_t i, mask = bucket_count - 1;
+    for(i=0; i<groups->count; i++) {
+        uint32_t bucket = (uint32_t)groups->hashes[i] & mask;
+        while(buckets[bucket] != -1) {
+            bucket = (bucket + 1) & mask;
+        }
+        buckets[bucket] = (int32_t)i;
+    }
+
+    if(groups->buckets != NULL) free(groups->buckets);
+    groups->buckets = buckets;
+    groups->bucket_count = bucket_count;
+    return 0;
+}
@@ -0,0 +1,222 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sky/hll.h"
+
+
+//==============================================================================
+//
+// Constants
+//
+//==============================================================================
+
+// The FNV-1a 64-bit offset basis and prime.
+#define FNV_OFFSET_BASIS  0xcbf29ce484222325ULL
+#define FNV_PRIME         0x100000001b3ULL
+
+// An offset added to numeric values before mixing so that zero does not
+// hash to zero.
+#define DOUBLE_SEED       0x9e3779b97f4a7c15ULL
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+uint64_t sky_hll_fmix64(uint64_t value);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a HyperLogLog sketch with 2^precision registers. The standard
+// error of the estimate is roughly 1.04 / sqrt(2^precision).
+//
+// precision - The number of bits used to select a register.
+//
+// Returns a new sketch or NULL if the precision is out of range.
+sky_hll *sky_hll_new(uint8_t precision)
+{
+    if(precision < SKY_HLL_MIN_PRECISION || precision > SKY_HLL_MAX_PRECISION) {
+        return NULL;
+    }
+
+    sky_hll *hll = calloc(1, sizeof(sky_hll) + ((size_t)1 << precision));
+    if(hll != NULL) {
+        hll->precision = precision;
+    }
+    return hll;
+}
+
+// Removes a sketch from memory.
+void sky_hll_free(sky_hll *hll)
+{
+    if(hll) {
+        free(hll);
+    }
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Calculates the size of a sketch, including its precision byte. The memory
+// of the sketch can be copied directly to serialize it.
+size_t sky_hll_sizeof(sky_hll *hll)
+{
+    return sizeof(sky_hll) + ((size_t)1 << hll->precision);
+}
+
+// Checks if a block of memory contains a serialized sketch.
+//
+// ptr - A pointer to the serialized sketch.
+// sz  - The size of the serialized sketch.
+//
+// Returns true if the memory is a valid sketch.
+bool sky_hll_validate(void *ptr, size_t sz)
+{
+    if(ptr == NULL || sz < sizeof(sky_hll)) {
+        return false;
+    }
+    sky_hll *hll = (sky_hll*)ptr;
+    if(hll->precision < SKY_HLL_MIN_PRECISION || hll->precision > SKY_HLL_MAX_PRECISION) {
+        return false;
+    }
+    return (sz == sky_hll_sizeof(hll));
+}
+
+
+//--------------------------------------
+// Values
+//--------------------------------------
+
+// Adds a 64-bit hash to the sketch. The top bits of the hash select the
+// register and the position of the first set bit in the remaining bits is
+// kept if it is larger than the current register value.
+void sky_hll_add_hash(sky_hll *hll, uint64_t hash)
+{
+    uint8_t precision = hll->precision;
+    uint64_t index = hash >> (64 - precision);
+    uint64_t w = hash << precision;
+    uint8_t rank = (w == 0 ? (64 - precision + 1) : (__builtin_clzll(w) + 1));
+
+    if(rank > hll->registers[index]) {
+        hll->registers[index] = rank;
+    }
+}
+
+// Adds a numeric value to the sketch.
+void sky_hll_add_double(sky_hll *hll, double value)
+{
+    // Negative zero should be counted as zero.
+    if(value == 0) {
+        value = 0;
+    }
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    sky_hll_add_hash(hll, sky_hll_fmix64(bits + DOUBLE_SEED));
+}
+
+// Adds a string to the sketch.
+//
+// ptr - A pointer to the string data.
+// sz  - The length of the string.
+void sky_hll_add_string(sky_hll *hll, void *ptr, size_t sz)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    uint8_t *data = (uint8_t*)ptr;
+    size_t i;
+    for(i=0; i<sz; i++) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    sky_hll_add_hash(hll, sky_hll_fmix64(hash));
+}
+
+// Scrambles the bits of a hash so that each input bit affects every output
+// bit. This is the MurmurHash3 finalizer.
+uint64_t sky_hll_fmix64(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+
+//--------------------------------------
+// Merge
+//--------------------------------------
+
+// Merges a serialized sketch into a sketch by taking the maximum of each
+// register. The result is the sketch of the union of both sets.
+//
+// hll - The sketch to merge into.
+// ptr - A pointer to the serialized sketch.
+// sz  - The size of the serialized sketch.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_hll_merge(sky_hll *hll, void *ptr, size_t sz)
+{
+    if(!sky_hll_validate(ptr, sz) || ((sky_hll*)ptr)->precision != hll->precision) {
+        return -1;
+    }
+
+    uint8_t *registers = ((sky_hll*)ptr)->registers;
+    size_t i, m = (size_t)1 << hll->precision;
+    for(i=0; i<m; i++) {
+        if(registers[i] > hll->registers[i]) {
+            hll->registers[i] = registers[i];
+        }
+    }
+    return 0;
+}
+
+
+//--------------------------------------
+// Estimation
+//--------------------------------------
+
+// Estimates the number of distinct values added to the sketch. Small
+// cardinalities use linear counting over the empty registers since the raw
+// estimate is biased when few registers are set.
+double sky_hll_estimate(sky_hll *hll)
+{
+    size_t i, m = (size_t)1 << hll->precision;
+    double sum = 0;
+    size_t zeros = 0;
+    for(i=0; i<m; i++) {
+        sum += 1.0 / (double)(1ULL << hll->registers[i]);
+        if(hll->registers[i] == 0) {
+            zeros++;
+        }
+    }
+
+    double alpha;
+    switch(m) {
+        case 16: alpha = 0.673; break;
+        case 32: alpha = 0.697; break;
+        case 64: alpha = 0.709; break;
+        default: alpha = 0.7213 / (1.0 + 1.079 / (double)m); break;
+    }
+    double estimate = alpha * (double)m * (double)m / sum;
+
+    if(estimate <= 2.5 * (double)m && zeros > 0) {
+        estimate = (double)m * log((double)m / (double)zeros);
+    }
+    return estimate;
+}
@@ -0,0 +1,405 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "sky/paths.h"
+
+
+//==============================================================================
+//
+// Constants
+//
+//==============================================================================
+
+// The FNV-1a 64-bit offset basis and prime.
+#define FNV_OFFSET_BASIS  0xcbf29ce484222325ULL
+#define FNV_PRIME         0x100000001b3ULL
+
+#define SKETCH_SIZE  (SKY_PATHS_SKETCH_DEPTH * SKY_PATHS_SKETCH_WIDTH)
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+uint64_t sky_paths_hash(int64_t *values, uint32_t length);
+
+uint32_t sky_paths_sketch_estimate(sky_paths *paths, uint64_t hash);
+
+sky_path *sky_paths_find(sky_path *list, uint32_t count, uint64_t hash, int64_t *values, uint32_t length);
+
+int sky_path_cmp(const void *a, const void *b);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an empty set of path counts.
+//
+// steps     - The maximum number of values in each path.
+// direction - SKY_PATHS_NEXT or SKY_PATHS_PREVIOUS.
+// capacity  - The number of heavy hitters to keep.
+//
+// Returns a new set of path counts or NULL if the arguments are out of range.
+sky_paths *sky_paths_new(uint32_t steps, uint32_t direction, uint32_t capacity)
+{
+    if(steps == 0 || steps > SKY_PATHS_MAX_STEPS || capacity == 0 || capacity > SKY_PATHS_MAX_CAPACITY) {
+        return NULL;
+    }
+    if(direction != SKY_PATHS_NEXT && direction != SKY_PATHS_PREVIOUS) {
+        return NULL;
+    }
+
+    sky_paths *paths = calloc(1, sizeof(sky_paths));
+    if(paths == NULL) return NULL;
+    paths->steps = steps;
+    paths->direction = direction;
+    paths->capacity = capacity;
+
+    paths->sketch = calloc(SKETCH_SIZE, sizeof(uint32_t));
+    paths->paths = calloc(capacity, sizeof(sky_path));
+    if(paths->sketch == NULL || paths->paths == NULL) {
+        sky_paths_free(paths);
+        return NULL;
+    }
+    return paths;
+}
+
+// Removes a set of path counts from memory.
+void sky_paths_free(sky_paths *paths)
+{
+    if(paths) {
+        if(paths->sketch != NULL) free(paths->sketch);
+        if(paths->paths != NULL) free(paths->paths);
+        free(paths);
+    }
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Calculates the number of bytes needed to serialize a set of path counts.
+size_t sky_paths_sizeof(sky_paths *paths)
+{
+    return sizeof(sky_paths_header) +
+        (SKETCH_SIZE * sizeof(uint32_t)) +
+        (paths->path_count * sizeof(sky_path));
+}
+
+// Serializes a set of path counts into a buffer of at least
+// sky_paths_sizeof() bytes.
+void sky_paths_pack(sky_paths *paths, void *ptr)
+{
+    sky_paths_header header;
+    header.steps = paths->steps;
+    header.direction = paths->direction;
+    header.capacity = paths->capacity;
+    header.path_count = paths->path_count;
+    memcpy(ptr, &header, sizeof(header));
+    ptr += sizeof(header);
+    memcpy(ptr, paths->sketch, SKETCH_SIZE * sizeof(uint32_t));
+    ptr += SKETCH_SIZE * sizeof(uint32_t);
+    memcpy(ptr, paths->paths, paths->path_count * sizeof(sky_path));
+}
+
+// Deserializes a set of path counts.
+//
+// ptr - A pointer to the serialized path counts.
+// sz  - The size of the serialized path counts.
+//
+// Returns a new set of path counts or NULL if the data is not valid.
+sky_paths *sky_paths_unpack(void *ptr, size_t sz)
+{
+    if(ptr == NULL || sz < sizeof(sky_paths_header)) {
+        return NULL;
+    }
+
+    sky_paths_header header;
+    memcpy(&header, ptr, sizeof(header));
+    sky_paths *paths = sky_paths_new(header.steps, header.direction, header.capacity);
+    if(paths == NULL) {
+        return NULL;
+    }
+    if(sky_paths_merge(paths, ptr, sz) != 0) {
+        sky_paths_free(paths);
+        return NULL;
+    }
+    return paths;
+}
+
+
+//--------------------------------------
+// Objects
+//--------------------------------------
+
+// Starts tracking a new object.
+void sky_paths_begin(sky_paths *paths)
+{
+    paths->event_count = 0;
+}
+
+// Adds an event of the current object. With SKY_PATHS_NEXT the values of the
+// events that follow each anchor event are counted once they are known. With
+// SKY_PATHS_PREVIOUS the values of the events leading up to an anchor event
+// are counted when the anchor is seen. The anchor's own value is not part of
+// its path.
+//
+// paths  - The path counts.
+// anchor - Whether the event is an anchor event.
+// value  - The value of the event.
+void sky_paths_push(sky_paths *paths, bool anchor, int64_t value)
+{
+    uint32_t i;
+    uint32_t n = paths->event_count;
+    uint32_t size = paths->steps + 1;
+    int64_t values[SKY_PATHS_MAX_STEPS];
+
+    if(paths->direction == SKY_PATHS_PREVIOUS) {
+        if(anchor) {
+            uint32_t length = (n < paths->steps ? n : paths->steps);
+            for(i=0; i<length; i++) {
+                values[i] = paths->history[(n - length + i) % size];
+            }
+            sky_paths_add(paths, values, length);
+        }
+    }
+    else if(n >= paths->steps && paths->anchors[(n - paths->steps) % size]) {
+        // The anchor's slot is not overwritten until after its path is read.
+        uint32_t start = n - paths->steps + 1;
+        for(i=0; i<paths->steps - 1; i++) {
+            values[i] = paths->history[(start + i) % size];
+        }
+        values[paths->steps - 1] = value;
+        sky_paths_add(paths, values, paths->steps);
+    }
+
+    paths->history[n % size] = value;
+    paths->anchors[n % size] = anchor;
+    paths->event_count++;
+}
+
+// Finishes the current object. Anchors that are followed by fewer events
+// than the number of steps have their shorter paths counted.
+void sky_paths_end(sky_paths *paths)
+{
+    if(paths->direction != SKY_PATHS_NEXT) {
+        return;
+    }
+
+    uint32_t i, j;
+    uint32_t n = paths->event_count;
+    uint32_t size = paths->steps + 1;
+    int64_t values[SKY_PATHS_MAX_STEPS];
+    for(i=(n > paths->steps ? n - paths->steps : 0); i<n; i++) {
+        if(paths->anchors[i % size]) {
+            uint32_t length = n - i - 1;
+            for(j=0; j<length; j++) {
+                values[j] = paths->history[(i + 1 + j) % size];
+            }
+            sky_paths_add(paths, values, length);
+        }
+    }
+    paths->event_count = 0;
+}
+
+
+//--------------------------------------
+// Counting
+//--------------------------------------
+
+// Counts a path in the sketch and updates the heavy hitters. A path that is
+// not yet a heavy hitter replaces the least frequent one once its estimated
+// count is higher.
+//
+// paths  - The path counts.
+// values - The values of the path.
+// length - The number of values in the path.
+void sky_paths_add(sky_paths *paths, int64_t *values, uint32_t length)
+{
+    uint32_t d;
+    uint64_t hash = sky_paths_hash(values, length);
+    uint32_t h1 = (uint32_t)hash, h2 = (uint32_t)(hash >> 32) | 1;
+    for(d=0; d<SKY_PATHS_SKETCH_DEPTH; d++) {
+        paths->sketch[(d * SKY_PATHS_SKETCH_WIDTH) + ((h1 + d * h2) % SKY_PATHS_SKETCH_WIDTH)]++;
+    }
+    uint32_t estimate = sky_paths_sketch_estimate(paths, hash);
+
+    // Update the path if it is already a heavy hitter.
+    sky_path *path = sky_paths_find(paths->paths, paths->path_count, hash, values, length);
+    if(path != NULL) {
+        path->count = estimate;
+        return;
+    }
+
+    // Otherwise add it if there is room or replace the least frequent path.
+    if(paths->path_count < paths->capacity) {
+        path = &paths->paths[paths->path_count++];
+    } else {
+        uint32_t i;
+        path = &paths->paths[0];
+        for(i=1; i<paths->path_count; i++) {
+            if(paths->paths[i].count < path->count) {
+                path = &paths->paths[i];
+            }
+        }
+        if(estimate <= path->count) {
+            return;
+        }
+    }
+    memset(path, 0, sizeof(*path));
+    path->hash = hash;
+    path->count = estimate;
+    path->length = length;
+    memcpy(path->values, values, length * sizeof(int64_t));
+}
+
+// Estimates the number of times a path has been counted.
+uint32_t sky_paths_estimate(sky_paths *paths, int64_t *values, uint32_t length)
+{
+    return sky_paths_sketch_estimate(paths, sky_paths_hash(values, length));
+}
+
+// Hashes the values of a path with FNV-1a.
+uint64_t sky_paths_hash(int64_t *values, uint32_t length)
+{
+    uint32_t i, j;
+    uint64_t hash = FNV_OFFSET_BASIS;
+    hash = (hash ^ length) * FNV_PRIME;
+    for(i=0; i<length; i++) {
+        uint64_t value = (uint64_t)values[i];
+        for(j=0; j<8; j++) {
+            hash = (hash ^ ((value >> (j * 8)) & 0xFF)) * FNV_PRIME;
+        }
+    }
+    return hash;
+}
+
+// Retrieves the minimum count of a hash across the rows of the sketch.
+uint32_t sky_paths_sketch_estimate(sky_paths *paths, uint64_t hash)
+{
+    uint32_t d;
+    uint32_t h1 = (uint32_t)hash, h2 = (uint32_t)(hash >> 32) | 1;
+    uint32_t estimate = UINT32_MAX;
+    for(d=0; d<SKY_PATHS_SKETCH_DEPTH; d++) {
+        uint32_t count = paths->sketch[(d * SKY_PATHS_SKETCH_WIDTH) + ((h1 + d * h2) % SKY_PATHS_SKETCH_WIDTH)];
+        if(count < estimate) estimate = count;
+    }
+    return estimate;
+}
+
+// Finds a path in a list.
+//
+// Returns a pointer to the path or NULL if it is not in the list.
+sky_path *sky_paths_find(sky_path *list, uint32_t count, uint64_t hash, int64_t *values, uint32_t length)
+{
+    uint32_t i;
+    for(i=0; i<count; i++) {
+        if(list[i].hash == hash && list[i].length == length && memcmp(list[i].values, values, length * sizeof(int64_t)) == 0) {
+            return &list[i];
+        }
+    }
+    return NULL;
+}
+
+
+//--------------------------------------
+// Merge
+//--------------------------------------
+
+// Adds serialized path counts into a set of path counts. The sketches are
+// summed and the union of both heavy hitter lists is re-estimated against the
+// merged sketch before keeping the most frequent paths. Both sets must use
+// the same steps, direction and capacity.
+//
+// paths - The path counts to merge into.
+// ptr   - A pointer to the serialized path counts.
+// sz    - The size of the serialized path counts.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_paths_merge(sky_paths *paths, void *ptr, size_t sz)
+{
+    if(ptr == NULL || sz < sizeof(sky_paths_header)) {
+        return -1;
+    }
+
+    sky_paths_header header;
+    memcpy(&header, ptr, sizeof(header));
+    if(header.steps != paths->steps || header.direction != paths->direction || header.capacity != paths->capacity) {
+        return -1;
+    }
+    if(header.path_count > header.capacity || sz != sizeof(header) + (SKETCH_SIZE * sizeof(uint32_t)) + (header.path_count * sizeof(sky_path))) {
+        return -1;
+    }
+
+    // Sum the sketches.
+    uint32_t i;
+    void *sketch = ptr + sizeof(header);
+    for(i=0; i<SKETCH_SIZE; i++) {
+        uint32_t count;
+        memcpy(&count, sketch + (i * sizeof(uint32_t)), sizeof(count));
+        paths->sketch[i] += count;
+    }
+
+    // Collect the union of the heavy hitters.
+    sky_path *candidates = malloc((paths->path_count + header.path_count) * sizeof(sky_path) + 1);
+    if(candidates == NULL) return -1;
+    uint32_t count = paths->path_count;
+    memcpy(candidates, paths->paths, count * sizeof(sky_path));
+    void *list = sketch + (SKETCH_SIZE * sizeof(uint32_t));
+    for(i=0; i<header.path_count; i++) {
+        sky_path path;
+        memcpy(&path, list + (i * sizeof(sky_path)), sizeof(path));
+        if(path.length > paths->steps) {
+            free(candidates);
+            return -1;
+        }
+        if(sky_paths_find(candidates, paths->path_count, path.hash, path.values, path.length) == NULL) {
+            candidates[count++] = path;
+        }
+    }
+
+    // Keep the most frequent paths.
+    for(i=0; i<count; i++) {
+        candidates[i].count = sky_paths_sketch_estimate(paths, candidates[i].hash);
+    }
+    qsort(candidates, count, sizeof(sky_path), sky_path_cmp);
+    paths->path_count = (count < paths->capacity ? count : paths->capacity);
+    memcpy(paths->paths, candidates, paths->path_count * sizeof(sky_path));
+    free(candidates);
+
+    return 0;
+}
+
+// Sorts the heavy hitters from most to least frequent.
+void sky_paths_sort(sky_paths *paths)
+{
+    qsort(paths->paths, paths->path_count, sizeof(sky_path), sky_path_cmp);
+}
+
+// Orders paths by descending count and then by their values so that the
+// order is deterministic.
+int sky_path_cmp(const void *_a, const void *_b)
+{
+    const sky_path *a = _a, *b = _b;
+    if(a->count != b->count) {
+        return (a->count > b->count ? -1 : 1);
+    }
+
+    uint32_t i;
+    for(i=0; i<a->length && i<b->length; i++) {
+        if(a->values[i] != b->values[i]) {
+            return (a->values[i] < b->values[i] ? -1 : 1);
+        }
+    }
+    return (int)a->length - (int)b->length;
+}
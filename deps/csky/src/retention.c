@@ -0,0 +1,306 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "sky/retention.h"
+
+
+//==============================================================================
+//
+// Constants
+//
+//==============================================================================
+
+// The initial number of rows allocated for a matrix.
+#define INITIAL_ROW_CAPACITY  16
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int64_t sky_retention_period_index(sky_retention *retention, uint32_t timestamp);
+
+int32_t sky_retention_row(sky_retention *retention, int64_t cohort);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an empty retention matrix.
+//
+// period  - The length of each period, in seconds.
+// offset  - The number of seconds after the epoch that periods are aligned to.
+// periods - The number of periods tracked after the start of each cohort.
+//
+// Returns a new matrix or NULL if the arguments are out of range.
+sky_retention *sky_retention_new(uint32_t period, uint32_t offset, uint32_t periods)
+{
+    if(period == 0 || periods == 0 || periods > SKY_RETENTION_MAX_PERIODS) {
+        return NULL;
+    }
+
+    sky_retention *retention = calloc(1, sizeof(sky_retention));
+    if(retention == NULL) return NULL;
+    retention->period = period;
+    retention->offset = offset % period;
+    retention->periods = periods;
+
+    retention->active = calloc((periods + 63) / 64, sizeof(uint64_t));
+    if(retention->active == NULL) {
+        sky_retention_free(retention);
+        return NULL;
+    }
+    return retention;
+}
+
+// Removes a matrix from memory.
+void sky_retention_free(sky_retention *retention)
+{
+    if(retention) {
+        if(retention->cohorts != NULL) free(retention->cohorts);
+        if(retention->counts != NULL) free(retention->counts);
+        if(retention->active != NULL) free(retention->active);
+        free(retention);
+    }
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Calculates the number of bytes needed to serialize a matrix.
+size_t sky_retention_sizeof(sky_retention *retention)
+{
+    return sizeof(sky_retention_header) +
+        (retention->row_count * sizeof(int64_t)) +
+        ((size_t)retention->row_count * retention->periods * sizeof(uint32_t));
+}
+
+// Serializes a matrix into a buffer of at least sky_retention_sizeof() bytes.
+void sky_retention_pack(sky_retention *retention, void *ptr)
+{
+    sky_retention_header header;
+    header.period = retention->period;
+    header.offset = retention->offset;
+    header.periods = retention->periods;
+    header.row_count = retention->row_count;
+    memcpy(ptr, &header, sizeof(header));
+    ptr += sizeof(header);
+    memcpy(ptr, retention->cohorts, retention->row_count * sizeof(int64_t));
+    ptr += retention->row_count * sizeof(int64_t);
+    memcpy(ptr, retention->counts, (size_t)retention->row_count * retention->periods * sizeof(uint32_t));
+}
+
+// Deserializes a matrix.
+//
+// ptr - A pointer to the serialized matrix.
+// sz  - The size of the serialized matrix.
+//
+// Returns a new matrix or NULL if the data is not a valid matrix.
+sky_retention *sky_retention_unpack(void *ptr, size_t sz)
+{
+    if(ptr == NULL || sz < sizeof(sky_retention_header)) {
+        return NULL;
+    }
+
+    sky_retention_header header;
+    memcpy(&header, ptr, sizeof(header));
+    sky_retention *retention = sky_retention_new(header.period, header.offset, header.periods);
+    if(retention == NULL) {
+        return NULL;
+    }
+    if(sky_retention_merge(retention, ptr, sz) != 0) {
+        sky_retention_free(retention);
+        return NULL;
+    }
+    return retention;
+}
+
+
+//--------------------------------------
+// Objects
+//--------------------------------------
+
+// Starts tracking a new object.
+void sky_retention_begin(sky_retention *retention)
+{
+    retention->in_cohort = false;
+    memset(retention->active, 0, ((retention->periods + 63) / 64) * sizeof(uint64_t));
+}
+
+// Adds an event of the current object. The first cohort event assigns the
+// object to a cohort and counts as activity in the first period. Activity
+// before the cohort event or past the last period is ignored.
+//
+// retention - The matrix.
+// flags     - Whether the event is a cohort event and/or an activity event.
+// timestamp - The time of the event, in seconds.
+void sky_retention_push(sky_retention *retention, uint32_t flags, uint32_t timestamp)
+{
+    int64_t index;
+    if(!retention->in_cohort) {
+        if(flags & SKY_RETENTION_COHORT) {
+            retention->in_cohort = true;
+            retention->cohort = sky_retention_period_index(retention, timestamp);
+            retention->active[0] |= 1;
+        }
+    }
+    else if(flags & SKY_RETENTION_ACTIVE) {
+        index = sky_retention_period_index(retention, timestamp) - retention->cohort;
+        if(index >= 0 && index < retention->periods) {
+            retention->active[index / 64] |= ((uint64_t)1 << (index % 64));
+        }
+    }
+}
+
+// Finishes the current object and adds its activity to its cohort's row.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_retention_end(sky_retention *retention)
+{
+    if(!retention->in_cohort) {
+        return 0;
+    }
+
+    int32_t row = sky_retention_row(retention, retention->cohort);
+    if(row < 0) return -1;
+
+    uint32_t i;
+    uint32_t *counts = &retention->counts[(size_t)row * retention->periods];
+    for(i=0; i<retention->periods; i++) {
+        if(retention->active[i / 64] & ((uint64_t)1 << (i % 64))) {
+            counts[i]++;
+        }
+    }
+    retention->in_cohort = false;
+    return 0;
+}
+
+// Calculates the index of the period that contains a timestamp.
+int64_t sky_retention_period_index(sky_retention *retention, uint32_t timestamp)
+{
+    int64_t value = (int64_t)timestamp - retention->offset;
+    int64_t index = value / retention->period;
+    if(value < 0 && value % retention->period != 0) {
+        index--;
+    }
+    return index;
+}
+
+// Finds the row for a cohort, inserting an empty row to keep the rows
+// sorted if the cohort has not been seen before.
+//
+// Returns the index of the row or -1 if memory could not be allocated.
+int32_t sky_retention_row(sky_retention *retention, int64_t cohort)
+{
+    // Binary search for the cohort.
+    uint32_t min = 0, max = retention->row_count;
+    while(min < max) {
+        uint32_t mid = (min + max) / 2;
+        if(retention->cohorts[mid] < cohort) {
+            min = mid + 1;
+        } else {
+            max = mid;
+        }
+    }
+    if(min < retention->row_count && retention->cohorts[min] == cohort) {
+        return (int32_t)min;
+    }
+
+    // Grow the rows if needed.
+    if(retention->row_count == retention->row_capacity) {
+        uint32_t capacity = (retention->row_capacity > 0 ? retention->row_capacity * 2 : INITIAL_ROW_CAPACITY);
+        int64_t *cohorts = realloc(retention->cohorts, capacity * sizeof(int64_t));
+        if(cohorts == NULL) return -1;
+        retention->cohorts = cohorts;
+        uint32_t *counts = realloc(retention->counts, (size_t)capacity * retention->periods * sizeof(uint32_t));
+        if(counts == NULL) return -1;
+        retention->counts = counts;
+        retention->row_capacity = capacity;
+    }
+
+    // Shift the later rows down and clear the new row.
+    size_t row_sz = retention->periods * sizeof(uint32_t);
+    memmove(&retention->cohorts[min+1], &retention->cohorts[min], (retention->row_count - min) * sizeof(int64_t));
+    memmove(&retention->counts[(size_t)(min+1) * retention->periods], &retention->counts[(size_t)min * retention->periods], (retention->row_count - min) * row_sz);
+    retention->cohorts[min] = cohort;
+    memset(&retention->counts[(size_t)min * retention->periods], 0, row_sz);
+    retention->row_count++;
+
+    return (int32_t)min;
+}
+
+
+//--------------------------------------
+// Merge
+//--------------------------------------
+
+// Adds the counts of a serialized matrix into a matrix. Both matrices must
+// use the same periods.
+//
+// retention - The matrix to merge into.
+// ptr       - A pointer to the serialized matrix.
+// sz        - The size of the serialized matrix.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_retention_merge(sky_retention *retention, void *ptr, size_t sz)
+{
+    if(ptr == NULL || sz < sizeof(sky_retention_header)) {
+        return -1;
+    }
+
+    sky_retention_header header;
+    memcpy(&header, ptr, sizeof(header));
+    if(header.period != retention->period || header.offset != retention->offset || header.periods != retention->periods) {
+        return -1;
+    }
+    size_t row_sz = sizeof(int64_t) + (header.periods * sizeof(uint32_t));
+    if(sz != sizeof(header) + (header.row_count * row_sz)) {
+        return -1;
+    }
+
+    uint32_t i, j;
+    void *cohorts = ptr + sizeof(header);
+    void *counts = cohorts + (header.row_count * sizeof(int64_t));
+    for(i=0; i<header.row_count; i++) {
+        int64_t cohort;
+        memcpy(&cohort, cohorts + (i * sizeof(int64_t)), sizeof(cohort));
+        int32_t row = sky_retention_row(retention, cohort);
+        if(row < 0) return -1;
+
+        for(j=0; j<header.periods; j++) {
+            uint32_t count;
+            memcpy(&count, counts + (((size_t)i * header.periods + j) * sizeof(uint32_t)), sizeof(count));
+            retention->counts[(size_t)row * retention->periods + j] += count;
+        }
+    }
+    return 0;
+}
+
+
+//--------------------------------------
+// Rows
+//--------------------------------------
+
+// Retrieves the start of a row's cohort, in seconds since the epoch.
+int64_t sky_retention_cohort_timestamp(sky_retention *retention, uint32_t row)
+{
+    return (retention->cohorts[row] * retention->period) + retention->offset;
+}
+
+// Retrieves the number of objects in a row's cohort that were active in a
+// given period after the start of the cohort.
+uint32_t sky_retention_count(sky_retention *retention, uint32_t row, uint32_t period)
+{
+    return retention->counts[(size_t)row * retention->periods + period];
+}
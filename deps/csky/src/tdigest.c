@@ -0,0 +1,353 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sky/tdigest.h"
+
+
+//==============================================================================
+//
+// Constants
+//
+//==============================================================================
+
+#define PI  3.14159265358979323846
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+uint32_t sky_tdigest_merged_capacity(double compression);
+
+int sky_tdigest_centroid_cmp(const void *a, const void *b);
+
+double sky_tdigest_k(double compression, double q);
+
+double sky_tdigest_k_inverse(double compression, double k);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a t-digest. Higher compression values keep more centroids and give
+// more accurate quantiles. The number of centroids is bounded by roughly
+// twice the compression.
+//
+// compression - The accuracy parameter of the digest.
+//
+// Returns a new digest or NULL if the compression is out of range.
+sky_tdigest *sky_tdigest_new(double compression)
+{
+    if(!(compression >= SKY_TDIGEST_MIN_COMPRESSION && compression <= SKY_TDIGEST_MAX_COMPRESSION)) {
+        return NULL;
+    }
+
+    sky_tdigest *tdigest = calloc(1, sizeof(sky_tdigest));
+    if(tdigest == NULL) {
+        return NULL;
+    }
+    tdigest->compression = compression;
+    tdigest->min = INFINITY;
+    tdigest->max = -INFINITY;
+
+    // Leave room for the merged centroids plus a buffer of unmerged values.
+    tdigest->capacity = sky_tdigest_merged_capacity(compression) * 3;
+    tdigest->centroids = calloc(tdigest->capacity, sizeof(sky_tdigest_centroid));
+    if(tdigest->centroids == NULL) {
+        free(tdigest);
+        return NULL;
+    }
+    return tdigest;
+}
+
+// Removes a digest from memory.
+void sky_tdigest_free(sky_tdigest *tdigest)
+{
+    if(tdigest) {
+        if(tdigest->centroids != NULL) free(tdigest->centroids);
+        free(tdigest);
+    }
+}
+
+// Calculates the maximum number of centroids after compression.
+uint32_t sky_tdigest_merged_capacity(double compression)
+{
+    return (uint32_t)ceil(compression) * 2 + 10;
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Calculates the size of the serialized digest. The digest is compressed
+// first so only merged centroids are written.
+size_t sky_tdigest_sizeof(sky_tdigest *tdigest)
+{
+    sky_tdigest_compress(tdigest);
+    return sizeof(sky_tdigest_header) + (tdigest->merged_count * sizeof(sky_tdigest_centroid));
+}
+
+// Serializes a digest. The pointer must have room for the number of bytes
+// returned by sky_tdigest_sizeof().
+void sky_tdigest_pack(sky_tdigest *tdigest, void *ptr)
+{
+    sky_tdigest_compress(tdigest);
+
+    sky_tdigest_header header;
+    memset(&header, 0, sizeof(header));
+    header.compression = tdigest->compression;
+    header.min = tdigest->min;
+    header.max = tdigest->max;
+    header.count = tdigest->merged_count;
+    memcpy(ptr, &header, sizeof(header));
+    memcpy(ptr + sizeof(header), tdigest->centroids, tdigest->merged_count * sizeof(sky_tdigest_centroid));
+}
+
+// Deserializes a digest.
+//
+// ptr - A pointer to the serialized digest.
+// sz  - The size of the serialized digest.
+//
+// Returns a new digest or NULL if the data is not a valid digest.
+sky_tdigest *sky_tdigest_unpack(void *ptr, size_t sz)
+{
+    if(ptr == NULL || sz < sizeof(sky_tdigest_header)) {
+        return NULL;
+    }
+
+    sky_tdigest_header header;
+    memcpy(&header, ptr, sizeof(header));
+    if(sz != sizeof(header) + (header.count * sizeof(sky_tdigest_centroid))) {
+        return NULL;
+    }
+
+    sky_tdigest *tdigest = sky_tdigest_new(header.compression);
+    if(tdigest == NULL) {
+        return NULL;
+    }
+    if(header.count > tdigest->capacity) {
+        tdigest->capacity = header.count + sky_tdigest_merged_capacity(header.compression);
+        sky_tdigest_centroid *centroids = realloc(tdigest->centroids, tdigest->capacity * sizeof(sky_tdigest_centroid));
+        if(centroids == NULL) {
+            sky_tdigest_free(tdigest);
+            return NULL;
+        }
+        tdigest->centroids = centroids;
+    }
+    tdigest->min = header.min;
+    tdigest->max = header.max;
+    tdigest->merged_count = header.count;
+    memcpy(tdigest->centroids, ptr + sizeof(header), header.count * sizeof(sky_tdigest_centroid));
+    return tdigest;
+}
+
+
+//--------------------------------------
+// Values
+//--------------------------------------
+
+// Adds a single value to the digest.
+void sky_tdigest_add(sky_tdigest *tdigest, double value)
+{
+    sky_tdigest_add_weighted(tdigest, value, 1);
+}
+
+// Adds a value with a given weight to the digest. NaN values and values
+// without a positive weight are ignored.
+void sky_tdigest_add_weighted(sky_tdigest *tdigest, double value, double weight)
+{
+    if(isnan(value) || !(weight > 0)) {
+        return;
+    }
+    if(tdigest->merged_count + tdigest->unmerged_count >= tdigest->capacity) {
+        sky_tdigest_compress(tdigest);
+    }
+
+    sky_tdigest_centroid *centroid = &tdigest->centroids[tdigest->merged_count + tdigest->unmerged_count];
+    centroid->mean = value;
+    centroid->weight = weight;
+    tdigest->unmerged_count++;
+
+    if(value < tdigest->min) tdigest->min = value;
+    if(value > tdigest->max) tdigest->max = value;
+}
+
+// Merges the buffered values into the centroids. Neighboring centroids are
+// combined as long as the combined centroid spans less than one unit of the
+// arcsine scale function so centroids near the tails stay small.
+void sky_tdigest_compress(sky_tdigest *tdigest)
+{
+    if(tdigest->unmerged_count == 0) {
+        return;
+    }
+
+    uint32_t i, n = tdigest->merged_count + tdigest->unmerged_count;
+    sky_tdigest_centroid *centroids = tdigest->centroids;
+    qsort(centroids, n, sizeof(sky_tdigest_centroid), sky_tdigest_centroid_cmp);
+
+    double total = 0;
+    for(i=0; i<n; i++) {
+        total += centroids[i].weight;
+    }
+
+    // Merge centroids in place. The output index never passes the input.
+    uint32_t count = 0;
+    double weight_so_far = 0;
+    double q_limit = sky_tdigest_k_inverse(tdigest->compression, sky_tdigest_k(tdigest->compression, 0) + 1) * total;
+    sky_tdigest_centroid current = centroids[0];
+    for(i=1; i<n; i++) {
+        double proposed = current.weight + centroids[i].weight;
+        if(weight_so_far + proposed <= q_limit) {
+            current.mean += (centroids[i].mean - current.mean) * centroids[i].weight / proposed;
+            current.weight = proposed;
+        }
+        else {
+            weight_so_far += current.weight;
+            centroids[count++] = current;
+            q_limit = sky_tdigest_k_inverse(tdigest->compression, sky_tdigest_k(tdigest->compression, weight_so_far / total) + 1) * total;
+            current = centroids[i];
+        }
+    }
+    centroids[count++] = current;
+
+    tdigest->merged_count = count;
+    tdigest->unmerged_count = 0;
+}
+
+// Orders centroids by their mean.
+int sky_tdigest_centroid_cmp(const void *a, const void *b)
+{
+    double x = ((sky_tdigest_centroid*)a)->mean;
+    double y = ((sky_tdigest_centroid*)b)->mean;
+    return (x < y ? -1 : (x > y ? 1 : 0));
+}
+
+// Maps a quantile onto the arcsine scale.
+double sky_tdigest_k(double compression, double q)
+{
+    return compression / (2 * PI) * asin(2 * q - 1);
+}
+
+// Maps a value on the arcsine scale back to a quantile.
+double sky_tdigest_k_inverse(double compression, double k)
+{
+    if(k >= compression / 4) {
+        return 1;
+    }
+    return (sin(k * (2 * PI) / compression) + 1) / 2;
+}
+
+
+//--------------------------------------
+// Merge
+//--------------------------------------
+
+// Merges a serialized digest into a digest.
+//
+// tdigest - The digest to merge into.
+// ptr     - A pointer to the serialized digest.
+// sz      - The size of the serialized digest.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_tdigest_merge(sky_tdigest *tdigest, void *ptr, size_t sz)
+{
+    if(ptr == NULL || sz < sizeof(sky_tdigest_header)) {
+        return -1;
+    }
+    sky_tdigest_header header;
+    memcpy(&header, ptr, sizeof(header));
+    if(sz != sizeof(header) + (header.count * sizeof(sky_tdigest_centroid))) {
+        return -1;
+    }
+
+    uint32_t i;
+    sky_tdigest_centroid centroid;
+    for(i=0; i<header.count; i++) {
+        memcpy(&centroid, ptr + sizeof(header) + (i * sizeof(centroid)), sizeof(centroid));
+        sky_tdigest_add_weighted(tdigest, centroid.mean, centroid.weight);
+    }
+    if(header.count > 0) {
+        if(header.min < tdigest->min) tdigest->min = header.min;
+        if(header.max > tdigest->max) tdigest->max = header.max;
+    }
+    return 0;
+}
+
+
+//--------------------------------------
+// Estimation
+//--------------------------------------
+
+// Calculates the total weight of the values added to the digest.
+double sky_tdigest_count(sky_tdigest *tdigest)
+{
+    uint32_t i;
+    double total = 0;
+    for(i=0; i<tdigest->merged_count + tdigest->unmerged_count; i++) {
+        total += tdigest->centroids[i].weight;
+    }
+    return total;
+}
+
+// Estimates the value at a given quantile by interpolating between the
+// centers of neighboring centroids. The minimum and maximum values are used
+// as the outer edges of the first and last centroids.
+//
+// q - The quantile, between 0 and 1.
+//
+// Returns the estimated value or NaN if the digest is empty.
+double sky_tdigest_quantile(sky_tdigest *tdigest, double q)
+{
+    sky_tdigest_compress(tdigest);
+
+    uint32_t i, n = tdigest->merged_count;
+    sky_tdigest_centroid *centroids = tdigest->centroids;
+    if(n == 0 || isnan(q)) {
+        return NAN;
+    }
+    if(q <= 0) {
+        return tdigest->min;
+    }
+    if(q >= 1) {
+        return tdigest->max;
+    }
+    if(n == 1) {
+        return centroids[0].mean;
+    }
+
+    double total = sky_tdigest_count(tdigest);
+    double index = q * total;
+
+    // Interpolate between the minimum and the center of the first centroid.
+    double weight_so_far = centroids[0].weight / 2;
+    if(index < weight_so_far) {
+        return tdigest->min + (index / weight_so_far) * (centroids[0].mean - tdigest->min);
+    }
+
+    // Interpolate between centroid centers.
+    for(i=0; i<n-1; i++) {
+        double dw = (centroids[i].weight + centroids[i+1].weight) / 2;
+        if(weight_so_far + dw > index) {
+            double t = (index - weight_so_far) / dw;
+            return centroids[i].mean + t * (centroids[i+1].mean - centroids[i].mean);
+        }
+        weight_so_far += dw;
+    }
+
+    // Interpolate between the center of the last centroid and the maximum.
+    double remaining = centroids[n-1].weight / 2;
+    double t = (index - weight_so_far) / remaining;
+    if(t > 1) t = 1;
+    return centroids[n-1].mean + t * (tdigest->max - centroids[n-1].mean);
+}
@@ -20,6 +20,17 @@
 #define SECONDS_BIT_OFFSET  20
 
 
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int64_t sky_timestamp_floor_div(int64_t value, int64_t divisor);
+
+int64_t sky_timestamp_month_start(int64_t days);
+
+
 //==============================================================================
 //
 // Functions
@@ -68,3 +79,90 @@ int64_t sky_timestamp_to_seconds(int64_t value)
     return (value >> SECONDS_BIT_OFFSET);
 }
 
+
+
+//--------------------------------------
+// Bucketing
+//--------------------------------------
+
+// Divides and rounds towards negative infinity.
+int64_t sky_timestamp_floor_div(int64_t value, int64_t divisor)
+{
+    int64_t quotient = value / divisor;
+    if(value % divisor != 0 && value < 0) {
+        quotient--;
+    }
+    return quotient;
+}
+
+// Calculates the number of days since the epoch of the first day of the
+// month containing a given day.
+//
+// days - The number of days since the epoch.
+//
+// Returns the number of days since the epoch.
+int64_t sky_timestamp_month_start(int64_t days)
+{
+    // Convert to a civil date in a calendar whose years start in March.
+    int64_t z = days + 719468;
+    int64_t era = sky_timestamp_floor_div(z, 146097);
+    int64_t doe = z - (era * 146097);
+    int64_t yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+    int64_t doy = doe - (365*yoe + yoe/4 - yoe/100);
+    int64_t mp = (5*doy + 2) / 153;
+    int64_t day = doy - (153*mp + 2)/5 + 1;
+    return days - (day - 1);
+}
+
+// Finds the offset from UTC of a timezone at a given time.
+//
+// timezone - The timezone.
+// seconds  - The number of seconds since the epoch.
+//
+// Returns the offset from UTC, in seconds.
+int32_t sky_timezone_offset(sky_timezone *timezone, int64_t seconds)
+{
+    if(timezone == NULL || timezone->count == 0 || seconds < timezone->starts[0]) {
+        return 0;
+    }
+
+    // Binary search for the last transition starting at or before the time.
+    uint32_t min = 0, max = timezone->count;
+    while(max - min > 1) {
+        uint32_t mid = (min + max) / 2;
+        if(timezone->starts[mid] <= seconds) {
+            min = mid;
+        } else {
+            max = mid;
+        }
+    }
+    return timezone->offsets[min];
+}
+
+// Calculates the start of the minute, hour, day, week or month containing a
+// time in a given timezone. Weeks start on Monday.
+//
+// timezone - The timezone that buckets are aligned to or NULL for UTC.
+// seconds  - The number of seconds since the epoch.
+// unit     - The bucket unit.
+//
+// Returns the start of the bucket in seconds since the epoch.
+int64_t sky_timestamp_bucket(sky_timezone *timezone, int64_t seconds, uint32_t unit)
+{
+    int32_t offset = sky_timezone_offset(timezone, seconds);
+    int64_t local = seconds + offset;
+
+    int64_t start;
+    switch(unit) {
+        case SKY_TIME_BUCKET_MINUTE: start = sky_timestamp_floor_div(local, 60) * 60; break;
+        case SKY_TIME_BUCKET_HOUR: start = sky_timestamp_floor_div(local, 3600) * 3600; break;
+        case SKY_TIME_BUCKET_DAY: start = sky_timestamp_floor_div(local, 86400) * 86400; break;
+        case SKY_TIME_BUCKET_WEEK: start = ((sky_timestamp_floor_div(sky_timestamp_floor_div(local, 86400) - 4, 7) * 7) + 4) * 86400; break;
+        case SKY_TIME_BUCKET_MONTH: start = sky_timestamp_month_start(sky_timestamp_floor_div(local, 86400)) * 86400; break;
+        default: return seconds;
+    }
+
+    // Convert the local start back to UTC using the offset in effect at the
+    // start of the bucket.
+    return start - sky_timezone_offset(timezone, start - offset);
+}
@@ -75,6 +75,14 @@ char *DATA5 = "\xA0"
   "\x92" "\xD3\x00\x00\x00\x00\x00\xA0\x00\x00" "\x81" "\x01\x14"
 ;
 
+int DATA6_LENGTH = 27;
+char *DATA6 = "\xAD"
+  // State: 1970-01-01T00:00:03Z, {1:7}
+  "\x92" "\xD3\x00\x00\x00\x00\x00\x30\x00\x00" "\x81" "\x01\x07"
+  // 1970-01-01T00:00:00Z, {1:2}
+  "\x92" "\xD3\x00\x00\x00\x00\x00\x00\x00\x00" "\x81" "\x01\x02"
+;
+
 
 //==============================================================================
 //
@@ -131,6 +139,31 @@ typedef struct {
     int64_t ts;
 } test2_t;
 
+typedef struct {
+    uint32_t timestamp;
+    int64_t ts;
+    uint32_t minute;
+    uint32_t hour;
+} test3_t;
+
+typedef struct {
+    uint32_t timestamp;
+    int64_t ts;
+    uint32_t session_index;
+    uint32_t session_event_index;
+    uint32_t session_start;
+    uint32_t gap;
+    uint32_t session_length;
+} test4_t;
+
+#define ASSERT_SESSION_FIELDS(OBJ, INDEX, EVENT_INDEX, START, GAP, LENGTH) do {\
+    mu_assert_int_equals(((test4_t*)OBJ)->session_index, INDEX); \
+    mu_assert_int_equals(((test4_t*)OBJ)->session_event_index, EVENT_INDEX); \
+    mu_assert_int_equals(((test4_t*)OBJ)->session_start, START); \
+    mu_assert_int_equals(((test4_t*)OBJ)->gap, GAP); \
+    mu_assert_int_equals(((test4_t*)OBJ)->session_length, LENGTH); \
+} while(0)
+
 //==============================================================================
 //
 // Test Cases
@@ -278,6 +311,127 @@ int test_sky_cursor_sessionize() {
 }
 
 
+int test_sky_cursor_session_fields() {
+    sky_cursor *cursor = sky_cursor_new(-2, 1);
+    sky_cursor_set_timestamp_offset(cursor, offsetof(test4_t, timestamp));
+    sky_cursor_set_ts_offset(cursor, offsetof(test4_t, ts));
+    sky_cursor_set_session_field_offset(cursor, SKY_SESSION_FIELD_INDEX, offsetof(test4_t, session_index));
+    sky_cursor_set_session_field_offset(cursor, SKY_SESSION_FIELD_EVENT_INDEX, offsetof(test4_t, session_event_index));
+    sky_cursor_set_session_field_offset(cursor, SKY_SESSION_FIELD_START, offsetof(test4_t, session_start));
+    sky_cursor_set_session_field_offset(cursor, SKY_SESSION_FIELD_GAP, offsetof(test4_t, gap));
+    sky_cursor_set_session_field_offset(cursor, SKY_SESSION_FIELD_LENGTH, offsetof(test4_t, session_length));
+    sky_cursor_set_data_sz(cursor, sizeof(test4_t));
+
+    // Sessions with a 10 second idle time: [0, 1, 10], [20] and [60, 63].
+    sky_cursor_set_ptr(cursor, DATA1, DATA1_LENGTH);
+    sky_cursor_set_session_idle(cursor, 10);
+    mu_assert_bool(sky_lua_cursor_next_session(cursor));
+    mu_assert_bool(sky_lua_cursor_next_event(cursor));
+    ASSERT_SESSION_FIELDS(cursor->data, 0, 0, 0, 0, 10);
+    mu_assert_bool(sky_lua_cursor_next_event(cursor));
+    ASSERT_SESSION_FIELDS(cursor->data, 0, 1, 0, 1, 10);
+    mu_assert_bool(sky_lua_cursor_next_event(cursor));
+    ASSERT_SESSION_FIELDS(cursor->data, 0, 2, 0, 9, 10);
+    mu_assert_bool(!sky_lua_cursor_next_event(cursor));
+
+    mu_assert_bool(sky_lua_cursor_next_session(cursor));
+    mu_assert_bool(sky_lua_cursor_next_event(cursor));
+    ASSERT_SESSION_FIELDS(cursor->data, 1, 0, 20, 10, 0);
+    mu_assert_bool(!sky_lua_cursor_next_event(cursor));
+
+    mu_assert_bool(sky_lua_cursor_next_session(cursor));
+    mu_assert_bool(sky_lua_cursor_next_event(cursor));
+    ASSERT_SESSION_FIELDS(cursor->data, 2, 0, 60, 40, 3);
+    mu_assert_bool(sky_lua_cursor_next_event(cursor));
+    ASSERT_SESSION_FIELDS(cursor->data, 2, 1, 60, 3, 3);
+    mu_assert_bool(!sky_lua_cursor_next_event(cursor));
+
+    // Without an idle time the whole object is a single session.
+    sky_cursor_set_ptr(cursor, DATA1, DATA1_LENGTH);
+    mu_assert_bool(sky_lua_cursor_next_event(cursor));
+    ASSERT_SESSION_FIELDS(cursor->data, 0, 0, 0, 0, 63);
+
+    sky_cursor_free(cursor);
+    return 0;
+}
+
+
+//--------------------------------------
+// Rewind
+//--------------------------------------
+
+int test_sky_cursor_rewind() {
+    sky_cursor *cursor = sky_cursor_new(-2, 1);
+    sky_cursor_set_timestamp_offset(cursor, offsetof(test_t, timestamp));
+    sky_cursor_set_ts_offset(cursor, offsetof(test_t, ts));
+    sky_cursor_set_property(cursor, -2, offsetof(test_t, action_int), sizeof(int32_t), "integer");
+    sky_cursor_set_property(cursor, -1, offsetof(test_t, action), sizeof(sky_string), "string");
+    sky_cursor_set_property(cursor, 1, offsetof(test_t, object_int), sizeof(int32_t), "integer");
+    sky_cursor_set_data_sz(cursor, sizeof(test_t));
+
+    // Read through the whole object with sessions enabled.
+    sky_cursor_set_ptr(cursor, DATA1, DATA1_LENGTH);
+    sky_cursor_set_session_idle(cursor, 10);
+    while(sky_lua_cursor_next_session(cursor)) {
+        while(sky_lua_cursor_next_event(cursor));
+    }
+    mu_assert_bool(cursor->eof == true);
+
+    // Rewind and make sure we start over without sessions.
+    sky_cursor_rewind(cursor);
+    mu_assert_bool(cursor->eof == false);
+    mu_assert_int_equals(cursor->session_event_index, -1);
+    ASSERT_OBJ_STATE2(cursor->data, 0, "", 0LL, 0LL);
+    mu_assert_bool(sky_lua_cursor_next_event(cursor));
+    ASSERT_OBJ_STATE2(cursor->data, 0, "A1", 1000LL, 0LL);
+    mu_assert_bool(sky_lua_cursor_next_event(cursor));
+    ASSERT_OBJ_STATE2(cursor->data, 1, "A2", 1000LL, 100LL);
+
+    sky_cursor_free(cursor);
+    return 0;
+}
+
+
+//--------------------------------------
+// State
+//--------------------------------------
+
+int test_sky_cursor_state() {
+    sky_cursor *cursor = sky_cursor_new(-2, 1);
+    sky_cursor_set_timestamp_offset(cursor, offsetof(test_t, timestamp));
+    sky_cursor_set_ts_offset(cursor, offsetof(test_t, ts));
+    sky_cursor_set_property(cursor, -1, offsetof(test_t, action), sizeof(sky_string), "string");
+    sky_cursor_set_property(cursor, 1, offsetof(test_t, object_int), sizeof(int32_t), "integer");
+    sky_cursor_set_data_sz(cursor, sizeof(test_t));
+    sky_cursor_enable_state(cursor);
+
+    // The state is decoded when the cursor moves to the object and is not
+    // changed by events.
+    sky_cursor_set_ptr(cursor, DATA6, DATA6_LENGTH);
+    ASSERT_OBJ_STATE2(cursor->state, 3, "", 7LL, 0LL);
+    ASSERT_OBJ_STATE2(cursor->data, 0, "", 0LL, 0LL);
+    mu_assert_bool(sky_lua_cursor_next_event(cursor));
+    ASSERT_OBJ_STATE2(cursor->data, 0, "", 2LL, 0LL);
+    ASSERT_OBJ_STATE2(cursor->state, 3, "", 7LL, 0LL);
+    mu_assert_bool(!sky_lua_cursor_next_event(cursor));
+
+    // Reading only the state never reads events.
+    sky_cursor_set_ptr(cursor, DATA6, DATA6_LENGTH);
+    mu_assert_bool(sky_cursor_next_state(cursor));
+    ASSERT_OBJ_STATE2(cursor->data, 3, "", 7LL, 0LL);
+    mu_assert_bool(!sky_lua_cursor_next_event(cursor));
+    mu_assert_bool(!sky_cursor_next_state(cursor));
+
+    // An empty state has no values.
+    sky_cursor_set_ptr(cursor, DATA4, DATA4_LENGTH);
+    ASSERT_OBJ_STATE2(cursor->state, 0, "", 0LL, 0LL);
+    mu_assert_bool(!sky_cursor_next_state(cursor));
+
+    sky_cursor_free(cursor);
+    return 0;
+}
+
+
 //--------------------------------------
 // Object Iteration
 //--------------------------------------
@@ -398,6 +552,65 @@ int test_sky_cursor_set_string() {
 
 
 
+//--------------------------------------
+// Time Buckets
+//--------------------------------------
+
+int test_sky_timestamp_bucket() {
+    // UTC. The epoch is a Thursday so its week starts on the Monday before.
+    mu_assert_int64_equals(sky_timestamp_bucket(NULL, 0, SKY_TIME_BUCKET_WEEK), -259200LL);
+    mu_assert_int64_equals(sky_timestamp_bucket(NULL, 0, SKY_TIME_BUCKET_MONTH), 0LL);
+    mu_assert_int64_equals(sky_timestamp_bucket(NULL, 1330516800LL, SKY_TIME_BUCKET_MONTH), 1328054400LL);
+    mu_assert_int64_equals(sky_timestamp_bucket(NULL, 1362913259LL, SKY_TIME_BUCKET_MINUTE), 1362913200LL);
+    mu_assert_int64_equals(sky_timestamp_bucket(NULL, 1362913259LL, SKY_TIME_BUCKET_DAY), 1362873600LL);
+
+    // New York in 2013. Buckets that start before daylight saving time began
+    // on March 10th use the standard offset.
+    int64_t starts[] = {0, 1362898800LL, 1383458400LL};
+    int32_t offsets[] = {-18000, -14400, -18000};
+    sky_timezone timezone = {3, starts, offsets};
+    mu_assert_int_equals(sky_timezone_offset(&timezone, -1), 0);
+    mu_assert_int_equals(sky_timezone_offset(&timezone, 1362898799LL), -18000);
+    mu_assert_int_equals(sky_timezone_offset(&timezone, 1362898800LL), -14400);
+    mu_assert_int_equals(sky_timezone_offset(&timezone, 1383458400LL), -18000);
+    mu_assert_int64_equals(sky_timestamp_bucket(&timezone, 1362913259LL, SKY_TIME_BUCKET_HOUR), 1362913200LL);
+    mu_assert_int64_equals(sky_timestamp_bucket(&timezone, 1362913259LL, SKY_TIME_BUCKET_DAY), 1362891600LL);
+    mu_assert_int64_equals(sky_timestamp_bucket(&timezone, 1362913259LL, SKY_TIME_BUCKET_WEEK), 1362373200LL);
+    mu_assert_int64_equals(sky_timestamp_bucket(&timezone, 1362913259LL, SKY_TIME_BUCKET_MONTH), 1362114000LL);
+    return 0;
+}
+
+int test_sky_cursor_time_buckets() {
+    sky_cursor *cursor = sky_cursor_new(-2, 1);
+    sky_cursor_set_timestamp_offset(cursor, offsetof(test3_t, timestamp));
+    sky_cursor_set_ts_offset(cursor, offsetof(test3_t, ts));
+    sky_cursor_set_time_bucket_offset(cursor, SKY_TIME_BUCKET_MINUTE, offsetof(test3_t, minute));
+    sky_cursor_set_data_sz(cursor, sizeof(test3_t));
+    sky_cursor_set_ptr(cursor, DATA1, DATA1_LENGTH);
+
+    // Only the minute is computed.
+    uint32_t minutes[] = {0, 0, 0, 0, 60, 60};
+    uint32_t i;
+    for(i=0; i<6; i++) {
+        mu_assert_bool(sky_lua_cursor_next_event(cursor));
+        mu_assert_int_equals(((test3_t*)cursor->data)->minute, minutes[i]);
+        mu_assert_int_equals(((test3_t*)cursor->data)->hour, 0);
+    }
+    mu_assert_bool(!sky_lua_cursor_next_event(cursor));
+
+    // Timezones are copied into the cursor.
+    int64_t starts[] = {0};
+    int32_t offsets[] = {1800};
+    mu_assert_int_equals(sky_cursor_set_timezone(cursor, 1, starts, offsets), 0);
+    starts[0] = 100;
+    mu_assert_int_equals(cursor->time_bucket_descriptor.timezone.count, 1);
+    mu_assert_int64_equals(cursor->time_bucket_descriptor.timezone.starts[0], 0LL);
+
+    sky_cursor_free(cursor);
+    return 0;
+}
+
+
 //==============================================================================
 //
 // Setup
@@ -407,7 +620,12 @@ int test_sky_cursor_set_string() {
 int all_tests() {
     mu_run_test(test_sky_cursor_set_data);
     mu_run_test(test_sky_cursor_sessionize);
+    mu_run_test(test_sky_cursor_session_fields);
+    mu_run_test(test_sky_cursor_rewind);
+    mu_run_test(test_sky_cursor_state);
     mu_run_test(test_sky_cursor_object_iteration);
+    mu_run_test(test_sky_timestamp_bucket);
+    mu_run_test(test_sky_cursor_time_buckets);
     
     mu_run_test(test_sky_cursor_set_integer);
     mu_run_test(test_sky_cursor_set_double);
@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <sky/expiry.h>
+#include <sky/cursor.h>
+#include <sky/minipack.h>
+#include <sky/timestamp.h>
+
+#include "minunit.h"
+
+//==============================================================================
+//
+// Declarations
+//
+//==============================================================================
+
+typedef struct {
+    int32_t action_int;
+    int32_t object_int;
+    int32_t object_int2;
+    uint32_t timestamp;
+    int64_t ts;
+} test_t;
+
+// Appends an event with several property values to a buffer.
+size_t pack_event_map(void *ptr, int64_t seconds, int64_t *keys, int64_t *values, uint32_t count)
+{
+    size_t sz;
+    void *start = ptr;
+    minipack_pack_fixarray(ptr, 2, &sz);
+    ptr += sz;
+    minipack_pack_int(ptr, sky_timestamp_shift(seconds * 1000000), &sz);
+    ptr += sz;
+    minipack_pack_map(ptr, count, &sz);
+    ptr += sz;
+
+    uint32_t i;
+    for(i=0; i<count; i++) {
+        minipack_pack_int(ptr, keys[i], &sz);
+        ptr += sz;
+        minipack_pack_int(ptr, values[i], &sz);
+        ptr += sz;
+    }
+    return (size_t)(ptr - start);
+}
+
+// Appends an event with a single property value to a buffer.
+size_t pack_event(void *ptr, int64_t seconds, int64_t value)
+{
+    size_t sz;
+    void *start = ptr;
+    minipack_pack_fixarray(ptr, 2, &sz);
+    ptr += sz;
+    minipack_pack_int(ptr, sky_timestamp_shift(seconds * 1000000), &sz);
+    ptr += sz;
+    minipack_pack_map(ptr, 1, &sz);
+    ptr += sz;
+    minipack_pack_int(ptr, 1, &sz);
+    ptr += sz;
+    minipack_pack_int(ptr, value, &sz);
+    ptr += sz;
+    return (size_t)(ptr - start);
+}
+
+// Builds an object value from a state and events at the given times.
+size_t pack_object(void *ptr, int64_t *seconds, uint32_t count)
+{
+    size_t sz;
+    uint8_t state[32];
+    size_t state_sz = pack_event(state, 0, 100);
+    void *start = ptr;
+    minipack_pack_raw(ptr, state_sz, &sz);
+    ptr += sz;
+    memcpy(ptr, state, state_sz);
+    ptr += state_sz;
+
+    uint32_t i;
+    for(i=0; i<count; i++) {
+        ptr += pack_event(ptr, seconds[i], seconds[i]);
+    }
+    return (size_t)(ptr - start);
+}
+
+// Builds the key of an object.
+size_t pack_key(void *ptr, const char *table_name, const char *object_id)
+{
+    size_t sz;
+    void *start = ptr;
+    minipack_pack_fixarray(ptr, 2, &sz);
+    ptr += sz;
+    minipack_pack_raw(ptr, strlen(table_name), &sz);
+    ptr += sz;
+    memcpy(ptr, table_name, strlen(table_name));
+    ptr += strlen(table_name);
+    minipack_pack_raw(ptr, strlen(object_id), &sz);
+    ptr += sz;
+    memcpy(ptr, object_id, strlen(object_id));
+    ptr += strlen(object_id);
+    return (size_t)(ptr - start);
+}
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Trimming
+//--------------------------------------
+
+int test_sky_expiry_trim() {
+    uint8_t value[256];
+    int64_t seconds[] = {10, 20, 30, 40};
+    size_t sz = pack_object(value, seconds, 4);
+    size_t state_sz, trimmed_sz;
+    uint32_t count;
+
+    // Events before the horizon are trimmed.
+    mu_assert_bool(sky_expiry_trim(value, sz, 25, &state_sz, &trimmed_sz, &count));
+    mu_assert_int_equals(count, 2);
+    mu_assert_bool(state_sz > 0);
+    mu_assert_int_equals((int)trimmed_sz, (int)(pack_event(value + sz, 10, 10) + pack_event(value + sz, 20, 20)));
+
+    // Nothing is trimmed before the first event and everything is trimmed
+    // after the last one.
+    mu_assert_bool(sky_expiry_trim(value, sz, 10, &state_sz, &trimmed_sz, &count));
+    mu_assert_int_equals(count, 0);
+    mu_assert_bool(sky_expiry_trim(value, sz, 41, &state_sz, &trimmed_sz, &count));
+    mu_assert_int_equals(count, 4);
+    mu_assert_int_equals((int)(state_sz + trimmed_sz), (int)sz);
+
+    // Invalid values are not read.
+    mu_assert_bool(!sky_expiry_trim(value, sz - 1, 41, &state_sz, &trimmed_sz, &count));
+    return 0;
+}
+
+
+//--------------------------------------
+// Compaction Filter
+//--------------------------------------
+
+int test_sky_expiry_filter() {
+    uint8_t key[64], value[256];
+    int64_t seconds[] = {10, 20, 30, 40};
+    size_t key_sz = pack_key(key, "foo", "obj0");
+    size_t sz = pack_object(value, seconds, 4);
+    char *new_value = NULL;
+    size_t new_value_sz = 0;
+    unsigned char changed = 0;
+    uint64_t events, bytes;
+
+    sky_expiry *expiry = sky_expiry_new();
+    expiry->now = 50;
+
+    // Tables without a retention period are not trimmed.
+    mu_assert_int_equals(sky_expiry_filter(expiry, 1, (char*)key, key_sz, (char*)value, sz, &new_value, &new_value_sz, &changed), 0);
+    mu_assert_int_equals(changed, 0);
+
+    // Events older than the retention period are removed from the value.
+    mu_assert_int_equals(sky_expiry_set_retention(expiry, "foo", 3, 25), 0);
+    mu_assert_int_equals(sky_expiry_filter(expiry, 1, (char*)key, key_sz, (char*)value, sz, &new_value, &new_value_sz, &changed), 0);
+    mu_assert_int_equals(changed, 1);
+
+    uint8_t expected[256];
+    int64_t expected_seconds[] = {30, 40};
+    size_t expected_sz = pack_object(expected, expected_seconds, 2);
+    mu_assert_int_equals((int)new_value_sz, (int)expected_sz);
+    mu_assert_bool(memcmp(new_value, expected, expected_sz) == 0);
+    free(new_value);
+
+    sky_expiry_stats(expiry, "foo", 3, &events, &bytes);
+    mu_assert_int_equals((int)events, 2);
+    mu_assert_int_equals((int)bytes, (int)(sz - new_value_sz));
+    sky_expiry_stats(expiry, "bar", 3, &events, &bytes);
+    mu_assert_int_equals((int)events, 0);
+
+    // Clearing the retention period keeps every event.
+    changed = 0;
+    mu_assert_int_equals(sky_expiry_set_retention(expiry, "foo", 3, 0), 0);
+    mu_assert_int_equals(sky_expiry_filter(expiry, 1, (char*)key, key_sz, (char*)value, sz, &new_value, &new_value_sz, &changed), 0);
+    mu_assert_int_equals(changed, 0);
+
+    sky_expiry_free(expiry);
+    return 0;
+}
+
+int test_sky_expiry_filter_permanent() {
+    uint8_t key[64], value[256], expected[256];
+    size_t key_sz = pack_key(key, "foo", "obj0");
+    char *new_value = NULL;
+    size_t sz, new_value_sz = 0;
+    unsigned char changed = 0;
+
+    // Permanent property 2 is only set by the first event and transient
+    // property -1 by the second. Both events expire.
+    int64_t keys0[] = {1, 2}, values0[] = {10, 7};
+    int64_t keys1[] = {1, -1}, values1[] = {20, 5};
+    int64_t keys2[] = {1}, values2[] = {30};
+    int64_t keys3[] = {-1}, values3[] = {40};
+    minipack_pack_raw(value, 0, &sz);
+    sz += pack_event_map(value + sz, 10, keys0, values0, 2);
+    sz += pack_event_map(value + sz, 20, keys1, values1, 2);
+    sz += pack_event_map(value + sz, 30, keys2, values2, 1);
+    sz += pack_event_map(value + sz, 40, keys3, values3, 1);
+
+    sky_expiry *expiry = sky_expiry_new();
+    expiry->now = 50;
+    mu_assert_int_equals(sky_expiry_set_retention(expiry, "foo", 3, 25), 0);
+    mu_assert_int_equals(sky_expiry_filter(expiry, 1, (char*)key, key_sz, (char*)value, sz, &new_value, &new_value_sz, &changed), 0);
+    mu_assert_int_equals(changed, 1);
+
+    // The permanent value is folded into the first kept event.
+    int64_t expected_keys[] = {1, 2}, expected_values[] = {30, 7};
+    size_t expected_sz;
+    minipack_pack_raw(expected, 0, &expected_sz);
+    expected_sz += pack_event_map(expected + expected_sz, 30, expected_keys, expected_values, 2);
+    expected_sz += pack_event_map(expected + expected_sz, 40, keys3, values3, 1);
+    mu_assert_int_equals((int)new_value_sz, (int)expected_sz);
+    mu_assert_bool(memcmp(new_value, expected, expected_sz) == 0);
+
+    // The cursor carries it forward to the later events.
+    sky_cursor *cursor = sky_cursor_new(-1, 2);
+    sky_cursor_set_timestamp_offset(cursor, offsetof(test_t, timestamp));
+    sky_cursor_set_ts_offset(cursor, offsetof(test_t, ts));
+    sky_cursor_set_property(cursor, -1, offsetof(test_t, action_int), sizeof(int32_t), "integer");
+    sky_cursor_set_property(cursor, 1, offsetof(test_t, object_int), sizeof(int32_t), "integer");
+    sky_cursor_set_property(cursor, 2, offsetof(test_t, object_int2), sizeof(int32_t), "integer");
+    sky_cursor_set_data_sz(cursor, sizeof(test_t));
+    sky_cursor_set_ptr(cursor, new_value, new_value_sz);
+    mu_assert_bool(sky_lua_cursor_next_event(cursor));
+    mu_assert_int_equals(((test_t*)cursor->data)->object_int2, 7);
+    mu_assert_int_equals(((test_t*)cursor->data)->action_int, 0);
+    mu_assert_bool(sky_lua_cursor_next_event(cursor));
+    mu_assert_int_equals(((test_t*)cursor->data)->timestamp, 40);
+    mu_assert_int_equals(((test_t*)cursor->data)->object_int, 30);
+    mu_assert_int_equals(((test_t*)cursor->data)->object_int2, 7);
+    mu_assert_int_equals(((test_t*)cursor->data)->action_int, 40);
+    mu_assert_bool(!sky_lua_cursor_next_event(cursor));
+    sky_cursor_free(cursor);
+    free(new_value);
+
+    // Values that are only expired are dropped with the rest of the object.
+    changed = 0;
+    expiry->now = 100;
+    mu_assert_int_equals(sky_expiry_filter(expiry, 1, (char*)key, key_sz, (char*)value, sz, &new_value, &new_value_sz, &changed), 0);
+    mu_assert_int_equals(changed, 1);
+    mu_assert_int_equals((int)new_value_sz, 1);
+    free(new_value);
+
+    sky_expiry_free(expiry);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_expiry_trim);
+    mu_run_test(test_sky_expiry_filter);
+    mu_run_test(test_sky_expiry_filter_permanent);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sky/funnel.h>
+
+#include "minunit.h"
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+int test_sky_funnel_new() {
+    mu_assert_bool(sky_funnel_new(0) == NULL);
+    mu_assert_bool(sky_funnel_new(SKY_FUNNEL_MAX_STEPS + 1) == NULL);
+
+    sky_funnel *funnel = sky_funnel_new(3);
+    mu_assert_int_equals(funnel->depth, 0);
+    mu_assert_int_equals(sky_funnel_set_window(funnel, 0, SKY_FUNNEL_UNIT_STEPS, 0, 1), -1);
+    mu_assert_int_equals(sky_funnel_set_window(funnel, 3, SKY_FUNNEL_UNIT_STEPS, 0, 1), -1);
+    mu_assert_int_equals(sky_funnel_set_window(funnel, 1, SKY_FUNNEL_UNIT_STEPS, 2, 1), -1);
+    mu_assert_int_equals(sky_funnel_set_window(funnel, 1, SKY_FUNNEL_UNIT_SECONDS, 0, 10), 0);
+    sky_funnel_free(funnel);
+    return 0;
+}
+
+
+//--------------------------------------
+// Matching
+//--------------------------------------
+
+int test_sky_funnel_push() {
+    sky_funnel *funnel = sky_funnel_new(3);
+
+    // Steps must occur in order.
+    mu_assert_int_equals(sky_funnel_push(funnel, 2, 0), 0);
+    mu_assert_int_equals(sky_funnel_push(funnel, 1, 1), 1);
+    mu_assert_int_equals(sky_funnel_push(funnel, 4, 2), 1);
+    mu_assert_int_equals(sky_funnel_push(funnel, 2, 3), 2);
+    mu_assert_int_equals(sky_funnel_push(funnel, 4, 4), 3);
+
+    // Resetting clears partial matches.
+    sky_funnel_reset(funnel);
+    mu_assert_int_equals(funnel->depth, 0);
+    mu_assert_int_equals(sky_funnel_push(funnel, 2, 0), 0);
+
+    // The same event does not match consecutive steps by default.
+    sky_funnel_reset(funnel);
+    mu_assert_int_equals(sky_funnel_push(funnel, 7, 0), 1);
+    mu_assert_int_equals(sky_funnel_push(funnel, 7, 1), 2);
+    mu_assert_int_equals(sky_funnel_push(funnel, 7, 2), 3);
+
+    sky_funnel_free(funnel);
+    return 0;
+}
+
+int test_sky_funnel_step_window() {
+    sky_funnel *funnel = sky_funnel_new(2);
+    sky_funnel_set_window(funnel, 1, SKY_FUNNEL_UNIT_STEPS, 2, 3);
+
+    // The second step is too close to the first match and then too far.
+    mu_assert_int_equals(sky_funnel_push(funnel, 1, 0), 1);
+    mu_assert_int_equals(sky_funnel_push(funnel, 2, 0), 1);
+    mu_assert_int_equals(sky_funnel_push(funnel, 0, 0), 1);
+    mu_assert_int_equals(sky_funnel_push(funnel, 0, 0), 1);
+    mu_assert_int_equals(sky_funnel_push(funnel, 2, 0), 1);
+
+    // A later partial match succeeds without backtracking.
+    sky_funnel_reset(funnel);
+    mu_assert_int_equals(sky_funnel_push(funnel, 1, 0), 1);
+    mu_assert_int_equals(sky_funnel_push(funnel, 0, 0), 1);
+    mu_assert_int_equals(sky_funnel_push(funnel, 1, 0), 1);
+    mu_assert_int_equals(sky_funnel_push(funnel, 0, 0), 1);
+    mu_assert_int_equals(sky_funnel_push(funnel, 0, 0), 1);
+    mu_assert_int_equals(sky_funnel_push(funnel, 2, 0), 2);
+
+    // A window starting at zero lets one event match consecutive steps.
+    sky_funnel_set_window(funnel, 1, SKY_FUNNEL_UNIT_STEPS, 0, 0);
+    sky_funnel_reset(funnel);
+    mu_assert_int_equals(sky_funnel_push(funnel, 3, 0), 2);
+
+    sky_funnel_free(funnel);
+    return 0;
+}
+
+int test_sky_funnel_seconds_window() {
+    int32_t i;
+    sky_funnel *funnel = sky_funnel_new(3);
+    sky_funnel_set_window(funnel, 1, SKY_FUNNEL_UNIT_SECONDS, 0, 60);
+    sky_funnel_set_window(funnel, 2, SKY_FUNNEL_UNIT_SECONDS, 0, 60);
+
+    // Many partial matches are kept at once.
+    for(i=0; i<100; i++) {
+        mu_assert_int_equals(sky_funnel_push(funnel, 1, 1000 + i), 1);
+    }
+    mu_assert_int_equals(sky_funnel_push(funnel, 2, 1150), 2);
+    mu_assert_int_equals(sky_funnel_push(funnel, 4, 1211), 2);
+
+    // A later chain completes the funnel after the first one expires.
+    mu_assert_int_equals(sky_funnel_push(funnel, 1, 1220), 2);
+    mu_assert_int_equals(sky_funnel_push(funnel, 2, 1260), 2);
+    mu_assert_int_equals(sky_funnel_push(funnel, 4, 1315), 3);
+
+    sky_funnel_free(funnel);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_funnel_new);
+    mu_run_test(test_sky_funnel_push);
+    mu_run_test(test_sky_funnel_step_window);
+    mu_run_test(test_sky_funnel_seconds_window);
+    return 0;
+}
+
+RUN_TESTS()
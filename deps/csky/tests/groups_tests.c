@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sky/groups.h>
+
+#include "minunit.h"
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Lookup
+//--------------------------------------
+
+int test_sky_groups_lookup() {
+    double initial[] = {0, 100};
+    sky_groups *groups = sky_groups_new(2, initial);
+
+    // Create a group for ("foo", 1).
+    sky_groups_key_reset(groups);
+    sky_groups_key_add_string(groups, "foo", 3);
+    sky_groups_key_add_double(groups, 1);
+    mu_assert_int_equals(sky_groups_lookup(groups), 0);
+    mu_assert_int_equals(groups->count, 1);
+    mu_assert_bool(groups->values[0] == 0 && groups->values[1] == 100);
+    groups->values[0] += 1;
+
+    // Create a group for ("fo", "o1") which must not collide.
+    sky_groups_key_reset(groups);
+    sky_groups_key_add_string(groups, "fo", 2);
+    sky_groups_key_add_string(groups, "o1", 2);
+    mu_assert_int_equals(sky_groups_lookup(groups), 1);
+
+    // Find the first group again.
+    sky_groups_key_reset(groups);
+    sky_groups_key_add_string(groups, "foo", 3);
+    sky_groups_key_add_double(groups, 1);
+    mu_assert_int_equals(sky_groups_lookup(groups), 0);
+    mu_assert_bool(groups->values[0] == 1);
+
+    // Negative zero matches zero.
+    sky_groups_key_reset(groups);
+    sky_groups_key_add_double(groups, 0);
+    mu_assert_int_equals(sky_groups_lookup(groups), 2);
+    sky_groups_key_reset(groups);
+    sky_groups_key_add_double(groups, -0.0);
+    mu_assert_int_equals(sky_groups_lookup(groups), 2);
+
+    sky_groups_free(groups);
+    return 0;
+}
+
+int test_sky_groups_grow() {
+    int32_t i;
+    double initial[] = {0};
+    sky_groups *groups = sky_groups_new(1, initial);
+
+    // Add enough groups to force several resizes.
+    for(i=0; i<10000; i++) {
+        sky_groups_key_reset(groups);
+        sky_groups_key_add_double(groups, (double)(i % 1000));
+        int32_t index = sky_groups_lookup(groups);
+        mu_assert_int_equals(index, i % 1000);
+        groups->values[index] += 1;
+    }
+    mu_assert_int_equals(groups->count, 1000);
+    for(i=0; i<1000; i++) {
+        mu_assert_bool(groups->values[i] == 10);
+    }
+
+    sky_groups_free(groups);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_groups_lookup);
+    mu_run_test(test_sky_groups_grow);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <sky/hll.h>
+
+#include "minunit.h"
+
+//==============================================================================
+//
+// Declarations
+//
+//==============================================================================
+
+#define mu_assert_estimate(HLL, EXPECTED, ERROR) do {\
+    double estimate = sky_hll_estimate(HLL); \
+    mu_assert_with_msg(fabs(estimate - (EXPECTED)) <= (EXPECTED) * (ERROR), "Expected: %f; Received: %f", (double)(EXPECTED), estimate); \
+} while(0)
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+int test_sky_hll_new() {
+    mu_assert_bool(sky_hll_new(3) == NULL);
+    mu_assert_bool(sky_hll_new(17) == NULL);
+
+    sky_hll *hll = sky_hll_new(12);
+    mu_assert_int_equals(hll->precision, 12);
+    mu_assert_long_equals(sky_hll_sizeof(hll), 4097L);
+    mu_assert_bool(sky_hll_estimate(hll) == 0);
+    mu_assert_bool(sky_hll_validate(hll, 4097));
+    mu_assert_bool(!sky_hll_validate(hll, 4096));
+    sky_hll_free(hll);
+    return 0;
+}
+
+
+//--------------------------------------
+// Values
+//--------------------------------------
+
+int test_sky_hll_add_double() {
+    int64_t i;
+    sky_hll *hll = sky_hll_new(12);
+
+    // Duplicates should not be counted.
+    for(i=0; i<1000; i++) {
+        sky_hll_add_double(hll, (double)(i % 100));
+    }
+    sky_hll_add_double(hll, -0.0);
+    mu_assert_estimate(hll, 100, 0.02);
+
+    for(i=0; i<100000; i++) {
+        sky_hll_add_double(hll, (double)i);
+    }
+    mu_assert_estimate(hll, 100000, 0.05);
+    sky_hll_free(hll);
+    return 0;
+}
+
+int test_sky_hll_add_string() {
+    int64_t i;
+    char str[32];
+    sky_hll *hll = sky_hll_new(12);
+    for(i=0; i<20000; i++) {
+        int sz = snprintf(str, sizeof(str), "user%lld", (long long int)(i % 5000));
+        sky_hll_add_string(hll, str, sz);
+    }
+    mu_assert_estimate(hll, 5000, 0.05);
+    sky_hll_free(hll);
+    return 0;
+}
+
+
+//--------------------------------------
+// Merge
+//--------------------------------------
+
+int test_sky_hll_merge() {
+    int64_t i;
+    sky_hll *a = sky_hll_new(12);
+    sky_hll *b = sky_hll_new(12);
+    sky_hll *c = sky_hll_new(10);
+
+    // Overlapping ranges: [0, 30000) and [20000, 50000).
+    for(i=0; i<30000; i++) {
+        sky_hll_add_double(a, (double)i);
+        sky_hll_add_double(b, (double)(i + 20000));
+    }
+    mu_assert_int_equals(sky_hll_merge(a, b, sky_hll_sizeof(b)), 0);
+    mu_assert_estimate(a, 50000, 0.05);
+
+    // Sketches with different precisions cannot be merged.
+    mu_assert_int_equals(sky_hll_merge(a, c, sky_hll_sizeof(c)), -1);
+    mu_assert_int_equals(sky_hll_merge(a, b, 100), -1);
+
+    sky_hll_free(a);
+    sky_hll_free(b);
+    sky_hll_free(c);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_hll_new);
+    mu_run_test(test_sky_hll_add_double);
+    mu_run_test(test_sky_hll_add_string);
+    mu_run_test(test_sky_hll_merge);
+    return 0;
+}
+
+RUN_TESTS()
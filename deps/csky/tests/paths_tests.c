@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sky/paths.h>
+
+#include "minunit.h"
+
+//==============================================================================
+//
+// Declarations
+//
+//==============================================================================
+
+#define mu_assert_path(PATHS, INDEX, COUNT, LENGTH, ...) do {\
+    int64_t _values[] = {__VA_ARGS__}; \
+    mu_assert_int_equals((PATHS)->paths[INDEX].count, COUNT); \
+    mu_assert_int_equals((PATHS)->paths[INDEX].length, LENGTH); \
+    mu_assert_bool(memcmp((PATHS)->paths[INDEX].values, _values, (LENGTH) * sizeof(int64_t)) == 0); \
+} while(0)
+
+// Pushes an object's events. Anchor events have negative values.
+void push_object(sky_paths *paths, int64_t *values, uint32_t count)
+{
+    uint32_t i;
+    sky_paths_begin(paths);
+    for(i=0; i<count; i++) {
+        sky_paths_push(paths, values[i] < 0, values[i]);
+    }
+    sky_paths_end(paths);
+}
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+int test_sky_paths_new() {
+    mu_assert_bool(sky_paths_new(0, SKY_PATHS_NEXT, 10) == NULL);
+    mu_assert_bool(sky_paths_new(SKY_PATHS_MAX_STEPS + 1, SKY_PATHS_NEXT, 10) == NULL);
+    mu_assert_bool(sky_paths_new(2, 2, 10) == NULL);
+    mu_assert_bool(sky_paths_new(2, SKY_PATHS_NEXT, 0) == NULL);
+
+    sky_paths *paths = sky_paths_new(2, SKY_PATHS_NEXT, 10);
+    mu_assert_int_equals(paths->path_count, 0);
+    sky_paths_free(paths);
+    return 0;
+}
+
+
+//--------------------------------------
+// Objects
+//--------------------------------------
+
+int test_sky_paths_next() {
+    sky_paths *paths = sky_paths_new(2, SKY_PATHS_NEXT, 10);
+    int64_t a[] = {1, -1, 2, 3, 4, -1, 2, 3};
+    int64_t b[] = {-1, 2, -1};
+    push_object(paths, a, 8);
+    push_object(paths, b, 3);
+    sky_paths_sort(paths);
+
+    mu_assert_int_equals(paths->path_count, 3);
+    mu_assert_path(paths, 0, 2, 2, 2, 3);
+    mu_assert_path(paths, 1, 1, 0, 0);
+    mu_assert_path(paths, 2, 1, 2, 2, -1);
+    sky_paths_free(paths);
+    return 0;
+}
+
+int test_sky_paths_previous() {
+    sky_paths *paths = sky_paths_new(3, SKY_PATHS_PREVIOUS, 10);
+    int64_t a[] = {1, 2, 3, 4, -1, 1, -1};
+    push_object(paths, a, 7);
+    int64_t b[] = {-1};
+    push_object(paths, b, 1);
+    sky_paths_sort(paths);
+
+    mu_assert_int_equals(paths->path_count, 3);
+    mu_assert_path(paths, 0, 1, 0, 0);
+    mu_assert_path(paths, 1, 1, 3, 2, 3, 4);
+    mu_assert_path(paths, 2, 1, 3, 4, -1, 1);
+    sky_paths_free(paths);
+    return 0;
+}
+
+int test_sky_paths_heavy_hitters() {
+    // Only the most frequent path is kept once many rare paths are seen.
+    uint32_t i;
+    sky_paths *paths = sky_paths_new(1, SKY_PATHS_NEXT, 4);
+    for(i=0; i<1000; i++) {
+        int64_t values[] = {-1, (i % 3 == 0 ? 7 : 1000 + i)};
+        push_object(paths, values, 2);
+    }
+    sky_paths_sort(paths);
+    mu_assert_int_equals(paths->path_count, 4);
+    mu_assert_path(paths, 0, 334, 1, 7);
+    mu_assert_bool(paths->paths[1].count < 10);
+    mu_assert_int_equals(sky_paths_estimate(paths, (int64_t[]){7}, 1), 334);
+    sky_paths_free(paths);
+    return 0;
+}
+
+
+//--------------------------------------
+// Merge
+//--------------------------------------
+
+int test_sky_paths_merge() {
+    sky_paths *a = sky_paths_new(1, SKY_PATHS_NEXT, 2);
+    sky_paths *b = sky_paths_new(1, SKY_PATHS_NEXT, 2);
+    int64_t x[] = {-1, 5, -1, 6};
+    int64_t y[] = {-1, 6, -1, 7, -1, 7};
+    push_object(a, x, 4);
+    push_object(b, y, 6);
+
+    // Round trip the first set and merge the second into it.
+    size_t sz = sky_paths_sizeof(a);
+    void *buffer = calloc(1, sz);
+    sky_paths_pack(a, buffer);
+    sky_paths *c = sky_paths_unpack(buffer, sz);
+    mu_assert_bool(c != NULL);
+    mu_assert_bool(sky_paths_unpack(buffer, sz - 1) == NULL);
+    free(buffer);
+
+    sz = sky_paths_sizeof(b);
+    buffer = calloc(1, sz);
+    sky_paths_pack(b, buffer);
+    mu_assert_int_equals(sky_paths_merge(c, buffer, sz), 0);
+    free(buffer);
+
+    mu_assert_int_equals(c->path_count, 2);
+    mu_assert_path(c, 0, 2, 1, 6);
+    mu_assert_path(c, 1, 2, 1, 7);
+
+    // Sets with different steps cannot be merged.
+    sky_paths *d = sky_paths_new(2, SKY_PATHS_NEXT, 2);
+    sz = sky_paths_sizeof(d);
+    buffer = calloc(1, sz);
+    sky_paths_pack(d, buffer);
+    mu_assert_int_equals(sky_paths_merge(c, buffer, sz), -1);
+    free(buffer);
+
+    sky_paths_free(a);
+    sky_paths_free(b);
+    sky_paths_free(c);
+    sky_paths_free(d);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_paths_new);
+    mu_run_test(test_sky_paths_next);
+    mu_run_test(test_sky_paths_previous);
+    mu_run_test(test_sky_paths_heavy_hitters);
+    mu_run_test(test_sky_paths_merge);
+    return 0;
+}
+
+RUN_TESTS()
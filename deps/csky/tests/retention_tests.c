@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sky/retention.h>
+
+#include "minunit.h"
+
+//==============================================================================
+//
+// Declarations
+//
+//==============================================================================
+
+#define DAY 86400
+
+#define mu_assert_row(RETENTION, ROW, TIMESTAMP, C0, C1, C2) do {\
+    mu_assert_long_equals(sky_retention_cohort_timestamp(RETENTION, ROW), (int64_t)(TIMESTAMP)); \
+    mu_assert_int_equals(sky_retention_count(RETENTION, ROW, 0), C0); \
+    mu_assert_int_equals(sky_retention_count(RETENTION, ROW, 1), C1); \
+    mu_assert_int_equals(sky_retention_count(RETENTION, ROW, 2), C2); \
+} while(0)
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+int test_sky_retention_new() {
+    mu_assert_bool(sky_retention_new(0, 0, 4) == NULL);
+    mu_assert_bool(sky_retention_new(DAY, 0, 0) == NULL);
+    mu_assert_bool(sky_retention_new(DAY, 0, SKY_RETENTION_MAX_PERIODS + 1) == NULL);
+
+    sky_retention *retention = sky_retention_new(DAY, 0, 3);
+    mu_assert_int_equals(retention->row_count, 0);
+    mu_assert_long_equals(sky_retention_sizeof(retention), (long)sizeof(sky_retention_header));
+    sky_retention_free(retention);
+    return 0;
+}
+
+
+//--------------------------------------
+// Objects
+//--------------------------------------
+
+int test_sky_retention_push() {
+    sky_retention *retention = sky_retention_new(DAY, 0, 3);
+
+    // Active on the first and third day after joining on day 10.
+    sky_retention_begin(retention);
+    sky_retention_push(retention, SKY_RETENTION_ACTIVE, 9 * DAY);
+    sky_retention_push(retention, SKY_RETENTION_COHORT | SKY_RETENTION_ACTIVE, 10 * DAY + 5);
+    sky_retention_push(retention, SKY_RETENTION_ACTIVE, 12 * DAY);
+    sky_retention_push(retention, SKY_RETENTION_ACTIVE, 12 * DAY + 10);
+    sky_retention_push(retention, SKY_RETENTION_ACTIVE, 20 * DAY);
+    mu_assert_int_equals(sky_retention_end(retention), 0);
+
+    // Active on the next day after joining on day 2.
+    sky_retention_begin(retention);
+    sky_retention_push(retention, SKY_RETENTION_COHORT, 2 * DAY);
+    sky_retention_push(retention, SKY_RETENTION_ACTIVE, 3 * DAY);
+    mu_assert_int_equals(sky_retention_end(retention), 0);
+
+    // Never joins.
+    sky_retention_begin(retention);
+    sky_retention_push(retention, SKY_RETENTION_ACTIVE, 2 * DAY);
+    mu_assert_int_equals(sky_retention_end(retention), 0);
+
+    // Joins on day 10 and is never active again.
+    sky_retention_begin(retention);
+    sky_retention_push(retention, SKY_RETENTION_COHORT, 10 * DAY);
+    mu_assert_int_equals(sky_retention_end(retention), 0);
+
+    mu_assert_int_equals(retention->row_count, 2);
+    mu_assert_row(retention, 0, 2 * DAY, 1, 1, 0);
+    mu_assert_row(retention, 1, 10 * DAY, 2, 0, 1);
+
+    sky_retention_free(retention);
+    return 0;
+}
+
+int test_sky_retention_offset() {
+    // Periods start an hour after midnight.
+    sky_retention *retention = sky_retention_new(DAY, 3600, 3);
+    sky_retention_begin(retention);
+    sky_retention_push(retention, SKY_RETENTION_COHORT, 1800);
+    sky_retention_push(retention, SKY_RETENTION_ACTIVE, 3600);
+    mu_assert_int_equals(sky_retention_end(retention), 0);
+    mu_assert_row(retention, 0, 3600 - DAY, 1, 1, 0);
+    sky_retention_free(retention);
+    return 0;
+}
+
+
+//--------------------------------------
+// Merge
+//--------------------------------------
+
+int test_sky_retention_merge() {
+    uint32_t i;
+    sky_retention *a = sky_retention_new(DAY, 0, 3);
+    sky_retention *b = sky_retention_new(DAY, 0, 3);
+    for(i=0; i<3; i++) {
+        sky_retention_begin(a);
+        sky_retention_push(a, SKY_RETENTION_COHORT, (5 + i) * DAY);
+        sky_retention_push(a, SKY_RETENTION_ACTIVE, (6 + i) * DAY);
+        sky_retention_end(a);
+    }
+    sky_retention_begin(b);
+    sky_retention_push(b, SKY_RETENTION_COHORT, 1 * DAY);
+    sky_retention_end(b);
+    sky_retention_begin(b);
+    sky_retention_push(b, SKY_RETENTION_COHORT, 6 * DAY);
+    sky_retention_push(b, SKY_RETENTION_ACTIVE, 8 * DAY);
+    sky_retention_end(b);
+
+    // Round trip the first matrix and merge the second into it.
+    size_t sz = sky_retention_sizeof(a);
+    void *buffer = calloc(1, sz);
+    sky_retention_pack(a, buffer);
+    sky_retention *c = sky_retention_unpack(buffer, sz);
+    mu_assert_bool(c != NULL);
+    mu_assert_bool(sky_retention_unpack(buffer, sz - 1) == NULL);
+    free(buffer);
+
+    sz = sky_retention_sizeof(b);
+    buffer = calloc(1, sz);
+    sky_retention_pack(b, buffer);
+    mu_assert_int_equals(sky_retention_merge(c, buffer, sz), 0);
+    free(buffer);
+
+    mu_assert_int_equals(c->row_count, 4);
+    mu_assert_row(c, 0, 1 * DAY, 1, 0, 0);
+    mu_assert_row(c, 1, 5 * DAY, 1, 1, 0);
+    mu_assert_row(c, 2, 6 * DAY, 2, 1, 1);
+    mu_assert_row(c, 3, 7 * DAY, 1, 1, 0);
+
+    // Matrices with different periods cannot be merged.
+    sky_retention *d = sky_retention_new(DAY, 0, 4);
+    sz = sky_retention_sizeof(d);
+    buffer = calloc(1, sz);
+    sky_retention_pack(d, buffer);
+    mu_assert_int_equals(sky_retention_merge(c, buffer, sz), -1);
+    free(buffer);
+
+    sky_retention_free(a);
+    sky_retention_free(b);
+    sky_retention_free(c);
+    sky_retention_free(d);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_retention_new);
+    mu_run_test(test_sky_retention_push);
+    mu_run_test(test_sky_retention_offset);
+    mu_run_test(test_sky_retention_merge);
+    return 0;
+}
+
+RUN_TESTS()
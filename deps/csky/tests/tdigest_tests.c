@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <sky/tdigest.h>
+
+#include "minunit.h"
+
+//==============================================================================
+//
+// Declarations
+//
+//==============================================================================
+
+#define mu_assert_double_near(ACTUAL, EXPECTED, ERROR) do {\
+    double actual = (ACTUAL); \
+    mu_assert_with_msg(fabs(actual - (EXPECTED)) <= (ERROR), "Expected: %f; Received: %f", (double)(EXPECTED), actual); \
+} while(0)
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+int test_sky_tdigest_new() {
+    mu_assert_bool(sky_tdigest_new(1) == NULL);
+    mu_assert_bool(sky_tdigest_new(10000) == NULL);
+
+    sky_tdigest *tdigest = sky_tdigest_new(100);
+    mu_assert_bool(isnan(sky_tdigest_quantile(tdigest, 0.5)));
+    mu_assert_long_equals(sky_tdigest_sizeof(tdigest), sizeof(sky_tdigest_header));
+    sky_tdigest_free(tdigest);
+    return 0;
+}
+
+
+//--------------------------------------
+// Quantiles
+//--------------------------------------
+
+int test_sky_tdigest_quantile_small() {
+    int i;
+    sky_tdigest *tdigest = sky_tdigest_new(100);
+    for(i=1; i<=9; i++) {
+        sky_tdigest_add(tdigest, (double)(10 - i));
+    }
+    mu_assert_double_near(sky_tdigest_quantile(tdigest, 0), 1, 0);
+    mu_assert_double_near(sky_tdigest_quantile(tdigest, 0.5), 5, 0.0001);
+    mu_assert_double_near(sky_tdigest_quantile(tdigest, 1), 9, 0);
+    sky_tdigest_free(tdigest);
+    return 0;
+}
+
+int test_sky_tdigest_quantile_large() {
+    int i;
+    sky_tdigest *tdigest = sky_tdigest_new(100);
+
+    // Add a shuffled sequence of 0..99999.
+    for(i=0; i<100000; i++) {
+        sky_tdigest_add(tdigest, (double)((i * 7919) % 100000));
+    }
+    mu_assert_double_near(sky_tdigest_count(tdigest), 100000, 0);
+    mu_assert_double_near(sky_tdigest_quantile(tdigest, 0.5), 50000, 500);
+    mu_assert_double_near(sky_tdigest_quantile(tdigest, 0.95), 95000, 200);
+    mu_assert_double_near(sky_tdigest_quantile(tdigest, 0.99), 99000, 50);
+    mu_assert_double_near(sky_tdigest_quantile(tdigest, 0.999), 99900, 30);
+
+    // Memory stays bounded.
+    mu_assert_bool(sky_tdigest_sizeof(tdigest) <= sizeof(sky_tdigest_header) + (210 * sizeof(sky_tdigest_centroid)));
+    sky_tdigest_free(tdigest);
+    return 0;
+}
+
+
+//--------------------------------------
+// Serialization & Merge
+//--------------------------------------
+
+int test_sky_tdigest_merge() {
+    int i;
+    sky_tdigest *a = sky_tdigest_new(100);
+    sky_tdigest *b = sky_tdigest_new(100);
+    for(i=0; i<50000; i++) {
+        sky_tdigest_add(a, (double)(i * 2));
+        sky_tdigest_add(b, (double)(i * 2 + 1));
+    }
+
+    // Round trip the first digest through its serialized form.
+    size_t sz = sky_tdigest_sizeof(a);
+    void *ptr = malloc(sz);
+    sky_tdigest_pack(a, ptr);
+    sky_tdigest *c = sky_tdigest_unpack(ptr, sz);
+    mu_assert_bool(c != NULL);
+    mu_assert_bool(sky_tdigest_unpack(ptr, sz - 1) == NULL);
+    free(ptr);
+
+    // Merge the second digest into the copy.
+    sz = sky_tdigest_sizeof(b);
+    ptr = malloc(sz);
+    sky_tdigest_pack(b, ptr);
+    mu_assert_int_equals(sky_tdigest_merge(c, ptr, sz), 0);
+    mu_assert_int_equals(sky_tdigest_merge(c, ptr, sz - 1), -1);
+    free(ptr);
+
+    mu_assert_double_near(sky_tdigest_count(c), 100000, 0);
+    mu_assert_double_near(sky_tdigest_quantile(c, 0), 0, 0);
+    mu_assert_double_near(sky_tdigest_quantile(c, 0.5), 50000, 500);
+    mu_assert_double_near(sky_tdigest_quantile(c, 0.99), 99000, 100);
+    mu_assert_double_near(sky_tdigest_quantile(c, 1), 99999, 0);
+
+    sky_tdigest_free(a);
+    sky_tdigest_free(b);
+    sky_tdigest_free(c);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_tdigest_new);
+    mu_run_test(test_sky_tdigest_quantile_small);
+    mu_run_test(test_sky_tdigest_quantile_large);
+    mu_run_test(test_sky_tdigest_merge);
+    return 0;
+}
+
+RUN_TESTS()
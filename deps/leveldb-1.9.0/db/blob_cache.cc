@@ -0,0 +1,97 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/blob_cache.h"
+
+#include "db/blob_file.h"
+#include "db/filename.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+static void DeleteFileEntry(const Slice& key, void* value) {
+  delete reinterpret_cast<RandomAccessFile*>(value);
+}
+
+static void DeleteValueEntry(const Slice& key, void* value) {
+  delete reinterpret_cast<std::string*>(value);
+}
+
+BlobCache::BlobCache(const std::string& dbname,
+                     const Options* options,
+                     int entries)
+    : env_(options->env),
+      dbname_(dbname),
+      options_(options),
+      files_(NewLRUCache(entries)) {
+}
+
+BlobCache::~BlobCache() {
+  delete files_;
+}
+
+Status BlobCache::FindFile(uint64_t file_number, Cache::Handle** handle) {
+  Status s;
+  char buf[sizeof(file_number)];
+  EncodeFixed64(buf, file_number);
+  Slice key(buf, sizeof(buf));
+  *handle = files_->Lookup(key);
+  if (*handle == NULL) {
+    RandomAccessFile* file = NULL;
+    s = env_->NewRandomAccessFile(BlobFileName(dbname_, file_number), &file);
+    if (s.ok()) {
+      *handle = files_->Insert(key, file, 1, &DeleteFileEntry);
+    }
+  }
+  return s;
+}
+
+Status BlobCache::Get(const ReadOptions& options, const Slice& index,
+                      std::string* value) {
+  BlobIndex blob;
+  Status s = blob.DecodeFrom(index);
+  if (!s.ok()) {
+    return s;
+  }
+
+  // Blob files are never rewritten, so a value is named by its file
+  // number and offset.
+  Cache* cache = options_->blob_cache;
+  char buf[16];
+  EncodeFixed64(buf, blob.file_number);
+  EncodeFixed64(buf + 8, blob.offset);
+  Slice key(buf, sizeof(buf));
+  const Cache::Priority priority =
+      options.low_priority ? Cache::kLowPriority : Cache::kHighPriority;
+  Cache::Handle* cached =
+      (cache != NULL) ? cache->Lookup(key, priority) : NULL;
+  if (cached != NULL) {
+    *value = *reinterpret_cast<std::string*>(cache->Value(cached));
+    cache->Release(cached);
+    return s;
+  }
+
+  Cache::Handle* handle = NULL;
+  s = FindFile(blob.file_number, &handle);
+  if (s.ok()) {
+    RandomAccessFile* file =
+        reinterpret_cast<RandomAccessFile*>(files_->Value(handle));
+    s = ReadBlob(file, blob, value);
+    files_->Release(handle);
+  }
+  if (s.ok() && cache != NULL && options.fill_cache) {
+    cache->Release(cache->Insert(key, new std::string(*value), value->size(),
+                                 &DeleteValueEntry, priority));
+  }
+  return s;
+}
+
+void BlobCache::Evict(uint64_t file_number) {
+  char buf[sizeof(file_number)];
+  EncodeFixed64(buf, file_number);
+  files_->Erase(Slice(buf, sizeof(buf)));
+}
+
+}  // namespace leveldb
@@ -0,0 +1,48 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Thread-safe (provides internal synchronization)
+
+#ifndef STORAGE_LEVELDB_DB_BLOB_CACHE_H_
+#define STORAGE_LEVELDB_DB_BLOB_CACHE_H_
+
+#include <string>
+#include <stdint.h>
+#include "leveldb/cache.h"
+#include "leveldb/options.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Env;
+
+// Reads the values that blob index entries refer to.  Open blob files
+// are kept in a cache of their own and the values read are kept in
+// options->blob_cache.
+class BlobCache {
+ public:
+  BlobCache(const std::string& dbname, const Options* options, int entries);
+  ~BlobCache();
+
+  // Store the value that the encoded BlobIndex "index" refers to in
+  // *value.  The value is added to the cache unless options.fill_cache
+  // is false.
+  Status Get(const ReadOptions& options, const Slice& index,
+             std::string* value);
+
+  // Close the specified blob file if it is open
+  void Evict(uint64_t file_number);
+
+ private:
+  Env* const env_;
+  const std::string dbname_;
+  const Options* options_;
+  Cache* files_;
+
+  Status FindFile(uint64_t file_number, Cache::Handle**);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_BLOB_CACHE_H_
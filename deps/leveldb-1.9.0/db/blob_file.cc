@@ -0,0 +1,101 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/blob_file.h"
+
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb {
+
+void BlobIndex::EncodeTo(std::string* dst) const {
+  PutVarint64(dst, file_number);
+  PutVarint64(dst, offset);
+  PutVarint64(dst, size);
+}
+
+Status BlobIndex::DecodeFrom(const Slice& src) {
+  Slice input = src;
+  if (GetVarint64(&input, &file_number) &&
+      GetVarint64(&input, &offset) &&
+      GetVarint64(&input, &size) &&
+      input.empty() &&
+      file_number != 0 &&
+      size <= 0xffffffffu) {
+    return Status::OK();
+  } else {
+    return Status::Corruption("bad blob index");
+  }
+}
+
+BlobFileBuilder::BlobFileBuilder(uint64_t number, WritableFile* file)
+    : number_(number),
+      file_(file),
+      offset_(0),
+      num_entries_(0),
+      closed_(false) {
+}
+
+BlobFileBuilder::~BlobFileBuilder() {
+  delete file_;
+}
+
+Status BlobFileBuilder::Add(const Slice& value, std::string* index) {
+  assert(!closed_);
+  char header[kBlobRecordHeaderSize];
+  EncodeFixed32(header, static_cast<uint32_t>(value.size()));
+  EncodeFixed32(header + 4, crc32c::Mask(crc32c::Value(value.data(),
+                                                       value.size())));
+  Status s = file_->Append(Slice(header, sizeof(header)));
+  if (s.ok()) {
+    s = file_->Append(value);
+  }
+  if (s.ok()) {
+    BlobIndex blob;
+    blob.file_number = number_;
+    blob.offset = offset_;
+    blob.size = value.size();
+    blob.EncodeTo(index);
+    offset_ += kBlobRecordHeaderSize + value.size();
+    num_entries_++;
+  }
+  return s;
+}
+
+Status BlobFileBuilder::Finish() {
+  assert(!closed_);
+  closed_ = true;
+  Status s = file_->Sync();
+  if (s.ok()) {
+    s = file_->Close();
+  }
+  return s;
+}
+
+Status ReadBlob(RandomAccessFile* file, const BlobIndex& index,
+                std::string* value) {
+  const size_t n = kBlobRecordHeaderSize + index.size;
+  char* buf = new char[n];
+  Slice contents;
+  Status s = file->Read(index.offset, n, &contents, buf);
+  if (s.ok()) {
+    if (contents.size() != n ||
+        DecodeFixed32(contents.data()) != index.size) {
+      s = Status::Corruption("truncated blob record");
+    } else {
+      const uint32_t crc = crc32c::Unmask(DecodeFixed32(contents.data() + 4));
+      const char* data = contents.data() + kBlobRecordHeaderSize;
+      if (crc32c::Value(data, index.size) != crc) {
+        s = Status::Corruption("blob checksum mismatch");
+      } else {
+        value->assign(data, index.size);
+      }
+    }
+  }
+  delete[] buf;
+  return s;
+}
+
+}  // namespace leveldb
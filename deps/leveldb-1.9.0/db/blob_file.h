@@ -0,0 +1,77 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Large values are moved out of the tables into blob files, leaving a
+// BlobIndex entry (of type kTypeBlobIndex) in their place.  A blob file is
+// written once and is a sequence of records:
+//    length: fixed32
+//    crc: fixed32          // masked crc32c of the value
+//    value: char[length]
+// A blob file is deleted once no table refers to it.
+
+#ifndef STORAGE_LEVELDB_DB_BLOB_FILE_H_
+#define STORAGE_LEVELDB_DB_BLOB_FILE_H_
+
+#include <string>
+#include <stdint.h>
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class RandomAccessFile;
+class WritableFile;
+
+static const size_t kBlobRecordHeaderSize = 8;
+
+// Where a value is stored in a blob file
+struct BlobIndex {
+  uint64_t file_number;
+  uint64_t offset;  // Of the value's record
+  uint64_t size;    // Of the value
+
+  BlobIndex() : file_number(0), offset(0), size(0) { }
+
+  void EncodeTo(std::string* dst) const;
+  Status DecodeFrom(const Slice& src);
+};
+
+// Appends values to a new blob file.
+class BlobFileBuilder {
+ public:
+  // Create a builder that writes to "*file", which is the blob file
+  // numbered "number".  Takes ownership of "file".
+  BlobFileBuilder(uint64_t number, WritableFile* file);
+  ~BlobFileBuilder();
+
+  // Append "value" to the file and store its encoded BlobIndex in *index.
+  Status Add(const Slice& value, std::string* index);
+
+  // Sync and close the file.  No values may be added afterwards.
+  Status Finish();
+
+  uint64_t number() const { return number_; }
+  uint64_t NumEntries() const { return num_entries_; }
+  uint64_t FileSize() const { return offset_; }
+
+ private:
+  const uint64_t number_;
+  WritableFile* file_;
+  uint64_t offset_;
+  uint64_t num_entries_;
+  bool closed_;
+
+  // No copying allowed
+  BlobFileBuilder(const BlobFileBuilder&);
+  void operator=(const BlobFileBuilder&);
+};
+
+// Read the value "index" refers to from "file" into *value, checking
+// its length and checksum.
+extern Status ReadBlob(RandomAccessFile* file, const BlobIndex& index,
+                       std::string* value);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_BLOB_FILE_H_
@@ -4,6 +4,7 @@
 
 #include "db/builder.h"
 
+#include "db/blob_file.h"
 #include "db/filename.h"
 #include "db/dbformat.h"
 #include "db/table_cache.h"
@@ -33,11 +34,45 @@ Status BuildTable(const std::string& dbname,
     }
 
     TableBuilder* builder = new TableBuilder(options, file);
-    meta->smallest.DecodeFrom(iter->key());
+    BlobFileBuilder* blobs = NULL;
+    std::string blob_key;
+    std::string blob_index;
+    meta->largest_sequence = 0;
     for (; iter->Valid(); iter->Next()) {
       Slice key = iter->key();
+      Slice value = iter->value();
+      if (options.min_blob_size > 0 && value.size() >= options.min_blob_size &&
+          ExtractValueType(key) == kTypeValue) {
+        // Move the value into the blob file that shares the table's number
+        if (blobs == NULL) {
+          WritableFile* blob_file;
+          s = env->NewWritableFile(BlobFileName(dbname, meta->number),
+                                   &blob_file);
+          if (!s.ok()) {
+            break;
+          }
+          blobs = new BlobFileBuilder(meta->number, blob_file);
+        }
+        blob_index.clear();
+        s = blobs->Add(value, &blob_index);
+        if (!s.ok()) {
+          break;
+        }
+        blob_key.clear();
+        AppendInternalKey(&blob_key, ParsedInternalKey(
+            ExtractUserKey(key), ExtractSequence(key), kTypeBlobIndex));
+        key = blob_key;
+        value = blob_index;
+      }
+      if (builder->NumEntries() == 0) {
+        meta->smallest.DecodeFrom(key);
+      }
       meta->largest.DecodeFrom(key);
-      builder->Add(key, iter->value());
+      const SequenceNumber seq = ExtractSequence(key);
+      if (seq > meta->largest_sequence) {
+        meta->largest_sequence = seq;
+      }
+      builder->Add(key, value);
     }
 
     // Finish and check for builder errors
@@ -52,6 +87,16 @@ Status BuildTable(const std::string& dbname,
     }
     delete builder;
 
+    if (blobs != NULL) {
+      if (s.ok()) {
+        s = blobs->Finish();
+      }
+      if (s.ok()) {
+        meta->blob_files.push_back(meta->number);
+      }
+      delete blobs;
+    }
+
     // Finish and check for file errors
     if (s.ok()) {
       s = file->Sync();
@@ -81,6 +126,8 @@ Status BuildTable(const std::string& dbname,
     // Keep it
   } else {
     env->DeleteFile(fname);
+    env->DeleteFile(BlobFileName(dbname, meta->number));
+    meta->blob_files.clear();
   }
   return s;
 }
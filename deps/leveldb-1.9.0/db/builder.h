@@ -21,7 +21,9 @@ class VersionEdit;
 // will be named according to meta->number.  On success, the rest of
 // *meta will be filled with metadata about the generated table.
 // If no data is present in *iter, meta->file_size will be set to
-// zero, and no Table file will be produced.
+// zero, and no Table file will be produced.  Values of at least
+// options.min_blob_size bytes are written to the blob file with the same
+// number instead, which is then listed in meta->blob_files.
 extern Status BuildTable(const std::string& dbname,
                          Env* env,
                          const Options& options,
@@ -7,16 +7,20 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include "leveldb/cache.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/comparator.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
+#include "leveldb/sst_file_writer.h"
 #include "leveldb/status.h"
 #include "leveldb/write_batch.h"
 
 using leveldb::Cache;
+using leveldb::CacheType;
+using leveldb::CompactionFilter;
 using leveldb::Comparator;
 using leveldb::CompressionType;
 using leveldb::DB;
@@ -28,6 +32,7 @@ using leveldb::kMajorVersion;
 using leveldb::kMinorVersion;
 using leveldb::Logger;
 using leveldb::NewBloomFilterPolicy;
+using leveldb::NewClockCache;
 using leveldb::NewLRUCache;
 using leveldb::Options;
 using leveldb::RandomAccessFile;
@@ -36,6 +41,7 @@ using leveldb::ReadOptions;
 using leveldb::SequentialFile;
 using leveldb::Slice;
 using leveldb::Snapshot;
+using leveldb::SstFileWriter;
 using leveldb::Status;
 using leveldb::WritableFile;
 using leveldb::WriteBatch;
@@ -56,6 +62,7 @@ struct leveldb_randomfile_t   { RandomAccessFile* rep; };
 struct leveldb_writablefile_t { WritableFile*     rep; };
 struct leveldb_logger_t       { Logger*           rep; };
 struct leveldb_filelock_t     { FileLock*         rep; };
+struct leveldb_sstfilewriter_t { SstFileWriter*   rep; };
 
 struct leveldb_comparator_t : public Comparator {
   void* state_;
@@ -83,6 +90,45 @@ struct leveldb_comparator_t : public Comparator {
   virtual void FindShortSuccessor(std::string* key) const { }
 };
 
+struct leveldb_compactionfilter_t : public CompactionFilter {
+  void* state_;
+  void (*destructor_)(void*);
+  unsigned char (*filter_)(
+      void*,
+      int level,
+      const char* key, size_t key_length,
+      const char* existing_value, size_t value_length,
+      char** new_value, size_t* new_value_length,
+      unsigned char* value_changed);
+  const char* (*name_)(void*);
+
+  virtual ~leveldb_compactionfilter_t() {
+    (*destructor_)(state_);
+  }
+
+  virtual const char* Name() const {
+    return (*name_)(state_);
+  }
+
+  virtual bool Filter(int level, const Slice& key, const Slice& existing_value,
+                      std::string* new_value, bool* value_changed) const {
+    char* c_value = NULL;
+    size_t c_value_length = 0;
+    unsigned char c_changed = 0;
+    unsigned char result = (*filter_)(
+        state_, level, key.data(), key.size(),
+        existing_value.data(), existing_value.size(),
+        &c_value, &c_value_length, &c_changed);
+    if (c_changed) {
+      new_value->assign(c_value != NULL ? c_value : "",
+                        c_value != NULL ? c_value_length : 0);
+      *value_changed = true;
+    }
+    free(c_value);
+    return result;
+  }
+};
+
 struct leveldb_filterpolicy_t : public FilterPolicy {
   void* state_;
   void (*destructor_)(void*);
@@ -185,6 +231,17 @@ void leveldb_delete(
   SaveError(errptr, db->rep->Delete(options->rep, Slice(key, keylen)));
 }
 
+void leveldb_delete_range(
+    leveldb_t* db,
+    const leveldb_writeoptions_t* options,
+    const char* start, size_t startlen,
+    const char* end, size_t endlen,
+    char** errptr) {
+  SaveError(errptr, db->rep->DeleteRange(options->rep,
+                                         Slice(start, startlen),
+                                         Slice(end, endlen)));
+}
+
 
 void leveldb_write(
     leveldb_t* db,
@@ -275,6 +332,14 @@ void leveldb_compact_range(
       (limit_key ? (b = Slice(limit_key, limit_key_len), &b) : NULL));
 }
 
+void leveldb_ingest_external_file(
+    leveldb_t* db,
+    const char* const* file_list, size_t list_len,
+    char** errptr) {
+  std::vector<std::string> files(file_list, file_list + list_len);
+  SaveError(errptr, db->rep->IngestExternalFile(files));
+}
+
 void leveldb_destroy_db(
     const leveldb_options_t* options,
     const char* name,
@@ -359,6 +424,13 @@ void leveldb_writebatch_delete(
   b->rep.Delete(Slice(key, klen));
 }
 
+void leveldb_writebatch_delete_range(
+    leveldb_writebatch_t* b,
+    const char* start, size_t startlen,
+    const char* end, size_t endlen) {
+  b->rep.DeleteRange(Slice(start, startlen), Slice(end, endlen));
+}
+
 void leveldb_writebatch_iterate(
     leveldb_writebatch_t* b,
     void* state,
@@ -375,6 +447,10 @@ void leveldb_writebatch_iterate(
     virtual void Delete(const Slice& key) {
       (*deleted_)(state_, key.data(), key.size());
     }
+    virtual Status DeleteRange(const Slice& start, const Slice& end) {
+      // Range deletions have no callback in this interface
+      return Status::OK();
+    }
   };
   H handler;
   handler.state_ = state;
@@ -383,6 +459,43 @@ void leveldb_writebatch_iterate(
   b->rep.Iterate(&handler);
 }
 
+leveldb_sstfilewriter_t* leveldb_sstfilewriter_create(
+    const leveldb_options_t* options) {
+  leveldb_sstfilewriter_t* result = new leveldb_sstfilewriter_t;
+  result->rep = new SstFileWriter(options->rep);
+  return result;
+}
+
+void leveldb_sstfilewriter_destroy(leveldb_sstfilewriter_t* writer) {
+  delete writer->rep;
+  delete writer;
+}
+
+void leveldb_sstfilewriter_open(
+    leveldb_sstfilewriter_t* writer,
+    const char* name,
+    char** errptr) {
+  SaveError(errptr, writer->rep->Open(name));
+}
+
+void leveldb_sstfilewriter_put(
+    leveldb_sstfilewriter_t* writer,
+    const char* key, size_t klen,
+    const char* val, size_t vlen,
+    char** errptr) {
+  SaveError(errptr, writer->rep->Put(Slice(key, klen), Slice(val, vlen)));
+}
+
+void leveldb_sstfilewriter_finish(
+    leveldb_sstfilewriter_t* writer,
+    char** errptr) {
+  SaveError(errptr, writer->rep->Finish());
+}
+
+uint64_t leveldb_sstfilewriter_file_size(leveldb_sstfilewriter_t* writer) {
+  return writer->rep->FileSize();
+}
+
 leveldb_options_t* leveldb_options_create() {
   return new leveldb_options_t;
 }
@@ -403,6 +516,12 @@ void leveldb_options_set_filter_policy(
   opt->rep.filter_policy = policy;
 }
 
+void leveldb_options_set_compaction_filter(
+    leveldb_options_t* opt,
+    leveldb_compactionfilter_t* filter) {
+  opt->rep.compaction_filter = filter;
+}
+
 void leveldb_options_set_create_if_missing(
     leveldb_options_t* opt, unsigned char v) {
   opt->rep.create_if_missing = v;
@@ -446,10 +565,46 @@ void leveldb_options_set_block_restart_interval(leveldb_options_t* opt, int n) {
   opt->rep.block_restart_interval = n;
 }
 
+void leveldb_options_set_max_subcompactions(leveldb_options_t* opt, int n) {
+  opt->rep.max_subcompactions = n;
+}
+
+void leveldb_options_set_concurrent_memtable_writes(
+    leveldb_options_t* opt, unsigned char v) {
+  opt->rep.concurrent_memtable_writes = v;
+}
+
+void leveldb_options_set_pipelined_writes(
+    leveldb_options_t* opt, unsigned char v) {
+  opt->rep.pipelined_writes = v;
+}
+
+void leveldb_options_set_min_blob_size(leveldb_options_t* opt, size_t s) {
+  opt->rep.min_blob_size = s;
+}
+
+void leveldb_options_set_blob_cache(leveldb_options_t* opt,
+                                    leveldb_cache_t* c) {
+  opt->rep.blob_cache = c->rep;
+}
+
+void leveldb_options_set_blob_gc_age_cutoff(leveldb_options_t* opt,
+                                            double cutoff) {
+  opt->rep.blob_gc_age_cutoff = cutoff;
+}
+
 void leveldb_options_set_compression(leveldb_options_t* opt, int t) {
   opt->rep.compression = static_cast<CompressionType>(t);
 }
 
+void leveldb_options_set_cache_type(leveldb_options_t* opt, int t) {
+  opt->rep.cache_type = static_cast<CacheType>(t);
+}
+
+void leveldb_options_set_cache_shard_bits(leveldb_options_t* opt, int n) {
+  opt->rep.cache_shard_bits = n;
+}
+
 leveldb_comparator_t* leveldb_comparator_create(
     void* state,
     void (*destructor)(void*),
@@ -496,6 +651,29 @@ void leveldb_filterpolicy_destroy(leveldb_filterpolicy_t* filter) {
   delete filter;
 }
 
+leveldb_compactionfilter_t* leveldb_compactionfilter_create(
+    void* state,
+    void (*destructor)(void*),
+    unsigned char (*filter)(
+        void*,
+        int level,
+        const char* key, size_t key_length,
+        const char* existing_value, size_t value_length,
+        char** new_value, size_t* new_value_length,
+        unsigned char* value_changed),
+    const char* (*name)(void*)) {
+  leveldb_compactionfilter_t* result = new leveldb_compactionfilter_t;
+  result->state_ = state;
+  result->destructor_ = destructor;
+  result->filter_ = filter;
+  result->name_ = name;
+  return result;
+}
+
+void leveldb_compactionfilter_destroy(leveldb_compactionfilter_t* filter) {
+  delete filter;
+}
+
 leveldb_filterpolicy_t* leveldb_filterpolicy_create_bloom(int bits_per_key) {
   // Make a leveldb_filterpolicy_t, but override all of its methods so
   // they delegate to a NewBloomFilterPolicy() instead of user
@@ -538,6 +716,16 @@ void leveldb_readoptions_set_fill_cache(
   opt->rep.fill_cache = v;
 }
 
+void leveldb_readoptions_set_low_priority(
+    leveldb_readoptions_t* opt, unsigned char v) {
+  opt->rep.low_priority = v;
+}
+
+void leveldb_readoptions_set_readahead_blocks(
+    leveldb_readoptions_t* opt, int n) {
+  opt->rep.readahead_blocks = n;
+}
+
 void leveldb_readoptions_set_snapshot(
     leveldb_readoptions_t* opt,
     const leveldb_snapshot_t* snap) {
@@ -563,6 +751,13 @@ leveldb_cache_t* leveldb_cache_create_lru(size_t capacity) {
   return c;
 }
 
+leveldb_cache_t* leveldb_cache_create_clock(size_t capacity,
+                                            int num_shard_bits) {
+  leveldb_cache_t* c = new leveldb_cache_t;
+  c->rep = NewClockCache(capacity, num_shard_bits);
+  return c;
+}
+
 void leveldb_cache_destroy(leveldb_cache_t* cache) {
   delete cache->rep;
   delete cache;
@@ -580,6 +775,19 @@ void leveldb_env_destroy(leveldb_env_t* env) {
   delete env;
 }
 
+void leveldb_env_set_background_threads(leveldb_env_t* env, int n) {
+  env->rep->SetBackgroundThreads(n, Env::LOW);
+}
+
+void leveldb_env_set_high_priority_background_threads(leveldb_env_t* env,
+                                                      int n) {
+  env->rep->SetBackgroundThreads(n, Env::HIGH);
+}
+
+void leveldb_env_set_io_threads(leveldb_env_t* env, int n) {
+  env->rep->SetBackgroundThreads(n, Env::IO);
+}
+
 void leveldb_free(void* ptr) {
   free(ptr);
 }
@@ -154,6 +154,30 @@ unsigned char FilterKeyMatch(
   return fake_filter_result;
 }
 
+// Custom compaction filter removes "drop*" keys and shortens "trim*" values
+static void CompactionFilterDestroy(void* arg) { }
+static const char* CompactionFilterName(void* arg) {
+  return "TestCompactionFilter";
+}
+static unsigned char CompactionFilterFilter(
+    void* arg,
+    int level,
+    const char* key, size_t key_length,
+    const char* existing_value, size_t value_length,
+    char** new_value, size_t* new_value_length,
+    unsigned char* value_changed) {
+  if (key_length >= 4 && memcmp(key, "drop", 4) == 0) {
+    return 1;
+  }
+  if (key_length >= 4 && memcmp(key, "trim", 4) == 0 && value_length > 1) {
+    *new_value = malloc(1);
+    memcpy(*new_value, existing_value, 1);
+    *new_value_length = 1;
+    *value_changed = 1;
+  }
+  return 0;
+}
+
 int main(int argc, char** argv) {
   leveldb_t* db;
   leveldb_comparator_t* cmp;
@@ -176,6 +200,9 @@ int main(int argc, char** argv) {
   StartPhase("create_objects");
   cmp = leveldb_comparator_create(NULL, CmpDestroy, CmpCompare, CmpName);
   env = leveldb_create_default_env();
+  leveldb_env_set_background_threads(env, 2);
+  leveldb_env_set_high_priority_background_threads(env, 1);
+  leveldb_env_set_io_threads(env, 2);
   cache = leveldb_cache_create_lru(100000);
 
   options = leveldb_options_create();
@@ -189,6 +216,9 @@ int main(int argc, char** argv) {
   leveldb_options_set_max_open_files(options, 10);
   leveldb_options_set_block_size(options, 1024);
   leveldb_options_set_block_restart_interval(options, 8);
+  leveldb_options_set_max_subcompactions(options, 2);
+  leveldb_options_set_concurrent_memtable_writes(options, 1);
+  leveldb_options_set_pipelined_writes(options, 1);
   leveldb_options_set_compression(options, leveldb_no_compression);
 
   roptions = leveldb_readoptions_create();
@@ -319,6 +349,51 @@ int main(int argc, char** argv) {
     leveldb_release_snapshot(db, snap);
   }
 
+  StartPhase("ingest");
+  {
+    char sstname[200];
+    const char* files[1];
+    snprintf(sstname, sizeof(sstname),
+             "%s/leveldb_c_test-%d.sst",
+             GetTempDir(),
+             ((int) geteuid()));
+    leveldb_sstfilewriter_t* writer = leveldb_sstfilewriter_create(options);
+    leveldb_sstfilewriter_open(writer, sstname, &err);
+    CheckNoError(err);
+    leveldb_sstfilewriter_put(writer, "zz1", 3, "v1", 2, &err);
+    CheckNoError(err);
+    leveldb_sstfilewriter_put(writer, "zz0", 3, "v0", 2, &err);
+    CheckCondition(err != NULL);
+    Free(&err);
+    leveldb_sstfilewriter_put(writer, "zz2", 3, "v2", 2, &err);
+    CheckNoError(err);
+    leveldb_sstfilewriter_finish(writer, &err);
+    CheckNoError(err);
+    CheckCondition(leveldb_sstfilewriter_file_size(writer) > 0);
+    leveldb_sstfilewriter_destroy(writer);
+
+    files[0] = sstname;
+    leveldb_ingest_external_file(db, files, 1, &err);
+    CheckNoError(err);
+    CheckGet(db, roptions, "zz1", "v1");
+    CheckGet(db, roptions, "zz2", "v2");
+    CheckGet(db, roptions, "box", "c");
+  }
+
+  StartPhase("deleterange");
+  {
+    leveldb_delete_range(db, woptions, "zz0", 3, "zz2", 3, &err);
+    CheckNoError(err);
+    CheckGet(db, roptions, "zz1", NULL);
+    CheckGet(db, roptions, "zz2", "v2");
+    leveldb_writebatch_t* wb = leveldb_writebatch_create();
+    leveldb_writebatch_delete_range(wb, "zz2", 3, "zz3", 3);
+    leveldb_write(db, woptions, wb, &err);
+    CheckNoError(err);
+    CheckGet(db, roptions, "zz2", NULL);
+    leveldb_writebatch_destroy(wb);
+  }
+
   StartPhase("repair");
   {
     leveldb_close(db);
@@ -331,6 +406,7 @@ int main(int argc, char** argv) {
     CheckGet(db, roptions, "foo", NULL);
     CheckGet(db, roptions, "bar", NULL);
     CheckGet(db, roptions, "box", "c");
+    CheckGet(db, roptions, "zz1", NULL);
     leveldb_options_set_create_if_missing(options, 1);
     leveldb_options_set_error_if_exists(options, 1);
   }
@@ -376,6 +452,92 @@ int main(int argc, char** argv) {
     leveldb_filterpolicy_destroy(policy);
   }
 
+  StartPhase("compaction_filter");
+  {
+    leveldb_compactionfilter_t* filter = leveldb_compactionfilter_create(
+        NULL, CompactionFilterDestroy, CompactionFilterFilter,
+        CompactionFilterName);
+    leveldb_close(db);
+    leveldb_destroy_db(options, dbname, &err);
+    leveldb_options_set_compaction_filter(options, filter);
+    db = leveldb_open(options, dbname, &err);
+    CheckNoError(err);
+    // Bound the keys below with a table so that they are compacted into it
+    leveldb_put(db, woptions, "a", 1, "a", 1, &err);
+    CheckNoError(err);
+    leveldb_put(db, woptions, "z", 1, "z", 1, &err);
+    CheckNoError(err);
+    leveldb_compact_range(db, NULL, 0, NULL, 0);
+    leveldb_put(db, woptions, "drop1", 5, "a", 1, &err);
+    CheckNoError(err);
+    leveldb_put(db, woptions, "keep1", 5, "bc", 2, &err);
+    CheckNoError(err);
+    leveldb_put(db, woptions, "trim1", 5, "def", 3, &err);
+    CheckNoError(err);
+    CheckGet(db, roptions, "drop1", "a");
+    leveldb_compact_range(db, NULL, 0, NULL, 0);
+    CheckGet(db, roptions, "drop1", NULL);
+    CheckGet(db, roptions, "keep1", "bc");
+    CheckGet(db, roptions, "trim1", "d");
+    leveldb_close(db);
+    leveldb_destroy_db(options, dbname, &err);
+    leveldb_options_set_compaction_filter(options, NULL);
+    db = leveldb_open(options, dbname, &err);
+    CheckNoError(err);
+    leveldb_compactionfilter_destroy(filter);
+  }
+
+  StartPhase("blobs");
+  {
+    leveldb_close(db);
+    leveldb_destroy_db(options, dbname, &err);
+    leveldb_options_set_min_blob_size(options, 4);
+    leveldb_options_set_blob_gc_age_cutoff(options, 1.0);
+    db = leveldb_open(options, dbname, &err);
+    CheckNoError(err);
+    leveldb_put(db, woptions, "small", 5, "abc", 3, &err);
+    CheckNoError(err);
+    leveldb_put(db, woptions, "large", 5, "abcdefgh", 8, &err);
+    CheckNoError(err);
+    leveldb_compact_range(db, NULL, 0, NULL, 0);
+    CheckGet(db, roptions, "small", "abc");
+    CheckGet(db, roptions, "large", "abcdefgh");
+    leveldb_close(db);
+    leveldb_options_set_min_blob_size(options, 0);
+    leveldb_options_set_error_if_exists(options, 0);
+    db = leveldb_open(options, dbname, &err);
+    CheckNoError(err);
+    CheckGet(db, roptions, "large", "abcdefgh");
+  }
+
+  StartPhase("clock_cache");
+  {
+    leveldb_cache_t* clock = leveldb_cache_create_clock(100000, 2);
+    leveldb_iterator_t* iter;
+    leveldb_close(db);
+    leveldb_options_set_cache(options, clock);
+    db = leveldb_open(options, dbname, &err);
+    CheckNoError(err);
+    leveldb_readoptions_set_fill_cache(roptions, 1);
+    leveldb_readoptions_set_low_priority(roptions, 1);
+    leveldb_readoptions_set_readahead_blocks(roptions, 2);
+    iter = leveldb_create_iterator(db, roptions);
+    leveldb_iter_seek(iter, "large", 5);
+    CheckIter(iter, "large", "abcdefgh");
+    leveldb_iter_destroy(iter);
+    leveldb_readoptions_set_low_priority(roptions, 0);
+    leveldb_readoptions_set_readahead_blocks(roptions, 0);
+    CheckGet(db, roptions, "small", "abc");
+    leveldb_close(db);
+    leveldb_options_set_cache(options, cache);
+    leveldb_options_set_cache_type(options, leveldb_clock_cache);
+    leveldb_options_set_cache_shard_bits(options, 0);
+    db = leveldb_open(options, dbname, &err);
+    CheckNoError(err);
+    leveldb_cache_destroy(clock);
+    CheckGet(db, roptions, "large", "abcdefgh");
+  }
+
   StartPhase("cleanup");
   leveldb_close(db);
   leveldb_options_destroy(options);
@@ -320,6 +320,11 @@ TEST(CorruptionTest, CompactionInputErrorParanoid) {
     dbi->TEST_CompactMemTable();
   }
 
+  // Flushes run alongside compactions so wait for the compaction of the
+  // level-0 files written above before adding another one
+  dbi->TEST_CompactRange(0, NULL, NULL);
+  ASSERT_EQ(0, Property("leveldb.num-files-at-level0"));
+
   Build(10);
   dbi->TEST_CompactMemTable();
   ASSERT_EQ(1, Property("leveldb.num-files-at-level0"));
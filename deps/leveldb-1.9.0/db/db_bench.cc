@@ -94,6 +94,25 @@ static int FLAGS_open_files = 0;
 // Negative means use default settings.
 static int FLAGS_bloom_bits = -1;
 
+// Number of databases that writes are spread across.  Databases after the
+// first are named after --db with a numeric suffix.
+static int FLAGS_num_dbs = 1;
+
+// Number of threads running compactions and memtable flushes in the
+// background.  Use the Env's default if <= 0.
+static int FLAGS_compaction_threads = 0;
+static int FLAGS_flush_threads = 0;
+
+// Maximum number of threads a single compaction is split across.
+// Use the default if <= 0.
+static int FLAGS_max_subcompactions = 0;
+
+// If true, writers of a group insert their own batches into the memtable
+static bool FLAGS_concurrent_memtable_writes = true;
+
+// If true, log the next write group while the previous one is inserted
+static bool FLAGS_pipelined_writes = false;
+
 // If true, do not destroy the existing database.  If you set this
 // flag and also specify a benchmark that wants a fresh database, that
 // benchmark will fail.
@@ -304,6 +323,7 @@ class Benchmark {
   Cache* cache_;
   const FilterPolicy* filter_policy_;
   DB* db_;
+  std::vector<DB*> dbs_;
   int num_;
   int value_size_;
   int entries_per_batch_;
@@ -405,12 +425,12 @@ class Benchmark {
       }
     }
     if (!FLAGS_use_existing_db) {
-      DestroyDB(FLAGS_db, Options());
+      DestroyAll();
     }
   }
 
   ~Benchmark() {
-    delete db_;
+    CloseAll();
     delete cache_;
     delete filter_policy_;
   }
@@ -515,9 +535,8 @@ class Benchmark {
                   name.ToString().c_str());
           method = NULL;
         } else {
-          delete db_;
-          db_ = NULL;
-          DestroyDB(FLAGS_db, Options());
+          CloseAll();
+          DestroyAll();
           Open();
         }
       }
@@ -687,6 +706,15 @@ class Benchmark {
     }
   }
 
+  std::string DBName(int i) {
+    if (i == 0) {
+      return FLAGS_db;
+    }
+    char suffix[100];
+    snprintf(suffix, sizeof(suffix), "-%d", i);
+    return std::string(FLAGS_db) + suffix;
+  }
+
   void Open() {
     assert(db_ == NULL);
     Options options;
@@ -695,10 +723,34 @@ class Benchmark {
     options.write_buffer_size = FLAGS_write_buffer_size;
     options.max_open_files = FLAGS_open_files;
     options.filter_policy = filter_policy_;
-    Status s = DB::Open(options, FLAGS_db, &db_);
-    if (!s.ok()) {
-      fprintf(stderr, "open error: %s\n", s.ToString().c_str());
-      exit(1);
+    if (FLAGS_max_subcompactions > 0) {
+      options.max_subcompactions = FLAGS_max_subcompactions;
+    }
+    options.concurrent_memtable_writes = FLAGS_concurrent_memtable_writes;
+    options.pipelined_writes = FLAGS_pipelined_writes;
+    for (int i = 0; i < FLAGS_num_dbs; i++) {
+      DB* db;
+      Status s = DB::Open(options, DBName(i), &db);
+      if (!s.ok()) {
+        fprintf(stderr, "open error: %s\n", s.ToString().c_str());
+        exit(1);
+      }
+      dbs_.push_back(db);
+    }
+    db_ = dbs_[0];
+  }
+
+  void CloseAll() {
+    for (int i = 0; i < dbs_.size(); i++) {
+      delete dbs_[i];
+    }
+    dbs_.clear();
+    db_ = NULL;
+  }
+
+  void DestroyAll() {
+    for (int i = 0; i < FLAGS_num_dbs; i++) {
+      DestroyDB(DBName(i), Options());
     }
   }
 
@@ -722,6 +774,7 @@ class Benchmark {
     Status s;
     int64_t bytes = 0;
     for (int i = 0; i < num_; i += entries_per_batch_) {
+      DB* db = dbs_[(i / entries_per_batch_) % dbs_.size()];
       batch.Clear();
       for (int j = 0; j < entries_per_batch_; j++) {
         const int k = seq ? i+j : (thread->rand.Next() % FLAGS_num);
@@ -731,7 +784,7 @@ class Benchmark {
         bytes += value_size_ + strlen(key);
         thread->stats.FinishedSingleOp();
       }
-      s = db_->Write(write_options_, &batch);
+      s = db->Write(write_options_, &batch);
       if (!s.ok()) {
         fprintf(stderr, "put error: %s\n", s.ToString().c_str());
         exit(1);
@@ -958,6 +1011,21 @@ int main(int argc, char** argv) {
       FLAGS_bloom_bits = n;
     } else if (sscanf(argv[i], "--open_files=%d%c", &n, &junk) == 1) {
       FLAGS_open_files = n;
+    } else if (sscanf(argv[i], "--num_dbs=%d%c", &n, &junk) == 1 && n > 0) {
+      FLAGS_num_dbs = n;
+    } else if (sscanf(argv[i], "--compaction_threads=%d%c", &n, &junk) == 1) {
+      FLAGS_compaction_threads = n;
+    } else if (sscanf(argv[i], "--flush_threads=%d%c", &n, &junk) == 1) {
+      FLAGS_flush_threads = n;
+    } else if (sscanf(argv[i], "--max_subcompactions=%d%c", &n, &junk) == 1) {
+      FLAGS_max_subcompactions = n;
+    } else if (sscanf(argv[i], "--concurrent_memtable_writes=%d%c",
+                      &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_concurrent_memtable_writes = n;
+    } else if (sscanf(argv[i], "--pipelined_writes=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_pipelined_writes = n;
     } else if (strncmp(argv[i], "--db=", 5) == 0) {
       FLAGS_db = argv[i] + 5;
     } else {
@@ -973,6 +1041,15 @@ int main(int argc, char** argv) {
       FLAGS_db = default_db_path.c_str();
   }
 
+  if (FLAGS_compaction_threads > 0) {
+    leveldb::Env::Default()->SetBackgroundThreads(FLAGS_compaction_threads,
+                                                  leveldb::Env::LOW);
+  }
+  if (FLAGS_flush_threads > 0) {
+    leveldb::Env::Default()->SetBackgroundThreads(FLAGS_flush_threads,
+                                                  leveldb::Env::HIGH);
+  }
+
   leveldb::Benchmark benchmark;
   benchmark.Run();
   return 0;
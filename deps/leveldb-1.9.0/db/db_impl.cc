@@ -10,6 +10,8 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <vector>
+#include "db/blob_cache.h"
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_iter.h"
 #include "db/dbformat.h"
@@ -17,9 +19,11 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_tombstone.h"
 #include "db/table_cache.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/status.h"
@@ -41,6 +45,8 @@ struct DBImpl::Writer {
   WriteBatch* batch;
   bool sync;
   bool done;
+  bool insert;  // Insert batch into mem_ alongside the rest of its group
+  bool exclusive;  // Never part of another writer's group
   port::CondVar cv;
 
   explicit Writer(port::Mutex* mu) : cv(mu) { }
@@ -55,36 +61,112 @@ struct DBImpl::CompactionState {
   // we can drop all entries for the same key with sequence numbers < S.
   SequenceNumber smallest_snapshot;
 
-  // Files produced by compaction
+  // Entries with sequence numbers >= filter_floor are newer than every
+  // snapshot, so the compaction filter may change them without changing
+  // what a snapshot reads.
+  SequenceNumber filter_floor;
+
+  // Range tombstones visible to every snapshot.  Entries they cover are
+  // dropped.  Shared by the states of all subcompactions; may be NULL.
+  const RangeTombstoneSet* tombstones;
+
+  // Values in blob files numbered below blob_gc_threshold are moved into
+  // the blob files of the outputs so the old files can be deleted.
+  uint64_t blob_gc_threshold;
+
+  // Files produced by compaction.  An output table's large values are
+  // written to the blob file with the same number.
   struct Output {
     uint64_t number;
     uint64_t file_size;
+    uint64_t blob_size;
     InternalKey smallest, largest;
+    SequenceNumber largest_sequence;
+    std::set<uint64_t> blob_files;  // Referred to by the table
   };
   std::vector<Output> outputs;
 
   // State kept for output being generated
   WritableFile* outfile;
   TableBuilder* builder;
+  BlobFileBuilder* blob_builder;  // Created by the first value moved
 
   uint64_t total_bytes;
 
+  // Values moved out of old blob files
+  int64_t blobs_relocated;
+
+  // Entries removed and changed by the compaction filter and the value
+  // bytes they no longer hold
+  int64_t filter_removed;
+  int64_t filter_changed;
+  int64_t filter_bytes;
+
+  // User keys in (start, end] are compacted into this state's outputs.
+  // A compaction split into subcompactions has one state per range.
+  bool has_start;
+  bool has_end;
+  std::string start;
+  std::string end;
+  Compaction::Position position;
+
   Output* current_output() { return &outputs[outputs.size()-1]; }
 
   explicit CompactionState(Compaction* c)
       : compaction(c),
+        filter_floor(0),
+        tombstones(NULL),
+        blob_gc_threshold(0),
         outfile(NULL),
         builder(NULL),
-        total_bytes(0) {
+        blob_builder(NULL),
+        total_bytes(0),
+        blobs_relocated(0),
+        filter_removed(0),
+        filter_changed(0),
+        filter_bytes(0),
+        has_start(false),
+        has_end(false) {
   }
 };
 
+// A write group that has been logged and is being inserted into the
+// memtable while later groups are logged
+struct DBImpl::LoggedGroup {
+  SequenceNumber last_sequence;
+  bool inserted;
+  bool published;
+  port::CondVar cv;
+
+  explicit LoggedGroup(port::Mutex* mu)
+      : inserted(false), published(false), cv(mu) { }
+};
+
+// A subcompaction run in its own thread
+struct DBImpl::SubcompactionJob {
+  DBImpl* db;
+  CompactionState* compact;
+  Status status;
+  port::Mutex* mu;
+  port::CondVar* cv;
+  int* remaining;
+};
+
 // Fix user-supplied options to be reasonable
 template <class T,class V>
 static void ClipToRange(T* ptr, V minvalue, V maxvalue) {
   if (static_cast<V>(*ptr) > maxvalue) *ptr = maxvalue;
   if (static_cast<V>(*ptr) < minvalue) *ptr = minvalue;
 }
+// Create a cache of the given capacity with the policy and sharding
+// that "options" asks for
+static Cache* NewInternalCache(const Options& options, size_t capacity) {
+  if (options.cache_type == kClockCache) {
+    return NewClockCache(capacity, options.cache_shard_bits);
+  }
+  return NewLRUCache(capacity, options.cache_shard_bits);
+}
+
 Options SanitizeOptions(const std::string& dbname,
                         const InternalKeyComparator* icmp,
                         const InternalFilterPolicy* ipolicy,
@@ -95,6 +177,9 @@ Options SanitizeOptions(const std::string& dbname,
   ClipToRange(&result.max_open_files,            20,     50000);
   ClipToRange(&result.write_buffer_size,         64<<10, 1<<30);
   ClipToRange(&result.block_size,                1<<10,  4<<20);
+  ClipToRange(&result.max_subcompactions,        1,      64);
+  ClipToRange(&result.blob_gc_age_cutoff,        0.0,    1.0);
+  ClipToRange(&result.cache_shard_bits,          0,      12);
   if (result.info_log == NULL) {
     // Open a log file in the same directory as the db
     src.env->CreateDir(dbname);  // In case it does not exist
@@ -106,7 +191,10 @@ Options SanitizeOptions(const std::string& dbname,
     }
   }
   if (result.block_cache == NULL) {
-    result.block_cache = NewLRUCache(8 << 20);
+    result.block_cache = NewInternalCache(result, 8 << 20);
+  }
+  if (result.blob_cache == NULL) {
+    result.blob_cache = NewInternalCache(result, 8 << 20);
   }
   return result;
 }
@@ -119,6 +207,7 @@ DBImpl::DBImpl(const Options& options, const std::string& dbname)
           dbname, &internal_comparator_, &internal_filter_policy_, options)),
       owns_info_log_(options_.info_log != options.info_log),
       owns_cache_(options_.block_cache != options.block_cache),
+      owns_blob_cache_(options_.blob_cache != options.blob_cache),
       dbname_(dbname),
       db_lock_(NULL),
       shutting_down_(NULL),
@@ -129,7 +218,14 @@ DBImpl::DBImpl(const Options& options, const std::string& dbname)
       logfile_number_(0),
       log_(NULL),
       tmp_batch_(new WriteBatch),
+      pending_inserts_(0),
       bg_compaction_scheduled_(false),
+      bg_flush_scheduled_(false),
+      flushing_(false),
+      applying_edit_(false),
+      installing_flush_(false),
+      ingesting_(false),
+      drop_covered_files_(false),
       manual_compaction_(NULL) {
   mem_->Ref();
   has_imm_.Release_Store(NULL);
@@ -137,6 +233,8 @@ DBImpl::DBImpl(const Options& options, const std::string& dbname)
   // Reserve ten files or so for other uses and give the rest to TableCache.
   const int table_cache_size = options.max_open_files - 10;
   table_cache_ = new TableCache(dbname_, &options_, table_cache_size);
+  blob_cache_ = new BlobCache(dbname_, &options_,
+                              std::max(table_cache_size / 4, 10));
 
   versions_ = new VersionSet(dbname_, &options_, table_cache_,
                              &internal_comparator_);
@@ -146,7 +244,7 @@ DBImpl::~DBImpl() {
   // Wait for background work to finish
   mutex_.Lock();
   shutting_down_.Release_Store(this);  // Any non-NULL value is ok
-  while (bg_compaction_scheduled_) {
+  while (bg_compaction_scheduled_ || bg_flush_scheduled_) {
     bg_cv_.Wait();
   }
   mutex_.Unlock();
@@ -162,6 +260,7 @@ DBImpl::~DBImpl() {
   delete log_;
   delete logfile_;
   delete table_cache_;
+  delete blob_cache_;
 
   if (owns_info_log_) {
     delete options_.info_log;
@@ -169,6 +268,9 @@ DBImpl::~DBImpl() {
   if (owns_cache_) {
     delete options_.block_cache;
   }
+  if (owns_blob_cache_) {
+    delete options_.blob_cache;
+  }
 }
 
 Status DBImpl::NewDB() {
@@ -217,6 +319,11 @@ void DBImpl::DeleteObsoleteFiles() {
   std::set<uint64_t> live = pending_outputs_;
   versions_->AddLiveFiles(&live);
 
+  // A blob file shares its number with the table that was written with
+  // it, so pending outputs also cover the blob files being written.
+  std::set<uint64_t> live_blobs = pending_outputs_;
+  versions_->AddLiveBlobFiles(&live_blobs);
+
   std::vector<std::string> filenames;
   env_->GetChildren(dbname_, &filenames); // Ignoring errors on purpose
   uint64_t number;
@@ -237,6 +344,9 @@ void DBImpl::DeleteObsoleteFiles() {
         case kTableFile:
           keep = (live.find(number) != live.end());
           break;
+        case kBlobFile:
+          keep = (live_blobs.find(number) != live_blobs.end());
+          break;
         case kTempFile:
           // Any temp files that are currently being written to must
           // be recorded in pending_outputs_, which is inserted into "live"
@@ -252,6 +362,8 @@ void DBImpl::DeleteObsoleteFiles() {
       if (!keep) {
         if (type == kTableFile) {
           table_cache_->Evict(number);
+        } else if (type == kBlobFile) {
+          blob_cache_->Evict(number);
         }
         Log(options_.info_log, "Delete type=%d #%lld\n",
             int(type),
@@ -415,7 +527,9 @@ Status DBImpl::RecoverLogFile(uint64_t log_number,
     }
 
     if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
-      status = WriteLevel0Table(mem, edit, NULL);
+      uint64_t number;
+      status = WriteLevel0Table(mem, edit, false, &number);
+      pending_outputs_.erase(number);
       if (!status.ok()) {
         // Reflect errors immediately so that conditions like full
         // file-systems cause the DB::Open() to fail.
@@ -427,7 +541,9 @@ Status DBImpl::RecoverLogFile(uint64_t log_number,
   }
 
   if (status.ok() && mem != NULL) {
-    status = WriteLevel0Table(mem, edit, NULL);
+    uint64_t number;
+    status = WriteLevel0Table(mem, edit, false, &number);
+    pending_outputs_.erase(number);
     // Reflect errors immediately so that conditions like full
     // file-systems cause the DB::Open() to fail.
   }
@@ -438,12 +554,13 @@ Status DBImpl::RecoverLogFile(uint64_t log_number,
 }
 
 Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
-                                Version* base) {
+                                bool pick_level, uint64_t* number) {
   mutex_.AssertHeld();
   const uint64_t start_micros = env_->NowMicros();
   FileMetaData meta;
   meta.number = versions_->NewFileNumber();
   pending_outputs_.insert(meta.number);
+  *number = meta.number;
   Iterator* iter = mem->NewIterator();
   Log(options_.info_log, "Level-0 table #%llu: started",
       (unsigned long long) meta.number);
@@ -460,20 +577,36 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
       (unsigned long long) meta.file_size,
       s.ToString().c_str());
   delete iter;
-  pending_outputs_.erase(meta.number);
-
 
   // Note that if file_size is zero, the file has been deleted and
-  // should not be added to the manifest.
+  // should not be added to the manifest.  The table stays in level-0
+  // while a compaction may be running since the compaction's outputs are
+  // not part of the current version yet and could overlap a deeper level.
+  // Otherwise the level is picked from the current version, which holds
+  // every compaction that finished while the table was built, and no
+  // compaction is picked until the edit is applied.
   int level = 0;
   if (s.ok() && meta.file_size > 0) {
     const Slice min_user_key = meta.smallest.user_key();
     const Slice max_user_key = meta.largest.user_key();
-    if (base != NULL) {
-      level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
+    if (pick_level && !bg_compaction_scheduled_) {
+      level = versions_->current()->PickLevelForMemTableOutput(
+          min_user_key, max_user_key);
+      installing_flush_ = (level > 0);
+    }
+    edit->AddFile(level, meta);
+  }
+
+  // Range tombstones are kept in the version rather than in the table
+  if (s.ok()) {
+    std::vector<RangeTombstone> tombstones;
+    mem->GetRangeTombstones(&tombstones);
+    for (size_t i = 0; i < tombstones.size(); i++) {
+      edit->AddRangeTombstone(tombstones[i]);
+    }
+    if (!tombstones.empty()) {
+      drop_covered_files_ = true;
     }
-    edit->AddFile(level, meta.number, meta.file_size,
-                  meta.smallest, meta.largest);
   }
 
   CompactionStats stats;
@@ -486,13 +619,13 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
 Status DBImpl::CompactMemTable() {
   mutex_.AssertHeld();
   assert(imm_ != NULL);
+  assert(!flushing_);
+  flushing_ = true;
 
   // Save the contents of the memtable as a new Table
   VersionEdit edit;
-  Version* base = versions_->current();
-  base->Ref();
-  Status s = WriteLevel0Table(imm_, &edit, base);
-  base->Unref();
+  uint64_t number;
+  Status s = WriteLevel0Table(imm_, &edit, true, &number);
 
   if (s.ok() && shutting_down_.Acquire_Load()) {
     s = Status::IOError("Deleting DB during memtable compaction");
@@ -502,7 +635,12 @@ Status DBImpl::CompactMemTable() {
   if (s.ok()) {
     edit.SetPrevLogNumber(0);
     edit.SetLogNumber(logfile_number_);  // Earlier logs no longer needed
-    s = versions_->LogAndApply(&edit, &mutex_);
+    s = LogAndApply(&edit);
+  }
+  pending_outputs_.erase(number);
+  if (installing_flush_) {
+    installing_flush_ = false;
+    bg_cv_.SignalAll();
   }
 
   if (s.ok()) {
@@ -513,6 +651,7 @@ Status DBImpl::CompactMemTable() {
     DeleteObsoleteFiles();
   }
 
+  flushing_ = false;
   return s;
 }
 
@@ -533,6 +672,252 @@ void DBImpl::CompactRange(const Slice* begin, const Slice* end) {
   }
 }
 
+// Move "src" to "dst", or copy it if it cannot be renamed, e.g. because
+// it is on another file system.  Sets *moved to whether it was renamed.
+static Status LinkExternalFile(Env* env, const std::string& src,
+                               const std::string& dst, bool* moved) {
+  Status s = env->RenameFile(src, dst);
+  *moved = s.ok();
+  if (s.ok()) {
+    return s;
+  }
+  SequentialFile* in;
+  s = env->NewSequentialFile(src, &in);
+  if (!s.ok()) {
+    return s;
+  }
+  WritableFile* out;
+  s = env->NewWritableFile(dst, &out);
+  if (s.ok()) {
+    const size_t kBufferSize = 1 << 20;
+    char* space = new char[kBufferSize];
+    while (s.ok()) {
+      Slice fragment;
+      s = in->Read(kBufferSize, &fragment, space);
+      if (!s.ok() || fragment.empty()) {
+        break;
+      }
+      s = out->Append(fragment);
+    }
+    delete[] space;
+    if (s.ok()) {
+      s = out->Sync();
+    }
+    if (s.ok()) {
+      s = out->Close();
+    }
+    delete out;
+    if (!s.ok()) {
+      env->DeleteFile(dst);
+    }
+  }
+  delete in;
+  return s;
+}
+
+Status DBImpl::ReadExternalFile(const std::string& fname,
+                                FileMetaData* meta) {
+  RandomAccessFile* file = NULL;
+  Table* table = NULL;
+  Status s = env_->GetFileSize(fname, &meta->file_size);
+  if (s.ok()) {
+    s = env_->NewRandomAccessFile(fname, &file);
+  }
+  if (s.ok()) {
+    s = Table::Open(options_, file, meta->file_size, &table);
+  }
+  if (s.ok()) {
+    ReadOptions options;
+    options.fill_cache = false;
+    Iterator* iter = table->NewIterator(options);
+    iter->SeekToFirst();
+    if (iter->Valid()) {
+      meta->smallest.DecodeFrom(iter->key());
+      iter->SeekToLast();
+    }
+    if (iter->Valid()) {
+      meta->largest.DecodeFrom(iter->key());
+    } else if (iter->status().ok()) {
+      s = Status::InvalidArgument("external file is empty", fname);
+    }
+    if (s.ok()) {
+      s = iter->status();
+    }
+    delete iter;
+  }
+  if (s.ok()) {
+    // SstFileWriter stores every entry with sequence number zero
+    ParsedInternalKey smallest, largest;
+    if (!ParseInternalKey(meta->smallest.Encode(), &smallest) ||
+        !ParseInternalKey(meta->largest.Encode(), &largest) ||
+        smallest.sequence != 0 || largest.sequence != 0) {
+      s = Status::InvalidArgument(
+          "external file was not written by an SstFileWriter", fname);
+    }
+  }
+  delete table;
+  delete file;
+  return s;
+}
+
+bool DBImpl::OverlapsLiveData(const Slice& smallest, const Slice& largest) {
+  mutex_.AssertHeld();
+  const InternalKey start(smallest, kMaxSequenceNumber, kValueTypeForSeek);
+  MemTable* mems[2] = { mem_, imm_ };
+  for (int i = 0; i < 2; i++) {
+    if (mems[i] == NULL) {
+      continue;
+    }
+    Iterator* iter = mems[i]->NewIterator();
+    iter->Seek(start.Encode());
+    const bool overlap = iter->Valid() &&
+        user_comparator()->Compare(ExtractUserKey(iter->key()), largest) <= 0;
+    delete iter;
+    if (overlap) {
+      return true;
+    }
+  }
+
+  Version* current = versions_->current();
+  for (int level = 0; level < config::kNumLevels; level++) {
+    if (current->OverlapInLevel(level, &smallest, &largest)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Status DBImpl::IngestExternalFile(const std::vector<std::string>& files) {
+  // Read the key ranges of the files without holding the mutex
+  std::vector<FileMetaData> metas(files.size());
+  Status s;
+  for (size_t i = 0; s.ok() && i < files.size(); i++) {
+    s = ReadExternalFile(files[i], &metas[i]);
+  }
+  const Comparator* ucmp = user_comparator();
+  for (size_t i = 0; s.ok() && i < metas.size(); i++) {
+    for (size_t j = i + 1; s.ok() && j < metas.size(); j++) {
+      if (ucmp->Compare(metas[i].largest.user_key(),
+                        metas[j].smallest.user_key()) >= 0 &&
+          ucmp->Compare(metas[j].largest.user_key(),
+                        metas[i].smallest.user_key()) >= 0) {
+        s = Status::InvalidArgument("external files overlap", files[j]);
+      }
+    }
+  }
+  if (!s.ok() || files.empty()) {
+    return s;
+  }
+
+  // Wait for earlier writes and keep later ones out while the files are
+  // checked against the memtables and linked in.
+  Writer w(&mutex_);
+  w.batch = NULL;
+  w.sync = false;
+  w.done = false;
+  w.insert = false;
+  w.exclusive = true;
+
+  MutexLock l(&mutex_);
+  writers_.push_back(&w);
+  while (&w != writers_.front()) {
+    w.cv.Wait();
+  }
+  while (!logged_groups_.empty()) {
+    bg_cv_.Wait();
+  }
+
+  s = bg_error_;
+  for (size_t i = 0; s.ok() && i < metas.size(); i++) {
+    if (OverlapsLiveData(metas[i].smallest.user_key(),
+                         metas[i].largest.user_key())) {
+      s = Status::InvalidArgument("external file overlaps existing data",
+                                  files[i]);
+    }
+  }
+
+  if (s.ok()) {
+    // The files overlap no other data so they belong in the last level.
+    // Flushes and compactions pick the levels of their outputs from the
+    // version they started with though, so while either is scheduled the
+    // files go to level-0 where overlapping files are allowed.
+    int level = config::kNumLevels - 1;
+    if (bg_compaction_scheduled_ || bg_flush_scheduled_) {
+      level = 0;
+    }
+    ingesting_ = true;
+
+    const SequenceNumber sequence = versions_->LastSequence() + 1;
+    for (size_t i = 0; i < metas.size(); i++) {
+      metas[i].number = versions_->NewFileNumber();
+      pending_outputs_.insert(metas[i].number);
+    }
+    size_t linked = 0;
+    std::vector<bool> moved(metas.size(), false);
+    {
+      mutex_.Unlock();
+      for (; linked < metas.size(); linked++) {
+        const std::string fname = TableFileName(dbname_,
+                                                metas[linked].number);
+        bool m;
+        s = LinkExternalFile(env_, files[linked], fname, &m);
+        if (!s.ok()) {
+          break;
+        }
+        moved[linked] = m;
+      }
+      mutex_.Lock();
+    }
+
+    if (s.ok()) {
+      VersionEdit edit;
+      for (size_t i = 0; i < metas.size(); i++) {
+        const FileMetaData& f = metas[i];
+        edit.AddFile(level, f.number, f.file_size,
+                     InternalKey(f.smallest.user_key(), sequence, kTypeValue),
+                     InternalKey(f.largest.user_key(), sequence, kTypeValue),
+                     sequence);
+      }
+      // Later writes must sort after the ingested entries, also once the
+      // DB is recovered, so the sequence is used before it is logged.
+      versions_->SetLastSequence(sequence);
+      s = LogAndApply(&edit);
+    }
+    if (!s.ok()) {
+      // Give the caller's files back before they lose the protection of
+      // pending_outputs_ and are deleted as obsolete.  Copies are simply
+      // removed.
+      for (size_t i = 0; i < linked; i++) {
+        const std::string fname = TableFileName(dbname_, metas[i].number);
+        Status r;
+        if (moved[i]) {
+          r = env_->RenameFile(fname, files[i]);
+        } else {
+          r = env_->DeleteFile(fname);
+        }
+        if (!r.ok()) {
+          Log(options_.info_log, "Unlinking %s: %s",
+              files[i].c_str(), r.ToString().c_str());
+        }
+      }
+    }
+    for (size_t i = 0; i < metas.size(); i++) {
+      pending_outputs_.erase(metas[i].number);
+    }
+    Log(options_.info_log, "Ingested %d files to level-%d: %s",
+        static_cast<int>(metas.size()), level, s.ToString().c_str());
+
+    ingesting_ = false;
+    MaybeScheduleCompaction();
+  }
+
+  writers_.pop_front();
+  if (!writers_.empty()) {
+    writers_.front()->cv.Signal();
+  }
+  return s;
+}
+
 void DBImpl::TEST_CompactRange(int level, const Slice* begin,const Slice* end) {
   assert(level >= 0);
   assert(level + 1 < config::kNumLevels);
@@ -584,19 +969,45 @@ Status DBImpl::TEST_CompactMemTable() {
   return s;
 }
 
+Status DBImpl::LogAndApply(VersionEdit* edit) {
+  mutex_.AssertHeld();
+  while (applying_edit_) {
+    bg_cv_.Wait();
+  }
+  applying_edit_ = true;
+  Status s = versions_->LogAndApply(edit, &mutex_);
+  applying_edit_ = false;
+  bg_cv_.SignalAll();
+  return s;
+}
+
 void DBImpl::MaybeScheduleCompaction() {
   mutex_.AssertHeld();
+  if (shutting_down_.Acquire_Load()) {
+    // DB is being deleted; no more background compactions
+    return;
+  }
+  if (ingesting_) {
+    // IngestExternalFile() reschedules once the files are linked
+    return;
+  }
+
+  // Memtable flushes run in the high priority pool so that they are not
+  // queued behind compactions of this or any other DB sharing the Env.
+  if (imm_ != NULL && !bg_flush_scheduled_) {
+    bg_flush_scheduled_ = true;
+    env_->Schedule(&DBImpl::BGWorkFlush, this, Env::HIGH);
+  }
+
   if (bg_compaction_scheduled_) {
     // Already scheduled
-  } else if (shutting_down_.Acquire_Load()) {
-    // DB is being deleted; no more background compactions
-  } else if (imm_ == NULL &&
-             manual_compaction_ == NULL &&
+  } else if (manual_compaction_ == NULL &&
+             !drop_covered_files_ &&
              !versions_->NeedsCompaction()) {
     // No work to be done
   } else {
     bg_compaction_scheduled_ = true;
-    env_->Schedule(&DBImpl::BGWork, this);
+    env_->Schedule(&DBImpl::BGWork, this, Env::LOW);
   }
 }
 
@@ -604,26 +1015,35 @@ void DBImpl::BGWork(void* db) {
   reinterpret_cast<DBImpl*>(db)->BackgroundCall();
 }
 
+void DBImpl::BGWorkFlush(void* db) {
+  reinterpret_cast<DBImpl*>(db)->BackgroundFlushCall();
+}
+
+void DBImpl::BackgroundError(const Status& s) {
+  mutex_.AssertHeld();
+  if (shutting_down_.Acquire_Load()) {
+    // Error most likely due to shutdown; do not wait
+  } else {
+    // Wait a little bit before retrying background compaction in
+    // case this is an environmental problem and we do not want to
+    // chew up resources for failed compactions for the duration of
+    // the problem.
+    bg_cv_.SignalAll();  // In case a waiter can proceed despite the error
+    Log(options_.info_log, "Waiting after background compaction error: %s",
+        s.ToString().c_str());
+    mutex_.Unlock();
+    env_->SleepForMicroseconds(1000000);
+    mutex_.Lock();
+  }
+}
+
 void DBImpl::BackgroundCall() {
   MutexLock l(&mutex_);
   assert(bg_compaction_scheduled_);
   if (!shutting_down_.Acquire_Load()) {
     Status s = BackgroundCompaction();
-    if (s.ok()) {
-      // Success
-    } else if (shutting_down_.Acquire_Load()) {
-      // Error most likely due to shutdown; do not wait
-    } else {
-      // Wait a little bit before retrying background compaction in
-      // case this is an environmental problem and we do not want to
-      // chew up resources for failed compactions for the duration of
-      // the problem.
-      bg_cv_.SignalAll();  // In case a waiter can proceed despite the error
-      Log(options_.info_log, "Waiting after background compaction error: %s",
-          s.ToString().c_str());
-      mutex_.Unlock();
-      env_->SleepForMicroseconds(1000000);
-      mutex_.Lock();
+    if (!s.ok()) {
+      BackgroundError(s);
     }
   }
 
@@ -635,17 +1055,67 @@ void DBImpl::BackgroundCall() {
   bg_cv_.SignalAll();
 }
 
-Status DBImpl::BackgroundCompaction() {
+void DBImpl::BackgroundFlushCall() {
+  MutexLock l(&mutex_);
+  assert(bg_flush_scheduled_);
+  if (!shutting_down_.Acquire_Load() && imm_ != NULL && !flushing_) {
+    Status s = CompactMemTable();
+    if (!s.ok()) {
+      BackgroundError(s);
+    }
+  }
+
+  bg_flush_scheduled_ = false;
+
+  // The new level-0 file may need to be compacted and a full memtable may
+  // have been switched out while the flush was running.
+  MaybeScheduleCompaction();
+  bg_cv_.SignalAll();
+}
+
+Status DBImpl::DropCoveredFiles() {
   mutex_.AssertHeld();
+  drop_covered_files_ = false;
+  if (versions_->current()->range_tombstones().empty()) {
+    return Status::OK();
+  }
 
-  if (imm_ != NULL) {
-    return CompactMemTable();
+  // Only tombstones that every snapshot sees may delete whole files.
+  // Tombstones are retired once no table overlaps them; newer writes to
+  // their ranges are not covered anyway.
+  const SequenceNumber smallest_snapshot =
+      snapshots_.empty() ? versions_->LastSequence()
+                         : snapshots_.oldest()->number_;
+  VersionEdit edit;
+  int files, tombstones;
+  versions_->AddRangeDeletions(smallest_snapshot, &edit, &files, &tombstones);
+  if (files == 0 && tombstones == 0) {
+    return Status::OK();
+  }
+
+  Status s = LogAndApply(&edit);
+  Log(options_.info_log, "Dropped %d files and %d range tombstones: %s\n",
+      files, tombstones, s.ToString().c_str());
+  if (s.ok()) {
+    DeleteObsoleteFiles();
+  }
+  return s;
+}
+
+Status DBImpl::BackgroundCompaction() {
+  mutex_.AssertHeld();
+  while (installing_flush_) {
+    bg_cv_.Wait();
   }
 
+  Status status = DropCoveredFiles();
+
   Compaction* c;
   bool is_manual = (manual_compaction_ != NULL);
   InternalKey manual_end;
-  if (is_manual) {
+  if (!status.ok()) {
+    c = NULL;
+  } else if (is_manual) {
     ManualCompaction* m = manual_compaction_;
     c = versions_->CompactRange(m->level, m->begin, m->end);
     m->done = (c == NULL);
@@ -662,7 +1132,6 @@ Status DBImpl::BackgroundCompaction() {
     c = versions_->PickCompaction();
   }
 
-  Status status;
   if (c == NULL) {
     // Nothing to do
   } else if (!is_manual && c->IsTrivialMove()) {
@@ -670,9 +1139,8 @@ Status DBImpl::BackgroundCompaction() {
     assert(c->num_input_files(0) == 1);
     FileMetaData* f = c->input(0, 0);
     c->edit()->DeleteFile(c->level(), f->number);
-    c->edit()->AddFile(c->level() + 1, f->number, f->file_size,
-                       f->smallest, f->largest);
-    status = versions_->LogAndApply(c->edit(), &mutex_);
+    c->edit()->AddFile(c->level() + 1, *f);
+    status = LogAndApply(c->edit());
     VersionSet::LevelSummaryStorage tmp;
     Log(options_.info_log, "Moved #%lld to level-%d %lld bytes %s: %s\n",
         static_cast<unsigned long long>(f->number),
@@ -727,6 +1195,7 @@ void DBImpl::CleanupCompaction(CompactionState* compact) {
     assert(compact->outfile == NULL);
   }
   delete compact->outfile;
+  delete compact->blob_builder;
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     const CompactionState::Output& out = compact->outputs[i];
     pending_outputs_.erase(out.number);
@@ -744,8 +1213,11 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
     pending_outputs_.insert(file_number);
     CompactionState::Output out;
     out.number = file_number;
+    out.file_size = 0;
+    out.blob_size = 0;
     out.smallest.Clear();
     out.largest.Clear();
+    out.largest_sequence = 0;
     compact->outputs.push_back(out);
     mutex_.Unlock();
   }
@@ -759,6 +1231,22 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   return s;
 }
 
+Status DBImpl::OpenCompactionBlobFile(CompactionState* compact) {
+  assert(compact != NULL);
+  assert(compact->builder != NULL);
+  assert(compact->blob_builder == NULL);
+
+  // The blob file shares the number of the output table, which is
+  // already in pending_outputs_
+  const uint64_t file_number = compact->current_output()->number;
+  WritableFile* file;
+  Status s = env_->NewWritableFile(BlobFileName(dbname_, file_number), &file);
+  if (s.ok()) {
+    compact->blob_builder = new BlobFileBuilder(file_number, file);
+  }
+  return s;
+}
+
 Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
                                           Iterator* input) {
   assert(compact != NULL);
@@ -792,6 +1280,24 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   delete compact->outfile;
   compact->outfile = NULL;
 
+  if (compact->blob_builder != NULL) {
+    if (s.ok()) {
+      s = compact->blob_builder->Finish();
+    }
+    if (s.ok()) {
+      Log(options_.info_log,
+          "Generated blob file #%llu: %lld values, %lld bytes",
+          (unsigned long long) output_number,
+          (unsigned long long) compact->blob_builder->NumEntries(),
+          (unsigned long long) compact->blob_builder->FileSize());
+    }
+    compact->current_output()->blob_size = compact->blob_builder->FileSize();
+    compact->current_output()->blob_files.insert(output_number);
+    compact->total_bytes += compact->blob_builder->FileSize();
+    delete compact->blob_builder;
+    compact->blob_builder = NULL;
+  }
+
   if (s.ok() && current_entries > 0) {
     // Verify that the table is usable
     Iterator* iter = table_cache_->NewIterator(ReadOptions(),
@@ -825,11 +1331,16 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact) {
   const int level = compact->compaction->level();
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     const CompactionState::Output& out = compact->outputs[i];
-    compact->compaction->edit()->AddFile(
-        level + 1,
-        out.number, out.file_size, out.smallest, out.largest);
-  }
-  return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
+    FileMetaData meta;
+    meta.number = out.number;
+    meta.file_size = out.file_size;
+    meta.smallest = out.smallest;
+    meta.largest = out.largest;
+    meta.largest_sequence = out.largest_sequence;
+    meta.blob_files.assign(out.blob_files.begin(), out.blob_files.end());
+    compact->compaction->edit()->AddFile(level + 1, meta);
+  }
+  return LogAndApply(compact->compaction->edit());
 }
 
 Status DBImpl::DoCompactionWork(CompactionState* compact) {
@@ -847,35 +1358,192 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   assert(compact->outfile == NULL);
   if (snapshots_.empty()) {
     compact->smallest_snapshot = versions_->LastSequence();
+    compact->filter_floor = 0;
   } else {
     compact->smallest_snapshot = snapshots_.oldest()->number_;
+    compact->filter_floor = snapshots_.newest()->number_ + 1;
+  }
+  RangeTombstoneSet tombstones(user_comparator(),
+                               versions_->current()->range_tombstones(),
+                               compact->smallest_snapshot);
+  if (!tombstones.empty()) {
+    compact->tombstones = &tombstones;
+  }
+
+  // Collect the oldest blob files.  Blob files are numbered in the order
+  // they are written.
+  std::set<uint64_t> blob_files;
+  versions_->AddLiveBlobFiles(&blob_files);
+  size_t collect = static_cast<size_t>(
+      blob_files.size() * options_.blob_gc_age_cutoff);
+  for (std::set<uint64_t>::const_iterator iter = blob_files.begin();
+       collect > 0 && iter != blob_files.end();
+       ++iter, --collect) {
+    compact->blob_gc_threshold = *iter + 1;
+  }
+
+  // Split a large compaction into key ranges that are compacted by
+  // separate threads.  This thread compacts the first range.
+  std::vector<std::string> boundaries;
+  compact->compaction->GetSubcompactionBoundaries(
+      options_.max_subcompactions, &boundaries);
+  std::vector<SubcompactionJob> jobs(boundaries.size());
+  for (size_t i = 0; i < boundaries.size(); i++) {
+    CompactionState* sub = new CompactionState(compact->compaction);
+    sub->smallest_snapshot = compact->smallest_snapshot;
+    sub->filter_floor = compact->filter_floor;
+    sub->tombstones = compact->tombstones;
+    sub->blob_gc_threshold = compact->blob_gc_threshold;
+    sub->has_start = true;
+    sub->start = boundaries[i];
+    if (i + 1 < boundaries.size()) {
+      sub->has_end = true;
+      sub->end = boundaries[i + 1];
+    }
+    jobs[i].db = this;
+    jobs[i].compact = sub;
+  }
+  if (!boundaries.empty()) {
+    compact->has_end = true;
+    compact->end = boundaries[0];
+    Log(options_.info_log, "Compacting in %d subcompactions",
+        static_cast<int>(boundaries.size() + 1));
   }
 
   // Release mutex while we're actually doing the compaction work
   mutex_.Unlock();
 
+  port::Mutex jobs_mu;
+  port::CondVar jobs_cv(&jobs_mu);
+  int remaining = jobs.size();
+  for (size_t i = 0; i < jobs.size(); i++) {
+    jobs[i].mu = &jobs_mu;
+    jobs[i].cv = &jobs_cv;
+    jobs[i].remaining = &remaining;
+    env_->StartThread(&DBImpl::BGWorkSubcompaction, &jobs[i]);
+  }
+  Status status = DoSubcompactionWork(compact, &imm_micros);
+  jobs_mu.Lock();
+  while (remaining > 0) {
+    jobs_cv.Wait();
+  }
+  jobs_mu.Unlock();
+
+  CompactionStats stats;
+  stats.micros = env_->NowMicros() - start_micros - imm_micros;
+  for (int which = 0; which < 2; which++) {
+    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
+      stats.bytes_read += compact->compaction->input(which, i)->file_size;
+    }
+  }
+
+  mutex_.Lock();
+
+  // Gather the outputs of every range so they are installed in one edit
+  for (size_t i = 0; i < jobs.size(); i++) {
+    CompactionState* sub = jobs[i].compact;
+    if (status.ok()) {
+      status = jobs[i].status;
+    }
+    compact->outputs.insert(compact->outputs.end(),
+                            sub->outputs.begin(), sub->outputs.end());
+    compact->total_bytes += sub->total_bytes;
+    compact->blobs_relocated += sub->blobs_relocated;
+    compact->filter_removed += sub->filter_removed;
+    compact->filter_changed += sub->filter_changed;
+    compact->filter_bytes += sub->filter_bytes;
+    sub->outputs.clear();
+    CleanupCompaction(sub);
+  }
+  for (size_t i = 0; i < compact->outputs.size(); i++) {
+    stats.bytes_written += compact->outputs[i].file_size +
+                           compact->outputs[i].blob_size;
+  }
+  stats.filter_removed = compact->filter_removed;
+  stats.filter_changed = compact->filter_changed;
+  stats.filter_bytes = compact->filter_bytes;
+  stats_[compact->compaction->level() + 1].Add(stats);
+  if (compact->filter_removed > 0 || compact->filter_changed > 0) {
+    Log(options_.info_log, "Compaction filter %s: removed %lld, changed %lld,"
+        " trimmed %lld bytes",
+        options_.compaction_filter->Name(),
+        static_cast<long long>(compact->filter_removed),
+        static_cast<long long>(compact->filter_changed),
+        static_cast<long long>(compact->filter_bytes));
+  }
+  if (compact->blobs_relocated > 0) {
+    Log(options_.info_log, "Moved %lld values out of blob files before #%llu",
+        static_cast<long long>(compact->blobs_relocated),
+        static_cast<unsigned long long>(compact->blob_gc_threshold));
+  }
+
+  if (status.ok()) {
+    status = InstallCompactionResults(compact);
+  }
+  VersionSet::LevelSummaryStorage tmp;
+  Log(options_.info_log,
+      "compacted to: %s", versions_->LevelSummary(&tmp));
+  return status;
+}
+
+void DBImpl::BGWorkSubcompaction(void* arg) {
+  SubcompactionJob* job = reinterpret_cast<SubcompactionJob*>(arg);
+  job->status = job->db->DoSubcompactionWork(job->compact, NULL);
+  MutexLock l(job->mu);
+  (*job->remaining)--;
+  job->cv->SignalAll();
+}
+
+Status DBImpl::DoSubcompactionWork(CompactionState* compact,
+                                   int64_t* imm_micros) {
   Iterator* input = versions_->MakeInputIterator(compact->compaction);
-  input->SeekToFirst();
   Status status;
   ParsedInternalKey ikey;
+  if (compact->has_start) {
+    // Skip the entries for the range's start key, which belong to the
+    // previous range.
+    InternalKey start(compact->start, kMaxSequenceNumber, kValueTypeForSeek);
+    input->Seek(start.Encode());
+    while (input->Valid() && ParseInternalKey(input->key(), &ikey) &&
+           user_comparator()->Compare(ikey.user_key, compact->start) <= 0) {
+      input->Next();
+    }
+  } else {
+    input->SeekToFirst();
+  }
+  const CompactionFilter* filter = options_.compaction_filter;
+  std::string filter_value;
+  std::string filter_key;
+  ReadOptions blob_options;
+  blob_options.fill_cache = false;
+  std::string blob_value;
+  std::string blob_index;
   std::string current_user_key;
   bool has_current_user_key = false;
   SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
   for (; input->Valid() && !shutting_down_.Acquire_Load(); ) {
-    // Prioritize immutable compaction work
-    if (has_imm_.NoBarrier_Load() != NULL) {
+    // Prioritize immutable compaction work unless a flush is already
+    // running.  Flushes normally run in their own thread but an Env may
+    // queue them behind this compaction.
+    if (imm_micros != NULL && has_imm_.NoBarrier_Load() != NULL) {
       const uint64_t imm_start = env_->NowMicros();
       mutex_.Lock();
-      if (imm_ != NULL) {
+      if (imm_ != NULL && !flushing_) {
         CompactMemTable();
         bg_cv_.SignalAll();  // Wakeup MakeRoomForWrite() if necessary
       }
       mutex_.Unlock();
-      imm_micros += (env_->NowMicros() - imm_start);
+      *imm_micros += (env_->NowMicros() - imm_start);
     }
 
     Slice key = input->key();
-    if (compact->compaction->ShouldStopBefore(key) &&
+    if (compact->has_end && ParseInternalKey(key, &ikey) &&
+        user_comparator()->Compare(ikey.user_key, compact->end) > 0) {
+      // Reached the start of the next range
+      break;
+    }
+
+    if (compact->compaction->ShouldStopBefore(key, &compact->position) &&
         compact->builder != NULL) {
       status = FinishCompactionOutputFile(compact, input);
       if (!status.ok()) {
@@ -905,7 +1573,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         drop = true;    // (A)
       } else if (ikey.type == kTypeDeletion &&
                  ikey.sequence <= compact->smallest_snapshot &&
-                 compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
+                 compact->compaction->IsBaseLevelForKey(ikey.user_key,
+                                                        &compact->position)) {
         // For this user key:
         // (1) there is no data in higher levels
         // (2) data in lower levels will have larger sequence numbers
@@ -914,6 +1583,11 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         //     few iterations of this loop (by rule (A) above).
         // Therefore this deletion marker is obsolete and can be dropped.
         drop = true;
+      } else if (compact->tombstones != NULL &&
+                 compact->tombstones->Covers(ikey.user_key, ikey.sequence)) {
+        // Deleted by a range tombstone that every snapshot sees.  The
+        // tombstone outlives the entries it covers in other files.
+        drop = true;
       }
 
       last_sequence_for_key = ikey.sequence;
@@ -924,10 +1598,53 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         "%d smallest_snapshot: %d",
         ikey.user_key.ToString().c_str(),
         (int)ikey.sequence, ikey.type, kTypeValue, drop,
-        compact->compaction->IsBaseLevelForKey(ikey.user_key),
+        compact->compaction->IsBaseLevelForKey(ikey.user_key,
+                                               &compact->position),
         (int)last_sequence_for_key, (int)compact->smallest_snapshot);
 #endif
 
+    // Values in blob files are read only for the compaction filter or
+    // when their blob file is collected.
+    Slice value = input->value();
+    ValueType type = has_current_user_key ? ikey.type : kTypeValue;
+    if (!drop && filter != NULL && has_current_user_key &&
+        (type == kTypeValue || type == kTypeBlobIndex) &&
+        ikey.sequence >= compact->filter_floor) {
+      Slice existing = value;
+      if (type == kTypeBlobIndex) {
+        status = blob_cache_->Get(blob_options, value, &blob_value);
+        if (!status.ok()) {
+          break;
+        }
+        existing = blob_value;
+      }
+      bool value_changed = false;
+      filter_value.clear();
+      if (filter->Filter(compact->compaction->level() + 1, ikey.user_key,
+                         existing, &filter_value, &value_changed)) {
+        compact->filter_removed++;
+        compact->filter_bytes += existing.size();
+        if (ikey.sequence <= compact->smallest_snapshot &&
+            compact->compaction->IsBaseLevelForKey(ikey.user_key,
+                                                   &compact->position)) {
+          // Older entries for the key in this compaction are dropped by
+          // rule (A) and there are none in deeper levels
+          drop = true;
+        } else {
+          // Older values of the key kept for snapshots or in deeper levels
+          // must stay hidden
+          type = kTypeDeletion;
+          value = Slice();
+        }
+      } else if (value_changed) {
+        compact->filter_changed++;
+        compact->filter_bytes += static_cast<int64_t>(existing.size()) -
+                                 static_cast<int64_t>(filter_value.size());
+        type = kTypeValue;
+        value = filter_value;
+      }
+    }
+
     if (!drop) {
       // Open output file if necessary
       if (compact->builder == NULL) {
@@ -936,11 +1653,58 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
           break;
         }
       }
+      CompactionState::Output* out = compact->current_output();
+
+      if (type == kTypeBlobIndex) {
+        BlobIndex blob;
+        status = blob.DecodeFrom(value);
+        if (!status.ok()) {
+          break;
+        }
+        if (blob.file_number < compact->blob_gc_threshold) {
+          status = blob_cache_->Get(blob_options, value, &blob_value);
+          if (!status.ok()) {
+            break;
+          }
+          compact->blobs_relocated++;
+          type = kTypeValue;
+          value = blob_value;
+        } else {
+          out->blob_files.insert(blob.file_number);
+        }
+      }
+      if (has_current_user_key && type == kTypeValue &&
+          options_.min_blob_size > 0 &&
+          value.size() >= options_.min_blob_size) {
+        if (compact->blob_builder == NULL) {
+          status = OpenCompactionBlobFile(compact);
+          if (!status.ok()) {
+            break;
+          }
+        }
+        blob_index.clear();
+        status = compact->blob_builder->Add(value, &blob_index);
+        if (!status.ok()) {
+          break;
+        }
+        type = kTypeBlobIndex;
+        value = blob_index;
+      }
+      if (has_current_user_key && type != ikey.type) {
+        filter_key.clear();
+        AppendInternalKey(&filter_key, ParsedInternalKey(
+            ikey.user_key, ikey.sequence, type));
+        key = filter_key;
+      }
+
       if (compact->builder->NumEntries() == 0) {
-        compact->current_output()->smallest.DecodeFrom(key);
+        out->smallest.DecodeFrom(key);
       }
-      compact->current_output()->largest.DecodeFrom(key);
-      compact->builder->Add(key, input->value());
+      out->largest.DecodeFrom(key);
+      out->largest_sequence = std::max(
+          out->largest_sequence,
+          has_current_user_key ? ikey.sequence : kMaxSequenceNumber);
+      compact->builder->Add(key, value);
 
       // Close output file if it is big enough
       if (compact->builder->FileSize() >=
@@ -965,31 +1729,10 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     status = input->status();
   }
   delete input;
-  input = NULL;
-
-  CompactionStats stats;
-  stats.micros = env_->NowMicros() - start_micros - imm_micros;
-  for (int which = 0; which < 2; which++) {
-    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
-      stats.bytes_read += compact->compaction->input(which, i)->file_size;
-    }
-  }
-  for (size_t i = 0; i < compact->outputs.size(); i++) {
-    stats.bytes_written += compact->outputs[i].file_size;
-  }
-
-  mutex_.Lock();
-  stats_[compact->compaction->level() + 1].Add(stats);
-
-  if (status.ok()) {
-    status = InstallCompactionResults(compact);
-  }
-  VersionSet::LevelSummaryStorage tmp;
-  Log(options_.info_log,
-      "compacted to: %s", versions_->LevelSummary(&tmp));
   return status;
 }
 
+
 namespace {
 struct IterState {
   port::Mutex* mu;
@@ -1010,10 +1753,20 @@ static void CleanupIteratorState(void* arg1, void* arg2) {
 }  // namespace
 
 Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
-                                      SequenceNumber* latest_snapshot) {
+                                      SequenceNumber* latest_snapshot,
+                                      std::vector<RangeTombstone>* tombstones) {
   IterState* cleanup = new IterState;
   mutex_.Lock();
   *latest_snapshot = versions_->LastSequence();
+  if (tombstones != NULL) {
+    mem_->GetRangeTombstones(tombstones);
+    if (imm_ != NULL) {
+      imm_->GetRangeTombstones(tombstones);
+    }
+    const std::vector<RangeTombstone>& flushed =
+        versions_->current()->range_tombstones();
+    tombstones->insert(tombstones->end(), flushed.begin(), flushed.end());
+  }
 
   // Collect together all needed child iterators
   std::vector<Iterator*> list;
@@ -1040,7 +1793,7 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
 
 Iterator* DBImpl::TEST_NewInternalIterator() {
   SequenceNumber ignored;
-  return NewInternalIterator(ReadOptions(), &ignored);
+  return NewInternalIterator(ReadOptions(), &ignored, NULL);
 }
 
 int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
@@ -1075,14 +1828,36 @@ Status DBImpl::Get(const ReadOptions& options,
     mutex_.Unlock();
     // First look in the memtable, then in the immutable memtable (if any).
     LookupKey lkey(key, snapshot);
-    if (mem->Get(lkey, value, &s)) {
+    SequenceNumber found = 0;
+    bool is_blob_index = false;
+    if (mem->Get(lkey, value, &s, &found)) {
       // Done
-    } else if (imm != NULL && imm->Get(lkey, value, &s)) {
+    } else if (imm != NULL && imm->Get(lkey, value, &s, &found)) {
       // Done
     } else {
-      s = current->Get(options, lkey, value, &stats);
+      s = current->Get(options, lkey, value, &stats, &found, &is_blob_index);
       have_stat_update = true;
     }
+    if (s.ok()) {
+      // The value is deleted if a newer range tombstone covers the key
+      SequenceNumber covering = std::max(
+          mem->NewestCoveringTombstone(key, snapshot),
+          NewestCoveringTombstone(user_comparator(),
+                                  current->range_tombstones(),
+                                  key, snapshot));
+      if (imm != NULL) {
+        covering = std::max(covering,
+                            imm->NewestCoveringTombstone(key, snapshot));
+      }
+      if (found < covering) {
+        value->clear();
+        s = Status::NotFound(Slice());
+      } else if (is_blob_index) {
+        std::string index;
+        index.swap(*value);
+        s = blob_cache_->Get(options, index, value);
+      }
+    }
     mutex_.Lock();
   }
 
@@ -1097,12 +1872,21 @@ Status DBImpl::Get(const ReadOptions& options,
 
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
   SequenceNumber latest_snapshot;
-  Iterator* internal_iter = NewInternalIterator(options, &latest_snapshot);
-  return NewDBIterator(
-      &dbname_, env_, user_comparator(), internal_iter,
+  std::vector<RangeTombstone> tombstones;
+  Iterator* internal_iter = NewInternalIterator(options, &latest_snapshot,
+                                                &tombstones);
+  const SequenceNumber sequence =
       (options.snapshot != NULL
        ? reinterpret_cast<const SnapshotImpl*>(options.snapshot)->number_
-       : latest_snapshot));
+       : latest_snapshot);
+  RangeTombstoneSet* tombstone_set = NULL;
+  if (!tombstones.empty()) {
+    tombstone_set = new RangeTombstoneSet(user_comparator(), tombstones,
+                                          sequence);
+  }
+  return NewDBIterator(
+      &dbname_, env_, user_comparator(), internal_iter, sequence,
+      tombstone_set, blob_cache_, options.fill_cache);
 }
 
 const Snapshot* DBImpl::GetSnapshot() {
@@ -1124,15 +1908,35 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key) {
   return DB::Delete(options, key);
 }
 
+Status DBImpl::DeleteRange(const WriteOptions& options,
+                           const Slice& start, const Slice& end) {
+  return DB::DeleteRange(options, start, end);
+}
+
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch) {
   Writer w(&mutex_);
   w.batch = my_batch;
   w.sync = options.sync;
   w.done = false;
+  w.insert = false;
+  w.exclusive = false;
 
   MutexLock l(&mutex_);
   writers_.push_back(&w);
   while (!w.done && &w != writers_.front()) {
+    if (w.insert) {
+      // The group leader has logged our batch; insert it into the
+      // memtable in parallel with the rest of the group.
+      MemTable* mem = mem_;
+      w.insert = false;
+      mutex_.Unlock();
+      w.status = WriteBatchInternal::InsertIntoConcurrently(w.batch, mem);
+      mutex_.Lock();
+      if (--pending_inserts_ == 0) {
+        writers_.front()->cv.Signal();
+      }
+      continue;
+    }
     w.cv.Wait();
   }
   if (w.done) {
@@ -1142,11 +1946,39 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch) {
   // May temporarily unlock and wait.
   Status status = MakeRoomForWrite(my_batch == NULL);
   uint64_t last_sequence = versions_->LastSequence();
+  if (!logged_groups_.empty()) {
+    // Groups still being inserted have taken later sequence numbers
+    last_sequence = logged_groups_.back()->last_sequence;
+  }
   Writer* last_writer = &w;
   if (status.ok() && my_batch != NULL) {  // NULL batch is for compactions
-    WriteBatch* updates = BuildBatchGroup(&last_writer);
+    // A pipelined group is still read after the next group is built, so
+    // it is built in its own batch rather than tmp_batch_.
+    const bool pipelined = options_.pipelined_writes;
+    WriteBatch group_batch;
+    WriteBatch* updates = BuildBatchGroup(
+        &last_writer, pipelined ? &group_batch : tmp_batch_);
     WriteBatchInternal::SetSequence(updates, last_sequence + 1);
-    last_sequence += WriteBatchInternal::Count(updates);
+
+    // A group of several batches may be inserted into the memtable by
+    // each batch's own writer.  Their batches take the same sequence
+    // numbers as in the combined batch that is logged.
+    const bool concurrent =
+        !pipelined && options_.concurrent_memtable_writes &&
+        updates != my_batch;
+    if (concurrent) {
+      std::deque<Writer*>::iterator iter = writers_.begin();
+      for (; ; ++iter) {
+        WriteBatch* batch = (*iter)->batch;
+        if (batch != NULL) {
+          WriteBatchInternal::SetSequence(batch, last_sequence + 1);
+          last_sequence += WriteBatchInternal::Count(batch);
+        }
+        if (*iter == last_writer) break;
+      }
+    } else {
+      last_sequence += WriteBatchInternal::Count(updates);
+    }
 
     // Add to log and apply to memtable.  We can release the lock
     // during this phase since &w is currently responsible for logging
@@ -1158,14 +1990,30 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch) {
       if (status.ok() && options.sync) {
         status = logfile_->Sync();
       }
-      if (status.ok()) {
+      if (status.ok() && !concurrent && !pipelined) {
         status = WriteBatchInternal::InsertInto(updates, mem_);
       }
       mutex_.Lock();
     }
+    if (status.ok() && pipelined) {
+      return PipelineBatchGroup(updates, last_writer, last_sequence);
+    }
+    if (status.ok() && concurrent) {
+      status = InsertBatchGroup(last_writer);
+    }
     if (updates == tmp_batch_) tmp_batch_->Clear();
 
-    versions_->SetLastSequence(last_sequence);
+    if (pipelined && !status.ok()) {
+      // Earlier groups may still be inserting and publish their own
+      // sequence numbers later, so this group's cannot be published.  The
+      // log may hold part of this group, so later groups must not reuse
+      // its sequence numbers either; fail all further writes instead.
+      if (bg_error_.ok()) {
+        bg_error_ = status;
+      }
+    } else {
+      versions_->SetLastSequence(last_sequence);
+    }
   }
 
   while (true) {
@@ -1189,7 +2037,7 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch) {
 
 // REQUIRES: Writer list must be non-empty
 // REQUIRES: First writer must have a non-NULL batch
-WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
+WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer, WriteBatch* tmp) {
   assert(!writers_.empty());
   Writer* first = writers_.front();
   WriteBatch* result = first->batch;
@@ -1215,6 +2063,11 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
       break;
     }
 
+    if (w->exclusive) {
+      // Waits for the front of the queue to change the DB by itself
+      break;
+    }
+
     if (w->batch != NULL) {
       size += WriteBatchInternal::ByteSize(w->batch);
       if (size > max_size) {
@@ -1225,7 +2078,7 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
       // Append to *reuslt
       if (result == first->batch) {
         // Switch to temporary batch instead of disturbing caller's batch
-        result = tmp_batch_;
+        result = tmp;
         assert(WriteBatchInternal::Count(result) == 0);
         WriteBatchInternal::Append(result, first->batch);
       }
@@ -1236,6 +2089,96 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
   return result;
 }
 
+// Insert the batches of the group that ends with last_writer into mem_,
+// each by its own writer, and wait for all of them to finish.
+// REQUIRES: this thread is currently at the front of the writer queue
+Status DBImpl::InsertBatchGroup(Writer* last_writer) {
+  mutex_.AssertHeld();
+  Writer* first = writers_.front();
+  assert(pending_inserts_ == 0);
+  std::deque<Writer*>::iterator iter = writers_.begin();
+  while (*iter != last_writer) {
+    ++iter;
+    Writer* w = *iter;
+    if (w->batch != NULL) {
+      w->insert = true;
+      pending_inserts_++;
+      w->cv.Signal();
+    }
+  }
+
+  MemTable* mem = mem_;
+  mutex_.Unlock();
+  Status s = WriteBatchInternal::InsertIntoConcurrently(first->batch, mem);
+  mutex_.Lock();
+  while (pending_inserts_ > 0) {
+    first->cv.Wait();
+  }
+
+  iter = writers_.begin();
+  while (s.ok() && *iter != last_writer) {
+    ++iter;
+    s = (*iter)->status;
+  }
+  return s;
+}
+
+// Take the logged group that ends with last_writer off the writer queue
+// so that the next group can be logged, insert it into mem_, and wait
+// until every earlier group has been inserted before publishing its
+// sequence numbers.
+// REQUIRES: this thread is currently at the front of the writer queue
+Status DBImpl::PipelineBatchGroup(WriteBatch* updates, Writer* last_writer,
+                                  SequenceNumber last_sequence) {
+  mutex_.AssertHeld();
+  LoggedGroup group(&mutex_);
+  group.last_sequence = last_sequence;
+  logged_groups_.push_back(&group);
+
+  Writer* first = writers_.front();
+  std::vector<Writer*> followers;
+  while (true) {
+    Writer* ready = writers_.front();
+    writers_.pop_front();
+    if (ready != first) {
+      followers.push_back(ready);
+    }
+    if (ready == last_writer) break;
+  }
+  if (!writers_.empty()) {
+    writers_.front()->cv.Signal();
+  }
+
+  // Other groups may be inserted into mem_ at the same time.  mem_ is not
+  // replaced while logged_groups_ is non-empty.
+  MemTable* mem = mem_;
+  mutex_.Unlock();
+  Status status = WriteBatchInternal::InsertIntoConcurrently(updates, mem);
+  mutex_.Lock();
+
+  group.inserted = true;
+  while (!logged_groups_.empty() && logged_groups_.front()->inserted) {
+    LoggedGroup* g = logged_groups_.front();
+    logged_groups_.pop_front();
+    versions_->SetLastSequence(g->last_sequence);
+    g->published = true;
+    g->cv.Signal();
+  }
+  if (logged_groups_.empty()) {
+    bg_cv_.SignalAll();  // Wakeup MakeRoomForWrite() if necessary
+  }
+  while (!group.published) {
+    group.cv.Wait();
+  }
+
+  for (size_t i = 0; i < followers.size(); i++) {
+    followers[i]->status = status;
+    followers[i]->done = true;
+    followers[i]->cv.Signal();
+  }
+  return status;
+}
+
 // REQUIRES: mutex_ is held
 // REQUIRES: this thread is currently at the front of the writer queue
 Status DBImpl::MakeRoomForWrite(bool force) {
@@ -1273,6 +2216,9 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       // There are too many level-0 files.
       Log(options_.info_log, "waiting...\n");
       bg_cv_.Wait();
+    } else if (!logged_groups_.empty()) {
+      // Pipelined writes are still being inserted into the memtable
+      bg_cv_.Wait();
     } else {
       // Attempt to switch to a new memtable and trigger compaction of old
       assert(versions_->PrevLogNumber() == 0);
@@ -1345,6 +2291,18 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
         value->append(buf);
       }
     }
+    if (options_.compaction_filter != NULL) {
+      CompactionStats total;
+      for (int level = 0; level < config::kNumLevels; level++) {
+        total.Add(stats_[level]);
+      }
+      snprintf(buf, sizeof(buf),
+               "Filtered: %lld removed, %lld changed, %.1f MB trimmed\n",
+               static_cast<long long>(total.filter_removed),
+               static_cast<long long>(total.filter_changed),
+               total.filter_bytes / 1048576.0);
+      value->append(buf);
+    }
     return true;
   } else if (in == "sstables") {
     *value = versions_->current()->DebugString();
@@ -1394,6 +2352,13 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key) {
   return Write(opt, &batch);
 }
 
+Status DB::DeleteRange(const WriteOptions& opt,
+                       const Slice& start, const Slice& end) {
+  WriteBatch batch;
+  batch.DeleteRange(start, end);
+  return Write(opt, &batch);
+}
+
 DB::~DB() { }
 
 Status DB::Open(const Options& options, const std::string& dbname,
@@ -1414,7 +2379,7 @@ Status DB::Open(const Options& options, const std::string& dbname,
       impl->logfile_ = lfile;
       impl->logfile_number_ = new_log_number;
       impl->log_ = new log::Writer(lfile);
-      s = impl->versions_->LogAndApply(&edit, &impl->mutex_);
+      s = impl->LogAndApply(&edit);
     }
     if (s.ok()) {
       impl->DeleteObsoleteFiles();
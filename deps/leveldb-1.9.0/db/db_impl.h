@@ -7,6 +7,7 @@
 
 #include <deque>
 #include <set>
+#include <vector>
 #include "db/dbformat.h"
 #include "db/log_writer.h"
 #include "db/snapshot.h"
@@ -17,6 +18,9 @@
 
 namespace leveldb {
 
+struct FileMetaData;
+struct RangeTombstone;
+class BlobCache;
 class MemTable;
 class TableCache;
 class Version;
@@ -31,6 +35,8 @@ class DBImpl : public DB {
   // Implementations of the DB interface
   virtual Status Put(const WriteOptions&, const Slice& key, const Slice& value);
   virtual Status Delete(const WriteOptions&, const Slice& key);
+  virtual Status DeleteRange(const WriteOptions&,
+                             const Slice& start, const Slice& end);
   virtual Status Write(const WriteOptions& options, WriteBatch* updates);
   virtual Status Get(const ReadOptions& options,
                      const Slice& key,
@@ -41,6 +47,7 @@ class DBImpl : public DB {
   virtual bool GetProperty(const Slice& property, std::string* value);
   virtual void GetApproximateSizes(const Range* range, int n, uint64_t* sizes);
   virtual void CompactRange(const Slice* begin, const Slice* end);
+  virtual Status IngestExternalFile(const std::vector<std::string>& files);
 
   // Extra methods (for testing) that are not in the public DB interface
 
@@ -62,10 +69,15 @@ class DBImpl : public DB {
  private:
   friend class DB;
   struct CompactionState;
+  struct LoggedGroup;
+  struct SubcompactionJob;
   struct Writer;
 
+  // If tombstones is non-NULL, the range tombstones of the memtables and
+  // the current version are appended to *tombstones.
   Iterator* NewInternalIterator(const ReadOptions&,
-                                SequenceNumber* latest_snapshot);
+                                SequenceNumber* latest_snapshot,
+                                std::vector<RangeTombstone>* tombstones);
 
   Status NewDB();
 
@@ -89,23 +101,63 @@ class DBImpl : public DB {
                         SequenceNumber* max_sequence)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
+  // Build a table from the memtable and add it to *edit.  The table's file
+  // number is stored in *number and stays in pending_outputs_ until the
+  // caller has applied the edit, so that a concurrent compaction does not
+  // delete it as obsolete.  If pick_level is true the table may be placed
+  // below level-0, in which case installing_flush_ is set until the
+  // caller has applied the edit.
+  Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, bool pick_level,
+                          uint64_t* number)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   Status MakeRoomForWrite(bool force /* compact even if there is room? */)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
-  WriteBatch* BuildBatchGroup(Writer** last_writer);
+  WriteBatch* BuildBatchGroup(Writer** last_writer, WriteBatch* tmp);
+  Status InsertBatchGroup(Writer* last_writer)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  Status PipelineBatchGroup(WriteBatch* updates, Writer* last_writer,
+                            SequenceNumber last_sequence)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Read the key range of an external table into *meta and check that it
+  // was written by an SstFileWriter.
+  Status ReadExternalFile(const std::string& fname, FileMetaData* meta);
+
+  // Returns true iff some data in the memtables or the current version
+  // may fall in the user key range [smallest,largest].
+  bool OverlapsLiveData(const Slice& smallest, const Slice& largest)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Apply an edit to the current version and log it to the descriptor.
+  // Flushes and compactions run concurrently so edits are applied one at
+  // a time.
+  Status LogAndApply(VersionEdit* edit) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   void MaybeScheduleCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   static void BGWork(void* db);
+  static void BGWorkFlush(void* db);
   void BackgroundCall();
+  void BackgroundFlushCall();
+  void BackgroundError(const Status& s) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   Status BackgroundCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Drop the files whose every entry is deleted by range tombstones that
+  // all snapshots see, and the tombstones that no longer cover any file.
+  Status DropCoveredFiles() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   void CleanupCompaction(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   Status DoCompactionWork(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Compact the keys in compact's range into its outputs.  Memtable
+  // compactions are prioritized and their duration added to *imm_micros
+  // unless imm_micros is NULL.
+  Status DoSubcompactionWork(CompactionState* compact, int64_t* imm_micros);
+  static void BGWorkSubcompaction(void* job);
+
   Status OpenCompactionOutputFile(CompactionState* compact);
+  Status OpenCompactionBlobFile(CompactionState* compact);
   Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
   Status InstallCompactionResults(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
@@ -117,11 +169,15 @@ class DBImpl : public DB {
   const Options options_;  // options_.comparator == &internal_comparator_
   bool owns_info_log_;
   bool owns_cache_;
+  bool owns_blob_cache_;
   const std::string dbname_;
 
   // table_cache_ provides its own synchronization
   TableCache* table_cache_;
 
+  // blob_cache_ provides its own synchronization
+  BlobCache* blob_cache_;
+
   // Lock over the persistent DB state.  Non-NULL iff successfully acquired.
   FileLock* db_lock_;
 
@@ -140,6 +196,15 @@ class DBImpl : public DB {
   std::deque<Writer*> writers_;
   WriteBatch* tmp_batch_;
 
+  // Number of writers of the current group still inserting their batch
+  // into mem_.
+  int pending_inserts_;
+
+  // Groups that have been logged and are being inserted into mem_ by
+  // pipelined writes, oldest first.  Their sequence numbers are published
+  // in this order.
+  std::deque<LoggedGroup*> logged_groups_;
+
   SnapshotList snapshots_;
 
   // Set of table files to protect from deletion because they are
@@ -149,6 +214,28 @@ class DBImpl : public DB {
   // Has a background compaction been scheduled or is running?
   bool bg_compaction_scheduled_;
 
+  // Has a background memtable flush been scheduled or is running?
+  bool bg_flush_scheduled_;
+
+  // Is the immutable memtable being written to a table?
+  bool flushing_;
+
+  // Is an edit being applied to the current version?
+  bool applying_edit_;
+
+  // Is a flushed table that was placed below level-0 waiting to be added
+  // to the current version?  Compactions are not picked meanwhile since
+  // their outputs could overlap the table.
+  bool installing_flush_;
+
+  // Are external files being linked into the current version?  No
+  // background work is started meanwhile.
+  bool ingesting_;
+
+  // Has a flush added range tombstones whose covered files have not been
+  // looked for yet?
+  bool drop_covered_files_;
+
   // Information for a manual compaction
   struct ManualCompaction {
     int level;
@@ -170,13 +257,21 @@ class DBImpl : public DB {
     int64_t micros;
     int64_t bytes_read;
     int64_t bytes_written;
+    int64_t filter_removed;
+    int64_t filter_changed;
+    int64_t filter_bytes;
 
-    CompactionStats() : micros(0), bytes_read(0), bytes_written(0) { }
+    CompactionStats()
+        : micros(0), bytes_read(0), bytes_written(0),
+          filter_removed(0), filter_changed(0), filter_bytes(0) { }
 
     void Add(const CompactionStats& c) {
       this->micros += c.micros;
       this->bytes_read += c.bytes_read;
       this->bytes_written += c.bytes_written;
+      this->filter_removed += c.filter_removed;
+      this->filter_changed += c.filter_changed;
+      this->filter_bytes += c.filter_bytes;
     }
   };
   CompactionStats stats_[config::kNumLevels];
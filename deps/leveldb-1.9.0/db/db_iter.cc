@@ -4,8 +4,10 @@
 
 #include "db/db_iter.h"
 
+#include "db/blob_cache.h"
 #include "db/filename.h"
 #include "db/dbformat.h"
+#include "db/range_tombstone.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
 #include "port/port.h"
@@ -47,17 +49,25 @@ class DBIter: public Iterator {
   };
 
   DBIter(const std::string* dbname, Env* env,
-         const Comparator* cmp, Iterator* iter, SequenceNumber s)
+         const Comparator* cmp, Iterator* iter, SequenceNumber s,
+         RangeTombstoneSet* tombstones, BlobCache* blob_cache,
+         bool fill_cache)
       : dbname_(dbname),
         env_(env),
         user_comparator_(cmp),
         iter_(iter),
         sequence_(s),
+        tombstones_(tombstones),
+        blob_cache_(blob_cache),
         direction_(kForward),
-        valid_(false) {
+        valid_(false),
+        is_blob_(false),
+        blob_read_(false) {
+    blob_options_.fill_cache = fill_cache;
   }
   virtual ~DBIter() {
     delete iter_;
+    delete tombstones_;
   }
   virtual bool Valid() const { return valid_; }
   virtual Slice key() const {
@@ -66,13 +76,16 @@ class DBIter: public Iterator {
   }
   virtual Slice value() const {
     assert(valid_);
-    return (direction_ == kForward) ? iter_->value() : saved_value_;
+    Slice raw_value = (direction_ == kForward) ? iter_->value() : saved_value_;
+    return is_blob_ ? ResolveBlob(raw_value) : raw_value;
   }
   virtual Status status() const {
-    if (status_.ok()) {
-      return iter_->status();
-    } else {
+    if (!status_.ok()) {
       return status_;
+    } else if (!blob_status_.ok()) {
+      return blob_status_;
+    } else {
+      return iter_->status();
     }
   }
 
@@ -86,6 +99,19 @@ class DBIter: public Iterator {
   void FindNextUserEntry(bool skipping, std::string* skip);
   void FindPrevUserEntry();
   bool ParseKey(ParsedInternalKey* key);
+  Slice ResolveBlob(const Slice& index) const;
+
+  // Remember whether the entry just found holds a blob index
+  inline void SetEntryType(ValueType type) {
+    is_blob_ = (type == kTypeBlobIndex);
+    blob_read_ = false;
+  }
+
+  // Is the entry deleted by a range tombstone?
+  inline bool Covered(const ParsedInternalKey& ikey) const {
+    return tombstones_ != NULL &&
+        tombstones_->Covers(ikey.user_key, ikey.sequence);
+  }
 
   inline void SaveKey(const Slice& k, std::string* dst) {
     dst->assign(k.data(), k.size());
@@ -105,6 +131,9 @@ class DBIter: public Iterator {
   const Comparator* const user_comparator_;
   Iterator* const iter_;
   SequenceNumber const sequence_;
+  const RangeTombstoneSet* const tombstones_;
+  BlobCache* const blob_cache_;
+  ReadOptions blob_options_;
 
   Status status_;
   std::string saved_key_;     // == current key when direction_==kReverse
@@ -112,6 +141,13 @@ class DBIter: public Iterator {
   Direction direction_;
   bool valid_;
 
+  // The value of the current entry is read from its blob file the first
+  // time it is asked for.
+  bool is_blob_;
+  mutable bool blob_read_;
+  mutable std::string blob_value_;
+  mutable Status blob_status_;
+
   // No copying allowed
   DBIter(const DBIter&);
   void operator=(const DBIter&);
@@ -126,6 +162,25 @@ inline bool DBIter::ParseKey(ParsedInternalKey* ikey) {
   }
 }
 
+Slice DBIter::ResolveBlob(const Slice& index) const {
+  if (!blob_read_) {
+    blob_read_ = true;
+    Status s;
+    if (blob_cache_ == NULL) {
+      s = Status::NotSupported("blob index in DBIter");
+    } else {
+      s = blob_cache_->Get(blob_options_, index, &blob_value_);
+    }
+    if (!s.ok()) {
+      blob_value_.clear();
+      if (blob_status_.ok()) {
+        blob_status_ = s;
+      }
+    }
+  }
+  return blob_value_;
+}
+
 void DBIter::Next() {
   assert(valid_);
 
@@ -167,12 +222,18 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
           skipping = true;
           break;
         case kTypeValue:
+        case kTypeBlobIndex:
           if (skipping &&
               user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
             // Entry hidden
+          } else if (Covered(ikey)) {
+            // Skip upcoming entries for this key as for a deletion
+            SaveKey(ikey.user_key, skip);
+            skipping = true;
           } else {
             valid_ = true;
             saved_key_.clear();
+            SetEntryType(ikey.type);
             return;
           }
           break;
@@ -224,7 +285,7 @@ void DBIter::FindPrevUserEntry() {
           // We encountered a non-deleted value in entries for previous keys,
           break;
         }
-        value_type = ikey.type;
+        value_type = Covered(ikey) ? kTypeDeletion : ikey.type;
         if (value_type == kTypeDeletion) {
           saved_key_.clear();
           ClearSavedValue();
@@ -250,6 +311,7 @@ void DBIter::FindPrevUserEntry() {
     direction_ = kForward;
   } else {
     valid_ = true;
+    SetEntryType(value_type);
   }
 }
 
@@ -292,8 +354,16 @@ Iterator* NewDBIterator(
     Env* env,
     const Comparator* user_key_comparator,
     Iterator* internal_iter,
-    const SequenceNumber& sequence) {
-  return new DBIter(dbname, env, user_key_comparator, internal_iter, sequence);
+    const SequenceNumber& sequence,
+    RangeTombstoneSet* tombstones,
+    BlobCache* blob_cache,
+    bool fill_cache) {
+  if (tombstones != NULL && tombstones->empty()) {
+    delete tombstones;
+    tombstones = NULL;
+  }
+  return new DBIter(dbname, env, user_key_comparator, internal_iter, sequence,
+                    tombstones, blob_cache, fill_cache);
 }
 
 }  // namespace leveldb
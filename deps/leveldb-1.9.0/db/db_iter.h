@@ -11,15 +11,24 @@
 
 namespace leveldb {
 
+class BlobCache;
+class RangeTombstoneSet;
+
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
-// into appropriate user keys.
+// into appropriate user keys.  Entries covered by "tombstones" are
+// skipped.  The iterator takes ownership of "tombstones", which may be
+// NULL.  Values held in blob files are read through "blob_cache" when
+// they are first asked for.
 extern Iterator* NewDBIterator(
     const std::string* dbname,
     Env* env,
     const Comparator* user_key_comparator,
     Iterator* internal_iter,
-    const SequenceNumber& sequence);
+    const SequenceNumber& sequence,
+    RangeTombstoneSet* tombstones = NULL,
+    BlobCache* blob_cache = NULL,
+    bool fill_cache = true);
 
 }  // namespace leveldb
 
@@ -3,6 +3,7 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include "leveldb/db.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/filter_policy.h"
 #include "db/db_impl.h"
 #include "db/filename.h"
@@ -10,6 +11,7 @@
 #include "db/write_batch_internal.h"
 #include "leveldb/cache.h"
 #include "leveldb/env.h"
+#include "leveldb/sst_file_writer.h"
 #include "leveldb/table.h"
 #include "util/hash.h"
 #include "util/logging.h"
@@ -65,6 +67,20 @@ class SpecialEnv : public EnvWrapper {
   // Force write to manifest files to fail while this pointer is non-NULL
   port::AtomicPointer manifest_write_error_;
 
+  // Force write to log files to fail while this pointer is non-NULL
+  port::AtomicPointer log_write_error_;
+
+  // Force renames and sequential reads of the file named by the
+  // std::string this points to to fail, so it can be neither moved nor
+  // copied
+  port::AtomicPointer link_error_;
+
+  // Env::IO work is held until RunHeldIO() while this pointer is non-NULL.
+  port::AtomicPointer hold_io_;
+  port::Mutex held_io_mu_;
+  std::vector<std::pair<void (*)(void*), void*> > held_io_;
+  AtomicCounter io_counter_;
+
   bool count_random_reads_;
   AtomicCounter random_read_counter_;
 
@@ -77,6 +93,53 @@ class SpecialEnv : public EnvWrapper {
     count_random_reads_ = false;
     manifest_sync_error_.Release_Store(NULL);
     manifest_write_error_.Release_Store(NULL);
+    log_write_error_.Release_Store(NULL);
+    link_error_.Release_Store(NULL);
+    hold_io_.Release_Store(NULL);
+  }
+
+  virtual void Schedule(void (*function)(void*), void* arg, Priority pri) {
+    if (pri == IO) {
+      io_counter_.Increment();
+      if (hold_io_.Acquire_Load() != NULL) {
+        MutexLock l(&held_io_mu_);
+        held_io_.push_back(std::make_pair(function, arg));
+        return;
+      }
+    }
+    target()->Schedule(function, arg, pri);
+  }
+
+  // Run the held Env::IO work in the calling thread
+  void RunHeldIO() {
+    std::vector<std::pair<void (*)(void*), void*> > work;
+    {
+      MutexLock l(&held_io_mu_);
+      work.swap(held_io_);
+    }
+    for (size_t i = 0; i < work.size(); i++) {
+      (*work[i].first)(work[i].second);
+    }
+  }
+
+  bool LinkError(const std::string& f) {
+    const std::string* name =
+        reinterpret_cast<const std::string*>(link_error_.Acquire_Load());
+    return name != NULL && *name == f;
+  }
+
+  Status RenameFile(const std::string& src, const std::string& dst) {
+    if (LinkError(src)) {
+      return Status::IOError("simulated rename error", src);
+    }
+    return target()->RenameFile(src, dst);
+  }
+
+  Status NewSequentialFile(const std::string& f, SequentialFile** r) {
+    if (LinkError(f)) {
+      return Status::IOError("simulated read error", f);
+    }
+    return target()->NewSequentialFile(f, r);
   }
 
   Status NewWritableFile(const std::string& f, WritableFile** r) {
@@ -133,6 +196,25 @@ class SpecialEnv : public EnvWrapper {
       }
     };
 
+    class LogFile : public WritableFile {
+     private:
+      SpecialEnv* env_;
+      WritableFile* base_;
+     public:
+      LogFile(SpecialEnv* env, WritableFile* b) : env_(env), base_(b) { }
+      ~LogFile() { delete base_; }
+      Status Append(const Slice& data) {
+        if (env_->log_write_error_.Acquire_Load() != NULL) {
+          return Status::IOError("simulated log write error");
+        } else {
+          return base_->Append(data);
+        }
+      }
+      Status Close() { return base_->Close(); }
+      Status Flush() { return base_->Flush(); }
+      Status Sync() { return base_->Sync(); }
+    };
+
     if (non_writable_.Acquire_Load() != NULL) {
       return Status::IOError("simulated write error");
     }
@@ -143,6 +225,8 @@ class SpecialEnv : public EnvWrapper {
         *r = new SSTableFile(this, *r);
       } else if (strstr(f.c_str(), "MANIFEST") != NULL) {
         *r = new ManifestFile(this, *r);
+      } else if (strstr(f.c_str(), ".log") != NULL) {
+        *r = new LogFile(this, *r);
       }
     }
     return s;
@@ -187,6 +271,9 @@ class DBTest {
     kDefault,
     kFilter,
     kUncompressed,
+    kSerialMemtableWrites,
+    kPipelinedWrites,
+    kClockCache,
     kEnd
   };
   int option_config_;
@@ -236,6 +323,15 @@ class DBTest {
       case kUncompressed:
         options.compression = kNoCompression;
         break;
+      case kSerialMemtableWrites:
+        options.concurrent_memtable_writes = false;
+        break;
+      case kPipelinedWrites:
+        options.pipelined_writes = true;
+        break;
+      case kClockCache:
+        options.cache_type = leveldb::kClockCache;
+        break;
       default:
         break;
     }
@@ -354,6 +450,9 @@ class DBTest {
             case kTypeDeletion:
               result += "DEL";
               break;
+            case kTypeBlobIndex:
+              result += "BLOB";
+              break;
           }
         }
         iter->Next();
@@ -406,6 +505,20 @@ class DBTest {
     return static_cast<int>(files.size());
   }
 
+  int CountBlobFiles() {
+    std::vector<std::string> files;
+    env_->GetChildren(dbname_, &files);
+    int result = 0;
+    uint64_t number;
+    FileType type;
+    for (size_t i = 0; i < files.size(); i++) {
+      if (ParseFileName(files[i], &number, &type) && type == kBlobFile) {
+        result++;
+      }
+    }
+    return result;
+  }
+
   uint64_t Size(const Slice& start, const Slice& limit) {
     Range r(start, limit);
     uint64_t size;
@@ -871,6 +984,86 @@ static std::string Key(int i) {
   return std::string(buf);
 }
 
+TEST(DBTest, IterReadahead) {
+  do {
+    for (int i = 0; i < 500; i++) {
+      ASSERT_OK(Put(Key(i), std::string(1000, 'a' + (i % 26))));
+    }
+    dbfull()->TEST_CompactMemTable();
+    Reopen();
+
+    ReadOptions options;
+    options.readahead_blocks = 4;
+    Iterator* iter = db_->NewIterator(options);
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      ASSERT_EQ(Key(count), iter->key().ToString());
+      ASSERT_EQ(std::string(1000, 'a' + (count % 26)), iter->value().ToString());
+      count++;
+    }
+    ASSERT_OK(iter->status());
+    ASSERT_EQ(500, count);
+
+    // Change direction and seek in the middle of a scan
+    iter->Seek(Key(100));
+    for (int i = 100; i < 200; i++) {
+      ASSERT_EQ(Key(i), iter->key().ToString());
+      iter->Next();
+    }
+    for (int i = 200; i > 150; i--) {
+      iter->Prev();
+      ASSERT_EQ(Key(i - 1), iter->key().ToString());
+    }
+    iter->Seek(Key(300));
+    for (int i = 300; i < 400; i++) {
+      ASSERT_EQ(Key(i), iter->key().ToString());
+      iter->Next();
+    }
+    ASSERT_OK(iter->status());
+
+    // Deleting an iterator waits for the blocks still being read
+    delete iter;
+  } while (ChangeOptions());
+}
+
+TEST(DBTest, IterReadaheadAfterSeek) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  Reopen(&options);
+  for (int i = 0; i < 500; i++) {
+    ASSERT_OK(Put(Key(i), std::string(1000, 'a' + (i % 26))));
+  }
+  dbfull()->TEST_CompactMemTable();
+  Reopen(&options);
+
+  // Scan until blocks are read ahead but hold the reads
+  ReadOptions read_options;
+  read_options.readahead_blocks = 4;
+  Iterator* iter = db_->NewIterator(read_options);
+  env_->hold_io_.Release_Store(env_);
+  env_->io_counter_.Reset();
+  iter->SeekToFirst();
+  while (env_->io_counter_.Read() == 0) {
+    ASSERT_TRUE(iter->Valid());
+    iter->Next();
+  }
+  const int reads = env_->io_counter_.Read();
+
+  // The blocks finish reading after a seek has moved the scan elsewhere
+  iter->Seek(Key(300));
+  env_->hold_io_.Release_Store(NULL);
+  env_->RunHeldIO();
+
+  // They do not take up the window of the new scan
+  for (int i = 300; i < 400; i++) {
+    ASSERT_EQ(Key(i), iter->key().ToString());
+    iter->Next();
+  }
+  ASSERT_OK(iter->status());
+  ASSERT_GT(env_->io_counter_.Read(), reads);
+  delete iter;
+}
+
 TEST(DBTest, MinorCompactionsHappen) {
   Options options = CurrentOptions();
   options.write_buffer_size = 10000;
@@ -946,6 +1139,426 @@ TEST(DBTest, CompactionsGenerateMultipleFiles) {
   }
 }
 
+TEST(DBTest, Subcompactions) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000000;        // Large write buffer
+  options.max_subcompactions = 4;
+  Reopen(&options);
+
+  // Write 800K of overlapping rounds, overwriting and deleting keys
+  Random rnd(301);
+  std::map<std::string, std::string> values;
+  for (int round = 0; round < 4; round++) {
+    for (int i = round * 100; i < round * 100 + 200; i++) {
+      if (i % 7 == round) {
+        ASSERT_OK(Delete(Key(i)));
+        values.erase(Key(i));
+      } else {
+        values[Key(i)] = RandomString(&rnd, 1000);
+        ASSERT_OK(Put(Key(i), values[Key(i)]));
+      }
+    }
+  }
+
+  // Reopening with a small write buffer moves updates to several
+  // level-0 files
+  options.write_buffer_size = 100000;
+  Reopen(&options);
+  dbfull()->TEST_CompactRange(0, NULL, NULL);
+
+  // A single compaction would produce one file for this much data
+  ASSERT_EQ(NumTableFilesAtLevel(0), 0);
+  ASSERT_GT(NumTableFilesAtLevel(1), 1);
+
+  // Every live key is present exactly once and in order
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  std::map<std::string, std::string>::const_iterator expected = values.begin();
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++expected) {
+    ASSERT_TRUE(expected != values.end());
+    ASSERT_EQ(expected->first, iter->key().ToString());
+    ASSERT_EQ(expected->second, iter->value().ToString());
+  }
+  ASSERT_TRUE(expected == values.end());
+  delete iter;
+}
+
+TEST(DBTest, DeleteRange) {
+  do {
+    ASSERT_OK(Put("a", "va"));
+    ASSERT_OK(Put("b", "vb"));
+    ASSERT_OK(Put("c", "vc"));
+    ASSERT_OK(Put("d", "vd"));
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_OK(db_->DeleteRange(WriteOptions(), "b", "d"));
+    ASSERT_OK(Put("c", "vc2"));
+
+    // The end of the range is exclusive and later writes are kept
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("vc2", Get("c"));
+    ASSERT_EQ("vd", Get("d"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+    ASSERT_EQ("vb", Get("b", snapshot));
+    ASSERT_EQ("vc", Get("c", snapshot));
+
+    // Tombstones are kept when the memtable is flushed
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+    ASSERT_EQ("vb", Get("b", snapshot));
+    db_->ReleaseSnapshot(snapshot);
+
+    Reopen();
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+
+    // An empty range deletes nothing
+    ASSERT_OK(db_->DeleteRange(WriteOptions(), "d", "a"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+  } while (ChangeOptions());
+}
+
+TEST(DBTest, DeleteRangeCompaction) {
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(Put(Key(i), "v" + Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("z", "vz"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(2, TotalTableFiles());
+
+  // A table holding only covered keys is dropped without being read, and
+  // the tombstone goes away with it
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), "", "z"));
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(0, NULL, NULL);
+  ASSERT_EQ(1, TotalTableFiles());
+  ASSERT_EQ("(z->vz)", Contents());
+  ASSERT_TRUE(DumpSSTableList().find("range tombstones") ==
+              std::string::npos);
+
+  // Compactions drop the keys that a tombstone covers
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(Put(Key(i), "v" + Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), Key(0), Key(50)));
+  dbfull()->TEST_CompactMemTable();
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbfull()->TEST_CompactRange(level, NULL, NULL);
+  }
+  ASSERT_EQ("[ ]", AllEntriesFor(Key(10)));
+  ASSERT_EQ("[ v" + Key(60) + " ]", AllEntriesFor(Key(60)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(10)));
+  ASSERT_EQ("v" + Key(60), Get(Key(60)));
+
+  Reopen();
+  ASSERT_EQ("NOT_FOUND", Get(Key(10)));
+  ASSERT_OK(Put(Key(10), "again"));
+  ASSERT_EQ("again", Get(Key(10)));
+}
+
+namespace {
+// Removes "old" values and shortens values that start with "trim"
+class TestCompactionFilter : public CompactionFilter {
+ public:
+  virtual const char* Name() const {
+    return "TestCompactionFilter";
+  }
+
+  virtual bool Filter(int level, const Slice& key, const Slice& existing_value,
+                      std::string* new_value, bool* value_changed) const {
+    if (existing_value == "old") {
+      return true;
+    }
+    if (existing_value.starts_with("trim") && existing_value.size() > 1) {
+      new_value->assign(existing_value.data(), 1);
+      *value_changed = true;
+    }
+    return false;
+  }
+};
+}
+
+TEST(DBTest, CompactionFilter) {
+  TestCompactionFilter filter;
+  Options options = CurrentOptions();
+  options.compaction_filter = &filter;
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  ASSERT_OK(Put("a", "v1"));
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(2, NULL, NULL);
+  ASSERT_OK(Put("a", "v2"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("a", "old"));
+  ASSERT_OK(Put("b", "trimmed"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,1,1,1", FilesPerLevel());
+
+  // A removed key leaves a deletion marker while deeper levels hold older
+  // values for it
+  dbfull()->TEST_CompactRange(1, NULL, NULL);
+  ASSERT_EQ("[ DEL, v1 ]", AllEntriesFor("a"));
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+  ASSERT_EQ("t", Get("b"));
+
+  // Values a snapshot can read are not filtered
+  ASSERT_OK(Put("c", "trimmed"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(2, NULL, NULL);
+  ASSERT_EQ("trimmed", Get("c", snapshot));
+  db_->ReleaseSnapshot(snapshot);
+  dbfull()->TEST_CompactRange(3, NULL, NULL);
+  ASSERT_EQ("t", Get("c"));
+
+  std::string stats;
+  ASSERT_TRUE(db_->GetProperty("leveldb.stats", &stats));
+  ASSERT_TRUE(stats.find("Filtered: 1 removed, 2 changed") !=
+              std::string::npos) << stats;
+}
+
+TEST(DBTest, CompactionFilterSnapshot) {
+  TestCompactionFilter filter;
+  Options options = CurrentOptions();
+  options.compaction_filter = &filter;
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  // A removed key leaves a deletion marker while a snapshot holds an
+  // older value for it in the same compaction
+  ASSERT_OK(Put("a", "v1"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_OK(Put("a", "old"));
+  ASSERT_EQ("old", Get("a"));
+  dbfull()->TEST_CompactMemTable();
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbfull()->TEST_CompactRange(level, NULL, NULL);
+  }
+  ASSERT_EQ("[ DEL, v1 ]", AllEntriesFor("a"));
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+  ASSERT_EQ("v1", Get("a", snapshot));
+
+  // Both are dropped once the snapshot is released
+  db_->ReleaseSnapshot(snapshot);
+  db_->CompactRange(NULL, NULL);
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+}
+
+TEST(DBTest, BlobFiles) {
+  TestCompactionFilter filter;
+  Options options = CurrentOptions();
+  options.min_blob_size = 3;
+  options.blob_gc_age_cutoff = 0.0;
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  const std::string big(1000, 'x');
+  ASSERT_OK(Put("a", big));
+  ASSERT_OK(Put("b", "v"));
+  ASSERT_OK(Put("c", "vc"));
+  ASSERT_OK(Put("d", "vd3"));
+  ASSERT_EQ(big, Get("a"));
+  ASSERT_EQ(0, CountBlobFiles());
+
+  // Large values are moved out of the table when it is written
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(1, CountBlobFiles());
+  ASSERT_EQ("[ BLOB ]", AllEntriesFor("a"));
+  ASSERT_EQ("[ vc ]", AllEntriesFor("c"));
+  ASSERT_EQ("[ BLOB ]", AllEntriesFor("d"));
+  ASSERT_EQ(big, Get("a"));
+  ASSERT_EQ("vd3", Get("d"));
+
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->SeekToFirst();
+  ASSERT_EQ(big, iter->value().ToString());
+  iter->Next();
+  ASSERT_EQ("v", iter->value().ToString());
+  iter->SeekToLast();
+  ASSERT_EQ("vd3", iter->value().ToString());
+  iter->Prev();
+  iter->Prev();
+  iter->Prev();
+  ASSERT_EQ("a", iter->key().ToString());
+  ASSERT_EQ(big, iter->value().ToString());
+  ASSERT_OK(iter->status());
+  delete iter;
+
+  // Compactions keep the references without reading the values, except
+  // for the values the compaction filter needs
+  options.compaction_filter = &filter;
+  Reopen(&options);
+  ASSERT_EQ(big, Get("a"));
+  ASSERT_OK(Put("0", "v0"));
+  ASSERT_OK(Put("e", "old"));
+  ASSERT_OK(Put("f", "trimmed"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(2, CountBlobFiles());
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbfull()->TEST_CompactRange(level, NULL, NULL);
+  }
+  ASSERT_EQ(1, TotalTableFiles());
+  ASSERT_EQ("[ BLOB ]", AllEntriesFor("a"));
+  ASSERT_EQ("[ ]", AllEntriesFor("e"));
+  ASSERT_EQ("[ t ]", AllEntriesFor("f"));
+  ASSERT_EQ(big, Get("a"));
+  ASSERT_EQ("NOT_FOUND", Get("e"));
+  ASSERT_EQ(1, CountBlobFiles());
+}
+
+TEST(DBTest, BlobGarbageCollection) {
+  Options options = CurrentOptions();
+  options.min_blob_size = 100;
+  options.blob_gc_age_cutoff = 1.0;
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  const std::string v1(1000, '1');
+  const std::string v2(2000, '2');
+  ASSERT_OK(Put("a", v1));
+  ASSERT_OK(Put("b", v1));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("a", v2));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(2, CountBlobFiles());
+
+  // The live values are moved into the output's blob file and the old
+  // blob files are deleted
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbfull()->TEST_CompactRange(level, NULL, NULL);
+  }
+  ASSERT_EQ(1, TotalTableFiles());
+  ASSERT_EQ(1, CountBlobFiles());
+  ASSERT_EQ("[ BLOB ]", AllEntriesFor("a"));
+  ASSERT_EQ(v2, Get("a"));
+  ASSERT_EQ(v1, Get("b"));
+
+  // Values move back into the tables once blobs are turned off
+  options.min_blob_size = 0;
+  Reopen(&options);
+  ASSERT_EQ(v2, Get("a"));
+  ASSERT_OK(Put("a", v1));
+  dbfull()->TEST_CompactMemTable();
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbfull()->TEST_CompactRange(level, NULL, NULL);
+  }
+  ASSERT_EQ(0, CountBlobFiles());
+  ASSERT_EQ("[ " + v1 + " ]", AllEntriesFor("a"));
+  ASSERT_EQ("[ " + v1 + " ]", AllEntriesFor("b"));
+}
+
+TEST(DBTest, IngestExternalFile) {
+  Options options = CurrentOptions();
+  Reopen(&options);
+  ASSERT_OK(Put("a", "va"));
+  ASSERT_OK(Put("z", "vz"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+
+  // Keys must be added in order
+  const std::string fname = test::TmpDir() + "/db_test_ingest.sst";
+  SstFileWriter writer(options);
+  ASSERT_OK(writer.Open(fname));
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(writer.Put("m" + Key(i), "v" + Key(i)));
+  }
+  ASSERT_TRUE(!writer.Put("m" + Key(50), "x").ok());
+  ASSERT_OK(writer.Finish());
+
+  // The file overlaps neither the memtable nor any table so it goes to
+  // the last level
+  ASSERT_OK(db_->IngestExternalFile(std::vector<std::string>(1, fname)));
+  ASSERT_TRUE(!env_->FileExists(fname));
+  ASSERT_EQ(NumTableFilesAtLevel(config::kNumLevels - 1), 1);
+  ASSERT_EQ("vkey000042", Get("mkey000042"));
+  ASSERT_EQ("NOT_FOUND", Get("mkey000042", snapshot));
+  ASSERT_EQ("va", Get("a", snapshot));
+  db_->ReleaseSnapshot(snapshot);
+
+  // Later writes take newer sequence numbers
+  ASSERT_OK(Put("mkey000007", "new"));
+  ASSERT_OK(Delete("mkey000008"));
+  ASSERT_EQ("new", Get("mkey000007"));
+  ASSERT_EQ("NOT_FOUND", Get("mkey000008"));
+
+  // Files overlapping a table or the memtable are rejected
+  const char* ranges[2][2] = { { "b", "mkey000050" }, { "y", "zz" } };
+  for (int i = 0; i < 2; i++) {
+    SstFileWriter overlapping(options);
+    ASSERT_OK(overlapping.Open(fname));
+    ASSERT_OK(overlapping.Put(ranges[i][0], "v"));
+    ASSERT_OK(overlapping.Put(ranges[i][1], "v"));
+    ASSERT_OK(overlapping.Finish());
+    Status s = db_->IngestExternalFile(std::vector<std::string>(1, fname));
+    ASSERT_TRUE(!s.ok());
+    ASSERT_TRUE(env_->FileExists(fname));
+    env_->DeleteFile(fname);
+  }
+
+  // The assigned sequence number survives recovery and compaction
+  Reopen(&options);
+  ASSERT_EQ("new", Get("mkey000007"));
+  ASSERT_EQ("NOT_FOUND", Get("mkey000008"));
+  ASSERT_EQ("vkey000009", Get("mkey000009"));
+  db_->CompactRange(NULL, NULL);
+  ASSERT_EQ("new", Get("mkey000007"));
+  ASSERT_EQ("NOT_FOUND", Get("mkey000008"));
+  ASSERT_EQ("vkey000099", Get("mkey000099"));
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_OK(iter->status());
+  ASSERT_EQ(101, count);
+  delete iter;
+}
+
+TEST(DBTest, IngestExternalFileError) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  Reopen(&options);
+
+  std::vector<std::string> files;
+  for (int i = 0; i < 2; i++) {
+    char fname[100];
+    snprintf(fname, sizeof(fname), "%s/db_test_ingest%d.sst",
+             test::TmpDir().c_str(), i);
+    SstFileWriter writer(options);
+    ASSERT_OK(writer.Open(fname));
+    ASSERT_OK(writer.Put(std::string(1, 'a' + i), "v"));
+    ASSERT_OK(writer.Finish());
+    files.push_back(fname);
+  }
+
+  // The first iteration fails to link the second file, the second one
+  // fails to record the files in the MANIFEST.  Either way the files that
+  // were already moved into the DB are given back.
+  for (int iter = 0; iter < 2; iter++) {
+    if (iter == 0) {
+      env_->link_error_.Release_Store(&files[1]);
+    } else {
+      env_->manifest_write_error_.Release_Store(env_);
+    }
+    ASSERT_TRUE(!db_->IngestExternalFile(files).ok());
+    env_->link_error_.Release_Store(NULL);
+    env_->manifest_write_error_.Release_Store(NULL);
+    ASSERT_TRUE(env_->FileExists(files[0]));
+    ASSERT_TRUE(env_->FileExists(files[1]));
+    ASSERT_EQ("NOT_FOUND", Get("a"));
+
+    // Obsolete files are deleted when the DB is reopened
+    Reopen(&options);
+    ASSERT_TRUE(env_->FileExists(files[0]));
+    ASSERT_TRUE(env_->FileExists(files[1]));
+  }
+
+  ASSERT_OK(db_->IngestExternalFile(files));
+  ASSERT_EQ("v", Get("a"));
+  ASSERT_EQ("v", Get("b"));
+}
+
 TEST(DBTest, RepeatedWritesToSameKey) {
   Options options = CurrentOptions();
   options.env = env_;
@@ -1567,6 +2180,96 @@ TEST(DBTest, ManifestWriteError) {
   }
 }
 
+namespace {
+// Compares user keys bytewise but blocks while "block_" is set and one of
+// the keys is "block", so a pipelined write can be held in its memtable
+// insert.
+class BlockingComparator : public Comparator {
+ public:
+  port::AtomicPointer block_;
+  mutable port::AtomicPointer blocked_;
+
+  BlockingComparator() {
+    block_.Release_Store(NULL);
+    blocked_.Release_Store(NULL);
+  }
+  virtual const char* Name() const { return "leveldb.BytewiseComparator"; }
+  virtual int Compare(const Slice& a, const Slice& b) const {
+    if (a == Slice("block") || b == Slice("block")) {
+      void* block;
+      while ((block = block_.Acquire_Load()) != NULL) {
+        blocked_.Release_Store(block);
+        Env::Default()->SleepForMicroseconds(1000);
+      }
+    }
+    return BytewiseComparator()->Compare(a, b);
+  }
+  virtual void FindShortestSeparator(std::string* s, const Slice& l) const {
+    BytewiseComparator()->FindShortestSeparator(s, l);
+  }
+  virtual void FindShortSuccessor(std::string* key) const {
+    BytewiseComparator()->FindShortSuccessor(key);
+  }
+};
+
+struct BlockedPut {
+  DB* db;
+  port::AtomicPointer done;
+  Status status;
+};
+
+static void BlockedPutBody(void* arg) {
+  BlockedPut* p = reinterpret_cast<BlockedPut*>(arg);
+  p->status = p->db->Put(WriteOptions(), "block", "v1");
+  p->done.Release_Store(p);
+}
+}  // namespace
+
+TEST(DBTest, PipelinedWriteLogError) {
+  // A group whose log write fails while an earlier group is still being
+  // inserted must not publish sequence numbers past the earlier group.
+  BlockingComparator cmp;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.create_if_missing = true;
+  options.comparator = &cmp;
+  options.pipelined_writes = true;
+  DestroyAndReopen(&options);
+  ASSERT_OK(Put("a", "v0"));
+
+  // Hold the next group in its memtable insert.
+  cmp.block_.Release_Store(&cmp);
+  BlockedPut p;
+  p.db = db_;
+  p.done.Release_Store(NULL);
+  env_->StartThread(BlockedPutBody, &p);
+  while (cmp.blocked_.Acquire_Load() == NULL) {
+    env_->SleepForMicroseconds(1000);
+  }
+
+  // Fail the log write of the group behind it.
+  env_->log_write_error_.Release_Store(env_);
+  ASSERT_TRUE(!Put("c", "v2").ok());
+  env_->log_write_error_.Release_Store(NULL);
+
+  cmp.block_.Release_Store(NULL);
+  while (p.done.Acquire_Load() == NULL) {
+    env_->SleepForMicroseconds(1000);
+  }
+  ASSERT_OK(p.status);
+  ASSERT_EQ("v1", Get("block"));
+  ASSERT_EQ("NOT_FOUND", Get("c"));
+
+  // Further writes fail until the DB is reopened.
+  ASSERT_TRUE(!Put("d", "v3").ok());
+  Reopen(&options);
+  ASSERT_EQ("v0", Get("a"));
+  ASSERT_EQ("v1", Get("block"));
+  ASSERT_EQ("NOT_FOUND", Get("c"));
+  ASSERT_OK(Put("d", "v3"));
+  ASSERT_EQ("v3", Get("d"));
+}
+
 TEST(DBTest, FilesDeletedAfterCompaction) {
   ASSERT_OK(Put("foo", "v2"));
   Compact("a", "z");
@@ -1742,6 +2445,10 @@ class ModelDB: public DB {
   virtual Status Delete(const WriteOptions& o, const Slice& key) {
     return DB::Delete(o, key);
   }
+  virtual Status DeleteRange(const WriteOptions& o,
+                             const Slice& start, const Slice& end) {
+    return DB::DeleteRange(o, start, end);
+  }
   virtual Status Get(const ReadOptions& options,
                      const Slice& key, std::string* value) {
     assert(false);      // Not implemented
@@ -1777,6 +2484,13 @@ class ModelDB: public DB {
       virtual void Delete(const Slice& key) {
         map_->erase(key.ToString());
       }
+      virtual Status DeleteRange(const Slice& start, const Slice& end) {
+        if (start.compare(end) < 0) {
+          map_->erase(map_->lower_bound(start.ToString()),
+                      map_->lower_bound(end.ToString()));
+        }
+        return Status::OK();
+      }
     };
     Handler handler;
     handler.map_ = &map_;
@@ -1793,6 +2507,9 @@ class ModelDB: public DB {
   }
   virtual void CompactRange(const Slice* start, const Slice* end) {
   }
+  virtual Status IngestExternalFile(const std::vector<std::string>& files) {
+    return Status::NotSupported("IngestExternalFile");
+  }
 
  private:
   class ModelIter: public Iterator {
@@ -1907,11 +2624,16 @@ TEST(DBTest, Randomized) {
         ASSERT_OK(model.Put(WriteOptions(), k, v));
         ASSERT_OK(db_->Put(WriteOptions(), k, v));
 
-      } else if (p < 90) {                        // Delete
+      } else if (p < 88) {                        // Delete
         k = RandomKey(&rnd);
         ASSERT_OK(model.Delete(WriteOptions(), k));
         ASSERT_OK(db_->Delete(WriteOptions(), k));
 
+      } else if (p < 90) {                        // DeleteRange
+        k = RandomKey(&rnd);
+        v = RandomKey(&rnd);
+        ASSERT_OK(model.DeleteRange(WriteOptions(), k, v));
+        ASSERT_OK(db_->DeleteRange(WriteOptions(), k, v));
 
       } else {                                    // Multi-element batch
         WriteBatch b;
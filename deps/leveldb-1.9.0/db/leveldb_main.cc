@@ -79,6 +79,12 @@ class WriteBatchItemPrinter : public WriteBatch::Handler {
     printf("  del '%s'\n",
            EscapeString(key).c_str());
   }
+  virtual Status DeleteRange(const Slice& start, const Slice& end) {
+    printf("  delrange '%s' '%s'\n",
+           EscapeString(start).c_str(),
+           EscapeString(end).c_str());
+    return Status::OK();
+  }
 };
 
 
@@ -159,6 +165,8 @@ bool DumpTable(Env* env, const std::string& fname) {
         type = "del";
       } else if (key.type == kTypeValue) {
         type = "val";
+      } else if (key.type == kTypeBlobIndex) {
+        type = "blob";
       } else {
         snprintf(kbuf, sizeof(kbuf), "%d", static_cast<int>(key.type));
         type = kbuf;
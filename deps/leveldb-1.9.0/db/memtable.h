@@ -6,9 +6,12 @@
 #define STORAGE_LEVELDB_DB_MEMTABLE_H_
 
 #include <string>
+#include <vector>
 #include "leveldb/db.h"
 #include "db/dbformat.h"
+#include "db/range_tombstone.h"
 #include "db/skiplist.h"
+#include "port/port.h"
 #include "util/arena.h"
 
 namespace leveldb {
@@ -57,11 +60,33 @@ class MemTable {
            const Slice& key,
            const Slice& value);
 
+  // Like Add(), but may be called from several threads at once.
+  // REQUIRES: no concurrent calls to Add()
+  void AddConcurrently(SequenceNumber seq, ValueType type,
+                       const Slice& key,
+                       const Slice& value);
+
+  // Record a deletion of every key in [start, end) older than seq.
+  // May be called alongside AddConcurrently().
+  void AddRangeTombstone(SequenceNumber seq,
+                         const Slice& start, const Slice& end);
+
+  // Append the range tombstones added so far to *tombstones.
+  void GetRangeTombstones(std::vector<RangeTombstone>* tombstones);
+
+  // Return the sequence number of the newest range tombstone covering
+  // user_key that is visible at snapshot, or zero if there is none.
+  SequenceNumber NewestCoveringTombstone(const Slice& user_key,
+                                         SequenceNumber snapshot);
+
   // If memtable contains a value for key, store it in *value and return true.
   // If memtable contains a deletion for key, store a NotFound() error
   // in *status and return true.
   // Else, return false.
-  bool Get(const LookupKey& key, std::string* value, Status* s);
+  // If an entry is found and seq is non-NULL, store its sequence number
+  // in *seq.
+  bool Get(const LookupKey& key, std::string* value, Status* s,
+           SequenceNumber* seq = NULL);
 
  private:
   ~MemTable();  // Private since only Unref() should be used to delete it
@@ -81,6 +106,10 @@ class MemTable {
   Arena arena_;
   Table table_;
 
+  // Range tombstones are rare so they are kept in a plain list
+  port::Mutex tombstones_mutex_;
+  std::vector<RangeTombstone> tombstones_;
+
   // No copying allowed
   MemTable(const MemTable&);
   void operator=(const MemTable&);
@@ -0,0 +1,120 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/range_tombstone.h"
+
+#include <algorithm>
+#include "leveldb/comparator.h"
+
+namespace leveldb {
+
+SequenceNumber NewestCoveringTombstone(
+    const Comparator* ucmp,
+    const std::vector<RangeTombstone>& tombstones,
+    const Slice& user_key,
+    SequenceNumber snapshot) {
+  SequenceNumber result = 0;
+  for (size_t i = 0; i < tombstones.size(); i++) {
+    const RangeTombstone& t = tombstones[i];
+    if (t.sequence > result && t.sequence <= snapshot &&
+        ucmp->Compare(t.start, user_key) <= 0 &&
+        ucmp->Compare(user_key, t.end) < 0) {
+      result = t.sequence;
+    }
+  }
+  return result;
+}
+
+namespace {
+struct BoundLess {
+  const Comparator* ucmp;
+  bool operator()(const std::string& a, const std::string& b) const {
+    return ucmp->Compare(a, b) < 0;
+  }
+};
+}  // namespace
+
+RangeTombstoneSet::RangeTombstoneSet(
+    const Comparator* ucmp,
+    const std::vector<RangeTombstone>& tombstones,
+    SequenceNumber snapshot)
+    : ucmp_(ucmp) {
+  std::vector<const RangeTombstone*> live;
+  for (size_t i = 0; i < tombstones.size(); i++) {
+    const RangeTombstone& t = tombstones[i];
+    if (t.sequence <= snapshot && ucmp_->Compare(t.start, t.end) < 0) {
+      live.push_back(&t);
+      bounds_.push_back(t.start);
+      bounds_.push_back(t.end);
+    }
+  }
+  if (live.empty()) {
+    bounds_.clear();
+    return;
+  }
+
+  BoundLess less;
+  less.ucmp = ucmp_;
+  std::sort(bounds_.begin(), bounds_.end(), less);
+  size_t n = 1;
+  for (size_t i = 1; i < bounds_.size(); i++) {
+    if (ucmp_->Compare(bounds_[i], bounds_[n - 1]) != 0) {
+      bounds_[n++].swap(bounds_[i]);
+    }
+  }
+  bounds_.resize(n);
+
+  sequences_.assign(bounds_.size() - 1, 0);
+  for (size_t i = 0; i < live.size(); i++) {
+    const RangeTombstone* t = live[i];
+    size_t f = std::lower_bound(bounds_.begin(), bounds_.end(),
+                                t->start, less) - bounds_.begin();
+    for (; f < sequences_.size() &&
+             ucmp_->Compare(bounds_[f], t->end) < 0; f++) {
+      sequences_[f] = std::max(sequences_[f], t->sequence);
+    }
+  }
+}
+
+int RangeTombstoneSet::FindFragment(const Slice& user_key) const {
+  // Find the first bound after user_key
+  size_t left = 0;
+  size_t right = bounds_.size();
+  while (left < right) {
+    size_t mid = (left + right) / 2;
+    if (ucmp_->Compare(bounds_[mid], user_key) <= 0) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  if (left == 0 || left == bounds_.size()) {
+    return -1;
+  }
+  return static_cast<int>(left - 1);
+}
+
+SequenceNumber RangeTombstoneSet::CoveringSequence(
+    const Slice& user_key) const {
+  const int f = FindFragment(user_key);
+  return (f < 0) ? 0 : sequences_[f];
+}
+
+SequenceNumber RangeTombstoneSet::CoveringSequence(
+    const Slice& smallest, const Slice& largest) const {
+  const int first = FindFragment(smallest);
+  if (first < 0) {
+    return 0;
+  }
+  SequenceNumber result = kMaxSequenceNumber;
+  for (size_t f = first; f < sequences_.size(); f++) {
+    result = std::min(result, sequences_[f]);
+    if (result == 0 || ucmp_->Compare(largest, bounds_[f + 1]) < 0) {
+      return result;
+    }
+  }
+  return 0;
+}
+
+}  // namespace leveldb
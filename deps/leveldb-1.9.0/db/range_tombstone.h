@@ -0,0 +1,78 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_RANGE_TOMBSTONE_H_
+#define STORAGE_LEVELDB_DB_RANGE_TOMBSTONE_H_
+
+#include <string>
+#include <vector>
+#include "db/dbformat.h"
+
+namespace leveldb {
+
+class Comparator;
+
+// A range tombstone deletes every entry for a user key in [start, end)
+// with a sequence number smaller than its own.
+struct RangeTombstone {
+  std::string start;
+  std::string end;
+  SequenceNumber sequence;
+
+  RangeTombstone() : sequence(0) { }
+  RangeTombstone(const Slice& s, const Slice& e, SequenceNumber seq)
+      : start(s.data(), s.size()), end(e.data(), e.size()), sequence(seq) { }
+};
+
+// Return the sequence number of the newest tombstone in "tombstones" that
+// covers "user_key" and is not newer than "snapshot", or zero if there
+// is none.
+extern SequenceNumber NewestCoveringTombstone(
+    const Comparator* ucmp,
+    const std::vector<RangeTombstone>& tombstones,
+    const Slice& user_key,
+    SequenceNumber snapshot);
+
+// An immutable set of range tombstones split into non-overlapping
+// fragments.  Each fragment records the newest tombstone covering it, so
+// the tombstones covering a key are found with one binary search.
+class RangeTombstoneSet {
+ public:
+  // Tombstones newer than "snapshot" are left out.
+  RangeTombstoneSet(const Comparator* ucmp,
+                    const std::vector<RangeTombstone>& tombstones,
+                    SequenceNumber snapshot);
+
+  bool empty() const { return sequences_.empty(); }
+
+  // Return true iff the entry for "user_key" at "sequence" is deleted.
+  bool Covers(const Slice& user_key, SequenceNumber sequence) const {
+    return sequence < CoveringSequence(user_key);
+  }
+
+  // Return the sequence number of the newest tombstone covering
+  // "user_key", or zero if there is none.
+  SequenceNumber CoveringSequence(const Slice& user_key) const;
+
+  // Return the largest sequence number below which every entry for a
+  // user key in [smallest, largest] is deleted, or zero if some key in
+  // the range is not covered.
+  SequenceNumber CoveringSequence(const Slice& smallest,
+                                  const Slice& largest) const;
+
+ private:
+  // Index of the fragment containing "user_key", or -1
+  int FindFragment(const Slice& user_key) const;
+
+  const Comparator* ucmp_;
+
+  // Fragment i covers [bounds_[i], bounds_[i+1]) and is deleted below
+  // sequences_[i], which is zero for a gap between tombstones.
+  std::vector<std::string> bounds_;
+  std::vector<SequenceNumber> sequences_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_RANGE_TOMBSTONE_H_
@@ -7,6 +7,7 @@
 // (2) We scan every table to compute
 //     (a) smallest/largest for the table
 //     (b) largest sequence number in the table
+//     (c) blob files the table refers to
 // (3) We generate descriptor contents:
 //      - log number is set to zero
 //      - next-file-number is set to 1 + largest file number we found
@@ -24,6 +25,7 @@
 //   Store per-table metadata (smallest, largest, largest-seq#, ...)
 //   in the table's meta section to speed up ScanTable.
 
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_impl.h"
 #include "db/dbformat.h"
@@ -52,6 +54,7 @@ class Repairer {
         options_(SanitizeOptions(dbname, &icmp_, &ipolicy_, options)),
         owns_info_log_(options_.info_log != options.info_log),
         owns_cache_(options_.block_cache != options.block_cache),
+        owns_blob_cache_(options_.blob_cache != options.blob_cache),
         next_file_number_(1) {
     // TableCache can be small since we expect each table to be opened once.
     table_cache_ = new TableCache(dbname_, &options_, 10);
@@ -65,6 +68,9 @@ class Repairer {
     if (owns_cache_) {
       delete options_.block_cache;
     }
+    if (owns_blob_cache_) {
+      delete options_.blob_cache;
+    }
   }
 
   Status Run() {
@@ -104,6 +110,7 @@ class Repairer {
   Options const options_;
   bool owns_info_log_;
   bool owns_cache_;
+  bool owns_blob_cache_;
   TableCache* table_cache_;
   VersionEdit edit_;
 
@@ -111,6 +118,7 @@ class Repairer {
   std::vector<uint64_t> table_numbers_;
   std::vector<uint64_t> logs_;
   std::vector<TableInfo> tables_;
+  std::vector<RangeTombstone> tombstones_;  // Found in logs
   uint64_t next_file_number_;
 
   Status FindFiles() {
@@ -226,6 +234,7 @@ class Repairer {
     Iterator* iter = mem->NewIterator();
     status = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
     delete iter;
+    mem->GetRangeTombstones(&tombstones_);
     mem->Unref();
     mem = NULL;
     if (status.ok()) {
@@ -268,6 +277,8 @@ class Repairer {
           ReadOptions(), t->meta.number, t->meta.file_size);
       bool empty = true;
       ParsedInternalKey parsed;
+      BlobIndex blob;
+      std::set<uint64_t> blob_files;
       t->max_sequence = 0;
       for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
         Slice key = iter->key();
@@ -287,11 +298,16 @@ class Repairer {
         if (parsed.sequence > t->max_sequence) {
           t->max_sequence = parsed.sequence;
         }
+        if (parsed.type == kTypeBlobIndex &&
+            blob.DecodeFrom(iter->value()).ok()) {
+          blob_files.insert(blob.file_number);
+        }
       }
       if (!iter->status().ok()) {
         status = iter->status();
       }
       delete iter;
+      t->meta.blob_files.assign(blob_files.begin(), blob_files.end());
     }
     Log(options_.info_log, "Table #%llu: %d entries %s",
         (unsigned long long) t->meta.number,
@@ -314,6 +330,11 @@ class Repairer {
         max_sequence = tables_[i].max_sequence;
       }
     }
+    for (size_t i = 0; i < tombstones_.size(); i++) {
+      if (max_sequence < tombstones_[i].sequence) {
+        max_sequence = tombstones_[i].sequence;
+      }
+    }
 
     edit_.SetComparatorName(icmp_.user_comparator()->Name());
     edit_.SetLogNumber(0);
@@ -323,8 +344,12 @@ class Repairer {
     for (size_t i = 0; i < tables_.size(); i++) {
       // TODO(opt): separate out into multiple levels
       const TableInfo& t = tables_[i];
-      edit_.AddFile(0, t.meta.number, t.meta.file_size,
-                    t.meta.smallest, t.meta.largest);
+      FileMetaData meta = t.meta;
+      meta.largest_sequence = t.max_sequence;
+      edit_.AddFile(0, meta);
+    }
+    for (size_t i = 0; i < tombstones_.size(); i++) {
+      edit_.AddRangeTombstone(tombstones_[i]);
     }
 
     //fprintf(stderr, "NewDescriptor:\n%s\n", edit_.DebugString().c_str());
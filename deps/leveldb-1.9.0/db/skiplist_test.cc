@@ -3,10 +3,13 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include "db/skiplist.h"
+#include <algorithm>
 #include <set>
+#include <vector>
 #include "leveldb/env.h"
 #include "util/arena.h"
 #include "util/hash.h"
+#include "util/mutexlock.h"
 #include "util/random.h"
 #include "util/testharness.h"
 
@@ -371,6 +374,81 @@ TEST(SkipTest, Concurrent3) { RunConcurrent(3); }
 TEST(SkipTest, Concurrent4) { RunConcurrent(4); }
 TEST(SkipTest, Concurrent5) { RunConcurrent(5); }
 
+// Several threads insert disjoint sets of keys with InsertConcurrently()
+struct ConcurrentInserts {
+  static const int kThreads = 4;
+  static const int kKeysPerThread = 20000;
+
+  SkipList<Key, Comparator>* list;
+  port::Mutex mu;
+  port::CondVar cv;
+  int next_thread;
+  int done;
+
+  ConcurrentInserts() : cv(&mu), next_thread(0), done(0) { }
+};
+
+static void ConcurrentInserter(void* arg) {
+  ConcurrentInserts* state = reinterpret_cast<ConcurrentInserts*>(arg);
+  state->mu.Lock();
+  const int t = state->next_thread++;
+  state->mu.Unlock();
+
+  // Insert in a random order so that threads race on the same splices
+  Random rnd(301 + t);
+  std::vector<Key> keys;
+  for (int i = 0; i < ConcurrentInserts::kKeysPerThread; i++) {
+    keys.push_back(i * ConcurrentInserts::kThreads + t);
+  }
+  for (size_t i = keys.size() - 1; i > 0; i--) {
+    std::swap(keys[i], keys[rnd.Uniform(i + 1)]);
+  }
+  for (size_t i = 0; i < keys.size(); i++) {
+    state->list->InsertConcurrently(keys[i]);
+  }
+
+  MutexLock l(&state->mu);
+  state->done++;
+  state->cv.Signal();
+}
+
+TEST(SkipTest, InsertConcurrently) {
+  Arena arena;
+  Comparator cmp;
+  SkipList<Key, Comparator> list(cmp, &arena);
+  ConcurrentInserts state;
+  state.list = &list;
+  for (int i = 0; i < ConcurrentInserts::kThreads; i++) {
+    Env::Default()->StartThread(ConcurrentInserter, &state);
+  }
+  state.mu.Lock();
+  while (state.done < ConcurrentInserts::kThreads) {
+    state.cv.Wait();
+  }
+  state.mu.Unlock();
+
+  // Every key is present once and in order at level 0
+  const Key total = ConcurrentInserts::kThreads *
+                    ConcurrentInserts::kKeysPerThread;
+  SkipList<Key, Comparator>::Iterator iter(&list);
+  iter.SeekToFirst();
+  for (Key k = 0; k < total; k++) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(k, iter.key());
+    iter.Next();
+  }
+  ASSERT_TRUE(!iter.Valid());
+
+  // Searches use the upper levels
+  for (Key k = 0; k < total; k += 7) {
+    ASSERT_TRUE(list.Contains(k));
+    iter.Seek(k);
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(k, iter.key());
+  }
+  ASSERT_TRUE(!list.Contains(total));
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
@@ -0,0 +1,99 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/sst_file_writer.h"
+
+#include "db/dbformat.h"
+#include "leveldb/env.h"
+#include "leveldb/table_builder.h"
+
+namespace leveldb {
+
+// Entries are stored as internal keys with sequence number zero.  The DB
+// assigns the table a sequence number when it is ingested.
+struct SstFileWriter::Rep {
+  InternalKeyComparator internal_comparator;
+  InternalFilterPolicy internal_filter_policy;
+  Options options;
+  WritableFile* file;
+  TableBuilder* builder;
+  std::string last_key;   // Last user key added
+  std::string key;        // Scratch space for the internal key
+  bool has_last_key;
+  bool finished;
+
+  Rep(const Options& opt)
+      : internal_comparator(opt.comparator),
+        internal_filter_policy(opt.filter_policy),
+        options(opt),
+        file(NULL),
+        builder(NULL),
+        has_last_key(false),
+        finished(false) {
+    options.comparator = &internal_comparator;
+    options.filter_policy =
+        (opt.filter_policy != NULL) ? &internal_filter_policy : NULL;
+  }
+};
+
+SstFileWriter::SstFileWriter(const Options& options)
+    : rep_(new Rep(options)) {
+}
+
+SstFileWriter::~SstFileWriter() {
+  if (rep_->builder != NULL && !rep_->finished) {
+    rep_->builder->Abandon();
+  }
+  delete rep_->builder;
+  delete rep_->file;
+  delete rep_;
+}
+
+Status SstFileWriter::Open(const std::string& fname) {
+  Rep* r = rep_;
+  if (r->file != NULL) {
+    return Status::InvalidArgument("table is already open", fname);
+  }
+  Status s = r->options.env->NewWritableFile(fname, &r->file);
+  if (s.ok()) {
+    r->builder = new TableBuilder(r->options, r->file);
+  }
+  return s;
+}
+
+Status SstFileWriter::Put(const Slice& key, const Slice& value) {
+  Rep* r = rep_;
+  assert(r->builder != NULL && !r->finished);
+  const Comparator* ucmp = r->internal_comparator.user_comparator();
+  if (r->has_last_key && ucmp->Compare(key, r->last_key) <= 0) {
+    return Status::InvalidArgument("keys must be added in strictly "
+                                   "increasing order", key);
+  }
+  r->key.clear();
+  AppendInternalKey(&r->key, ParsedInternalKey(key, 0, kTypeValue));
+  r->builder->Add(r->key, value);
+  r->last_key.assign(key.data(), key.size());
+  r->has_last_key = true;
+  return r->builder->status();
+}
+
+Status SstFileWriter::Finish() {
+  Rep* r = rep_;
+  assert(r->builder != NULL && !r->finished);
+  r->finished = true;
+  Status s = r->builder->Finish();
+  if (s.ok()) {
+    s = r->file->Sync();
+  }
+  if (s.ok()) {
+    s = r->file->Close();
+  }
+  return s;
+}
+
+uint64_t SstFileWriter::FileSize() const {
+  return (rep_->builder != NULL) ? rep_->builder->FileSize() : 0;
+}
+
+}  // namespace leveldb
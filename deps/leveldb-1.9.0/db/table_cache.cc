@@ -29,6 +29,66 @@ static void UnrefEntry(void* arg1, void* arg2) {
   cache->Release(h);
 }
 
+namespace {
+// Yields the entries of an ingested table, which are all written with
+// sequence number zero, with the sequence number the table was assigned
+// when it was ingested.  Each user key appears at most once in the table.
+class GlobalSequenceIterator : public Iterator {
+ public:
+  GlobalSequenceIterator(const Comparator* icmp, Iterator* iter,
+                         SequenceNumber sequence)
+      : icmp_(icmp), iter_(iter), sequence_(sequence) { }
+  virtual ~GlobalSequenceIterator() { delete iter_; }
+
+  virtual bool Valid() const { return iter_->Valid(); }
+  virtual void SeekToFirst() { iter_->SeekToFirst(); UpdateKey(); }
+  virtual void SeekToLast() { iter_->SeekToLast(); UpdateKey(); }
+  virtual void Next() { iter_->Next(); UpdateKey(); }
+  virtual void Prev() { iter_->Prev(); UpdateKey(); }
+  virtual void Seek(const Slice& target) {
+    ParsedInternalKey ikey;
+    if (!ParseInternalKey(target, &ikey)) {
+      iter_->Seek(target);
+      UpdateKey();
+      return;
+    }
+    // Find the entry for the target's user key, then skip it if its
+    // assigned sequence number sorts it before the target.
+    std::string seek_key;
+    AppendInternalKey(&seek_key, ParsedInternalKey(ikey.user_key,
+                                                   kMaxSequenceNumber,
+                                                   kValueTypeForSeek));
+    iter_->Seek(seek_key);
+    UpdateKey();
+    if (Valid() && icmp_->Compare(key_, target) < 0) {
+      Next();
+    }
+  }
+  virtual Slice key() const { return key_; }
+  virtual Slice value() const { return iter_->value(); }
+  virtual Status status() const { return iter_->status(); }
+
+ private:
+  void UpdateKey() {
+    key_.clear();
+    ParsedInternalKey ikey;
+    if (!iter_->Valid()) {
+      // Nothing to present
+    } else if (ParseInternalKey(iter_->key(), &ikey)) {
+      AppendInternalKey(&key_, ParsedInternalKey(ikey.user_key, sequence_,
+                                                 ikey.type));
+    } else {
+      key_ = iter_->key().ToString();
+    }
+  }
+
+  const Comparator* const icmp_;
+  Iterator* const iter_;
+  const SequenceNumber sequence_;
+  std::string key_;
+};
+}  // namespace
+
 TableCache::TableCache(const std::string& dbname,
                        const Options* options,
                        int entries)
@@ -76,7 +136,8 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
 Iterator* TableCache::NewIterator(const ReadOptions& options,
                                   uint64_t file_number,
                                   uint64_t file_size,
-                                  Table** tableptr) {
+                                  Table** tableptr,
+                                  SequenceNumber global_sequence) {
   if (tableptr != NULL) {
     *tableptr = NULL;
   }
@@ -90,6 +151,10 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
   Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
   Iterator* result = table->NewIterator(options);
   result->RegisterCleanup(&UnrefEntry, cache_, handle);
+  if (global_sequence != 0) {
+    result = new GlobalSequenceIterator(options_->comparator, result,
+                                        global_sequence);
+  }
   if (tableptr != NULL) {
     *tableptr = table;
   }
@@ -101,7 +166,12 @@ Status TableCache::Get(const ReadOptions& options,
                        uint64_t file_size,
                        const Slice& k,
                        void* arg,
-                       void (*saver)(void*, const Slice&, const Slice&)) {
+                       void (*saver)(void*, const Slice&, const Slice&),
+                       SequenceNumber global_sequence) {
+  if (global_sequence != 0 && ExtractSequence(k) < global_sequence) {
+    // The table was ingested after the snapshot being read
+    return Status::OK();
+  }
   Cache::Handle* handle = NULL;
   Status s = FindTable(file_number, file_size, &handle);
   if (s.ok()) {
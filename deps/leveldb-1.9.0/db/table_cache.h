@@ -29,20 +29,25 @@ class TableCache {
   // underlying the returned iterator, or NULL if no Table object underlies
   // the returned iterator.  The returned "*tableptr" object is owned by
   // the cache and should not be deleted, and is valid for as long as the
-  // returned iterator is live.
+  // returned iterator is live.  If "global_sequence" is non-zero the
+  // file is an ingested table and the iterator presents its keys with
+  // that sequence number.
   Iterator* NewIterator(const ReadOptions& options,
                         uint64_t file_number,
                         uint64_t file_size,
-                        Table** tableptr = NULL);
+                        Table** tableptr = NULL,
+                        SequenceNumber global_sequence = 0);
 
   // If a seek to internal key "k" in specified file finds an entry,
-  // call (*handle_result)(arg, found_key, found_value).
+  // call (*handle_result)(arg, found_key, found_value).  Entries of an
+  // ingested table are not found by a "k" older than "global_sequence".
   Status Get(const ReadOptions& options,
              uint64_t file_number,
              uint64_t file_size,
              const Slice& k,
              void* arg,
-             void (*handle_result)(void*, const Slice&, const Slice&));
+             void (*handle_result)(void*, const Slice&, const Slice&),
+             SequenceNumber global_sequence = 0);
 
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
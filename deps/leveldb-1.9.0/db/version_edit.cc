@@ -6,6 +6,7 @@
 
 #include "db/version_set.h"
 #include "util/coding.h"
+#include "util/logging.h"
 
 namespace leveldb {
 
@@ -20,7 +21,12 @@ enum Tag {
   kDeletedFile          = 6,
   kNewFile              = 7,
   // 8 was used for large value refs
-  kPrevLogNumber        = 9
+  kPrevLogNumber        = 9,
+  kIngestedFile         = 10,
+  kNewFileWithSequence  = 11,
+  kRangeTombstone       = 12,
+  kDeletedRangeTombstone = 13,
+  kBlobFiles            = 14   // Of the preceding new file
 };
 
 void VersionEdit::Clear() {
@@ -36,6 +42,8 @@ void VersionEdit::Clear() {
   has_last_sequence_ = false;
   deleted_files_.clear();
   new_files_.clear();
+  new_tombstones_.clear();
+  deleted_tombstones_.clear();
 }
 
 void VersionEdit::EncodeTo(std::string* dst) const {
@@ -76,12 +84,46 @@ void VersionEdit::EncodeTo(std::string* dst) const {
 
   for (size_t i = 0; i < new_files_.size(); i++) {
     const FileMetaData& f = new_files_[i].second;
-    PutVarint32(dst, kNewFile);
+    Tag tag = kNewFile;
+    if (f.global_sequence != 0) {
+      tag = kIngestedFile;
+    } else if (f.largest_sequence != kMaxSequenceNumber) {
+      tag = kNewFileWithSequence;
+    }
+    PutVarint32(dst, tag);
     PutVarint32(dst, new_files_[i].first);  // level
     PutVarint64(dst, f.number);
     PutVarint64(dst, f.file_size);
     PutLengthPrefixedSlice(dst, f.smallest.Encode());
     PutLengthPrefixedSlice(dst, f.largest.Encode());
+    if (tag == kIngestedFile) {
+      PutVarint64(dst, f.global_sequence);
+    } else if (tag == kNewFileWithSequence) {
+      PutVarint64(dst, f.largest_sequence);
+    }
+    if (!f.blob_files.empty()) {
+      PutVarint32(dst, kBlobFiles);
+      PutVarint32(dst, f.blob_files.size());
+      for (size_t j = 0; j < f.blob_files.size(); j++) {
+        PutVarint64(dst, f.blob_files[j]);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < new_tombstones_.size(); i++) {
+    const RangeTombstone& t = new_tombstones_[i];
+    PutVarint32(dst, kRangeTombstone);
+    PutLengthPrefixedSlice(dst, t.start);
+    PutLengthPrefixedSlice(dst, t.end);
+    PutVarint64(dst, t.sequence);
+  }
+
+  for (std::set<SequenceNumber>::const_iterator iter =
+           deleted_tombstones_.begin();
+       iter != deleted_tombstones_.end();
+       ++iter) {
+    PutVarint32(dst, kDeletedRangeTombstone);
+    PutVarint64(dst, *iter);
   }
 }
 
@@ -118,6 +160,9 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
   FileMetaData f;
   Slice str;
   InternalKey key;
+  Slice end;
+  SequenceNumber sequence;
+  uint32_t count;
 
   while (msg == NULL && GetVarint32(&input, &tag)) {
     switch (tag) {
@@ -186,12 +231,77 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
             GetVarint64(&input, &f.file_size) &&
             GetInternalKey(&input, &f.smallest) &&
             GetInternalKey(&input, &f.largest)) {
+          f.global_sequence = 0;
+          f.largest_sequence = kMaxSequenceNumber;
+          new_files_.push_back(std::make_pair(level, f));
+        } else {
+          msg = "new-file entry";
+        }
+        break;
+
+      case kIngestedFile:
+        if (GetLevel(&input, &level) &&
+            GetVarint64(&input, &f.number) &&
+            GetVarint64(&input, &f.file_size) &&
+            GetInternalKey(&input, &f.smallest) &&
+            GetInternalKey(&input, &f.largest) &&
+            GetVarint64(&input, &f.global_sequence)) {
+          f.largest_sequence = f.global_sequence;
+          new_files_.push_back(std::make_pair(level, f));
+        } else {
+          msg = "ingested-file entry";
+        }
+        break;
+
+      case kNewFileWithSequence:
+        if (GetLevel(&input, &level) &&
+            GetVarint64(&input, &f.number) &&
+            GetVarint64(&input, &f.file_size) &&
+            GetInternalKey(&input, &f.smallest) &&
+            GetInternalKey(&input, &f.largest) &&
+            GetVarint64(&input, &f.largest_sequence)) {
+          f.global_sequence = 0;
           new_files_.push_back(std::make_pair(level, f));
         } else {
           msg = "new-file entry";
         }
         break;
 
+      case kBlobFiles:
+        if (!new_files_.empty() && GetVarint32(&input, &count)) {
+          std::vector<uint64_t>* blob_files =
+              &new_files_.back().second.blob_files;
+          blob_files->clear();
+          for (uint32_t i = 0; i < count && msg == NULL; i++) {
+            if (GetVarint64(&input, &number)) {
+              blob_files->push_back(number);
+            } else {
+              msg = "blob files";
+            }
+          }
+        } else {
+          msg = "blob files";
+        }
+        break;
+
+      case kRangeTombstone:
+        if (GetLengthPrefixedSlice(&input, &str) &&
+            GetLengthPrefixedSlice(&input, &end) &&
+            GetVarint64(&input, &sequence)) {
+          new_tombstones_.push_back(RangeTombstone(str, end, sequence));
+        } else {
+          msg = "range tombstone";
+        }
+        break;
+
+      case kDeletedRangeTombstone:
+        if (GetVarint64(&input, &sequence)) {
+          deleted_tombstones_.insert(sequence);
+        } else {
+          msg = "deleted range tombstone";
+        }
+        break;
+
       default:
         msg = "unknown tag";
         break;
@@ -258,6 +368,30 @@ std::string VersionEdit::DebugString() const {
     r.append(f.smallest.DebugString());
     r.append(" .. ");
     r.append(f.largest.DebugString());
+    if (f.global_sequence != 0) {
+      r.append(" @ ");
+      AppendNumberTo(&r, f.global_sequence);
+    }
+    for (size_t j = 0; j < f.blob_files.size(); j++) {
+      r.append(j == 0 ? " blobs " : ",");
+      AppendNumberTo(&r, f.blob_files[j]);
+    }
+  }
+  for (size_t i = 0; i < new_tombstones_.size(); i++) {
+    const RangeTombstone& t = new_tombstones_[i];
+    r.append("\n  AddRangeTombstone: '");
+    r.append(EscapeString(t.start));
+    r.append("' .. '");
+    r.append(EscapeString(t.end));
+    r.append("' @ ");
+    AppendNumberTo(&r, t.sequence);
+  }
+  for (std::set<SequenceNumber>::const_iterator iter =
+           deleted_tombstones_.begin();
+       iter != deleted_tombstones_.end();
+       ++iter) {
+    r.append("\n  DeleteRangeTombstone: ");
+    AppendNumberTo(&r, *iter);
   }
   r.append("\n}\n");
   return r;
@@ -9,6 +9,7 @@
 #include <utility>
 #include <vector>
 #include "db/dbformat.h"
+#include "db/range_tombstone.h"
 
 namespace leveldb {
 
@@ -21,8 +22,14 @@ struct FileMetaData {
   uint64_t file_size;         // File size in bytes
   InternalKey smallest;       // Smallest internal key served by table
   InternalKey largest;        // Largest internal key served by table
-
-  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) { }
+  SequenceNumber global_sequence;  // Non-zero for an ingested table whose
+                                   // entries are written with sequence zero
+  SequenceNumber largest_sequence;  // Newest entry in the table, or
+                                    // kMaxSequenceNumber if unknown
+  std::vector<uint64_t> blob_files;  // Blob files the table refers to
+
+  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0),
+                   global_sequence(0), largest_sequence(kMaxSequenceNumber) { }
 };
 
 class VersionEdit {
@@ -59,23 +66,54 @@ class VersionEdit {
   // Add the specified file at the specified number.
   // REQUIRES: This version has not been saved (see VersionSet::SaveTo)
   // REQUIRES: "smallest" and "largest" are smallest and largest keys in file
+  // REQUIRES: "global_sequence" is zero unless the file was ingested
   void AddFile(int level, uint64_t file,
                uint64_t file_size,
                const InternalKey& smallest,
-               const InternalKey& largest) {
+               const InternalKey& largest,
+               SequenceNumber global_sequence = 0) {
     FileMetaData f;
     f.number = file;
     f.file_size = file_size;
     f.smallest = smallest;
     f.largest = largest;
+    f.global_sequence = global_sequence;
+    if (global_sequence != 0) {
+      f.largest_sequence = global_sequence;
+    }
     new_files_.push_back(std::make_pair(level, f));
   }
 
+  // Like the above, but takes the file's attributes from "f".
+  void AddFile(int level, const FileMetaData& f) {
+    FileMetaData copy;
+    copy.number = f.number;
+    copy.file_size = f.file_size;
+    copy.smallest = f.smallest;
+    copy.largest = f.largest;
+    copy.global_sequence = f.global_sequence;
+    copy.largest_sequence = f.largest_sequence;
+    copy.blob_files = f.blob_files;
+    new_files_.push_back(std::make_pair(level, copy));
+  }
+
   // Delete the specified "file" from the specified "level".
   void DeleteFile(int level, uint64_t file) {
     deleted_files_.insert(std::make_pair(level, file));
   }
 
+  // Add a range tombstone deleting every key in [start, end) older than
+  // "sequence".
+  void AddRangeTombstone(const RangeTombstone& tombstone) {
+    new_tombstones_.push_back(tombstone);
+  }
+
+  // Drop the range tombstone written at "sequence" once nothing it
+  // covers is left.
+  void DeleteRangeTombstone(SequenceNumber sequence) {
+    deleted_tombstones_.insert(sequence);
+  }
+
   void EncodeTo(std::string* dst) const;
   Status DecodeFrom(const Slice& src);
 
@@ -100,6 +138,8 @@ class VersionEdit {
   std::vector< std::pair<int, InternalKey> > compact_pointers_;
   DeletedFileSet deleted_files_;
   std::vector< std::pair<int, FileMetaData> > new_files_;
+  std::vector<RangeTombstone> new_tombstones_;
+  std::set<SequenceNumber> deleted_tombstones_;
 };
 
 }  // namespace leveldb
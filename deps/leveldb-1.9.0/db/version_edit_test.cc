@@ -39,6 +39,63 @@ TEST(VersionEditTest, EncodeDecode) {
   TestEncodeDecode(edit);
 }
 
+TEST(VersionEditTest, IngestedFile) {
+  static const uint64_t kBig = 1ull << 50;
+
+  VersionEdit edit;
+  edit.AddFile(6, kBig + 300, kBig + 400,
+               InternalKey("foo", kBig + 500, kTypeValue),
+               InternalKey("zoo", kBig + 500, kTypeValue),
+               kBig + 500);
+  edit.AddFile(2, kBig + 301, kBig + 401,
+               InternalKey("a", kBig + 501, kTypeValue),
+               InternalKey("b", kBig + 502, kTypeValue));
+  TestEncodeDecode(edit);
+}
+
+TEST(VersionEditTest, RangeTombstones) {
+  static const uint64_t kBig = 1ull << 50;
+
+  VersionEdit edit;
+  FileMetaData f;
+  f.number = kBig + 300;
+  f.file_size = kBig + 400;
+  f.smallest = InternalKey("foo", kBig + 500, kTypeValue);
+  f.largest = InternalKey("zoo", kBig + 501, kTypeValue);
+  f.largest_sequence = kBig + 502;
+  edit.AddFile(1, f);
+  edit.AddRangeTombstone(RangeTombstone("a", "m", kBig + 600));
+  edit.AddRangeTombstone(RangeTombstone("", "\xff", kBig + 601));
+  edit.DeleteRangeTombstone(kBig + 10);
+  TestEncodeDecode(edit);
+}
+
+TEST(VersionEditTest, BlobFiles) {
+  static const uint64_t kBig = 1ull << 50;
+
+  VersionEdit edit;
+  FileMetaData f;
+  f.number = kBig + 300;
+  f.file_size = kBig + 400;
+  f.smallest = InternalKey("foo", kBig + 500, kTypeBlobIndex);
+  f.largest = InternalKey("zoo", kBig + 501, kTypeValue);
+  f.blob_files.push_back(kBig + 100);
+  f.blob_files.push_back(kBig + 300);
+  edit.AddFile(1, f);
+  edit.AddFile(2, kBig + 301, kBig + 401,
+               InternalKey("a", kBig + 501, kTypeValue),
+               InternalKey("b", kBig + 502, kTypeValue));
+  TestEncodeDecode(edit);
+
+  VersionEdit parsed;
+  std::string encoded;
+  edit.EncodeTo(&encoded);
+  ASSERT_OK(parsed.DecodeFrom(encoded));
+  ASSERT_TRUE(parsed.DebugString().find("blobs 1125899906842724,"
+                                        "1125899906842924") !=
+              std::string::npos);
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
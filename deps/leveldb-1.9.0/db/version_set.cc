@@ -163,8 +163,8 @@ bool SomeFileOverlapsRange(
 // An internal iterator.  For a given version/level pair, yields
 // information about the files in the level.  For a given entry, key()
 // is the largest key that occurs in the file, and value() is an
-// 16-byte value containing the file number and file size, both
-// encoded using EncodeFixed64.
+// 24-byte value containing the file number, file size and global
+// sequence number, all encoded using EncodeFixed64.
 class Version::LevelFileNumIterator : public Iterator {
  public:
   LevelFileNumIterator(const InternalKeyComparator& icmp,
@@ -203,6 +203,7 @@ class Version::LevelFileNumIterator : public Iterator {
     assert(Valid());
     EncodeFixed64(value_buf_, (*flist_)[index_]->number);
     EncodeFixed64(value_buf_+8, (*flist_)[index_]->file_size);
+    EncodeFixed64(value_buf_+16, (*flist_)[index_]->global_sequence);
     return Slice(value_buf_, sizeof(value_buf_));
   }
   virtual Status status() const { return Status::OK(); }
@@ -211,21 +212,24 @@ class Version::LevelFileNumIterator : public Iterator {
   const std::vector<FileMetaData*>* const flist_;
   uint32_t index_;
 
-  // Backing store for value().  Holds the file number and size.
-  mutable char value_buf_[16];
+  // Backing store for value().  Holds the file number, size and global
+  // sequence number.
+  mutable char value_buf_[24];
 };
 
 static Iterator* GetFileIterator(void* arg,
                                  const ReadOptions& options,
                                  const Slice& file_value) {
   TableCache* cache = reinterpret_cast<TableCache*>(arg);
-  if (file_value.size() != 16) {
+  if (file_value.size() != 24) {
     return NewErrorIterator(
         Status::Corruption("FileReader invoked with unexpected value"));
   } else {
     return cache->NewIterator(options,
                               DecodeFixed64(file_value.data()),
-                              DecodeFixed64(file_value.data() + 8));
+                              DecodeFixed64(file_value.data() + 8),
+                              NULL,
+                              DecodeFixed64(file_value.data() + 16));
   }
 }
 
@@ -242,7 +246,8 @@ void Version::AddIterators(const ReadOptions& options,
   for (size_t i = 0; i < files_[0].size(); i++) {
     iters->push_back(
         vset_->table_cache_->NewIterator(
-            options, files_[0][i]->number, files_[0][i]->file_size));
+            options, files_[0][i]->number, files_[0][i]->file_size, NULL,
+            files_[0][i]->global_sequence));
   }
 
   // For levels > 0, we can use a concatenating iterator that sequentially
@@ -268,6 +273,8 @@ struct Saver {
   const Comparator* ucmp;
   Slice user_key;
   std::string* value;
+  SequenceNumber sequence;
+  bool is_blob_index;
 };
 }
 static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
@@ -277,7 +284,10 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
     s->state = kCorrupt;
   } else {
     if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
-      s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
+      s->state = (parsed_key.type == kTypeValue ||
+                  parsed_key.type == kTypeBlobIndex) ? kFound : kDeleted;
+      s->sequence = parsed_key.sequence;
+      s->is_blob_index = (parsed_key.type == kTypeBlobIndex);
       if (s->state == kFound) {
         s->value->assign(v.data(), v.size());
       }
@@ -292,7 +302,9 @@ static bool NewestFirst(FileMetaData* a, FileMetaData* b) {
 Status Version::Get(const ReadOptions& options,
                     const LookupKey& k,
                     std::string* value,
-                    GetStats* stats) {
+                    GetStats* stats,
+                    SequenceNumber* seq,
+                    bool* is_blob_index) {
   Slice ikey = k.internal_key();
   Slice user_key = k.user_key();
   const Comparator* ucmp = vset_->icmp_.user_comparator();
@@ -365,15 +377,27 @@ Status Version::Get(const ReadOptions& options,
       saver.ucmp = ucmp;
       saver.user_key = user_key;
       saver.value = value;
+      saver.is_blob_index = false;
       s = vset_->table_cache_->Get(options, f->number, f->file_size,
-                                   ikey, &saver, SaveValue);
+                                   ikey, &saver, SaveValue,
+                                   f->global_sequence);
       if (!s.ok()) {
         return s;
       }
+      if (seq != NULL && (saver.state == kFound || saver.state == kDeleted)) {
+        // Entries of an ingested table are stored with sequence zero
+        *seq = (f->global_sequence != 0) ? f->global_sequence
+                                         : saver.sequence;
+      }
       switch (saver.state) {
         case kNotFound:
           break;      // Keep searching in other files
         case kFound:
+          if (is_blob_index != NULL) {
+            *is_blob_index = saver.is_blob_index;
+          } else if (saver.is_blob_index) {
+            s = Status::NotSupported("blob index for ", user_key);
+          }
           return s;
         case kDeleted:
           s = Status::NotFound(Slice());  // Use empty error message for speed
@@ -511,6 +535,22 @@ std::string Version::DebugString() const {
       r.append("]\n");
     }
   }
+  if (!range_tombstones_.empty()) {
+    // E.g.,
+    //   --- range tombstones ---
+    //   'a' .. 'c' @ 17
+    r.append("--- range tombstones ---\n");
+    for (size_t i = 0; i < range_tombstones_.size(); i++) {
+      const RangeTombstone& t = range_tombstones_[i];
+      r.append(" '");
+      r.append(EscapeString(t.start));
+      r.append("' .. '");
+      r.append(EscapeString(t.end));
+      r.append("' @ ");
+      AppendNumberTo(&r, t.sequence);
+      r.append("\n");
+    }
+  }
   return r;
 }
 
@@ -543,6 +583,8 @@ class VersionSet::Builder {
   VersionSet* vset_;
   Version* base_;
   LevelState levels_[config::kNumLevels];
+  std::vector<RangeTombstone> added_tombstones_;
+  std::set<SequenceNumber> deleted_tombstones_;
 
  public:
   // Initialize a builder with the files from *base and other info from *vset
@@ -622,6 +664,18 @@ class VersionSet::Builder {
       levels_[level].deleted_files.erase(f->number);
       levels_[level].added_files->insert(f);
     }
+
+    // Update range tombstones
+    for (std::set<SequenceNumber>::const_iterator iter =
+             edit->deleted_tombstones_.begin();
+         iter != edit->deleted_tombstones_.end();
+         ++iter) {
+      deleted_tombstones_.insert(*iter);
+    }
+    for (size_t i = 0; i < edit->new_tombstones_.size(); i++) {
+      deleted_tombstones_.erase(edit->new_tombstones_[i].sequence);
+      added_tombstones_.push_back(edit->new_tombstones_[i]);
+    }
   }
 
   // Save the current state in *v.
@@ -671,6 +725,19 @@ class VersionSet::Builder {
       }
 #endif
     }
+
+    for (size_t i = 0; i < base_->range_tombstones_.size(); i++) {
+      MaybeAddTombstone(v, base_->range_tombstones_[i]);
+    }
+    for (size_t i = 0; i < added_tombstones_.size(); i++) {
+      MaybeAddTombstone(v, added_tombstones_[i]);
+    }
+  }
+
+  void MaybeAddTombstone(Version* v, const RangeTombstone& t) {
+    if (deleted_tombstones_.count(t.sequence) == 0) {
+      v->range_tombstones_.push_back(t);
+    }
   }
 
   void MaybeAddFile(Version* v, int level, FileMetaData* f) {
@@ -1006,10 +1073,16 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
     const std::vector<FileMetaData*>& files = current_->files_[level];
     for (size_t i = 0; i < files.size(); i++) {
       const FileMetaData* f = files[i];
-      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+      edit.AddFile(level, *f);
     }
   }
 
+  // Save range tombstones
+  const std::vector<RangeTombstone>& tombstones = current_->range_tombstones_;
+  for (size_t i = 0; i < tombstones.size(); i++) {
+    edit.AddRangeTombstone(tombstones[i]);
+  }
+
   std::string record;
   edit.EncodeTo(&record);
   return log->AddRecord(record);
@@ -1106,6 +1179,20 @@ void VersionSet::AddLiveFiles(std::set<uint64_t>* live) {
   }
 }
 
+void VersionSet::AddLiveBlobFiles(std::set<uint64_t>* live) {
+  for (Version* v = dummy_versions_.next_;
+       v != &dummy_versions_;
+       v = v->next_) {
+    for (int level = 0; level < config::kNumLevels; level++) {
+      const std::vector<FileMetaData*>& files = v->files_[level];
+      for (size_t i = 0; i < files.size(); i++) {
+        live->insert(files[i]->blob_files.begin(),
+                     files[i]->blob_files.end());
+      }
+    }
+  }
+}
+
 int64_t VersionSet::NumLevelBytes(int level) const {
   assert(level >= 0);
   assert(level < config::kNumLevels);
@@ -1129,6 +1216,47 @@ int64_t VersionSet::MaxNextLevelOverlappingBytes() {
   return result;
 }
 
+void VersionSet::AddRangeDeletions(SequenceNumber smallest_snapshot,
+                                   VersionEdit* edit,
+                                   int* files, int* tombstones) {
+  *files = 0;
+  *tombstones = 0;
+  const std::vector<RangeTombstone>& list = current_->range_tombstones_;
+  if (list.empty()) {
+    return;
+  }
+
+  const Comparator* ucmp = icmp_.user_comparator();
+  RangeTombstoneSet set(ucmp, list, smallest_snapshot);
+  std::vector<FileMetaData*> remaining;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (size_t i = 0; i < current_->files_[level].size(); i++) {
+      FileMetaData* f = current_->files_[level][i];
+      if (f->largest_sequence < set.CoveringSequence(f->smallest.user_key(),
+                                                     f->largest.user_key())) {
+        edit->DeleteFile(level, f->number);
+        (*files)++;
+      } else {
+        remaining.push_back(f);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < list.size(); i++) {
+    const RangeTombstone& t = list[i];
+    bool overlap = false;
+    for (size_t j = 0; !overlap && j < remaining.size(); j++) {
+      const FileMetaData* f = remaining[j];
+      overlap = (ucmp->Compare(f->smallest.user_key(), t.end) < 0 &&
+                 ucmp->Compare(t.start, f->largest.user_key()) <= 0);
+    }
+    if (!overlap) {
+      edit->DeleteRangeTombstone(t.sequence);
+      (*tombstones)++;
+    }
+  }
+}
+
 // Stores the minimal range that covers all entries in inputs in
 // *smallest, *largest.
 // REQUIRES: inputs is not empty
@@ -1183,7 +1311,8 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
         const std::vector<FileMetaData*>& files = c->inputs_[which];
         for (size_t i = 0; i < files.size(); i++) {
           list[num++] = table_cache_->NewIterator(
-              options, files[i]->number, files[i]->file_size);
+              options, files[i]->number, files[i]->file_size, NULL,
+              files[i]->global_sequence);
         }
       } else {
         // Create concatenating iterator for the files from this level
@@ -1350,16 +1479,19 @@ Compaction* VersionSet::CompactRange(
   return c;
 }
 
+Compaction::Position::Position()
+    : grandparent_index(0),
+      seen_key(false),
+      overlapped_bytes(0) {
+  for (int i = 0; i < config::kNumLevels; i++) {
+    level_ptrs[i] = 0;
+  }
+}
+
 Compaction::Compaction(int level)
     : level_(level),
       max_output_file_size_(MaxFileSizeForLevel(level)),
-      input_version_(NULL),
-      grandparent_index_(0),
-      seen_key_(false),
-      overlapped_bytes_(0) {
-  for (int i = 0; i < config::kNumLevels; i++) {
-    level_ptrs_[i] = 0;
-  }
+      input_version_(NULL) {
 }
 
 Compaction::~Compaction() {
@@ -1385,13 +1517,13 @@ void Compaction::AddInputDeletions(VersionEdit* edit) {
   }
 }
 
-bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
+bool Compaction::IsBaseLevelForKey(const Slice& user_key, Position* pos) {
   // Maybe use binary search to find right entry instead of linear search?
   const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
   for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
     const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
-    for (; level_ptrs_[lvl] < files.size(); ) {
-      FileMetaData* f = files[level_ptrs_[lvl]];
+    for (; pos->level_ptrs[lvl] < files.size(); ) {
+      FileMetaData* f = files[pos->level_ptrs[lvl]];
       if (user_cmp->Compare(user_key, f->largest.user_key()) <= 0) {
         // We've advanced far enough
         if (user_cmp->Compare(user_key, f->smallest.user_key()) >= 0) {
@@ -1400,34 +1532,84 @@ bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
         }
         break;
       }
-      level_ptrs_[lvl]++;
+      pos->level_ptrs[lvl]++;
     }
   }
   return true;
 }
 
-bool Compaction::ShouldStopBefore(const Slice& internal_key) {
+bool Compaction::ShouldStopBefore(const Slice& internal_key, Position* pos) {
   // Scan to find earliest grandparent file that contains key.
   const InternalKeyComparator* icmp = &input_version_->vset_->icmp_;
-  while (grandparent_index_ < grandparents_.size() &&
+  while (pos->grandparent_index < grandparents_.size() &&
       icmp->Compare(internal_key,
-                    grandparents_[grandparent_index_]->largest.Encode()) > 0) {
-    if (seen_key_) {
-      overlapped_bytes_ += grandparents_[grandparent_index_]->file_size;
+                    grandparents_[pos->grandparent_index]->largest.Encode()) > 0) {
+    if (pos->seen_key) {
+      pos->overlapped_bytes += grandparents_[pos->grandparent_index]->file_size;
     }
-    grandparent_index_++;
+    pos->grandparent_index++;
   }
-  seen_key_ = true;
+  pos->seen_key = true;
 
-  if (overlapped_bytes_ > kMaxGrandParentOverlapBytes) {
+  if (pos->overlapped_bytes > kMaxGrandParentOverlapBytes) {
     // Too much overlap for current output; start new output
-    overlapped_bytes_ = 0;
+    pos->overlapped_bytes = 0;
     return true;
   } else {
     return false;
   }
 }
 
+namespace {
+struct ByUserKey {
+  const Comparator* user_cmp;
+
+  bool operator()(const Slice& a, const Slice& b) const {
+    return user_cmp->Compare(a, b) < 0;
+  }
+};
+}  // namespace
+
+void Compaction::GetSubcompactionBoundaries(
+    int max_ranges, std::vector<std::string>* boundaries) {
+  boundaries->clear();
+  if (max_ranges <= 1) {
+    return;
+  }
+
+  // Candidate boundaries are the smallest and largest keys of the input
+  // files, except for the largest key of the whole input.
+  const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
+  std::vector<Slice> keys;
+  Slice largest;
+  for (int which = 0; which < 2; which++) {
+    for (size_t i = 0; i < inputs_[which].size(); i++) {
+      FileMetaData* f = inputs_[which][i];
+      keys.push_back(f->smallest.user_key());
+      keys.push_back(f->largest.user_key());
+      if (keys.size() == 2 || user_cmp->Compare(keys.back(), largest) > 0) {
+        largest = keys.back();
+      }
+    }
+  }
+  ByUserKey cmp;
+  cmp.user_cmp = user_cmp;
+  std::sort(keys.begin(), keys.end(), cmp);
+
+  // Pick evenly spaced candidates
+  size_t count = 0;
+  while (count < keys.size() && user_cmp->Compare(keys[count], largest) < 0) {
+    count++;
+  }
+  for (int i = 1; i < max_ranges && count > 0; i++) {
+    const Slice key = keys[i * count / max_ranges];
+    if (boundaries->empty() ||
+        user_cmp->Compare(key, Slice(boundaries->back())) > 0) {
+      boundaries->push_back(key.ToString());
+    }
+  }
+}
+
 void Compaction::ReleaseInputs() {
   if (input_version_ != NULL) {
     input_version_->Unref();
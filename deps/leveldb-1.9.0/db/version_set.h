@@ -70,8 +70,13 @@ class Version {
     FileMetaData* seek_file;
     int seek_file_level;
   };
+  // If seq is non-NULL, the sequence number of the entry found is stored
+  // in *seq.  If the entry found is a blob index, *val holds the index
+  // and *is_blob_index is set; a blob index is an error if is_blob_index
+  // is NULL.
   Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
-             GetStats* stats);
+             GetStats* stats, SequenceNumber* seq = NULL,
+             bool* is_blob_index = NULL);
 
   // Adds "stats" into the current state.  Returns true if a new
   // compaction may need to be triggered, false otherwise.
@@ -104,6 +109,12 @@ class Version {
 
   int NumFiles(int level) const { return files_[level].size(); }
 
+  // Range tombstones that have been flushed from memtables.  They stay
+  // here until no file holds a key they cover.
+  const std::vector<RangeTombstone>& range_tombstones() const {
+    return range_tombstones_;
+  }
+
   // Return a human readable string that describes this version's contents.
   std::string DebugString() const;
 
@@ -122,6 +133,9 @@ class Version {
   // List of files per level
   std::vector<FileMetaData*> files_[config::kNumLevels];
 
+  // Flushed range tombstones
+  std::vector<RangeTombstone> range_tombstones_;
+
   // Next file to compact based on seek stats.
   FileMetaData* file_to_compact_;
   int file_to_compact_level_;
@@ -228,6 +242,14 @@ class VersionSet {
   // file at a level >= 1.
   int64_t MaxNextLevelOverlappingBytes();
 
+  // Add to *edit the deletion of every file in the current version whose
+  // entries are all deleted by range tombstones not newer than
+  // "smallest_snapshot", and of every range tombstone that no remaining
+  // file overlaps.  The numbers of files and tombstones deleted are
+  // stored in *files and *tombstones.
+  void AddRangeDeletions(SequenceNumber smallest_snapshot, VersionEdit* edit,
+                         int* files, int* tombstones);
+
   // Create an iterator that reads over the compaction inputs for "*c".
   // The caller should delete the iterator when no longer needed.
   Iterator* MakeInputIterator(Compaction* c);
@@ -242,6 +264,9 @@ class VersionSet {
   // May also mutate some internal state.
   void AddLiveFiles(std::set<uint64_t>* live);
 
+  // Add all blob files referred to by a file in any live version to *live.
+  void AddLiveBlobFiles(std::set<uint64_t>* live);
+
   // Return the approximate offset in the database of the data for
   // "key" as of version "v".
   uint64_t ApproximateOffsetOf(Version* v, const InternalKey& key);
@@ -308,6 +333,27 @@ class VersionSet {
 // A Compaction encapsulates information about a compaction.
 class Compaction {
  public:
+  // The position of a scan over the compaction's input in key order.
+  // Subcompactions scan disjoint key ranges so each keeps its own.
+  struct Position {
+    // State used to check for number of of overlapping grandparent files
+    // (parent == level_ + 1, grandparent == level_ + 2)
+    size_t grandparent_index;  // Index in grandparents_
+    bool seen_key;             // Some output key has been seen
+    int64_t overlapped_bytes;  // Bytes of overlap between current output
+                               // and grandparent files
+
+    // State for implementing IsBaseLevelForKey
+
+    // level_ptrs holds indices into input_version_->levels_: our state
+    // is that we are positioned at one of the file ranges for each
+    // higher level than the ones involved in this compaction (i.e. for
+    // all L >= level_ + 2).
+    size_t level_ptrs[config::kNumLevels];
+
+    Position();
+  };
+
   ~Compaction();
 
   // Return the level that is being compacted.  Inputs from "level"
@@ -337,11 +383,21 @@ class Compaction {
   // Returns true if the information we have available guarantees that
   // the compaction is producing data in "level+1" for which no data exists
   // in levels greater than "level+1".
-  bool IsBaseLevelForKey(const Slice& user_key);
+  // REQUIRES: keys passed with the same *pos are in increasing order
+  bool IsBaseLevelForKey(const Slice& user_key, Position* pos);
 
   // Returns true iff we should stop building the current output
   // before processing "internal_key".
-  bool ShouldStopBefore(const Slice& internal_key);
+  // REQUIRES: keys passed with the same *pos are in increasing order
+  bool ShouldStopBefore(const Slice& internal_key, Position* pos);
+
+  // Store in *boundaries up to "max_ranges-1" user keys, in increasing
+  // order, that split the input into disjoint ranges.  Boundaries are
+  // picked evenly from the input files' smallest and largest keys.  A
+  // range includes its upper boundary, so all entries for a user key fall
+  // in one range.
+  void GetSubcompactionBoundaries(int max_ranges,
+                                  std::vector<std::string>* boundaries);
 
   // Release the input version for the compaction, once the compaction
   // is successful.
@@ -361,21 +417,8 @@ class Compaction {
   // Each compaction reads inputs from "level_" and "level_+1"
   std::vector<FileMetaData*> inputs_[2];      // The two sets of inputs
 
-  // State used to check for number of of overlapping grandparent files
-  // (parent == level_ + 1, grandparent == level_ + 2)
+  // Files in level_ + 2 that overlap the compaction's key range
   std::vector<FileMetaData*> grandparents_;
-  size_t grandparent_index_;  // Index in grandparent_starts_
-  bool seen_key_;             // Some output key has been seen
-  int64_t overlapped_bytes_;  // Bytes of overlap between current output
-                              // and grandparent files
-
-  // State for implementing IsBaseLevelForKey
-
-  // level_ptrs_ holds indices into input_version_->levels_: our state
-  // is that we are positioned at one of the file ranges for each
-  // higher level than the ones involved in this compaction (i.e. for
-  // all L >= level_ + 2).
-  size_t level_ptrs_[config::kNumLevels];
 };
 
 }  // namespace leveldb
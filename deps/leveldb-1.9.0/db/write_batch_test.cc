@@ -43,6 +43,17 @@ static std::string PrintContents(WriteBatch* b) {
     state.append(NumberToString(ikey.sequence));
   }
   delete iter;
+  std::vector<RangeTombstone> tombstones;
+  mem->GetRangeTombstones(&tombstones);
+  for (size_t i = 0; i < tombstones.size(); i++) {
+    state.append("DeleteRange(");
+    state.append(tombstones[i].start);
+    state.append(", ");
+    state.append(tombstones[i].end);
+    state.append(")@");
+    state.append(NumberToString(tombstones[i].sequence));
+    count++;
+  }
   if (!s.ok()) {
     state.append("ParseError()");
   } else if (count != WriteBatchInternal::Count(b)) {
@@ -74,6 +85,38 @@ TEST(WriteBatchTest, Multiple) {
             PrintContents(&batch));
 }
 
+TEST(WriteBatchTest, DeleteRange) {
+  WriteBatch batch;
+  batch.Put(Slice("foo"), Slice("bar"));
+  batch.DeleteRange(Slice("a"), Slice("g"));
+  batch.Put(Slice("baz"), Slice("boo"));
+  WriteBatchInternal::SetSequence(&batch, 100);
+  ASSERT_EQ(3, WriteBatchInternal::Count(&batch));
+  ASSERT_EQ("Put(baz, boo)@102"
+            "Put(foo, bar)@100"
+            "DeleteRange(a, g)@101",
+            PrintContents(&batch));
+}
+
+TEST(WriteBatchTest, DeleteRangeNotSupported) {
+  // A handler that predates range deletions
+  class Handler : public WriteBatch::Handler {
+   public:
+    int count_;
+    Handler() : count_(0) { }
+    virtual void Put(const Slice& key, const Slice& value) { count_++; }
+    virtual void Delete(const Slice& key) { count_++; }
+  };
+  WriteBatch batch;
+  batch.Put(Slice("foo"), Slice("bar"));
+  batch.DeleteRange(Slice("a"), Slice("g"));
+  batch.Delete(Slice("baz"));
+  Handler handler;
+  ASSERT_EQ("Not implemented: WriteBatch::Handler::DeleteRange",
+            batch.Iterate(&handler).ToString());
+  ASSERT_EQ(1, handler.count_);
+}
+
 TEST(WriteBatchTest, Corruption) {
   WriteBatch batch;
   batch.Put(Slice("foo"), Slice("bar"));
@@ -53,6 +53,7 @@ extern "C" {
 
 typedef struct leveldb_t               leveldb_t;
 typedef struct leveldb_cache_t         leveldb_cache_t;
+typedef struct leveldb_compactionfilter_t leveldb_compactionfilter_t;
 typedef struct leveldb_comparator_t    leveldb_comparator_t;
 typedef struct leveldb_env_t           leveldb_env_t;
 typedef struct leveldb_filelock_t      leveldb_filelock_t;
@@ -64,6 +65,7 @@ typedef struct leveldb_randomfile_t    leveldb_randomfile_t;
 typedef struct leveldb_readoptions_t   leveldb_readoptions_t;
 typedef struct leveldb_seqfile_t       leveldb_seqfile_t;
 typedef struct leveldb_snapshot_t      leveldb_snapshot_t;
+typedef struct leveldb_sstfilewriter_t leveldb_sstfilewriter_t;
 typedef struct leveldb_writablefile_t  leveldb_writablefile_t;
 typedef struct leveldb_writebatch_t    leveldb_writebatch_t;
 typedef struct leveldb_writeoptions_t  leveldb_writeoptions_t;
@@ -90,6 +92,14 @@ extern void leveldb_delete(
     const char* key, size_t keylen,
     char** errptr);
 
+/* Deletes every key in [start, end). */
+extern void leveldb_delete_range(
+    leveldb_t* db,
+    const leveldb_writeoptions_t* options,
+    const char* start, size_t startlen,
+    const char* end, size_t endlen,
+    char** errptr);
+
 extern void leveldb_write(
     leveldb_t* db,
     const leveldb_writeoptions_t* options,
@@ -134,6 +144,11 @@ extern void leveldb_compact_range(
     const char* start_key, size_t start_key_len,
     const char* limit_key, size_t limit_key_len);
 
+extern void leveldb_ingest_external_file(
+    leveldb_t* db,
+    const char* const* file_list, size_t list_len,
+    char** errptr);
+
 /* Management operations */
 
 extern void leveldb_destroy_db(
@@ -171,12 +186,35 @@ extern void leveldb_writebatch_put(
 extern void leveldb_writebatch_delete(
     leveldb_writebatch_t*,
     const char* key, size_t klen);
+extern void leveldb_writebatch_delete_range(
+    leveldb_writebatch_t*,
+    const char* start, size_t startlen,
+    const char* end, size_t endlen);
 extern void leveldb_writebatch_iterate(
     leveldb_writebatch_t*,
     void* state,
     void (*put)(void*, const char* k, size_t klen, const char* v, size_t vlen),
     void (*deleted)(void*, const char* k, size_t klen));
 
+/* SST file writer */
+
+extern leveldb_sstfilewriter_t* leveldb_sstfilewriter_create(
+    const leveldb_options_t* options);
+extern void leveldb_sstfilewriter_destroy(leveldb_sstfilewriter_t*);
+extern void leveldb_sstfilewriter_open(
+    leveldb_sstfilewriter_t*,
+    const char* name,
+    char** errptr);
+extern void leveldb_sstfilewriter_put(
+    leveldb_sstfilewriter_t*,
+    const char* key, size_t klen,
+    const char* val, size_t vlen,
+    char** errptr);
+extern void leveldb_sstfilewriter_finish(
+    leveldb_sstfilewriter_t*,
+    char** errptr);
+extern uint64_t leveldb_sstfilewriter_file_size(leveldb_sstfilewriter_t*);
+
 /* Options */
 
 extern leveldb_options_t* leveldb_options_create();
@@ -187,6 +225,9 @@ extern void leveldb_options_set_comparator(
 extern void leveldb_options_set_filter_policy(
     leveldb_options_t*,
     leveldb_filterpolicy_t*);
+extern void leveldb_options_set_compaction_filter(
+    leveldb_options_t*,
+    leveldb_compactionfilter_t*);
 extern void leveldb_options_set_create_if_missing(
     leveldb_options_t*, unsigned char);
 extern void leveldb_options_set_error_if_exists(
@@ -200,6 +241,15 @@ extern void leveldb_options_set_max_open_files(leveldb_options_t*, int);
 extern void leveldb_options_set_cache(leveldb_options_t*, leveldb_cache_t*);
 extern void leveldb_options_set_block_size(leveldb_options_t*, size_t);
 extern void leveldb_options_set_block_restart_interval(leveldb_options_t*, int);
+extern void leveldb_options_set_max_subcompactions(leveldb_options_t*, int);
+extern void leveldb_options_set_concurrent_memtable_writes(
+    leveldb_options_t*, unsigned char);
+extern void leveldb_options_set_pipelined_writes(
+    leveldb_options_t*, unsigned char);
+extern void leveldb_options_set_min_blob_size(leveldb_options_t*, size_t);
+extern void leveldb_options_set_blob_cache(
+    leveldb_options_t*, leveldb_cache_t*);
+extern void leveldb_options_set_blob_gc_age_cutoff(leveldb_options_t*, double);
 
 enum {
   leveldb_no_compression = 0,
@@ -207,6 +257,13 @@ enum {
 };
 extern void leveldb_options_set_compression(leveldb_options_t*, int);
 
+enum {
+  leveldb_lru_cache = 0,
+  leveldb_clock_cache = 1
+};
+extern void leveldb_options_set_cache_type(leveldb_options_t*, int);
+extern void leveldb_options_set_cache_shard_bits(leveldb_options_t*, int);
+
 /* Comparator */
 
 extern leveldb_comparator_t* leveldb_comparator_create(
@@ -239,6 +296,24 @@ extern void leveldb_filterpolicy_destroy(leveldb_filterpolicy_t*);
 extern leveldb_filterpolicy_t* leveldb_filterpolicy_create_bloom(
     int bits_per_key);
 
+/* Compaction filter */
+
+/* The filter returns 1 to remove the key.  To replace the value it sets
+   *value_changed to 1 and *new_value to a malloc()-ed buffer that
+   leveldb frees. */
+extern leveldb_compactionfilter_t* leveldb_compactionfilter_create(
+    void* state,
+    void (*destructor)(void*),
+    unsigned char (*filter)(
+        void*,
+        int level,
+        const char* key, size_t key_length,
+        const char* existing_value, size_t value_length,
+        char** new_value, size_t* new_value_length,
+        unsigned char* value_changed),
+    const char* (*name)(void*));
+extern void leveldb_compactionfilter_destroy(leveldb_compactionfilter_t*);
+
 /* Read options */
 
 extern leveldb_readoptions_t* leveldb_readoptions_create();
@@ -248,6 +323,10 @@ extern void leveldb_readoptions_set_verify_checksums(
     unsigned char);
 extern void leveldb_readoptions_set_fill_cache(
     leveldb_readoptions_t*, unsigned char);
+extern void leveldb_readoptions_set_low_priority(
+    leveldb_readoptions_t*, unsigned char);
+extern void leveldb_readoptions_set_readahead_blocks(
+    leveldb_readoptions_t*, int);
 extern void leveldb_readoptions_set_snapshot(
     leveldb_readoptions_t*,
     const leveldb_snapshot_t*);
@@ -262,6 +341,8 @@ extern void leveldb_writeoptions_set_sync(
 /* Cache */
 
 extern leveldb_cache_t* leveldb_cache_create_lru(size_t capacity);
+extern leveldb_cache_t* leveldb_cache_create_clock(
+    size_t capacity, int num_shard_bits);
 extern void leveldb_cache_destroy(leveldb_cache_t* cache);
 
 /* Env */
@@ -269,6 +350,15 @@ extern void leveldb_cache_destroy(leveldb_cache_t* cache);
 extern leveldb_env_t* leveldb_create_default_env();
 extern void leveldb_env_destroy(leveldb_env_t*);
 
+/* Set the number of threads used for compactions and for memtable flushes.
+   The default env's threads are shared by every database that uses it. */
+extern void leveldb_env_set_background_threads(leveldb_env_t*, int n);
+extern void leveldb_env_set_high_priority_background_threads(
+    leveldb_env_t*, int n);
+
+/* Set the number of threads that read blocks ahead for iterators. */
+extern void leveldb_env_set_io_threads(leveldb_env_t*, int n);
+
 /* Utility */
 
 /* Calls free(ptr).
@@ -10,10 +10,11 @@
 // length strings, may use the length of the string as the charge for
 // the string.
 //
-// A builtin cache implementation with a least-recently-used eviction
-// policy is provided.  Clients may use their own implementations if
-// they want something more sophisticated (like scan-resistance, a
-// custom eviction policy, variable cache sizing, etc.)
+// Builtin cache implementations with a least-recently-used eviction
+// policy and with a scan-resistant CLOCK policy are provided.  Clients
+// may use their own implementations if they want something more
+// sophisticated (like a custom eviction policy, variable cache sizing,
+// etc.)
 
 #ifndef STORAGE_LEVELDB_INCLUDE_CACHE_H_
 #define STORAGE_LEVELDB_INCLUDE_CACHE_H_
@@ -29,6 +30,19 @@ class Cache;
 // of Cache uses a least-recently-used eviction policy.
 extern Cache* NewLRUCache(size_t capacity);
 
+// Like NewLRUCache(capacity), but the cache is split into
+// 2^num_shard_bits independently locked shards.  More shards let more
+// threads use the cache at once at the cost of a coarser eviction order.
+extern Cache* NewLRUCache(size_t capacity, int num_shard_bits);
+
+// Create a new cache with a fixed size capacity, split into
+// 2^num_shard_bits shards.  This implementation uses a CLOCK eviction
+// policy: lookups that hit only take a shared lock, entries that are
+// used often survive a number of sweeps of the clock hand, and entries
+// inserted with kLowPriority are the first candidates for eviction, so
+// a long scan does not push the working set out of the cache.
+extern Cache* NewClockCache(size_t capacity, int num_shard_bits);
+
 class Cache {
  public:
   Cache() { }
@@ -40,6 +54,13 @@ class Cache {
   // Opaque handle to an entry stored in the cache.
   struct Handle { };
 
+  // How much an entry is worth keeping.  Caches without a notion of
+  // priority treat every entry alike.
+  enum Priority {
+    kHighPriority,
+    kLowPriority
+  };
+
   // Insert a mapping from key->value into the cache and assign it
   // the specified charge against the total cache capacity.
   //
@@ -59,6 +80,19 @@ class Cache {
   // longer needed.
   virtual Handle* Lookup(const Slice& key) = 0;
 
+  // Like Insert() and Lookup() above, but "priority" says whether the
+  // caller expects the entry to be used again soon.  Scans use
+  // kLowPriority so their entries are evicted before the rest.  The
+  // default implementations ignore the priority.
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value),
+                         Priority priority) {
+    return Insert(key, value, charge, deleter);
+  }
+  virtual Handle* Lookup(const Slice& key, Priority priority) {
+    return Lookup(key);
+  }
+
   // Release a mapping returned by a previous Lookup().
   // REQUIRES: handle must not have been released yet.
   // REQUIRES: handle must have been returned by a method on *this.
@@ -0,0 +1,47 @@
+// Copyright (c) 2013 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A database can be configured with a custom CompactionFilter object.
+// The filter is shown the value of every key that a compaction rewrites
+// and may remove the key or replace its value, so that data can expire
+// or be trimmed without the application rewriting it.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+#define STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+
+#include <string>
+
+namespace leveldb {
+
+class Slice;
+
+class CompactionFilter {
+ public:
+  virtual ~CompactionFilter();
+
+  // Return the name of this filter.  Used in log messages.
+  virtual const char* Name() const = 0;
+
+  // Called for the values of a key that were written after every live
+  // snapshot, so that no snapshot reads them, while the key is compacted
+  // into "level".  Return true to remove the key: later reads find
+  // neither this value nor an older one, though snapshots still read
+  // the values they see.  Otherwise the key is kept and, if the value
+  // should change, *new_value is set to the replacement and
+  // *value_changed to true.
+  //
+  // Compactions run in background threads, several at once when they are
+  // split into subcompactions, so Filter() must be thread-safe.  It must
+  // also be deterministic: a key is filtered again each time it moves down
+  // a level.
+  virtual bool Filter(int level,
+                      const Slice& key,
+                      const Slice& existing_value,
+                      std::string* new_value,
+                      bool* value_changed) const = 0;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
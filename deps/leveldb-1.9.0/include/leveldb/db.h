@@ -7,6 +7,8 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string>
+#include <vector>
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
 
@@ -68,6 +70,13 @@ class DB {
   // Note: consider setting options.sync = true.
   virtual Status Delete(const WriteOptions& options, const Slice& key) = 0;
 
+  // Remove the database entries (if any) for every key in [start, end).
+  // The keys are hidden at once and reclaimed by later compactions.
+  // Returns OK on success, and a non-OK status on error.
+  // Note: consider setting options.sync = true.
+  virtual Status DeleteRange(const WriteOptions& options,
+                             const Slice& start, const Slice& end) = 0;
+
   // Apply the specified updates to the database.
   // Returns OK on success, non-OK on failure.
   // Note: consider setting options.sync = true.
@@ -140,6 +149,15 @@ class DB {
   //    db->CompactRange(NULL, NULL);
   virtual void CompactRange(const Slice* begin, const Slice* end) = 0;
 
+  // Link the tables in "files", built with an SstFileWriter, into the
+  // database.  The key ranges of the files must not overlap each other or
+  // any data already in the database.  All of their entries are assigned
+  // one new sequence number, so they are not visible through snapshots
+  // acquired before the call.  The files are moved into the database
+  // directory when possible and copied otherwise.  If the call fails the
+  // files are left where they were.
+  virtual Status IngestExternalFile(const std::vector<std::string>& files) = 0;
+
  private:
   // No copying allowed
   DB(const DB&);
@@ -30,6 +30,13 @@ class WritableFile;
 
 class Env {
  public:
+  // The priority of background work.  High priority work, such as
+  // flushing memtables, runs in a separate pool of threads so that it is
+  // not queued behind long running low priority work such as compactions.
+  // Blocks that iterators read ahead (see ReadOptions::readahead_blocks)
+  // are read in the IO pool so they never wait for background work.
+  enum Priority { LOW, HIGH, IO, TOTAL };
+
   Env() { }
   virtual ~Env();
 
@@ -120,10 +127,16 @@ class Env {
   // "function" may run in an unspecified thread.  Multiple functions
   // added to the same Env may run concurrently in different threads.
   // I.e., the caller may not assume that background work items are
-  // serialized.
+  // serialized.  "function" runs in the pool of threads for "pri".
   virtual void Schedule(
       void (*function)(void* arg),
-      void* arg) = 0;
+      void* arg,
+      Priority pri = LOW) = 0;
+
+  // Set the maximum number of background threads in the pool for "pri".
+  // Environments that run all background work in a single pool may ignore
+  // this.  The default implementation does nothing.
+  virtual void SetBackgroundThreads(int number, Priority pri = LOW) { }
 
   // Start a new thread, invoking "function(arg)" within the new thread.
   // When "function(arg)" returns, the thread will be destroyed.
@@ -306,8 +319,11 @@ class EnvWrapper : public Env {
     return target_->LockFile(f, l);
   }
   Status UnlockFile(FileLock* l) { return target_->UnlockFile(l); }
-  void Schedule(void (*f)(void*), void* a) {
-    return target_->Schedule(f, a);
+  void Schedule(void (*f)(void*), void* a, Priority pri = LOW) {
+    return target_->Schedule(f, a, pri);
+  }
+  void SetBackgroundThreads(int number, Priority pri = LOW) {
+    return target_->SetBackgroundThreads(number, pri);
   }
   void StartThread(void (*f)(void*), void* a) {
     return target_->StartThread(f, a);
@@ -10,6 +10,7 @@
 namespace leveldb {
 
 class Cache;
+class CompactionFilter;
 class Comparator;
 class Env;
 class FilterPolicy;
@@ -27,6 +28,12 @@ enum CompressionType {
   kSnappyCompression = 0x1
 };
 
+// Eviction policies of the caches that leveldb creates for itself.
+enum CacheType {
+  kLRUCache   = 0x0,  // See NewLRUCache()
+  kClockCache = 0x1   // See NewClockCache()
+};
+
 // Options to control the behavior of a database (passed to DB::Open)
 struct Options {
   // -------------------
@@ -97,6 +104,20 @@ struct Options {
   // Default: NULL
   Cache* block_cache;
 
+  // Eviction policy of the caches leveldb creates when block_cache or
+  // blob_cache is NULL.  kClockCache lets hits proceed in parallel and
+  // keeps scans (see ReadOptions::low_priority) from evicting the
+  // blocks other reads use.
+  //
+  // Default: kLRUCache
+  CacheType cache_type;
+
+  // The caches leveldb creates are split into 2^cache_shard_bits
+  // independently locked shards.
+  //
+  // Default: 4
+  int cache_shard_bits;
+
   // Approximate size of user data packed per block.  Note that the
   // block size specified here corresponds to uncompressed data.  The
   // actual size of the unit read from disk may be smaller if
@@ -135,6 +156,59 @@ struct Options {
   // Default: NULL
   const FilterPolicy* filter_policy;
 
+  // If non-NULL, compactions pass the value of each key they rewrite to
+  // this filter, which may remove the key or replace its value.  Only
+  // values that no snapshot needs the older contents of are filtered.
+  //
+  // Default: NULL
+  const CompactionFilter* compaction_filter;
+
+  // Maximum number of threads that a single compaction is split across.
+  // The input of a compaction is divided into disjoint key ranges that
+  // are compacted concurrently, each into its own output files, and the
+  // outputs are installed together.  Ranges are cut at the smallest and
+  // largest keys of the input files, picked evenly by count, so they are
+  // not balanced by size and a compaction with few input files may use
+  // fewer threads.
+  //
+  // Default: 1
+  int max_subcompactions;
+
+  // If true, writes that are grouped together are inserted into the
+  // memtable by their own threads in parallel once the group has been
+  // logged.  Otherwise the thread that logs a group inserts all of it.
+  //
+  // Default: true
+  bool concurrent_memtable_writes;
+
+  // If true, a group of writes is taken off the write queue as soon as it
+  // has been logged, so the next group is logged while this one is
+  // inserted into the memtable.  Writes become visible to readers in
+  // sequence order and a write returns only once it is visible.
+  //
+  // Default: false
+  bool pipelined_writes;
+
+  // Values of at least this many bytes are moved out of the tables into
+  // append-only blob files when the memtable is flushed, leaving a small
+  // reference in their place, so compactions rewrite keys rather than
+  // large values.  Zero keeps every value in the tables.
+  //
+  // Default: 0
+  size_t min_blob_size;
+
+  // If non-NULL, use the specified cache for values read from blob files.
+  // If NULL, leveldb will automatically create and use an 8MB internal cache.
+  // Default: NULL
+  Cache* blob_cache;
+
+  // Compactions move the live values they meet in the oldest fraction
+  // of blob files into new blob files, so those files can be deleted
+  // once no table refers to them.
+  //
+  // Default: 0.25
+  double blob_gc_age_cutoff;
+
   // Create an Options object with default values for all fields.
   Options();
 };
@@ -151,6 +225,20 @@ struct ReadOptions {
   // Default: true
   bool fill_cache;
 
+  // Should the blocks read for this iteration be cached with low
+  // priority?  They are still cached, but are the first to be evicted,
+  // so a bulk scan does not push the working set of other reads out of
+  // the block cache.  Has no effect unless fill_cache is true.
+  // Default: false
+  bool low_priority;
+
+  // If positive, an iterator that moves forward over several data blocks
+  // in a row starts reading up to this many of the following blocks of
+  // each table in the background (in the Env::IO pool), so a long scan
+  // does not wait for every block to be read from disk.
+  // Default: 0
+  int readahead_blocks;
+
   // If "snapshot" is non-NULL, read as of the supplied snapshot
   // (which must belong to the DB that is being read and which must
   // not have been released).  If "snapshot" is NULL, use an impliicit
@@ -161,6 +249,8 @@ struct ReadOptions {
   ReadOptions()
       : verify_checksums(false),
         fill_cache(true),
+        low_priority(false),
+        readahead_blocks(0),
         snapshot(NULL) {
   }
 };
@@ -0,0 +1,59 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// SstFileWriter builds a table outside of a DB that can later be linked
+// into a DB with DB::IngestExternalFile().  Keys must be added in
+// increasing order and each key may be added only once.
+//
+// An SstFileWriter must not be used by several threads at once without
+// external synchronization.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+#define STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+
+#include <stdint.h>
+#include <string>
+#include "leveldb/options.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class SstFileWriter {
+ public:
+  // Tables are written with options.env, options.comparator,
+  // options.filter_policy, options.block_size,
+  // options.block_restart_interval and options.compression, which should
+  // match the options of the DB the table is ingested into.
+  explicit SstFileWriter(const Options& options);
+
+  // Abandons the table if Finish() has not been called.
+  ~SstFileWriter();
+
+  // Create the file "fname" and start building a table in it.
+  Status Open(const std::string& fname);
+
+  // Add key,value to the table.
+  // REQUIRES: Open() has succeeded and Finish() has not been called.
+  // Returns InvalidArgument if key is not after every previously added key.
+  Status Put(const Slice& key, const Slice& value);
+
+  // Finish building the table and close the file.  A table with no
+  // entries cannot be ingested.
+  Status Finish();
+
+  // Size of the file generated so far.
+  uint64_t FileSize() const;
+
+ private:
+  struct Rep;
+  Rep* rep_;
+
+  // No copying allowed
+  SstFileWriter(const SstFileWriter&);
+  void operator=(const SstFileWriter&);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
@@ -39,6 +39,9 @@ class WriteBatch {
   // If the database contains a mapping for "key", erase it.  Else do nothing.
   void Delete(const Slice& key);
 
+  // Erase every mapping for a key in the range [start, end).
+  void DeleteRange(const Slice& start, const Slice& end);
+
   // Clear all updates buffered in this batch.
   void Clear();
 
@@ -48,6 +51,10 @@ class WriteBatch {
     virtual ~Handler();
     virtual void Put(const Slice& key, const Slice& value) = 0;
     virtual void Delete(const Slice& key) = 0;
+    // The default returns NotSupported, which stops Iterate() and is
+    // returned by it, so handlers written before range deletions existed
+    // do not silently skip them.
+    virtual Status DeleteRange(const Slice& start, const Slice& end);
   };
   Status Iterate(Handler* handler) const;
 
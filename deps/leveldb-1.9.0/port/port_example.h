@@ -42,6 +42,30 @@ class Mutex {
   void AssertHeld();
 };
 
+// A reader-writer lock.  Any number of threads may hold it in shared
+// mode at once, or a single thread may hold it exclusively.
+class RWMutex {
+ public:
+  RWMutex();
+  ~RWMutex();
+
+  // Lock the mutex in shared mode.  Waits while another thread holds
+  // it exclusively.
+  void ReadLock();
+
+  // Lock the mutex exclusively.  Waits until all other holders have
+  // exited.
+  void WriteLock();
+
+  // Release a shared or exclusive hold on the mutex.
+  // REQUIRES: This thread holds the mutex in the corresponding mode.
+  void ReadUnlock();
+  void WriteUnlock();
+
+  // Optionally crash if this thread does not hold this mutex.
+  void AssertHeld();
+};
+
 class CondVar {
  public:
   explicit CondVar(Mutex* mu);
@@ -97,6 +121,11 @@ class AtomicPointer {
 
   // Set va as the stored pointer with no ordering guarantees.
   void NoBarrier_Store(void* v);
+
+  // If the stored pointer equals "expected", replace it with v and
+  // return true.  Otherwise return false.  No memory access by this
+  // thread can be reordered across this operation.
+  bool CompareAndSwap(void* expected, void* v);
 };
 
 // ------------------ Compression -------------------
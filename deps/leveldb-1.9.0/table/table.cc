@@ -172,7 +172,9 @@ Iterator* Table::BlockReader(void* arg,
       EncodeFixed64(cache_key_buffer, table->rep_->cache_id);
       EncodeFixed64(cache_key_buffer+8, handle.offset());
       Slice key(cache_key_buffer, sizeof(cache_key_buffer));
-      cache_handle = block_cache->Lookup(key);
+      const Cache::Priority priority =
+          options.low_priority ? Cache::kLowPriority : Cache::kHighPriority;
+      cache_handle = block_cache->Lookup(key, priority);
       if (cache_handle != NULL) {
         block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
       } else {
@@ -181,7 +183,7 @@ Iterator* Table::BlockReader(void* arg,
           block = new Block(contents);
           if (contents.cachable && options.fill_cache) {
             cache_handle = block_cache->Insert(
-                key, block, block->size(), &DeleteCachedBlock);
+                key, block, block->size(), &DeleteCachedBlock, priority);
           }
         }
       }
@@ -208,9 +210,16 @@ Iterator* Table::BlockReader(void* arg,
 }
 
 Iterator* Table::NewIterator(const ReadOptions& options) const {
+  Iterator* readahead_iter = NULL;
+  if (options.readahead_blocks > 0) {
+    // BlockReader only reads state that is fixed once the table is open,
+    // so blocks can be read ahead from other threads.
+    readahead_iter = rep_->index_block->NewIterator(rep_->options.comparator);
+  }
   return NewTwoLevelIterator(
       rep_->index_block->NewIterator(rep_->options.comparator),
-      &Table::BlockReader, const_cast<Table*>(this), options);
+      &Table::BlockReader, const_cast<Table*>(this), options,
+      readahead_iter, rep_->options.env);
 }
 
 Status Table::InternalGet(const ReadOptions& options, const Slice& k,
@@ -4,10 +4,15 @@
 
 #include "table/two_level_iterator.h"
 
+#include <map>
+#include <set>
+#include "leveldb/env.h"
 #include "leveldb/table.h"
+#include "port/port.h"
 #include "table/block.h"
 #include "table/format.h"
 #include "table/iterator_wrapper.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
@@ -15,13 +20,19 @@ namespace {
 
 typedef Iterator* (*BlockFunction)(void*, const ReadOptions&, const Slice&);
 
+// Number of blocks an iterator must move forward over in a row before
+// it starts reading ahead
+static const int kReadaheadTrigger = 2;
+
 class TwoLevelIterator: public Iterator {
  public:
   TwoLevelIterator(
     Iterator* index_iter,
     BlockFunction block_function,
     void* arg,
-    const ReadOptions& options);
+    const ReadOptions& options,
+    Iterator* readahead_iter,
+    Env* env);
 
   virtual ~TwoLevelIterator();
 
@@ -62,6 +73,12 @@ class TwoLevelIterator: public Iterator {
   void SetDataIterator(Iterator* data_iter);
   void InitDataBlock();
 
+  // Read ahead of a forward scan
+  void ReadAhead();
+  void ResetReadahead();
+  Iterator* TakeReadaheadBlock(const Slice& handle);
+  static void BGReadBlock(void* arg);
+
   BlockFunction block_function_;
   void* arg_;
   const ReadOptions options_;
@@ -71,25 +88,74 @@ class TwoLevelIterator: public Iterator {
   // If data_iter_ is non-NULL, then "data_block_handle_" holds the
   // "index_value" passed to block_function_ to create the data_iter_.
   std::string data_block_handle_;
+
+  // State for reading ahead.  readahead_iter_ is NULL if disabled.
+  // Otherwise it is positioned at the last block read ahead once
+  // readahead_started_ is true.
+  Iterator* const readahead_iter_;
+  Env* const env_;
+  int sequential_blocks_;
+  bool readahead_started_;
+
+  // mu_ protects the following state
+  port::Mutex mu_;
+  port::CondVar cv_;
+  int pending_;  // Blocks being read in the background
+  // Blocks read ahead, keyed by index value.  The iterator is NULL
+  // while the block is still being read.
+  std::map<std::string, Iterator*> readahead_blocks_;
+  // Blocks that were still being read when readahead was reset.  They
+  // are not part of the current window and are deleted once read unless
+  // they are used meanwhile.
+  std::set<std::string> dropped_blocks_;
+};
+
+// A block to read in the Env::IO pool
+struct ReadaheadTask {
+  TwoLevelIterator* iter;
+  std::string handle;
 };
 
 TwoLevelIterator::TwoLevelIterator(
     Iterator* index_iter,
     BlockFunction block_function,
     void* arg,
-    const ReadOptions& options)
+    const ReadOptions& options,
+    Iterator* readahead_iter,
+    Env* env)
     : block_function_(block_function),
       arg_(arg),
       options_(options),
       index_iter_(index_iter),
-      data_iter_(NULL) {
+      data_iter_(NULL),
+      readahead_iter_(readahead_iter),
+      env_(env),
+      sequential_blocks_(0),
+      readahead_started_(false),
+      cv_(&mu_),
+      pending_(0) {
+  assert(readahead_iter_ == NULL || env_ != NULL);
 }
 
 TwoLevelIterator::~TwoLevelIterator() {
+  if (readahead_iter_ != NULL) {
+    // Background reads refer to this iterator and to arg_
+    MutexLock l(&mu_);
+    while (pending_ > 0) {
+      cv_.Wait();
+    }
+    for (std::map<std::string, Iterator*>::iterator it =
+             readahead_blocks_.begin();
+         it != readahead_blocks_.end(); ++it) {
+      delete it->second;
+    }
+  }
+  delete readahead_iter_;
 }
 
 void TwoLevelIterator::Seek(const Slice& target) {
   index_iter_.Seek(target);
+  ResetReadahead();
   InitDataBlock();
   if (data_iter_.iter() != NULL) data_iter_.Seek(target);
   SkipEmptyDataBlocksForward();
@@ -97,6 +163,7 @@ void TwoLevelIterator::Seek(const Slice& target) {
 
 void TwoLevelIterator::SeekToFirst() {
   index_iter_.SeekToFirst();
+  ResetReadahead();
   InitDataBlock();
   if (data_iter_.iter() != NULL) data_iter_.SeekToFirst();
   SkipEmptyDataBlocksForward();
@@ -104,6 +171,7 @@ void TwoLevelIterator::SeekToFirst() {
 
 void TwoLevelIterator::SeekToLast() {
   index_iter_.SeekToLast();
+  ResetReadahead();
   InitDataBlock();
   if (data_iter_.iter() != NULL) data_iter_.SeekToLast();
   SkipEmptyDataBlocksBackward();
@@ -132,6 +200,7 @@ void TwoLevelIterator::SkipEmptyDataBlocksForward() {
     index_iter_.Next();
     InitDataBlock();
     if (data_iter_.iter() != NULL) data_iter_.SeekToFirst();
+    ReadAhead();
   }
 }
 
@@ -143,6 +212,7 @@ void TwoLevelIterator::SkipEmptyDataBlocksBackward() {
       return;
     }
     index_iter_.Prev();
+    ResetReadahead();
     InitDataBlock();
     if (data_iter_.iter() != NULL) data_iter_.SeekToLast();
   }
@@ -162,21 +232,124 @@ void TwoLevelIterator::InitDataBlock() {
       // data_iter_ is already constructed with this iterator, so
       // no need to change anything
     } else {
-      Iterator* iter = (*block_function_)(arg_, options_, handle);
+      Iterator* iter = TakeReadaheadBlock(handle);
+      if (iter == NULL) {
+        iter = (*block_function_)(arg_, options_, handle);
+      }
       data_block_handle_.assign(handle.data(), handle.size());
       SetDataIterator(iter);
     }
   }
 }
 
+void TwoLevelIterator::ReadAhead() {
+  if (readahead_iter_ == NULL || !index_iter_.Valid() ||
+      ++sequential_blocks_ < kReadaheadTrigger) {
+    return;
+  }
+  if (!readahead_started_) {
+    readahead_iter_->Seek(index_iter_.key());
+    readahead_started_ = true;
+  }
+
+  // Keep up to options_.readahead_blocks blocks read or being read
+  MutexLock l(&mu_);
+  while (readahead_iter_->Valid() &&
+         readahead_blocks_.size() - dropped_blocks_.size() <
+             static_cast<size_t>(options_.readahead_blocks)) {
+    readahead_iter_->Next();
+    if (!readahead_iter_->Valid()) {
+      break;
+    }
+    ReadaheadTask* task = new ReadaheadTask;
+    task->iter = this;
+    task->handle = readahead_iter_->value().ToString();
+    if (readahead_blocks_.count(task->handle) > 0) {
+      // Still being read since before the last reset
+      dropped_blocks_.erase(task->handle);
+      delete task;
+      continue;
+    }
+    readahead_blocks_[task->handle] = NULL;
+    pending_++;
+    env_->Schedule(&TwoLevelIterator::BGReadBlock, task, Env::IO);
+  }
+}
+
+void TwoLevelIterator::ResetReadahead() {
+  if (readahead_iter_ == NULL) {
+    return;
+  }
+  sequential_blocks_ = 0;
+  readahead_started_ = false;
+
+  // Drop the blocks that have been read.  Blocks still being read are
+  // dropped once they are read unless they are used.
+  MutexLock l(&mu_);
+  std::map<std::string, Iterator*>::iterator it = readahead_blocks_.begin();
+  while (it != readahead_blocks_.end()) {
+    if (it->second != NULL) {
+      delete it->second;
+      readahead_blocks_.erase(it++);
+    } else {
+      dropped_blocks_.insert(it->first);
+      ++it;
+    }
+  }
+}
+
+Iterator* TwoLevelIterator::TakeReadaheadBlock(const Slice& handle) {
+  if (readahead_iter_ == NULL) {
+    return NULL;
+  }
+  MutexLock l(&mu_);
+  std::map<std::string, Iterator*>::iterator it =
+      readahead_blocks_.find(handle.ToString());
+  if (it == readahead_blocks_.end()) {
+    return NULL;
+  }
+  // Wait for the read instead of reading the block a second time
+  dropped_blocks_.erase(it->first);
+  while (it->second == NULL) {
+    cv_.Wait();
+  }
+  Iterator* result = it->second;
+  readahead_blocks_.erase(it);
+  return result;
+}
+
+void TwoLevelIterator::BGReadBlock(void* arg) {
+  ReadaheadTask* task = reinterpret_cast<ReadaheadTask*>(arg);
+  TwoLevelIterator* iter = task->iter;
+  Iterator* block =
+      (*iter->block_function_)(iter->arg_, iter->options_, task->handle);
+  assert(block != NULL);
+  {
+    MutexLock l(&iter->mu_);
+    if (iter->dropped_blocks_.erase(task->handle) > 0) {
+      // Deleted before pending_ drops since it may refer to arg_
+      iter->readahead_blocks_.erase(task->handle);
+      delete block;
+    } else {
+      iter->readahead_blocks_[task->handle] = block;
+    }
+    iter->pending_--;
+    iter->cv_.SignalAll();
+  }
+  delete task;
+}
+
 }  // namespace
 
 Iterator* NewTwoLevelIterator(
     Iterator* index_iter,
     BlockFunction block_function,
     void* arg,
-    const ReadOptions& options) {
-  return new TwoLevelIterator(index_iter, block_function, arg, options);
+    const ReadOptions& options,
+    Iterator* readahead_iter,
+    Env* env) {
+  return new TwoLevelIterator(index_iter, block_function, arg, options,
+                              readahead_iter, env);
 }
 
 }  // namespace leveldb
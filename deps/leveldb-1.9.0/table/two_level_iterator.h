@@ -9,6 +9,7 @@
 
 namespace leveldb {
 
+class Env;
 struct ReadOptions;
 
 // Return a new two level iterator.  A two-level iterator contains an
@@ -20,6 +21,15 @@ struct ReadOptions;
 //
 // Uses a supplied function to convert an index_iter value into
 // an iterator over the contents of the corresponding block.
+//
+// If "readahead_iter" is non-NULL it is a second iterator over the same
+// index, which is used to find the blocks that follow the current one.
+// Once the iterator has moved forward over a few blocks in a row,
+// "block_function" is called for up to options.readahead_blocks of the
+// following blocks in env's Env::IO pool, and the resulting iterators
+// are kept until they are reached.  "block_function" must then be safe
+// to call from several threads at once.  Takes ownership of
+// "readahead_iter".
 extern Iterator* NewTwoLevelIterator(
     Iterator* index_iter,
     Iterator* (*block_function)(
@@ -27,7 +37,9 @@ extern Iterator* NewTwoLevelIterator(
         const ReadOptions& options,
         const Slice& index_value),
     void* arg,
-    const ReadOptions& options);
+    const ReadOptions& options,
+    Iterator* readahead_iter = NULL,
+    Env* env = NULL);
 
 }  // namespace leveldb
 
@@ -5,6 +5,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <vector>
 
 #include "leveldb/cache.h"
 #include "port/port.h"
@@ -49,19 +50,21 @@ struct LRUHandle {
 // of porting hacks and is also faster than some of the built-in hash
 // table implementations in some of the compiler/runtime combinations
 // we have tested.  E.g., readrandom speeds up by ~5% over the g++
-// 4.4.3's builtin hashtable.
+// 4.4.3's builtin hashtable.  "H" is the entry type of a cache
+// implementation; it provides key(), hash and next_hash.
+template <typename H>
 class HandleTable {
  public:
   HandleTable() : length_(0), elems_(0), list_(NULL) { Resize(); }
   ~HandleTable() { delete[] list_; }
 
-  LRUHandle* Lookup(const Slice& key, uint32_t hash) {
+  H* Lookup(const Slice& key, uint32_t hash) {
     return *FindPointer(key, hash);
   }
 
-  LRUHandle* Insert(LRUHandle* h) {
-    LRUHandle** ptr = FindPointer(h->key(), h->hash);
-    LRUHandle* old = *ptr;
+  H* Insert(H* h) {
+    H** ptr = FindPointer(h->key(), h->hash);
+    H* old = *ptr;
     h->next_hash = (old == NULL ? NULL : old->next_hash);
     *ptr = h;
     if (old == NULL) {
@@ -75,9 +78,9 @@ class HandleTable {
     return old;
   }
 
-  LRUHandle* Remove(const Slice& key, uint32_t hash) {
-    LRUHandle** ptr = FindPointer(key, hash);
-    LRUHandle* result = *ptr;
+  H* Remove(const Slice& key, uint32_t hash) {
+    H** ptr = FindPointer(key, hash);
+    H* result = *ptr;
     if (result != NULL) {
       *ptr = result->next_hash;
       --elems_;
@@ -90,13 +93,13 @@ class HandleTable {
   // a linked list of cache entries that hash into the bucket.
   uint32_t length_;
   uint32_t elems_;
-  LRUHandle** list_;
+  H** list_;
 
   // Return a pointer to slot that points to a cache entry that
   // matches key/hash.  If there is no such cache entry, return a
   // pointer to the trailing slot in the corresponding linked list.
-  LRUHandle** FindPointer(const Slice& key, uint32_t hash) {
-    LRUHandle** ptr = &list_[hash & (length_ - 1)];
+  H** FindPointer(const Slice& key, uint32_t hash) {
+    H** ptr = &list_[hash & (length_ - 1)];
     while (*ptr != NULL &&
            ((*ptr)->hash != hash || key != (*ptr)->key())) {
       ptr = &(*ptr)->next_hash;
@@ -109,16 +112,16 @@ class HandleTable {
     while (new_length < elems_) {
       new_length *= 2;
     }
-    LRUHandle** new_list = new LRUHandle*[new_length];
+    H** new_list = new H*[new_length];
     memset(new_list, 0, sizeof(new_list[0]) * new_length);
     uint32_t count = 0;
     for (uint32_t i = 0; i < length_; i++) {
-      LRUHandle* h = list_[i];
+      H* h = list_[i];
       while (h != NULL) {
-        LRUHandle* next = h->next_hash;
+        H* next = h->next_hash;
         Slice key = h->key();
         uint32_t hash = h->hash;
-        LRUHandle** ptr = &new_list[hash & (new_length - 1)];
+        H** ptr = &new_list[hash & (new_length - 1)];
         h->next_hash = *ptr;
         *ptr = h;
         h = next;
@@ -144,14 +147,17 @@ class LRUCache {
   // Like Cache methods, but with an extra "hash" parameter.
   Cache::Handle* Insert(const Slice& key, uint32_t hash,
                         void* value, size_t charge,
-                        void (*deleter)(const Slice& key, void* value));
-  Cache::Handle* Lookup(const Slice& key, uint32_t hash);
+                        void (*deleter)(const Slice& key, void* value),
+                        Cache::Priority priority);
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash,
+                        Cache::Priority priority);
   void Release(Cache::Handle* handle);
   void Erase(const Slice& key, uint32_t hash);
 
  private:
   void LRU_Remove(LRUHandle* e);
   void LRU_Append(LRUHandle* e);
+  void LRU_Prepend(LRUHandle* e);
   void Unref(LRUHandle* e);
 
   // Initialized before use.
@@ -166,7 +172,7 @@ class LRUCache {
   // lru.prev is newest entry, lru.next is oldest entry.
   LRUHandle lru_;
 
-  HandleTable table_;
+  HandleTable<LRUHandle> table_;
 };
 
 LRUCache::LRUCache()
@@ -209,13 +215,24 @@ void LRUCache::LRU_Append(LRUHandle* e) {
   e->next->prev = e;
 }
 
-Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash) {
+void LRUCache::LRU_Prepend(LRUHandle* e) {
+  // Make "e" oldest entry by inserting just after lru_
+  e->next = lru_.next;
+  e->prev = &lru_;
+  e->prev->next = e;
+  e->next->prev = e;
+}
+
+Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash,
+                                Cache::Priority priority) {
   MutexLock l(&mutex_);
   LRUHandle* e = table_.Lookup(key, hash);
   if (e != NULL) {
     e->refs++;
-    LRU_Remove(e);
-    LRU_Append(e);
+    if (priority == Cache::kHighPriority) {
+      LRU_Remove(e);
+      LRU_Append(e);
+    }
   }
   return reinterpret_cast<Cache::Handle*>(e);
 }
@@ -227,7 +244,8 @@ void LRUCache::Release(Cache::Handle* handle) {
 
 Cache::Handle* LRUCache::Insert(
     const Slice& key, uint32_t hash, void* value, size_t charge,
-    void (*deleter)(const Slice& key, void* value)) {
+    void (*deleter)(const Slice& key, void* value),
+    Cache::Priority priority) {
   MutexLock l(&mutex_);
 
   LRUHandle* e = reinterpret_cast<LRUHandle*>(
@@ -239,7 +257,9 @@ Cache::Handle* LRUCache::Insert(
   e->hash = hash;
   e->refs = 2;  // One from LRUCache, one for the returned handle
   memcpy(e->key_data, key.data(), key.size());
-  LRU_Append(e);
+  if (priority == Cache::kHighPriority) {
+    LRU_Append(e);
+  }
   usage_ += charge;
 
   LRUHandle* old = table_.Insert(e);
@@ -255,6 +275,12 @@ Cache::Handle* LRUCache::Insert(
     Unref(old);
   }
 
+  if (priority == Cache::kLowPriority) {
+    // Make "e" the oldest entry once room has been made for it, so a
+    // scan keeps replacing its own entries instead of the newest ones.
+    LRU_Prepend(e);
+  }
+
   return reinterpret_cast<Cache::Handle*>(e);
 }
 
@@ -267,51 +293,300 @@ void LRUCache::Erase(const Slice& key, uint32_t hash) {
   }
 }
 
-static const int kNumShardBits = 4;
-static const int kNumShards = 1 << kNumShardBits;
+// CLOCK cache implementation
+
+// Entries are kept in a circular list that a clock hand sweeps over
+// when the cache needs room.  Each entry has a small usage count that
+// hits raise and the hand lowers; the hand evicts the first entry it
+// finds with a count of zero.  Lookups only read the hash table, so they
+// run under a shared lock and touch the entry through atomic words.
+static const uintptr_t kMaxClockUsage = 3;
+
+struct ClockHandle {
+  void* value;
+  void (*deleter)(const Slice&, void* value);
+  ClockHandle* next_hash;
+  ClockHandle* next;
+  ClockHandle* prev;
+  size_t charge;
+  size_t key_length;
+  port::AtomicPointer refs;   // Holds a uintptr_t count
+  port::AtomicPointer usage;  // Holds a uintptr_t count
+  uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
+  char key_data[1];   // Beginning of key
+
+  Slice key() const {
+    return Slice(key_data, key_length);
+  }
+};
+
+static inline uintptr_t LoadCount(const port::AtomicPointer* p) {
+  return reinterpret_cast<uintptr_t>(p->NoBarrier_Load());
+}
+
+// Add "delta" to the count held in *p and return the new count.
+static inline uintptr_t AddToCount(port::AtomicPointer* p, int delta) {
+  while (true) {
+    void* old = p->Acquire_Load();
+    void* v = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(old) + delta);
+    if (p->CompareAndSwap(old, v)) {
+      return reinterpret_cast<uintptr_t>(v);
+    }
+  }
+}
+
+// A single shard of sharded cache.
+class ClockCache {
+ public:
+  ClockCache();
+  ~ClockCache();
+
+  // Separate from constructor so caller can easily make an array of ClockCache
+  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+
+  // Like Cache methods, but with an extra "hash" parameter.
+  Cache::Handle* Insert(const Slice& key, uint32_t hash,
+                        void* value, size_t charge,
+                        void (*deleter)(const Slice& key, void* value),
+                        Cache::Priority priority);
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash,
+                        Cache::Priority priority);
+  void Release(Cache::Handle* handle);
+  void Erase(const Slice& key, uint32_t hash);
 
-class ShardedLRUCache : public Cache {
  private:
-  LRUCache shard_[kNumShards];
-  port::Mutex id_mutex_;
-  uint64_t last_id_;
+  void Ring_Remove(ClockHandle* e);
+  void Ring_Insert(ClockHandle* e, ClockHandle* before);
+  void Unref(ClockHandle* e);
+
+  // Initialized before use.
+  size_t capacity_;
+
+  // mutex_ protects the following state.  Lookups only hold it in
+  // shared mode; every change to the table or the ring holds it
+  // exclusively.
+  port::RWMutex mutex_;
+  size_t usage_;
+
+  // Dummy head of the ring, which the hand skips over.
+  ClockHandle ring_;
 
-  static inline uint32_t HashSlice(const Slice& s) {
-    return Hash(s.data(), s.size(), 0);
+  // Next entry the hand will examine.
+  ClockHandle* hand_;
+
+  HandleTable<ClockHandle> table_;
+};
+
+ClockCache::ClockCache()
+    : usage_(0) {
+  // Make empty circular linked list
+  ring_.next = &ring_;
+  ring_.prev = &ring_;
+  hand_ = &ring_;
+}
+
+ClockCache::~ClockCache() {
+  for (ClockHandle* e = ring_.next; e != &ring_; ) {
+    ClockHandle* next = e->next;
+    assert(LoadCount(&e->refs) == 1);  // Error if caller has an unreleased handle
+    Unref(e);
+    e = next;
   }
+}
 
-  static uint32_t Shard(uint32_t hash) {
-    return hash >> (32 - kNumShardBits);
+void ClockCache::Unref(ClockHandle* e) {
+  // The cache holds a reference for as long as "e" is in table_, so the
+  // count can only reach zero once "e" can no longer be looked up.
+  if (AddToCount(&e->refs, -1) == 0) {
+    (*e->deleter)(e->key(), e->value);
+    free(e);
   }
+}
+
+void ClockCache::Ring_Remove(ClockHandle* e) {
+  if (hand_ == e) {
+    hand_ = e->next;
+  }
+  e->next->prev = e->prev;
+  e->prev->next = e->next;
+}
+
+void ClockCache::Ring_Insert(ClockHandle* e, ClockHandle* before) {
+  e->next = before;
+  e->prev = before->prev;
+  e->prev->next = e;
+  e->next->prev = e;
+}
+
+Cache::Handle* ClockCache::Lookup(const Slice& key, uint32_t hash,
+                                  Cache::Priority priority) {
+  ReadLock l(&mutex_);
+  ClockHandle* e = table_.Lookup(key, hash);
+  if (e != NULL) {
+    AddToCount(&e->refs, 1);
+    // Concurrent hits may lose an increment, which only makes the
+    // entry look slightly colder than it is.
+    const uintptr_t usage = LoadCount(&e->usage);
+    if (priority == Cache::kHighPriority && usage < kMaxClockUsage) {
+      e->usage.NoBarrier_Store(reinterpret_cast<void*>(usage + 1));
+    }
+  }
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void ClockCache::Release(Cache::Handle* handle) {
+  Unref(reinterpret_cast<ClockHandle*>(handle));
+}
+
+Cache::Handle* ClockCache::Insert(
+    const Slice& key, uint32_t hash, void* value, size_t charge,
+    void (*deleter)(const Slice& key, void* value),
+    Cache::Priority priority) {
+  ClockHandle* e = reinterpret_cast<ClockHandle*>(
+      malloc(sizeof(ClockHandle)-1 + key.size()));
+  e->value = value;
+  e->deleter = deleter;
+  e->charge = charge;
+  e->key_length = key.size();
+  e->hash = hash;
+  e->refs.NoBarrier_Store(reinterpret_cast<void*>(2));  // Cache and handle
+  memcpy(e->key_data, key.data(), key.size());
+
+  std::vector<ClockHandle*> evicted;
+  {
+    WriteLock l(&mutex_);
+    usage_ += charge;
+
+    ClockHandle* old = table_.Insert(e);
+    if (old != NULL) {
+      Ring_Remove(old);
+      usage_ -= old->charge;
+      evicted.push_back(old);
+    }
+
+    // "e" joins the ring only after room has been made for it, so an
+    // entry is never evicted by its own insertion.  Each sweep lowers
+    // every usage count, so this ends after at most kMaxClockUsage + 1
+    // sweeps.
+    while (usage_ > capacity_ && ring_.next != &ring_) {
+      if (hand_ == &ring_) {
+        hand_ = ring_.next;
+      }
+      ClockHandle* victim = hand_;
+      const uintptr_t count = LoadCount(&victim->usage);
+      if (count > 0) {
+        victim->usage.NoBarrier_Store(reinterpret_cast<void*>(count - 1));
+        hand_ = victim->next;
+        continue;
+      }
+      Ring_Remove(victim);
+      table_.Remove(victim->key(), victim->hash);
+      usage_ -= victim->charge;
+      evicted.push_back(victim);
+    }
+
+    if (usage_ > capacity_) {
+      // "e" is larger than the whole shard
+      table_.Remove(key, hash);
+      usage_ -= charge;
+      evicted.push_back(e);
+    } else if (priority == Cache::kHighPriority) {
+      // Place the entry just behind the hand so it is examined last.
+      e->usage.NoBarrier_Store(reinterpret_cast<void*>(1));
+      Ring_Insert(e, hand_);
+    } else {
+      // Place the entry under the hand so it is the next one evicted
+      // unless it is hit first.  A scan keeps replacing its own entries
+      // instead of sweeping the whole ring.
+      e->usage.NoBarrier_Store(NULL);
+      Ring_Insert(e, hand_);
+      hand_ = e;
+    }
+  }
+
+  // Run the deleters of the evicted entries without holding the lock.
+  for (size_t i = 0; i < evicted.size(); i++) {
+    Unref(evicted[i]);
+  }
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void ClockCache::Erase(const Slice& key, uint32_t hash) {
+  ClockHandle* e;
+  {
+    WriteLock l(&mutex_);
+    e = table_.Remove(key, hash);
+    if (e != NULL) {
+      Ring_Remove(e);
+      usage_ -= e->charge;
+    }
+  }
+  if (e != NULL) {
+    Unref(e);
+  }
+}
+
+static const int kNumShardBits = 4;
+
+static inline uint32_t HashSlice(const Slice& s) {
+  return Hash(s.data(), s.size(), 0);
+}
+
+// Shards are picked by the top "num_shard_bits" bits of the hash.
+static inline uint32_t Shard(uint32_t hash, int num_shard_bits) {
+  return (num_shard_bits > 0) ? (hash >> (32 - num_shard_bits)) : 0;
+}
+
+template <typename S, typename H>
+class ShardedCache : public Cache {
+ private:
+  const int num_shard_bits_;
+  S* shard_;
+  port::Mutex id_mutex_;
+  uint64_t last_id_;
 
  public:
-  explicit ShardedLRUCache(size_t capacity)
-      : last_id_(0) {
-    const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
-    for (int s = 0; s < kNumShards; s++) {
+  ShardedCache(size_t capacity, int num_shard_bits)
+      : num_shard_bits_(num_shard_bits),
+        last_id_(0) {
+    const int num_shards = 1 << num_shard_bits;
+    const size_t per_shard = (capacity + (num_shards - 1)) / num_shards;
+    shard_ = new S[num_shards];
+    for (int s = 0; s < num_shards; s++) {
       shard_[s].SetCapacity(per_shard);
     }
   }
-  virtual ~ShardedLRUCache() { }
+  virtual ~ShardedCache() {
+    delete[] shard_;
+  }
   virtual Handle* Insert(const Slice& key, void* value, size_t charge,
                          void (*deleter)(const Slice& key, void* value)) {
+    return Insert(key, value, charge, deleter, kHighPriority);
+  }
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value),
+                         Priority priority) {
     const uint32_t hash = HashSlice(key);
-    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+    return shard_[Shard(hash, num_shard_bits_)].Insert(
+        key, hash, value, charge, deleter, priority);
   }
   virtual Handle* Lookup(const Slice& key) {
+    return Lookup(key, kHighPriority);
+  }
+  virtual Handle* Lookup(const Slice& key, Priority priority) {
     const uint32_t hash = HashSlice(key);
-    return shard_[Shard(hash)].Lookup(key, hash);
+    return shard_[Shard(hash, num_shard_bits_)].Lookup(key, hash, priority);
   }
   virtual void Release(Handle* handle) {
-    LRUHandle* h = reinterpret_cast<LRUHandle*>(handle);
-    shard_[Shard(h->hash)].Release(handle);
+    H* h = reinterpret_cast<H*>(handle);
+    shard_[Shard(h->hash, num_shard_bits_)].Release(handle);
   }
   virtual void Erase(const Slice& key) {
     const uint32_t hash = HashSlice(key);
-    shard_[Shard(hash)].Erase(key, hash);
+    shard_[Shard(hash, num_shard_bits_)].Erase(key, hash);
   }
   virtual void* Value(Handle* handle) {
-    return reinterpret_cast<LRUHandle*>(handle)->value;
+    return reinterpret_cast<H*>(handle)->value;
   }
   virtual uint64_t NewId() {
     MutexLock l(&id_mutex_);
@@ -322,7 +597,17 @@ class ShardedLRUCache : public Cache {
 }  // end anonymous namespace
 
 Cache* NewLRUCache(size_t capacity) {
-  return new ShardedLRUCache(capacity);
+  return NewLRUCache(capacity, kNumShardBits);
+}
+
+Cache* NewLRUCache(size_t capacity, int num_shard_bits) {
+  assert(num_shard_bits >= 0 && num_shard_bits < 20);
+  return new ShardedCache<LRUCache, LRUHandle>(capacity, num_shard_bits);
+}
+
+Cache* NewClockCache(size_t capacity, int num_shard_bits) {
+  assert(num_shard_bits >= 0 && num_shard_bits < 20);
+  return new ShardedCache<ClockCache, ClockHandle>(capacity, num_shard_bits);
 }
 
 }  // namespace leveldb
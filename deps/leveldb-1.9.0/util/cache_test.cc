@@ -45,8 +45,9 @@ class CacheTest {
     delete cache_;
   }
 
-  int Lookup(int key) {
-    Cache::Handle* handle = cache_->Lookup(EncodeKey(key));
+  int Lookup(int key,
+             Cache::Priority priority = Cache::kHighPriority) {
+    Cache::Handle* handle = cache_->Lookup(EncodeKey(key), priority);
     const int r = (handle == NULL) ? -1 : DecodeValue(cache_->Value(handle));
     if (handle != NULL) {
       cache_->Release(handle);
@@ -54,9 +55,23 @@ class CacheTest {
     return r;
   }
 
-  void Insert(int key, int value, int charge = 1) {
+  void Insert(int key, int value, int charge = 1,
+              Cache::Priority priority = Cache::kHighPriority) {
     cache_->Release(cache_->Insert(EncodeKey(key), EncodeValue(value), charge,
-                                   &CacheTest::Deleter));
+                                   &CacheTest::Deleter, priority));
+  }
+
+  // Fill half of the cache with entries that are used twice, then scan
+  // many more entries than the cache holds at low priority.
+  void Scan() {
+    for (int i = 0; i < kCacheSize / 2; i++) {
+      Insert(i, 1000+i);
+      ASSERT_EQ(1000+i, Lookup(i));
+    }
+    for (int i = 0; i < 10 * kCacheSize; i++) {
+      Insert(100000+i, 200000+i, 1, Cache::kLowPriority);
+      ASSERT_EQ(200000+i, Lookup(100000+i, Cache::kLowPriority));
+    }
   }
 
   void Erase(int key) {
@@ -179,6 +194,147 @@ TEST(CacheTest, NewId) {
   ASSERT_NE(a, b);
 }
 
+TEST(CacheTest, LowPriorityScan) {
+  Scan();
+  for (int i = 0; i < kCacheSize / 2; i++) {
+    ASSERT_EQ(1000+i, Lookup(i));
+  }
+}
+
+TEST(CacheTest, SingleShard) {
+  delete cache_;
+  cache_ = NewLRUCache(kCacheSize, 0);
+  for (int i = 0; i < kCacheSize; i++) {
+    Insert(i, 1000+i);
+  }
+  ASSERT_EQ(0, deleted_keys_.size());
+  Insert(kCacheSize, 1000+kCacheSize);
+  ASSERT_EQ(1, deleted_keys_.size());
+  ASSERT_EQ(0, deleted_keys_[0]);
+  ASSERT_EQ(-1, Lookup(0));
+}
+
+class ClockCacheTest : public CacheTest {
+ public:
+  ClockCacheTest() {
+    delete cache_;
+    cache_ = NewClockCache(kCacheSize, 4);
+  }
+};
+
+TEST(ClockCacheTest, ClockHitAndMiss) {
+  ASSERT_EQ(-1, Lookup(100));
+
+  Insert(100, 101);
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(-1,  Lookup(200));
+
+  Insert(200, 201);
+  Insert(100, 102);
+  ASSERT_EQ(102, Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+
+  ASSERT_EQ(1, deleted_keys_.size());
+  ASSERT_EQ(100, deleted_keys_[0]);
+  ASSERT_EQ(101, deleted_values_[0]);
+}
+
+TEST(ClockCacheTest, ClockErase) {
+  Insert(100, 101);
+  Insert(200, 201);
+  Erase(100);
+  ASSERT_EQ(-1,  Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+  ASSERT_EQ(1, deleted_keys_.size());
+
+  Erase(100);
+  ASSERT_EQ(1, deleted_keys_.size());
+}
+
+TEST(ClockCacheTest, ClockEntriesArePinned) {
+  Insert(100, 101);
+  Cache::Handle* h1 = cache_->Lookup(EncodeKey(100));
+  Insert(100, 102);
+  Cache::Handle* h2 = cache_->Lookup(EncodeKey(100));
+  ASSERT_EQ(101, DecodeValue(cache_->Value(h1)));
+  ASSERT_EQ(102, DecodeValue(cache_->Value(h2)));
+  ASSERT_EQ(0, deleted_keys_.size());
+
+  cache_->Release(h1);
+  ASSERT_EQ(1, deleted_keys_.size());
+  ASSERT_EQ(101, deleted_values_[0]);
+
+  Erase(100);
+  ASSERT_EQ(-1, Lookup(100));
+  ASSERT_EQ(1, deleted_keys_.size());
+
+  cache_->Release(h2);
+  ASSERT_EQ(2, deleted_keys_.size());
+  ASSERT_EQ(102, deleted_values_[1]);
+}
+
+TEST(ClockCacheTest, ClockEvictionPolicy) {
+  Insert(100, 101);
+  Insert(200, 201);
+
+  // Frequently used entry must be kept around
+  for (int i = 0; i < 2 * kCacheSize; i++) {
+    Insert(1000+i, 2000+i);
+    ASSERT_EQ(2000+i, Lookup(1000+i));
+    ASSERT_EQ(101, Lookup(100));
+  }
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(-1, Lookup(200));
+}
+
+TEST(ClockCacheTest, ClockHeavyEntries) {
+  const int kLight = 1;
+  const int kHeavy = 10;
+  int added = 0;
+  int index = 0;
+  while (added < 2*kCacheSize) {
+    const int weight = (index & 1) ? kLight : kHeavy;
+    Insert(index, 1000+index, weight);
+    added += weight;
+    index++;
+  }
+
+  int cached_weight = 0;
+  for (int i = 0; i < index; i++) {
+    const int weight = (i & 1 ? kLight : kHeavy);
+    int r = Lookup(i);
+    if (r >= 0) {
+      cached_weight += weight;
+      ASSERT_EQ(1000+i, r);
+    }
+  }
+  ASSERT_LE(cached_weight, kCacheSize + kCacheSize/10);
+}
+
+TEST(ClockCacheTest, ScanResistance) {
+  Scan();
+  for (int i = 0; i < kCacheSize / 2; i++) {
+    ASSERT_EQ(1000+i, Lookup(i));
+  }
+}
+
+TEST(ClockCacheTest, LowPriorityHitsDoNotPromote) {
+  // A single shard makes the sweep order predictable.
+  delete cache_;
+  cache_ = NewClockCache(kCacheSize, 0);
+  Insert(100, 101, 1, Cache::kLowPriority);
+  Insert(200, 201, 1, Cache::kLowPriority);
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ(101, Lookup(100, Cache::kLowPriority));
+    ASSERT_EQ(201, Lookup(200));
+  }
+  for (int i = 0; i < kCacheSize; i++) {
+    Insert(1000+i, 2000+i);
+  }
+  ASSERT_EQ(-1, Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
@@ -538,7 +538,9 @@ class PosixEnv : public Env {
     return result;
   }
 
-  virtual void Schedule(void (*function)(void*), void* arg);
+  virtual void Schedule(void (*function)(void*), void* arg, Priority pri);
+
+  virtual void SetBackgroundThreads(int number, Priority pri);
 
   virtual void StartThread(void (*function)(void* arg), void* arg);
 
@@ -592,70 +594,109 @@ class PosixEnv : public Env {
     }
   }
 
-  // BGThread() is the body of the background thread
-  void BGThread();
+  // Entry per Schedule() call
+  struct BGItem { void* arg; void (*function)(void*); };
+  typedef std::deque<BGItem> BGQueue;
+
+  // A pool of background threads that run the work of one priority.
+  // Threads are started lazily as work is scheduled, up to "max_threads".
+  struct BGPool {
+    PosixEnv* env;
+    pthread_cond_t bgsignal;
+    BGQueue queue;
+    int max_threads;
+    int started_threads;
+    int idle_threads;
+  };
+
+  // Starts another thread for the pool unless it is at its limit.
+  // REQUIRES: mu_ is held
+  void MaybeStartThread(BGPool* pool);
+
+  // BGThread() is the body of each background thread
+  void BGThread(BGPool* pool);
   static void* BGThreadWrapper(void* arg) {
-    reinterpret_cast<PosixEnv*>(arg)->BGThread();
+    BGPool* pool = reinterpret_cast<BGPool*>(arg);
+    pool->env->BGThread(pool);
     return NULL;
   }
 
   size_t page_size_;
   pthread_mutex_t mu_;
-  pthread_cond_t bgsignal_;
-  pthread_t bgthread_;
-  bool started_bgthread_;
-
-  // Entry per Schedule() call
-  struct BGItem { void* arg; void (*function)(void*); };
-  typedef std::deque<BGItem> BGQueue;
-  BGQueue queue_;
+  BGPool pools_[TOTAL];
 
   PosixLockTable locks_;
   MmapLimiter mmap_limit_;
 };
 
-PosixEnv::PosixEnv() : page_size_(getpagesize()),
-                       started_bgthread_(false) {
+PosixEnv::PosixEnv() : page_size_(getpagesize()) {
   PthreadCall("mutex_init", pthread_mutex_init(&mu_, NULL));
-  PthreadCall("cvar_init", pthread_cond_init(&bgsignal_, NULL));
+  for (int pri = 0; pri < TOTAL; pri++) {
+    BGPool* pool = &pools_[pri];
+    PthreadCall("cvar_init", pthread_cond_init(&pool->bgsignal, NULL));
+    pool->env = this;
+    pool->max_threads = 1;
+    pool->started_threads = 0;
+    pool->idle_threads = 0;
+  }
 }
 
-void PosixEnv::Schedule(void (*function)(void*), void* arg) {
+void PosixEnv::Schedule(void (*function)(void*), void* arg, Priority pri) {
   PthreadCall("lock", pthread_mutex_lock(&mu_));
+  BGPool* pool = &pools_[pri];
 
-  // Start background thread if necessary
-  if (!started_bgthread_) {
-    started_bgthread_ = true;
-    PthreadCall(
-        "create thread",
-        pthread_create(&bgthread_, NULL,  &PosixEnv::BGThreadWrapper, this));
-  }
+  // Add to the pool's queue
+  pool->queue.push_back(BGItem());
+  pool->queue.back().function = function;
+  pool->queue.back().arg = arg;
 
-  // If the queue is currently empty, the background thread may currently be
-  // waiting.
-  if (queue_.empty()) {
-    PthreadCall("signal", pthread_cond_signal(&bgsignal_));
+  // Start another thread if there is more work waiting than idle threads
+  // to pick it up, then wake up an idle thread.
+  if (pool->queue.size() > static_cast<size_t>(pool->idle_threads)) {
+    MaybeStartThread(pool);
   }
+  PthreadCall("signal", pthread_cond_signal(&pool->bgsignal));
 
-  // Add to priority queue
-  queue_.push_back(BGItem());
-  queue_.back().function = function;
-  queue_.back().arg = arg;
+  PthreadCall("unlock", pthread_mutex_unlock(&mu_));
+}
+
+void PosixEnv::SetBackgroundThreads(int number, Priority pri) {
+  PthreadCall("lock", pthread_mutex_lock(&mu_));
+  BGPool* pool = &pools_[pri];
+  pool->max_threads = std::max(number, 1);
 
+  // Start threads for any work that is already waiting.  Threads that were
+  // started before the pool was shrunk keep running.
+  for (size_t i = pool->idle_threads; i < pool->queue.size(); i++) {
+    MaybeStartThread(pool);
+  }
   PthreadCall("unlock", pthread_mutex_unlock(&mu_));
 }
 
-void PosixEnv::BGThread() {
+void PosixEnv::MaybeStartThread(BGPool* pool) {
+  if (pool->started_threads < pool->max_threads) {
+    pool->started_threads++;
+    pthread_t t;
+    PthreadCall(
+        "create thread",
+        pthread_create(&t, NULL,  &PosixEnv::BGThreadWrapper, pool));
+    PthreadCall("detach thread", pthread_detach(t));
+  }
+}
+
+void PosixEnv::BGThread(BGPool* pool) {
   while (true) {
     // Wait until there is an item that is ready to run
     PthreadCall("lock", pthread_mutex_lock(&mu_));
-    while (queue_.empty()) {
-      PthreadCall("wait", pthread_cond_wait(&bgsignal_, &mu_));
+    pool->idle_threads++;
+    while (pool->queue.empty()) {
+      PthreadCall("wait", pthread_cond_wait(&pool->bgsignal, &mu_));
     }
+    pool->idle_threads--;
 
-    void (*function)(void*) = queue_.front().function;
-    void* arg = queue_.front().arg;
-    queue_.pop_front();
+    void (*function)(void*) = pool->queue.front().function;
+    void* arg = pool->queue.front().arg;
+    pool->queue.pop_front();
 
     PthreadCall("unlock", pthread_mutex_unlock(&mu_));
     (*function)(arg);
@@ -97,6 +97,60 @@ TEST(EnvPosixTest, StartThread) {
   ASSERT_EQ(state.val, 3);
 }
 
+// Blocks until every waiter has arrived.
+struct Barrier {
+  port::Mutex mu;
+  port::CondVar cv;
+  int waiting;
+  Barrier(int n) : cv(&mu), waiting(n) { }
+};
+
+static void WaitAtBarrier(void* arg) {
+  Barrier* b = reinterpret_cast<Barrier*>(arg);
+  b->mu.Lock();
+  b->waiting--;
+  b->cv.SignalAll();
+  while (b->waiting > 0) {
+    b->cv.Wait();
+  }
+  b->mu.Unlock();
+}
+
+TEST(EnvPosixTest, RunHighPriorityAlongsideLow) {
+  // The low priority work only finishes once the high priority work runs.
+  Barrier barrier(2);
+  env_->Schedule(&WaitAtBarrier, &barrier, Env::LOW);
+  env_->Schedule(&WaitAtBarrier, &barrier, Env::HIGH);
+  Env::Default()->SleepForMicroseconds(kDelayMicros);
+  barrier.mu.Lock();
+  ASSERT_EQ(barrier.waiting, 0);
+  barrier.mu.Unlock();
+}
+
+TEST(EnvPosixTest, RunIOAlongsideBackgroundWork) {
+  Barrier barrier(3);
+  env_->Schedule(&WaitAtBarrier, &barrier, Env::LOW);
+  env_->Schedule(&WaitAtBarrier, &barrier, Env::HIGH);
+  env_->Schedule(&WaitAtBarrier, &barrier, Env::IO);
+  Env::Default()->SleepForMicroseconds(kDelayMicros);
+  barrier.mu.Lock();
+  ASSERT_EQ(barrier.waiting, 0);
+  barrier.mu.Unlock();
+}
+
+TEST(EnvPosixTest, SetBackgroundThreads) {
+  // Three high priority items that wait for each other need three threads.
+  env_->SetBackgroundThreads(3, Env::HIGH);
+  Barrier barrier(3);
+  for (int i = 0; i < 3; i++) {
+    env_->Schedule(&WaitAtBarrier, &barrier, Env::HIGH);
+  }
+  Env::Default()->SleepForMicroseconds(kDelayMicros);
+  barrier.mu.Lock();
+  ASSERT_EQ(barrier.waiting, 0);
+  barrier.mu.Unlock();
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
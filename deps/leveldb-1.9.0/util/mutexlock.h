@@ -35,6 +35,38 @@ class SCOPED_LOCKABLE MutexLock {
   void operator=(const MutexLock&);
 };
 
+// Like MutexLock, but holds a reader-writer lock in shared mode.
+class SCOPED_LOCKABLE ReadLock {
+ public:
+  explicit ReadLock(port::RWMutex *mu) SHARED_LOCK_FUNCTION(mu)
+      : mu_(mu)  {
+    this->mu_->ReadLock();
+  }
+  ~ReadLock() UNLOCK_FUNCTION() { this->mu_->ReadUnlock(); }
+
+ private:
+  port::RWMutex *const mu_;
+  // No copying allowed
+  ReadLock(const ReadLock&);
+  void operator=(const ReadLock&);
+};
+
+// Like MutexLock, but holds a reader-writer lock exclusively.
+class SCOPED_LOCKABLE WriteLock {
+ public:
+  explicit WriteLock(port::RWMutex *mu) EXCLUSIVE_LOCK_FUNCTION(mu)
+      : mu_(mu)  {
+    this->mu_->WriteLock();
+  }
+  ~WriteLock() UNLOCK_FUNCTION() { this->mu_->WriteUnlock(); }
+
+ private:
+  port::RWMutex *const mu_;
+  // No copying allowed
+  WriteLock(const WriteLock&);
+  void operator=(const WriteLock&);
+};
+
 }  // namespace leveldb
 
 
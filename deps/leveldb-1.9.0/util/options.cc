@@ -19,10 +19,19 @@ Options::Options()
       write_buffer_size(4<<20),
       max_open_files(1000),
       block_cache(NULL),
+      cache_type(kLRUCache),
+      cache_shard_bits(4),
       block_size(4096),
       block_restart_interval(16),
       compression(kSnappyCompression),
-      filter_policy(NULL) {
+      filter_policy(NULL),
+      compaction_filter(NULL),
+      max_subcompactions(1),
+      concurrent_memtable_writes(true),
+      pipelined_writes(false),
+      min_blob_size(0),
+      blob_cache(NULL),
+      blob_gc_age_cutoff(0.25) {
 }
 
 
@@ -8,6 +8,7 @@ import (
 	"os"
 	"os/signal"
 	"runtime"
+	"time"
 )
 
 //------------------------------------------------------------------------------
@@ -19,11 +20,15 @@ import (
 const (
 	defaultPort = 8585
 	defaultDataDir = "/var/lib/sky"
+	defaultQueryCacheSize = 64
+	defaultQueryCacheStaleness = 0
 )
 
 const (
 	portUsage = "the port to listen on"
 	dataDirUsage = "the data directory"
+	queryCacheSizeUsage = "the query cache size in megabytes (0 disables it)"
+	queryCacheStalenessUsage = "the number of seconds a cached query result can be served after its table changes"
 )
 
 const (
@@ -38,6 +43,8 @@ const (
 
 var port uint
 var dataDir string
+var queryCacheSize uint
+var queryCacheStaleness uint
 
 //------------------------------------------------------------------------------
 //
@@ -54,6 +61,8 @@ func init() {
 	flag.UintVar(&port, "p", defaultPort, portUsage+"(shorthand)")
 	flag.StringVar(&dataDir, "data-dir", defaultDataDir, dataDirUsage)
 	flag.StringVar(&dataDir, "d", defaultDataDir, dataDirUsage+"(shorthand)")
+	flag.UintVar(&queryCacheSize, "query-cache-size", defaultQueryCacheSize, queryCacheSizeUsage)
+	flag.UintVar(&queryCacheStaleness, "query-cache-staleness", defaultQueryCacheStaleness, queryCacheStalenessUsage)
 }
 
 //--------------------------------------
@@ -69,6 +78,8 @@ func main() {
 	
 	// Initialize
 	server := skyd.NewServer(port, dataDir)
+	server.QueryCache().SetMaxSize(int(queryCacheSize) * 1024 * 1024)
+	server.QueryCache().SetStaleness(time.Duration(queryCacheStaleness) * time.Second)
 	writePidFile()
 	//setupSignalHandlers(server)
 	
@@ -24,3 +24,14 @@ func condenseUint64(value uint64, offset uint) uint32 {
 	}
 	return ret
 }
+
+// Scrambles the bits of a 64-bit hash so that every output bit depends on
+// every input bit. This uses the MurmurHash3 64-bit finalizer.
+func MixUint64(value uint64) uint64 {
+	value ^= value >> 33
+	value *= 0xff51afd7ed558ccd
+	value ^= value >> 33
+	value *= 0xc4ceb9fe1a85ec53
+	value ^= value >> 33
+	return value
+}
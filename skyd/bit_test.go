@@ -24,6 +24,16 @@ func TestCondenseUint64Odd(t *testing.T) {
 	}
 }
 
+// Ensure that mixing spreads small input differences across all bits.
+func TestMixUint64(t *testing.T) {
+	if MixUint64(0x0) != 0x0 {
+		t.Fatalf("MixUint64: expected %x, got %x", 0x0, MixUint64(0x0))
+	}
+	if MixUint64(0x1)>>32 == MixUint64(0x2)>>32 {
+		t.Fatalf("MixUint64: high bits not mixed: %x, %x", MixUint64(0x1), MixUint64(0x2))
+	}
+}
+
 func BenchmarkCondenseUint64(b *testing.B) {
 	for i := 0; i < b.N; i++ {
 		CondenseUint64Odd(0x58AB)
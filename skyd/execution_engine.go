@@ -30,9 +30,12 @@ import (
 	"fmt"
 	"github.com/jmhodges/levigo"
 	"github.com/ugorji/go-msgpack"
+	"hash/fnv"
 	"regexp"
 	"sort"
+	"strings"
 	"text/template"
+	"time"
 	"unsafe"
 )
 
@@ -46,6 +49,12 @@ import (
 type ExecutionEngine struct {
 	tableName    string
 	iterator     *levigo.Iterator
+	objects      [][]byte
+	keys         [][]byte
+	objectKeys   [][]byte
+	lookup       bool
+	key          []byte
+	sample       uint64
 	cursor       *C.sky_cursor
 	prefix       []byte
 	state        *C.lua_State
@@ -153,6 +162,73 @@ func (e *ExecutionEngine) SetIterator(iterator *levigo.Iterator) error {
 	return nil
 }
 
+// Restricts iteration to a sorted list of object keys. Each object is read
+// by seeking the iterator to its key instead of scanning the table so the
+// cost is proportional to the number of keys.
+func (e *ExecutionEngine) SetObjectKeys(keys [][]byte) {
+	e.objectKeys = keys
+	e.lookup = (keys != nil)
+}
+
+// Restricts iteration to a fraction of the objects. Objects are selected by
+// the odd bits of the mixed FNV-1a hash of their key so the choice is
+// independent of which servlet the object is stored on.
+func (e *ExecutionEngine) SetSample(sample float64) {
+	if sample > 0 && sample < 1 {
+		e.sample = uint64(sample * (1 << 32))
+	} else {
+		e.sample = 0
+	}
+}
+
+// Sets the location that the cursor aligns time buckets to.
+func (e *ExecutionEngine) SetLocation(location *time.Location) error {
+	if location == nil || location == time.UTC {
+		C.sky_cursor_set_timezone(e.cursor, 0, nil, nil)
+		return nil
+	}
+	t := GetTimezoneTransitions(location)
+	if C.sky_cursor_set_timezone(e.cursor, C.uint32_t(len(t.Starts)), (*C.int64_t)(unsafe.Pointer(&t.Starts[0])), (*C.int32_t)(unsafe.Pointer(&t.Offsets[0]))) != 0 {
+		return errors.New("skyd.ExecutionEngine: Unable to set timezone")
+	}
+	return nil
+}
+
+// Checks if an object key falls within the sample.
+func (e *ExecutionEngine) inSample(key []byte) bool {
+	if e.sample == 0 {
+		return true
+	}
+	h := fnv.New64a()
+	h.Write(key)
+	return uint64(CondenseUint64Odd(MixUint64(h.Sum64()))) < e.sample
+}
+
+// Sets a list of serialized objects and their keys to iterate over instead
+// of an iterator.
+func (e *ExecutionEngine) SetObjects(keys [][]byte, objects [][]byte) error {
+	if len(keys) != len(objects) {
+		return errors.New("skyd.ExecutionEngine: Object key count mismatch")
+	}
+	if e.iterator != nil {
+		e.SetIterator(nil)
+	}
+	e.keys = keys
+	e.objects = objects
+	return nil
+}
+
+// Sets the key of the current object on the cursor. A reference is kept so
+// the key stays valid while the object is being aggregated.
+func (e *ExecutionEngine) setKey(key []byte) {
+	e.key = key
+	if len(key) > 0 {
+		C.sky_cursor_set_key(e.cursor, unsafe.Pointer(&key[0]), (C.size_t)(len(key)))
+	} else {
+		C.sky_cursor_set_key(e.cursor, nil, 0)
+	}
+}
+
 //------------------------------------------------------------------------------
 //
 // Methods
@@ -349,7 +425,7 @@ func (e *ExecutionEngine) decodeResult() (interface{}, error) {
 func (e *ExecutionEngine) generateHeader() error {
 	// Parse the header template.
 	t := template.New("header.lua")
-	t.Funcs(template.FuncMap{"structdef": propertyStructDef, "metatypedef": metatypeFunctionDef, "initdescriptor": initDescriptorDef})
+	t.Funcs(template.FuncMap{"structdef": propertyStructDef, "metatypedef": metatypeFunctionDef, "initdescriptor": initDescriptorDef, "virtualstructdef": virtualPropertyStructDef, "virtualdescriptors": func() string { return virtualPropertyDescriptorDefs(e.source) }, "statedescriptor": func() string { return stateDescriptorDef(e.source) }})
 	_, err := t.Parse(LuaHeader)
 	if err != nil {
 		return err
@@ -374,14 +450,29 @@ func extractPropertyReferences(propertyFile *PropertyFile, source string) ([]*Pr
 	properties := make([]*Property, 0)
 	lookup := make(map[int64]*Property)
 
-	// Find all the event property references in the script.
-	r, err := regexp.Compile(`\bevent(?:\.|:)(\w+)`)
+	// Find all the event and state property references in the script.
+	r, err := regexp.Compile(`\b(?:event|cursor\.state)(?:\.|:)(\w+)`)
 	if err != nil {
 		return nil, err
 	}
 	for _, match := range r.FindAllStringSubmatch(source, -1) {
 		name := match[1]
 		property := propertyFile.GetPropertyByName(name)
+
+		// Raw struct fields are prefixed with an underscore.
+		if property == nil && strings.HasPrefix(name, "_") {
+			property = propertyFile.GetPropertyByName(name[1:])
+		}
+
+		// The event's timestamps are always part of the struct.
+		if property == nil && (name == "ts" || name == "timestamp") {
+			continue
+		}
+
+		// Virtual properties are computed by the cursor.
+		if property == nil && strings.HasPrefix(name, "__") && GetVirtualProperty("@"+name[2:]) != nil {
+			continue
+		}
 		if property == nil {
 			return nil, fmt.Errorf("Property not found: '%v'", name)
 		}
@@ -18,18 +18,61 @@ import (
 func executionEngine_nextObject(cursor unsafe.Pointer) C.int {
 	e := (*ExecutionEngine)(((*C.sky_cursor)(cursor)).context)
 
-	// If the iterator is invalid then exit.
-	if !e.iterator.Valid() {
+	// Iterate over in-memory objects if there is no iterator.
+	if e.iterator == nil {
+		for len(e.objects) > 0 {
+			key, value := e.keys[0], e.objects[0]
+			e.keys, e.objects = e.keys[1:], e.objects[1:]
+			if len(value) > 0 {
+				e.setKey(key)
+				C.sky_cursor_set_ptr(e.cursor, unsafe.Pointer(&value[0]), (C.size_t)(len(value)))
+				return 1
+			}
+		}
 		return 0
 	}
 
-	// If the key prefix doesn't match then the iterator is done.
-	key := e.iterator.Key()
-	if !bytes.HasPrefix(key, e.prefix) {
+	// Seek to each object in a subset of objects. Objects that do not exist
+	// are skipped.
+	if e.lookup {
+		for len(e.objectKeys) > 0 {
+			key := e.objectKeys[0]
+			e.objectKeys = e.objectKeys[1:]
+			if !e.inSample(key) {
+				continue
+			}
+			e.iterator.Seek(key)
+			if e.iterator.Valid() && bytes.Equal(e.iterator.Key(), key) {
+				e.setKey(key)
+				value := e.iterator.Value()
+				C.sky_cursor_set_ptr(e.cursor, unsafe.Pointer(&value[0]), (C.size_t)(len(value)))
+				return 1
+			}
+		}
 		return 0
 	}
 
-	// Set the object data on the cursor.
+	for {
+		// If the iterator is invalid then exit.
+		if !e.iterator.Valid() {
+			return 0
+		}
+
+		// If the key prefix doesn't match then the iterator is done.
+		key := e.iterator.Key()
+		if !bytes.HasPrefix(key, e.prefix) {
+			return 0
+		}
+
+		// Skip objects outside of the sample without reading their value.
+		if e.inSample(key) {
+			break
+		}
+		e.iterator.Next()
+	}
+
+	// Set the object key and data on the cursor.
+	e.setKey(e.iterator.Key())
 	value := e.iterator.Value()
 	C.sky_cursor_set_ptr(e.cursor, unsafe.Pointer(&value[0]), (C.size_t)(len(value)))
 
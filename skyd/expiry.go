@@ -0,0 +1,99 @@
+package skyd
+
+/*
+#cgo LDFLAGS: -lcsky -lleveldb -lpthread
+#include <stdlib.h>
+#include <sky/expiry.h>
+#include <leveldb/c.h>
+*/
+import "C"
+
+import (
+	"errors"
+	"github.com/jmhodges/levigo"
+	"unsafe"
+)
+
+//------------------------------------------------------------------------------
+//
+// Typedefs
+//
+//------------------------------------------------------------------------------
+
+// An Expiry removes events older than their table's retention period from
+// object values while LevelDB compacts them so old events expire without
+// the objects being rewritten. One expiry is shared by every servlet.
+type Expiry struct {
+	filter *C.leveldb_compactionfilter_t
+	expiry *C.sky_expiry
+}
+
+//------------------------------------------------------------------------------
+//
+// Constructors
+//
+//------------------------------------------------------------------------------
+
+// NewExpiry returns a new Expiry that keeps every event until a retention
+// period is set.
+func NewExpiry() *Expiry {
+	expiry := C.sky_expiry_new()
+	if expiry == nil {
+		return nil
+	}
+	filter := C.leveldb_compactionfilter_create(
+		unsafe.Pointer(expiry),
+		(*[0]byte)(C.sky_expiry_destroy),
+		(*[0]byte)(C.sky_expiry_filter),
+		(*[0]byte)(C.sky_expiry_name))
+	return &Expiry{filter: filter, expiry: expiry}
+}
+
+//------------------------------------------------------------------------------
+//
+// Methods
+//
+//------------------------------------------------------------------------------
+
+// Releases the compaction filter. Every database using it must be closed.
+func (e *Expiry) Close() {
+	if e.filter != nil {
+		C.leveldb_compactionfilter_destroy(e.filter)
+		e.filter = nil
+		e.expiry = nil
+	}
+}
+
+// Sets the number of seconds that a table's events are kept for. A
+// retention of zero keeps every event.
+func (e *Expiry) SetRetention(tableName string, retention int64) error {
+	if e.expiry == nil {
+		return errors.New("skyd.Expiry: Expiry is closed")
+	}
+	name := C.CString(tableName)
+	defer C.free(unsafe.Pointer(name))
+	if C.sky_expiry_set_retention(e.expiry, name, C.uint32_t(len(tableName)), C.int64_t(retention)) != 0 {
+		return errors.New("skyd.Expiry: Unable to set retention")
+	}
+	return nil
+}
+
+// Retrieves the number of events and bytes expired from a table's objects
+// since the server started.
+func (e *Expiry) Stats(tableName string) map[string]interface{} {
+	var events, bytes C.uint64_t
+	if e.expiry != nil {
+		name := C.CString(tableName)
+		defer C.free(unsafe.Pointer(name))
+		C.sky_expiry_stats(e.expiry, name, C.uint32_t(len(tableName)), &events, &bytes)
+	}
+	return map[string]interface{}{
+		"trimmedEvents": uint64(events),
+		"trimmedBytes":  uint64(bytes),
+	}
+}
+
+// Registers the compaction filter with the options of a database.
+func (e *Expiry) setOptions(opts *levigo.Options) {
+	C.leveldb_options_set_compaction_filter((*C.leveldb_options_t)(unsafe.Pointer(opts.Opt)), e.filter)
+}
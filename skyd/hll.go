@@ -0,0 +1,26 @@
+package skyd
+
+/*
+#cgo LDFLAGS: -lcsky -lm
+#include <stdlib.h>
+#include <sky/hll.h>
+*/
+import "C"
+
+import (
+	"errors"
+	"unsafe"
+)
+
+// The number of bits used to select a register in the HyperLogLog sketches
+// used by distinct counts. Each sketch uses 2^12 bytes and has a standard
+// error of about 1.6%.
+const HLLPrecision = 12
+
+// Estimates the number of distinct values in a serialized HyperLogLog sketch.
+func EstimateHLL(data []byte) (float64, error) {
+	if len(data) == 0 || !C.sky_hll_validate(unsafe.Pointer(&data[0]), (C.size_t)(len(data))) {
+		return 0, errors.New("skyd: Invalid HyperLogLog sketch")
+	}
+	return float64(C.sky_hll_estimate((*C.sky_hll)(unsafe.Pointer(&data[0])))), nil
+}
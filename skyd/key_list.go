@@ -0,0 +1,22 @@
+package skyd
+
+import (
+	"bytes"
+)
+
+type KeyList [][]byte
+
+// Determines the length of a key slice.
+func (s KeyList) Len() int {
+	return len(s)
+}
+
+// Compares two keys in a key slice.
+func (s KeyList) Less(i, j int) bool {
+	return bytes.Compare(s[i], s[j]) < 0
+}
+
+// Swaps two keys in a key slice.
+func (s KeyList) Swap(i, j int) {
+	s[i], s[j] = s[j], s[i]
+}
@@ -0,0 +1,104 @@
+package skyd
+
+/*
+#cgo LDFLAGS: -lleveldb
+#include <stdlib.h>
+#include <leveldb/c.h>
+*/
+import "C"
+
+import (
+	"errors"
+	"github.com/jmhodges/levigo"
+	"unsafe"
+)
+
+// Deletes every key in [start, end) with a single range tombstone instead of
+// one deletion per key. The keys are reclaimed by later compactions.
+func deleteRange(db *levigo.DB, wo *levigo.WriteOptions, start []byte, end []byte) error {
+	if len(start) == 0 || len(end) == 0 {
+		return errors.New("skyd: Invalid range")
+	}
+	var errStr *C.char
+	C.leveldb_delete_range(
+		(*C.leveldb_t)(unsafe.Pointer(db.Ldb)),
+		(*C.leveldb_writeoptions_t)(unsafe.Pointer(wo.Opt)),
+		(*C.char)(unsafe.Pointer(&start[0])), C.size_t(len(start)),
+		(*C.char)(unsafe.Pointer(&end[0])), C.size_t(len(end)),
+		&errStr)
+	return leveldbError(errStr)
+}
+
+// Writes the key/value pairs into a new table file at path that can be linked
+// into a database with ingestExternalFiles(). Keys must be in increasing order.
+func writeTable(path string, keys [][]byte, values [][]byte) error {
+	if len(keys) == 0 || len(keys) != len(values) {
+		return errors.New("skyd: Invalid table data")
+	}
+	opts := levigo.NewOptions()
+	defer opts.Close()
+	writer := C.leveldb_sstfilewriter_create((*C.leveldb_options_t)(unsafe.Pointer(opts.Opt)))
+	defer C.leveldb_sstfilewriter_destroy(writer)
+
+	cpath := C.CString(path)
+	defer C.free(unsafe.Pointer(cpath))
+	var errStr *C.char
+	C.leveldb_sstfilewriter_open(writer, cpath, &errStr)
+	for i := 0; i < len(keys) && errStr == nil; i++ {
+		var value *C.char
+		if len(values[i]) > 0 {
+			value = (*C.char)(unsafe.Pointer(&values[i][0]))
+		}
+		C.leveldb_sstfilewriter_put(writer,
+			(*C.char)(unsafe.Pointer(&keys[i][0])), C.size_t(len(keys[i])),
+			value, C.size_t(len(values[i])),
+			&errStr)
+	}
+	if errStr == nil {
+		C.leveldb_sstfilewriter_finish(writer, &errStr)
+	}
+	return leveldbError(errStr)
+}
+
+// Moves table files built by writeTable() into the database. Fails without
+// changing the database if any of their keys overlap existing data.
+func ingestExternalFiles(db *levigo.DB, paths []string) error {
+	if len(paths) == 0 {
+		return nil
+	}
+	cpaths := make([]*C.char, len(paths))
+	for i, path := range paths {
+		cpaths[i] = C.CString(path)
+		defer C.free(unsafe.Pointer(cpaths[i]))
+	}
+	var errStr *C.char
+	C.leveldb_ingest_external_file(
+		(*C.leveldb_t)(unsafe.Pointer(db.Ldb)),
+		(**C.char)(unsafe.Pointer(&cpaths[0])), C.size_t(len(cpaths)),
+		&errStr)
+	return leveldbError(errStr)
+}
+
+// Converts and frees an error string returned by the LevelDB C API.
+func leveldbError(errStr *C.char) error {
+	if errStr == nil {
+		return nil
+	}
+	err := errors.New(C.GoString(errStr))
+	C.leveldb_free(unsafe.Pointer(errStr))
+	return err
+}
+
+// Returns the smallest key greater than every key that starts with the prefix
+// or nil if there is none.
+func prefixSuccessor(prefix []byte) []byte {
+	for i := len(prefix) - 1; i >= 0; i-- {
+		if prefix[i] != 0xff {
+			successor := make([]byte, i+1)
+			copy(successor, prefix)
+			successor[i]++
+			return successor
+		}
+	}
+	return nil
+}
@@ -10,13 +10,17 @@ typedef struct {
   {{end}}
   int64_t ts;
   uint32_t timestamp;
+  {{virtualstructdef}}
 } sky_lua_event_t;
-typedef struct sky_cursor_t { sky_lua_event_t *event; int32_t session_event_index; } sky_cursor_t;
+typedef struct sky_cursor_t { sky_lua_event_t *event; sky_lua_event_t *state; int32_t session_event_index; } sky_cursor_t;
 
 int sky_cursor_set_data_sz(sky_cursor_t *cursor, uint32_t sz);
 int sky_cursor_set_timestamp_offset(sky_cursor_t *cursor, uint32_t offset);
 int sky_cursor_set_ts_offset(sky_cursor_t *cursor, uint32_t offset);
+void sky_cursor_set_time_bucket_offset(sky_cursor_t *cursor, uint32_t unit, uint32_t offset);
+void sky_cursor_set_session_field_offset(sky_cursor_t *cursor, uint32_t field, uint32_t offset);
 int sky_cursor_set_property(sky_cursor_t *cursor, int64_t property_id, uint32_t offset, uint32_t sz, const char *data_type);
+void sky_cursor_enable_state(sky_cursor_t *cursor);
 
 bool sky_cursor_has_next_object(sky_cursor_t *);
 bool sky_cursor_next_object(sky_cursor_t *);
@@ -24,15 +28,76 @@ bool sky_cursor_eof(sky_cursor_t *);
 bool sky_cursor_eos(sky_cursor_t *);
 bool sky_lua_cursor_next_event(sky_cursor_t *);
 bool sky_lua_cursor_next_session(sky_cursor_t *);
+bool sky_cursor_next_state(sky_cursor_t *);
 bool sky_cursor_set_session_idle(sky_cursor_t *, uint32_t);
+void sky_cursor_rewind(sky_cursor_t *);
+const void *sky_cursor_key(sky_cursor_t *);
+uint32_t sky_cursor_key_sz(sky_cursor_t *);
+
+typedef struct sky_hll_t sky_hll_t;
+sky_hll_t *sky_hll_new(uint8_t precision);
+void sky_hll_free(sky_hll_t *);
+size_t sky_hll_sizeof(sky_hll_t *);
+void sky_hll_add_double(sky_hll_t *, double);
+void sky_hll_add_string(sky_hll_t *, const void *, size_t);
+int sky_hll_merge(sky_hll_t *, const void *, size_t);
+
+typedef struct sky_tdigest_t sky_tdigest_t;
+sky_tdigest_t *sky_tdigest_new(double compression);
+void sky_tdigest_free(sky_tdigest_t *);
+size_t sky_tdigest_sizeof(sky_tdigest_t *);
+void sky_tdigest_pack(sky_tdigest_t *, void *);
+sky_tdigest_t *sky_tdigest_unpack(const void *, size_t);
+void sky_tdigest_add(sky_tdigest_t *, double);
+int sky_tdigest_merge(sky_tdigest_t *, const void *, size_t);
+
+typedef struct sky_groups_t { uint32_t width; uint32_t count; double *values; } sky_groups_t;
+sky_groups_t *sky_groups_new(uint32_t width, double *initial);
+void sky_groups_free(sky_groups_t *);
+void sky_groups_key_reset(sky_groups_t *);
+int sky_groups_key_add_double(sky_groups_t *, double);
+int sky_groups_key_add_string(sky_groups_t *, const void *, size_t);
+int32_t sky_groups_lookup(sky_groups_t *);
+
+typedef struct sky_funnel_t { uint32_t depth; } sky_funnel_t;
+sky_funnel_t *sky_funnel_new(uint32_t step_count);
+void sky_funnel_free(sky_funnel_t *);
+int sky_funnel_set_window(sky_funnel_t *, uint32_t step, uint8_t unit, int64_t start, int64_t end);
+void sky_funnel_reset(sky_funnel_t *);
+uint32_t sky_funnel_push(sky_funnel_t *, uint32_t mask, uint32_t timestamp);
+
+typedef struct sky_retention_t sky_retention_t;
+sky_retention_t *sky_retention_new(uint32_t period, uint32_t offset, uint32_t periods);
+void sky_retention_free(sky_retention_t *);
+size_t sky_retention_sizeof(sky_retention_t *);
+void sky_retention_pack(sky_retention_t *, void *);
+sky_retention_t *sky_retention_unpack(const void *, size_t);
+void sky_retention_begin(sky_retention_t *);
+void sky_retention_push(sky_retention_t *, uint32_t flags, uint32_t timestamp);
+int sky_retention_end(sky_retention_t *);
+int sky_retention_merge(sky_retention_t *, const void *, size_t);
+
+typedef struct sky_paths_t sky_paths_t;
+sky_paths_t *sky_paths_new(uint32_t steps, uint32_t direction, uint32_t capacity);
+void sky_paths_free(sky_paths_t *);
+size_t sky_paths_sizeof(sky_paths_t *);
+void sky_paths_pack(sky_paths_t *, void *);
+sky_paths_t *sky_paths_unpack(const void *, size_t);
+void sky_paths_begin(sky_paths_t *);
+void sky_paths_push(sky_paths_t *, bool anchor, int64_t value);
+void sky_paths_end(sky_paths_t *);
+int sky_paths_merge(sky_paths_t *, const void *, size_t);
 ]])
 ffi.metatype('sky_cursor_t', {
   __index = {
     set_data_sz = function(cursor, sz) return ffi.C.sky_cursor_set_data_sz(cursor, sz) end,
     set_timestamp_offset = function(cursor, offset) return ffi.C.sky_cursor_set_timestamp_offset(cursor, offset) end,
     set_ts_offset = function(cursor, offset) return ffi.C.sky_cursor_set_ts_offset(cursor, offset) end,
+    set_time_bucket_offset = function(cursor, unit, offset) ffi.C.sky_cursor_set_time_bucket_offset(cursor, unit, offset) end,
+    set_session_field_offset = function(cursor, field, offset) ffi.C.sky_cursor_set_session_field_offset(cursor, field, offset) end,
     set_action_id_offset = function(cursor, offset) return ffi.C.sky_cursor_set_action_id_offset(cursor, offset) end,
     set_property = function(cursor, property_id, offset, sz, data_type) return ffi.C.sky_cursor_set_property(cursor, property_id, offset, sz, data_type) end,
+    enable_state = function(cursor) ffi.C.sky_cursor_enable_state(cursor) end,
 
     hasNextObject = function(cursor) return ffi.C.sky_cursor_has_next_object(cursor) end,
     nextObject = function(cursor) return ffi.C.sky_cursor_next_object(cursor) end,
@@ -40,9 +105,99 @@ ffi.metatype('sky_cursor_t', {
     eos = function(cursor) return ffi.C.sky_cursor_eos(cursor) end,
     next = function(cursor) return ffi.C.sky_lua_cursor_next_event(cursor) end,
     next_session = function(cursor) return ffi.C.sky_lua_cursor_next_session(cursor) end,
+    next_state = function(cursor) return ffi.C.sky_cursor_next_state(cursor) end,
     set_session_idle = function(cursor, seconds) return ffi.C.sky_cursor_set_session_idle(cursor, seconds) end,
+    rewind = function(cursor) return ffi.C.sky_cursor_rewind(cursor) end,
+  }
+})
+ffi.metatype('sky_hll_t', {
+  __index = {
+    add = function(hll, value)
+      if type(value) == 'string' then
+        ffi.C.sky_hll_add_string(hll, value, #value)
+      elseif type(value) == 'boolean' then
+        ffi.C.sky_hll_add_double(hll, value and 1 or 0)
+      elseif value ~= nil then
+        ffi.C.sky_hll_add_double(hll, value)
+      end
+    end,
+    add_object = function(hll, cursor) ffi.C.sky_hll_add_string(hll, ffi.C.sky_cursor_key(cursor), ffi.C.sky_cursor_key_sz(cursor)) end,
+    serialize = function(hll) return ffi.string(hll, ffi.C.sky_hll_sizeof(hll)) end,
+  }
+})
+ffi.metatype('sky_tdigest_t', {
+  __index = {
+    add = function(tdigest, value)
+      if type(value) == 'number' then
+        ffi.C.sky_tdigest_add(tdigest, value)
+      end
+    end,
+    serialize = function(tdigest)
+      local sz = ffi.C.sky_tdigest_sizeof(tdigest)
+      local buf = ffi.new('char[?]', sz)
+      ffi.C.sky_tdigest_pack(tdigest, buf)
+      return ffi.string(buf, sz)
+    end,
+  }
+})
+ffi.metatype('sky_groups_t', {
+  __index = {
+    reset = function(groups) ffi.C.sky_groups_key_reset(groups) end,
+    add = function(groups, value)
+      if type(value) == 'string' then
+        ffi.C.sky_groups_key_add_string(groups, value, #value)
+      elseif type(value) == 'boolean' then
+        ffi.C.sky_groups_key_add_double(groups, value and 1 or 0)
+      else
+        ffi.C.sky_groups_key_add_double(groups, value)
+      end
+    end,
+    add_string = function(groups, ptr, sz) ffi.C.sky_groups_key_add_string(groups, ptr, sz) end,
+    lookup = function(groups)
+      local index = ffi.C.sky_groups_lookup(groups)
+      if index < 0 then error('sky_groups: Unable to allocate group') end
+      return index
+    end,
+  }
+})
+ffi.metatype('sky_funnel_t', {
+  __index = {
+    reset = function(funnel) ffi.C.sky_funnel_reset(funnel) end,
+    push = function(funnel, mask, timestamp) return ffi.C.sky_funnel_push(funnel, mask, timestamp) end,
+  }
+})
+ffi.metatype('sky_retention_t', {
+  __index = {
+    begin = function(retention) ffi.C.sky_retention_begin(retention) end,
+    push = function(retention, flags, timestamp) ffi.C.sky_retention_push(retention, flags, timestamp) end,
+    finish = function(retention)
+      if ffi.C.sky_retention_end(retention) ~= 0 then error('sky_retention: Unable to allocate row') end
+    end,
+    serialize = function(retention)
+      local sz = ffi.C.sky_retention_sizeof(retention)
+      local buf = ffi.new('char[?]', sz)
+      ffi.C.sky_retention_pack(retention, buf)
+      return ffi.string(buf, sz)
+    end,
   }
 })
+ffi.metatype('sky_paths_t', {
+  __index = {
+    begin = function(paths) ffi.C.sky_paths_begin(paths) end,
+    push = function(paths, anchor, value) ffi.C.sky_paths_push(paths, anchor, value) end,
+    finish = function(paths) ffi.C.sky_paths_end(paths) end,
+    serialize = function(paths)
+      local sz = ffi.C.sky_paths_sizeof(paths)
+      local buf = ffi.new('char[?]', sz)
+      ffi.C.sky_paths_pack(paths, buf)
+      return ffi.string(buf, sz)
+    end,
+  }
+})
+local sky_hll_ptr_t = ffi.typeof('sky_hll_t*')
+local sky_tdigest_ptr_t = ffi.typeof('sky_tdigest_t*')
+local sky_retention_ptr_t = ffi.typeof('sky_retention_t*')
+local sky_paths_ptr_t = ffi.typeof('sky_paths_t*')
 ffi.metatype('sky_lua_event_t', {
   __index = {
   {{range .}}{{metatypedef .}}
@@ -56,16 +211,147 @@ function sky_init_cursor(_cursor)
   {{end}}
   cursor:set_timestamp_offset(ffi.offsetof('sky_lua_event_t', 'timestamp'))
   cursor:set_ts_offset(ffi.offsetof('sky_lua_event_t', 'ts'))
+  {{virtualdescriptors}}
   cursor:set_data_sz(ffi.sizeof('sky_lua_event_t'))
+  {{statedescriptor}}
+end
+
+-- Creates a HyperLogLog sketch that is freed when it is garbage collected.
+function sky_hll(precision)
+  local hll = ffi.C.sky_hll_new(precision)
+  if hll == nil then error('sky_hll: Invalid precision: ' .. tostring(precision)) end
+  return ffi.gc(hll, ffi.C.sky_hll_free)
+end
+
+-- Merges two serialized HyperLogLog sketches.
+function sky_hll_merge(a, b)
+  if a == nil then return b end
+  if b == nil then return a end
+  local hll = sky_hll(string.byte(a, 1))
+  ffi.copy(hll, a, #a)
+  if ffi.C.sky_hll_merge(hll, b, #b) ~= 0 then error('sky_hll_merge: Incompatible sketches') end
+  return hll:serialize()
+end
+
+-- Creates a t-digest that is freed when it is garbage collected.
+function sky_tdigest(compression)
+  local tdigest = ffi.C.sky_tdigest_new(compression)
+  if tdigest == nil then error('sky_tdigest: Invalid compression: ' .. tostring(compression)) end
+  return ffi.gc(tdigest, ffi.C.sky_tdigest_free)
+end
+
+-- Merges two serialized t-digests.
+function sky_tdigest_merge(a, b)
+  if a == nil then return b end
+  if b == nil then return a end
+  local tdigest = ffi.C.sky_tdigest_unpack(a, #a)
+  if tdigest == nil then error('sky_tdigest_merge: Invalid digest') end
+  tdigest = ffi.gc(tdigest, ffi.C.sky_tdigest_free)
+  if ffi.C.sky_tdigest_merge(tdigest, b, #b) ~= 0 then error('sky_tdigest_merge: Invalid digest') end
+  return tdigest:serialize()
+end
+
+-- Creates a retention matrix that is freed when it is garbage collected.
+function sky_retention(period, offset, periods)
+  local retention = ffi.C.sky_retention_new(period, offset, periods)
+  if retention == nil then error('sky_retention: Invalid periods') end
+  return ffi.gc(retention, ffi.C.sky_retention_free)
+end
+
+-- Merges two serialized retention matrices.
+function sky_retention_merge(a, b)
+  if a == nil then return b end
+  if b == nil then return a end
+  local retention = ffi.C.sky_retention_unpack(a, #a)
+  if retention == nil then error('sky_retention_merge: Invalid matrix') end
+  retention = ffi.gc(retention, ffi.C.sky_retention_free)
+  if ffi.C.sky_retention_merge(retention, b, #b) ~= 0 then error('sky_retention_merge: Incompatible matrices') end
+  return retention:serialize()
+end
+
+-- Creates a path counter that is freed when it is garbage collected.
+function sky_paths(steps, direction, capacity)
+  local paths = ffi.C.sky_paths_new(steps, direction, capacity)
+  if paths == nil then error('sky_paths: Invalid arguments') end
+  return ffi.gc(paths, ffi.C.sky_paths_free)
+end
+
+-- Merges two serialized path counters.
+function sky_paths_merge(a, b)
+  if a == nil then return b end
+  if b == nil then return a end
+  local paths = ffi.C.sky_paths_unpack(a, #a)
+  if paths == nil then error('sky_paths_merge: Invalid paths') end
+  paths = ffi.gc(paths, ffi.C.sky_paths_free)
+  if ffi.C.sky_paths_merge(paths, b, #b) ~= 0 then error('sky_paths_merge: Incompatible paths') end
+  return paths:serialize()
+end
+
+-- Creates a funnel matcher that is freed when it is garbage collected. Each
+-- window is a table of {step, unit, start, end}.
+function sky_funnel(step_count, windows)
+  local funnel = ffi.C.sky_funnel_new(step_count)
+  if funnel == nil then error('sky_funnel: Invalid step count: ' .. tostring(step_count)) end
+  funnel = ffi.gc(funnel, ffi.C.sky_funnel_free)
+  for _, w in ipairs(windows) do
+    if ffi.C.sky_funnel_set_window(funnel, w[1], w[2], w[3], w[4]) ~= 0 then error('sky_funnel: Invalid window') end
+  end
+  return funnel
+end
+
+-- Creates the group-by state for a selection. Slots hold fixed-width numeric
+-- aggregates, 'keys' holds the dimension values of each group and 'extras'
+-- holds per-group tables for fields that do not fit in a slot.
+function sky_groups(width, initial, flush)
+  local groups = ffi.C.sky_groups_new(width, initial)
+  if groups == nil then error('sky_groups: Unable to allocate groups') end
+  return {__sky_groups = true, groups = ffi.gc(groups, ffi.C.sky_groups_free), keys = {}, extras = {}, flush = flush}
+end
+
+-- Writes all group-by states into nested result tables keyed by dimension.
+function sky_flush_groups(data)
+  local states = {}
+  local function collect(t)
+    for k, v in pairs(t) do
+      if type(v) == 'table' then
+        if v.__sky_groups then
+          table.insert(states, {t, k, v})
+        else
+          collect(v)
+        end
+      end
+    end
+  end
+  collect(data)
+  for _, s in ipairs(states) do
+    s[1][s[2]] = nil
+    s[3].flush(s[3], s[1])
+  end
+  return data
+end
+
+-- Converts sketches in the results to strings so they can be encoded.
+function sky_serialize(data)
+  for k, v in pairs(data) do
+    if type(v) == 'table' then
+      sky_serialize(v)
+    elseif type(v) == 'cdata' and (ffi.istype(sky_hll_ptr_t, v) or ffi.istype(sky_tdigest_ptr_t, v) or ffi.istype(sky_retention_ptr_t, v) or ffi.istype(sky_paths_ptr_t, v)) then
+      data[k] = v:serialize()
+    end
+  end
+  return data
 end
 
 function sky_aggregate(_cursor)
   cursor = ffi.cast('sky_cursor_t*', _cursor)
   data = {}
+  sky_object_index = 0
   while cursor:nextObject() do
+    sky_object_index = sky_object_index + 1
     aggregate(cursor, data)
   end
-  return data
+  sky_flush_groups(data)
+  return sky_serialize(data)
 end
 
 -- The wrapper for the merge.
@@ -0,0 +1,45 @@
+package skyd
+
+/*
+#cgo LDFLAGS: -lcsky -lm
+#include <stdlib.h>
+#include <sky/paths.h>
+*/
+import "C"
+
+import (
+	"errors"
+	"unsafe"
+)
+
+// A path of event values and the estimated number of times it occurred.
+type PathCount struct {
+	Values []int64
+	Count  int64
+}
+
+// Decodes the heavy hitters of serialized path counts, from most to least
+// frequent.
+func PathCounts(data []byte) ([]*PathCount, error) {
+	if len(data) == 0 {
+		return nil, errors.New("skyd: Invalid paths")
+	}
+	paths := C.sky_paths_unpack(unsafe.Pointer(&data[0]), (C.size_t)(len(data)))
+	if paths == nil {
+		return nil, errors.New("skyd: Invalid paths")
+	}
+	defer C.sky_paths_free(paths)
+	C.sky_paths_sort(paths)
+
+	list := (*[C.SKY_PATHS_MAX_CAPACITY]C.sky_path)(unsafe.Pointer(paths.paths))
+	counts := make([]*PathCount, 0, int(paths.path_count))
+	for i := 0; i < int(paths.path_count); i++ {
+		path := &list[i]
+		count := &PathCount{Values: make([]int64, int(path.length)), Count: int64(path.count)}
+		for j := range count.Values {
+			count.Values[j] = int64(path.values[j])
+		}
+		counts = append(counts, count)
+	}
+	return counts, nil
+}
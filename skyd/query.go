@@ -5,8 +5,18 @@ import (
 	"encoding/json"
 	"fmt"
 	"io"
+	"time"
 )
 
+//------------------------------------------------------------------------------
+//
+// Constants
+//
+//------------------------------------------------------------------------------
+
+// The maximum number of objects that a query can be restricted to.
+const MaxQueryObjectIds = 100000
+
 //------------------------------------------------------------------------------
 //
 // Typedefs
@@ -20,6 +30,11 @@ type Query struct {
 	sequence        int
 	Steps           QueryStepList
 	SessionIdleTime int
+	Sample          float64
+	Timezone        string
+	StateOnly       bool
+	ObjectIds       []string
+	location        *time.Location
 }
 
 //------------------------------------------------------------------------------
@@ -31,9 +46,10 @@ type Query struct {
 // NewQuery returns a new query.
 func NewQuery(table *Table, factors *Factors) *Query {
 	return &Query{
-		table:   table,
-		factors: factors,
-		Steps:   make(QueryStepList, 0),
+		table:    table,
+		factors:  factors,
+		Steps:    make(QueryStepList, 0),
+		location: time.UTC,
 	}
 }
 
@@ -53,6 +69,37 @@ func (q *Query) Factors() *Factors {
 	return q.factors
 }
 
+// Retrieves the location that time buckets are aligned to.
+func (q *Query) Location() *time.Location {
+	if q.location == nil {
+		return time.UTC
+	}
+	return q.location
+}
+
+// Checks if the query only runs against an explicit list of objects.
+func (q *Query) Subset() bool {
+	return q.ObjectIds != nil
+}
+
+// Checks if two queries run against the same objects.
+func (q *Query) SameObjects(other *Query) bool {
+	if q.Subset() != other.Subset() || len(q.ObjectIds) != len(other.ObjectIds) {
+		return false
+	}
+	for i, objectId := range q.ObjectIds {
+		if other.ObjectIds[i] != objectId {
+			return false
+		}
+	}
+	return true
+}
+
+// Checks if the query only runs against a sample of the objects.
+func (q *Query) Sampled() bool {
+	return q.Sample > 0 && q.Sample < 1
+}
+
 //------------------------------------------------------------------------------
 //
 // Methods
@@ -69,6 +116,18 @@ func (q *Query) Serialize() map[string]interface{} {
 		"sessionIdleTime": q.SessionIdleTime,
 		"steps":           q.Steps.Serialize(),
 	}
+	if q.Sampled() {
+		obj["sample"] = q.Sample
+	}
+	if q.Timezone != "" {
+		obj["timezone"] = q.Timezone
+	}
+	if q.StateOnly {
+		obj["stateOnly"] = true
+	}
+	if q.Subset() {
+		obj["objectIds"] = q.ObjectIds
+	}
 	return obj
 }
 
@@ -83,10 +142,99 @@ func (q *Query) Deserialize(obj map[string]interface{}) error {
 		return fmt.Errorf("Invalid 'sessionIdleTime': %v", obj["sessionIdleTime"])
 	}
 
+	// Deserialize "sample".
+	if sample, ok := obj["sample"].(float64); ok && sample > 0 && sample <= 1 {
+		q.Sample = sample
+	} else if obj["sample"] != nil {
+		return fmt.Errorf("Invalid 'sample': %v", obj["sample"])
+	}
+
+	// Deserialize "timezone". Time buckets are aligned to UTC by default.
+	if timezone, ok := obj["timezone"].(string); ok && timezone != "" {
+		location, err := time.LoadLocation(timezone)
+		if err != nil {
+			return fmt.Errorf("Invalid 'timezone': %v", timezone)
+		}
+		q.Timezone, q.location = timezone, location
+	} else if obj["timezone"] == nil {
+		q.Timezone, q.location = "", time.UTC
+	} else {
+		return fmt.Errorf("Invalid 'timezone': %v", obj["timezone"])
+	}
+
+	// Deserialize "state only".
+	if stateOnly, ok := obj["stateOnly"].(bool); ok || obj["stateOnly"] == nil {
+		q.StateOnly = stateOnly
+	} else {
+		return fmt.Errorf("Invalid 'stateOnly': %v", obj["stateOnly"])
+	}
+
+	// Deserialize "object ids". Queries run against every object by default.
+	if objectIds, ok := obj["objectIds"].([]interface{}); ok && len(objectIds) <= MaxQueryObjectIds {
+		q.ObjectIds = make([]string, 0, len(objectIds))
+		for _, objectId := range objectIds {
+			if str, ok := objectId.(string); ok {
+				q.ObjectIds = append(q.ObjectIds, str)
+			} else {
+				return fmt.Errorf("Invalid 'objectIds' item: %v", objectId)
+			}
+		}
+	} else if obj["objectIds"] == nil {
+		q.ObjectIds = nil
+	} else {
+		return fmt.Errorf("Invalid 'objectIds': %v", obj["objectIds"])
+	}
+
 	q.Steps, err = DeserializeQueryStepList(obj["steps"], q)
 	if err != nil {
 		return err
 	}
+
+	// State-only queries see a single event per object so they cannot be
+	// sessionized and can only use steps that evaluate the current event.
+	if q.StateOnly {
+		if q.SessionIdleTime > 0 {
+			return fmt.Errorf("Invalid 'sessionIdleTime' for a state-only query: %v", q.SessionIdleTime)
+		}
+		if err = validateStateOnlySteps(q.Steps); err != nil {
+			return err
+		}
+	}
+
+	// Retention cohorts are built once per object so they cannot be split
+	// across sessions.
+	if q.SessionIdleTime > 0 && hasRetentionStep(q.Steps) {
+		return fmt.Errorf("Invalid 'sessionIdleTime' for a query with a retention step: %v", q.SessionIdleTime)
+	}
+	return nil
+}
+
+// Checks whether any step in the list or its substeps is a retention step.
+func hasRetentionStep(steps QueryStepList) bool {
+	for _, step := range steps {
+		if _, ok := step.(*QueryRetention); ok {
+			return true
+		}
+		if hasRetentionStep(step.GetSteps()) {
+			return true
+		}
+	}
+	return false
+}
+
+// Checks that each step in a state-only query only evaluates the current
+// event.
+func validateStateOnlySteps(steps QueryStepList) error {
+	for _, step := range steps {
+		switch step.(type) {
+		case *QuerySelection, *QueryCondition:
+		default:
+			return fmt.Errorf("Invalid step for a state-only query: %v", step.Serialize()["type"])
+		}
+		if err := validateStateOnlySteps(step.GetSteps()); err != nil {
+			return err
+		}
+	}
 	return nil
 }
 
@@ -149,6 +297,18 @@ func (q *Query) CodegenAggregateFunction() string {
 	// Generate the function definition.
 	fmt.Fprintln(buffer, "function aggregate(cursor, data)")
 
+	// State-only queries read the object's current state instead of its
+	// events.
+	if q.StateOnly {
+		fmt.Fprintln(buffer, "  if cursor:next_state() then")
+		for _, step := range q.Steps {
+			fmt.Fprintf(buffer, "    %s(cursor, data)\n", step.FunctionName())
+		}
+		fmt.Fprintln(buffer, "  end")
+		fmt.Fprintln(buffer, "end\n")
+		return buffer.String()
+	}
+
 	// Set the session idle if one is available.
 	if q.SessionIdleTime > 0 {
 		fmt.Fprintf(buffer, "  cursor:set_session_idle(%d)\n", q.SessionIdleTime)
@@ -204,3 +364,25 @@ func (q *Query) NextIdentifier() int {
 func (q *Query) Defactorize(data interface{}) error {
 	return q.Steps.Defactorize(data)
 }
+
+//--------------------------------------
+// Pruning
+//--------------------------------------
+
+// Drops cells from the aggregate results of one of several partitions that
+// cannot reach the limit of any ordered selection. This bounds the size of
+// the results that need to be merged.
+func (q *Query) Prune(data interface{}, partitions int) error {
+	return q.Steps.Prune(data, partitions)
+}
+
+//--------------------------------------
+// Finalization
+//--------------------------------------
+
+// Finalizes the merged results of the query. Sketches are converted to their
+// estimates and sampled counts and sums are scaled up to the full table with
+// a confidence interval added for each.
+func (q *Query) Finalize(data interface{}) error {
+	return q.Steps.Finalize(data)
+}
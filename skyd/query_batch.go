@@ -0,0 +1,267 @@
+package skyd
+
+import (
+	"bytes"
+	"errors"
+	"fmt"
+	"time"
+)
+
+//------------------------------------------------------------------------------
+//
+// Constants
+//
+//------------------------------------------------------------------------------
+
+// The maximum number of queries that can share a single scan.
+const MaxQueryBatchSize = 32
+
+//------------------------------------------------------------------------------
+//
+// Typedefs
+//
+//------------------------------------------------------------------------------
+
+// A QueryBatch is a set of queries against the same table that are executed
+// with a single pass over each servlet. Each query is compiled into its own
+// Lua environment so that generated function names do not collide.
+type QueryBatch struct {
+	table   *Table
+	Queries []*Query
+}
+
+//------------------------------------------------------------------------------
+//
+// Constructors
+//
+//------------------------------------------------------------------------------
+
+// NewQueryBatch returns a new batch of queries.
+func NewQueryBatch(table *Table, queries []*Query) *QueryBatch {
+	return &QueryBatch{
+		table:   table,
+		Queries: queries,
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+// Accessors
+//
+//------------------------------------------------------------------------------
+
+// Retrieves the table this batch is associated with.
+func (b *QueryBatch) Table() *Table {
+	return b.table
+}
+
+// Retrieves the sample fraction shared by all queries in the batch.
+func (b *QueryBatch) Sample() (float64, error) {
+	if len(b.Queries) == 0 {
+		return 0, nil
+	}
+	sample := b.Queries[0].Sample
+	for _, query := range b.Queries[1:] {
+		if query.Sample != sample {
+			return 0, errors.New("skyd.QueryBatch: All queries in a batch must use the same sample")
+		}
+	}
+	return sample, nil
+}
+
+// Retrieves the location that time buckets are aligned to. All queries in
+// the batch share a cursor so they must use the same timezone.
+func (b *QueryBatch) Location() (*time.Location, error) {
+	if len(b.Queries) == 0 {
+		return time.UTC, nil
+	}
+	timezone := b.Queries[0].Timezone
+	for _, query := range b.Queries[1:] {
+		if query.Timezone != timezone {
+			return nil, errors.New("skyd.QueryBatch: All queries in a batch must use the same timezone")
+		}
+	}
+	return b.Queries[0].Location(), nil
+}
+
+// Retrieves the objects that all queries in the batch are restricted to or
+// nil if the batch runs against every object.
+func (b *QueryBatch) ObjectIds() ([]string, error) {
+	if len(b.Queries) == 0 {
+		return nil, nil
+	}
+	for _, query := range b.Queries[1:] {
+		if !query.SameObjects(b.Queries[0]) {
+			return nil, errors.New("skyd.QueryBatch: All queries in a batch must use the same objects")
+		}
+	}
+	return b.Queries[0].ObjectIds, nil
+}
+
+//------------------------------------------------------------------------------
+//
+// Methods
+//
+//------------------------------------------------------------------------------
+
+//--------------------------------------
+// Code Generation
+//--------------------------------------
+
+// Generates Lua code for all queries in the batch. A batch with a single
+// query generates the same code as the query itself.
+func (b *QueryBatch) Codegen() (string, error) {
+	if len(b.Queries) == 0 {
+		return "", errors.New("skyd.QueryBatch: At least one query is required")
+	}
+	if len(b.Queries) == 1 {
+		return b.Queries[0].Codegen()
+	}
+
+	buffer := new(bytes.Buffer)
+	fmt.Fprintln(buffer, "local _G = _G")
+	fmt.Fprintln(buffer, "local queries = {}\n")
+
+	// Generate each query inside its own environment.
+	for i, query := range b.Queries {
+		str, err := query.Codegen()
+		if err != nil {
+			return "", err
+		}
+		fmt.Fprintf(buffer, "queries[%d] = setmetatable({}, {__index = _G})\n", i+1)
+		fmt.Fprintf(buffer, "setfenv(1, queries[%d])\n", i+1)
+		buffer.WriteString(str)
+		fmt.Fprintln(buffer, "setfenv(1, _G)\n")
+	}
+
+	buffer.WriteString(b.CodegenAggregateFunction())
+	buffer.WriteString(b.CodegenMergeFunction())
+
+	return buffer.String(), nil
+}
+
+// Generates the 'aggregate()' function which rewinds the cursor and runs
+// each query over the current object.
+func (b *QueryBatch) CodegenAggregateFunction() string {
+	buffer := new(bytes.Buffer)
+
+	fmt.Fprintln(buffer, "function aggregate(cursor, data)")
+	for i := range b.Queries {
+		if i > 0 {
+			fmt.Fprintln(buffer, "  cursor:rewind()")
+		}
+		fmt.Fprintf(buffer, "  if data[%d] == nil then data[%d] = {} end\n", i+1, i+1)
+		fmt.Fprintf(buffer, "  queries[%d].aggregate(cursor, data[%d])\n", i+1, i+1)
+	}
+	fmt.Fprintln(buffer, "end\n")
+
+	return buffer.String()
+}
+
+// Generates the 'merge()' function which merges each query's results
+// independently.
+func (b *QueryBatch) CodegenMergeFunction() string {
+	buffer := new(bytes.Buffer)
+
+	fmt.Fprintln(buffer, "function merge(results, data)")
+	for i := range b.Queries {
+		fmt.Fprintf(buffer, "  if results[%d] == nil then results[%d] = {} end\n", i+1, i+1)
+		fmt.Fprintf(buffer, "  if data[%d] ~= nil then queries[%d].merge(results[%d], data[%d]) end\n", i+1, i+1, i+1, i+1)
+	}
+	fmt.Fprintln(buffer, "end\n")
+
+	return buffer.String()
+}
+
+//--------------------------------------
+// Results
+//--------------------------------------
+
+// Splits the combined results of an aggregation or merge into one result
+// per query.
+func (b *QueryBatch) Demultiplex(data interface{}) ([]interface{}, error) {
+	if len(b.Queries) == 1 {
+		return []interface{}{data}, nil
+	}
+
+	results := make([]interface{}, len(b.Queries))
+	switch data := data.(type) {
+	case []interface{}:
+		for i := range results {
+			if i < len(data) {
+				results[i] = data[i]
+			}
+		}
+	case map[interface{}]interface{}:
+		for k, v := range data {
+			if index, ok := normalize(k).(int64); ok && index >= 1 && int(index) <= len(results) {
+				results[index-1] = v
+			}
+		}
+	case nil:
+	default:
+		return nil, fmt.Errorf("skyd.QueryBatch: Invalid results: %v", data)
+	}
+
+	// Queries without any results return an empty map.
+	for i := range results {
+		if results[i] == nil {
+			results[i] = make(map[interface{}]interface{})
+		}
+	}
+	return results, nil
+}
+
+//--------------------------------------
+// Factorization
+//--------------------------------------
+
+// Converts factorized results from the aggregate function results to use
+// the appropriate strings.
+func (b *QueryBatch) Defactorize(data interface{}) error {
+	results, err := b.Demultiplex(data)
+	if err != nil {
+		return err
+	}
+	for i, query := range b.Queries {
+		if err := query.Defactorize(results[i]); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+//--------------------------------------
+// Pruning
+//--------------------------------------
+
+// Prunes the aggregate results of a single partition for each query.
+func (b *QueryBatch) Prune(data interface{}, partitions int) error {
+	results, err := b.Demultiplex(data)
+	if err != nil {
+		return err
+	}
+	for i, query := range b.Queries {
+		if err := query.Prune(results[i], partitions); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+//--------------------------------------
+// Finalization
+//--------------------------------------
+
+// Finalizes the demultiplexed results of each query.
+func (b *QueryBatch) Finalize(results []interface{}) error {
+	if len(results) != len(b.Queries) {
+		return errors.New("skyd.QueryBatch: Result count mismatch")
+	}
+	for i, query := range b.Queries {
+		if err := query.Finalize(results[i]); err != nil {
+			return err
+		}
+	}
+	return nil
+}
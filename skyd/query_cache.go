@@ -0,0 +1,222 @@
+package skyd
+
+import (
+	"container/list"
+	"encoding/json"
+	"sync"
+	"time"
+)
+
+//------------------------------------------------------------------------------
+//
+// Constants
+//
+//------------------------------------------------------------------------------
+
+// The default maximum size of the query cache, in bytes.
+const DefaultQueryCacheSize = 64 * 1024 * 1024
+
+//------------------------------------------------------------------------------
+//
+// Typedefs
+//
+//------------------------------------------------------------------------------
+
+// A QueryCache stores query results keyed by the serialized query. Each
+// result is tagged with the version of the table it was computed against and
+// is only served while the table is unchanged or while it is within the
+// staleness tolerance. Entries are evicted in LRU order once the estimated
+// size of the cache exceeds its maximum size.
+type QueryCache struct {
+	mutex     sync.Mutex
+	maxSize   int
+	staleness time.Duration
+	size      int
+	entries   map[string]*list.Element
+	lru       *list.List
+	hits      uint64
+	misses    uint64
+	evictions uint64
+}
+
+// A queryCacheEntry is a single cached query result.
+type queryCacheEntry struct {
+	key       string
+	tableName string
+	version   uint64
+	result    interface{}
+	size      int
+	createdAt time.Time
+}
+
+//------------------------------------------------------------------------------
+//
+// Constructors
+//
+//------------------------------------------------------------------------------
+
+// NewQueryCache returns a new QueryCache that holds up to maxSize bytes.
+func NewQueryCache(maxSize int) *QueryCache {
+	return &QueryCache{
+		maxSize: maxSize,
+		entries: make(map[string]*list.Element),
+		lru:     list.New(),
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+// Accessors
+//
+//------------------------------------------------------------------------------
+
+// Retrieves the maximum size of the cache, in bytes.
+func (c *QueryCache) MaxSize() int {
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
+	return c.maxSize
+}
+
+// Sets the maximum size of the cache, in bytes. A size of zero disables the
+// cache.
+func (c *QueryCache) SetMaxSize(maxSize int) {
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
+	c.maxSize = maxSize
+	c.evict()
+}
+
+// Retrieves how long a result can be served after its table has changed.
+func (c *QueryCache) Staleness() time.Duration {
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
+	return c.staleness
+}
+
+// Sets how long a result can be served after its table has changed.
+func (c *QueryCache) SetStaleness(staleness time.Duration) {
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
+	c.staleness = staleness
+}
+
+//------------------------------------------------------------------------------
+//
+// Methods
+//
+//------------------------------------------------------------------------------
+
+//--------------------------------------
+// Keys
+//--------------------------------------
+
+// Generates the cache key for a query. Map keys are sorted during encoding
+// so equivalent queries produce the same key.
+func (c *QueryCache) Key(query *Query) (string, error) {
+	b, err := json.Marshal(query.Serialize())
+	if err != nil {
+		return "", err
+	}
+	return string(b), nil
+}
+
+//--------------------------------------
+// Entries
+//--------------------------------------
+
+// Retrieves the cached result for a key computed against a given table version.
+func (c *QueryCache) Get(table *Table, key string, version uint64) (interface{}, bool) {
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
+
+	if elem := c.entries[table.Name+"\x00"+key]; elem != nil {
+		entry := elem.Value.(*queryCacheEntry)
+		if entry.version == version || (c.staleness > 0 && time.Since(entry.createdAt) <= c.staleness) {
+			c.lru.MoveToFront(elem)
+			c.hits++
+			return entry.result, true
+		}
+		c.remove(elem)
+	}
+	c.misses++
+	return nil, false
+}
+
+// Adds a result to the cache for a key computed against a given table version.
+func (c *QueryCache) Put(table *Table, key string, version uint64, result interface{}) {
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
+	if c.maxSize <= 0 {
+		return
+	}
+
+	// Estimate the size of the result from its encoded form.
+	b, err := json.Marshal(ConvertToStringKeys(result))
+	if err != nil {
+		return
+	}
+	entry := &queryCacheEntry{
+		key:       table.Name + "\x00" + key,
+		tableName: table.Name,
+		version:   version,
+		result:    result,
+		size:      len(key) + len(b),
+		createdAt: time.Now(),
+	}
+	if entry.size > c.maxSize {
+		return
+	}
+
+	// Replace any existing entry.
+	if elem := c.entries[entry.key]; elem != nil {
+		c.remove(elem)
+	}
+	c.entries[entry.key] = c.lru.PushFront(entry)
+	c.size += entry.size
+	c.evict()
+}
+
+// Removes all cached results for a table.
+func (c *QueryCache) Purge(tableName string) {
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
+	for _, elem := range c.entries {
+		if elem.Value.(*queryCacheEntry).tableName == tableName {
+			c.remove(elem)
+		}
+	}
+}
+
+// Removes entries from the back of the LRU list until the cache fits.
+func (c *QueryCache) evict() {
+	for c.size > c.maxSize && c.lru.Len() > 0 {
+		c.remove(c.lru.Back())
+		c.evictions++
+	}
+}
+
+// Removes a single entry from the cache.
+func (c *QueryCache) remove(elem *list.Element) {
+	entry := elem.Value.(*queryCacheEntry)
+	c.lru.Remove(elem)
+	delete(c.entries, entry.key)
+	c.size -= entry.size
+}
+
+//--------------------------------------
+// Stats
+//--------------------------------------
+
+// Retrieves the cache statistics.
+func (c *QueryCache) Stats() map[string]interface{} {
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
+	return map[string]interface{}{
+		"hits":      c.hits,
+		"misses":    c.misses,
+		"evictions": c.evictions,
+		"count":     c.lru.Len(),
+		"size":      c.size,
+		"maxSize":   c.maxSize,
+	}
+}
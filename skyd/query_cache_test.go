@@ -0,0 +1,56 @@
+package skyd
+
+import (
+	"testing"
+	"time"
+)
+
+// Ensure that cached results are only served for the same table version.
+func TestQueryCacheVersion(t *testing.T) {
+	table := NewTable("foo", "/tmp/foo")
+	cache := NewQueryCache(1024)
+	cache.Put(table, "q", 1, map[interface{}]interface{}{"count": 1})
+	if _, ok := cache.Get(table, "q", 1); !ok {
+		t.Fatalf("Expected cache hit")
+	}
+	if _, ok := cache.Get(table, "q", 2); ok {
+		t.Fatalf("Expected cache miss after version change")
+	}
+	if _, ok := cache.Get(table, "q", 1); ok {
+		t.Fatalf("Expected stale entry to be removed")
+	}
+	stats := cache.Stats()
+	if stats["hits"] != uint64(1) || stats["misses"] != uint64(2) {
+		t.Fatalf("Unexpected stats: %v", stats)
+	}
+}
+
+// Ensure that results within the staleness tolerance are served.
+func TestQueryCacheStaleness(t *testing.T) {
+	table := NewTable("foo", "/tmp/foo")
+	cache := NewQueryCache(1024)
+	cache.SetStaleness(time.Hour)
+	cache.Put(table, "q", 1, map[interface{}]interface{}{"count": 1})
+	if _, ok := cache.Get(table, "q", 2); !ok {
+		t.Fatalf("Expected stale cache hit")
+	}
+}
+
+// Ensure that the least recently used entries are evicted first.
+func TestQueryCacheEviction(t *testing.T) {
+	table := NewTable("foo", "/tmp/foo")
+	cache := NewQueryCache(20)
+	cache.Put(table, "a", 1, map[interface{}]interface{}{"n": 1})
+	cache.Put(table, "b", 1, map[interface{}]interface{}{"n": 2})
+	cache.Get(table, "a", 1)
+	cache.Put(table, "c", 1, map[interface{}]interface{}{"n": 3})
+	if _, ok := cache.Get(table, "a", 1); !ok {
+		t.Fatalf("Expected 'a' to remain in the cache")
+	}
+	if _, ok := cache.Get(table, "b", 1); ok {
+		t.Fatalf("Expected 'b' to be evicted")
+	}
+	if stats := cache.Stats(); stats["evictions"] != uint64(1) {
+		t.Fatalf("Unexpected stats: %v", stats)
+	}
+}
@@ -246,20 +246,26 @@ func (c *QueryCondition) CodegenMergeFunction() (string, error) {
 
 // Generates Lua code for the expression.
 func (c *QueryCondition) CodegenExpression() (string, error) {
+	return codegenConditionExpression(c.query, c.Expression)
+}
+
+// Generates Lua code that tests the cursor's current event against a
+// condition expression. Funnel steps share the same expression syntax.
+func codegenConditionExpression(query *Query, expression string) (string, error) {
 	// Do not transform simple booleans.
-	if c.Expression == "true" || c.Expression == "false" {
-		return c.Expression, nil
+	if expression == "true" || expression == "false" {
+		return expression, nil
 	}
 
 	// Full expressions should be prepended with cursor's event reference.
 	r, _ := regexp.Compile(`^ *(\w+) *(==) *(?:"([^"]*)"|'([^']*)'|(\d+(?:\.\d+)?)|(true|false)) *$`)
-	m := r.FindSubmatch([]byte(c.Expression))
+	m := r.FindSubmatch([]byte(expression))
 	if m == nil {
-		return "", fmt.Errorf("skyd.QueryCondition: Invalid expression: %v", c.Expression)
+		return "", fmt.Errorf("skyd.QueryCondition: Invalid expression: %v", expression)
 	}
 
 	// Find the property.
-	property := c.query.table.propertyFile.GetPropertyByName(string(m[1]))
+	property := query.table.propertyFile.GetPropertyByName(string(m[1]))
 	if property == nil {
 		return "", fmt.Errorf("skyd.QueryCondition: Property not found: %v", string(m[1]))
 	}
@@ -275,12 +281,12 @@ func (c *QueryCondition) CodegenExpression() (string, error) {
 		} else if m[4] != nil {
 			stringValue = string(m[4])
 		} else {
-			return "", fmt.Errorf("skyd.QueryCondition: Expression value must be a string literal for string and factor properties: %v", c.Expression)
+			return "", fmt.Errorf("skyd.QueryCondition: Expression value must be a string literal for string and factor properties: %v", expression)
 		}
 
 		// Convert factors.
 		if property.DataType == FactorDataType {
-			sequence, err := c.query.factors.Factorize(c.query.table.Name, property.Name, stringValue, false)
+			sequence, err := query.factors.Factorize(query.table.Name, property.Name, stringValue, false)
 			if err != nil {
 				return "", err
 			} else {
@@ -292,13 +298,13 @@ func (c *QueryCondition) CodegenExpression() (string, error) {
 
 	case IntegerDataType, FloatDataType:
 		if m[5] == nil {
-			return "", fmt.Errorf("skyd.QueryCondition: Expression value must be a numeric literal for integer and float properties: %v", c.Expression)
+			return "", fmt.Errorf("skyd.QueryCondition: Expression value must be a numeric literal for integer and float properties: %v", expression)
 		}
 		value = string(m[5])
 
 	case BooleanDataType:
 		if m[6] == nil {
-			return "", fmt.Errorf("skyd.QueryCondition: Expression value must be a boolean literal for boolean properties: %v", c.Expression)
+			return "", fmt.Errorf("skyd.QueryCondition: Expression value must be a boolean literal for boolean properties: %v", expression)
 		}
 		value = string(m[6])
 	}
@@ -314,3 +320,21 @@ func (c *QueryCondition) CodegenExpression() (string, error) {
 func (c *QueryCondition) Defactorize(data interface{}) error {
 	return c.Steps.Defactorize(data)
 }
+
+//--------------------------------------
+// Pruning
+//--------------------------------------
+
+// Prunes the results of a single partition for the child steps.
+func (c *QueryCondition) Prune(data interface{}, partitions int) error {
+	return c.Steps.Prune(data, partitions)
+}
+
+//--------------------------------------
+// Finalization
+//--------------------------------------
+
+// Finalizes the merged results of the child steps.
+func (c *QueryCondition) Finalize(data interface{}) error {
+	return c.Steps.Finalize(data)
+}
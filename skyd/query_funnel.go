@@ -0,0 +1,381 @@
+package skyd
+
+import (
+	"bytes"
+	"errors"
+	"fmt"
+)
+
+//------------------------------------------------------------------------------
+//
+// Constants
+//
+//------------------------------------------------------------------------------
+
+// The maximum number of steps in a funnel. Each step is one bit of the mask
+// passed to the native matcher.
+const MaxQueryFunnelSteps = 32
+
+//------------------------------------------------------------------------------
+//
+// Typedefs
+//
+//------------------------------------------------------------------------------
+
+// A funnel step counts the number of objects that reach each step of an
+// ordered sequence of events. All steps are matched natively in a single
+// pass over the object's events so every partial match is tracked at once.
+// The counts can be broken down by the value of a dimension at the event
+// that entered the funnel.
+type QueryFunnel struct {
+	query             *Query
+	functionName      string
+	mergeFunctionName string
+	Name              string
+	Dimension         string
+	Steps             []*QueryFunnelStep
+}
+
+//------------------------------------------------------------------------------
+//
+// Constructors
+//
+//------------------------------------------------------------------------------
+
+// Creates a new funnel.
+func NewQueryFunnel(query *Query) *QueryFunnel {
+	id := query.NextIdentifier()
+	return &QueryFunnel{
+		query:             query,
+		functionName:      fmt.Sprintf("a%d", id),
+		mergeFunctionName: fmt.Sprintf("m%d", id),
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+// Accessors
+//
+//------------------------------------------------------------------------------
+
+// Retrieves the query this funnel is associated with.
+func (f *QueryFunnel) Query() *Query {
+	return f.query
+}
+
+// Retrieves the function name used during codegen.
+func (f *QueryFunnel) FunctionName() string {
+	return f.functionName
+}
+
+// Retrieves the merge function name used during codegen.
+func (f *QueryFunnel) MergeFunctionName() string {
+	return f.mergeFunctionName
+}
+
+// Retrieves the child steps.
+func (f *QueryFunnel) GetSteps() QueryStepList {
+	return []QueryStep{}
+}
+
+//------------------------------------------------------------------------------
+//
+// Methods
+//
+//------------------------------------------------------------------------------
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Encodes a funnel into an untyped map.
+func (f *QueryFunnel) Serialize() map[string]interface{} {
+	steps := []interface{}{}
+	for _, step := range f.Steps {
+		steps = append(steps, step.Serialize())
+	}
+
+	obj := map[string]interface{}{
+		"type":  QueryStepTypeFunnel,
+		"name":  f.Name,
+		"steps": steps,
+	}
+	if f.Dimension != "" {
+		obj["dimension"] = f.Dimension
+	}
+	return obj
+}
+
+// Decodes a funnel from an untyped map.
+func (f *QueryFunnel) Deserialize(obj map[string]interface{}) error {
+	if obj == nil {
+		return errors.New("skyd.QueryFunnel: Unable to deserialize nil.")
+	}
+	if obj["type"] != QueryStepTypeFunnel {
+		return fmt.Errorf("skyd.QueryFunnel: Invalid step type: %v", obj["type"])
+	}
+
+	// Deserialize "name".
+	if name, ok := obj["name"].(string); ok {
+		f.Name = name
+	} else if obj["name"] == nil {
+		f.Name = ""
+	} else {
+		return fmt.Errorf("skyd.QueryFunnel: Invalid name: %v", obj["name"])
+	}
+
+	// Deserialize "dimension".
+	if dimension, ok := obj["dimension"].(string); ok {
+		f.Dimension = dimension
+	} else if obj["dimension"] == nil {
+		f.Dimension = ""
+	} else {
+		return fmt.Errorf("skyd.QueryFunnel: Invalid dimension: %v", obj["dimension"])
+	}
+
+	// Deserialize "steps".
+	steps, ok := obj["steps"].([]interface{})
+	if !ok || len(steps) == 0 || len(steps) > MaxQueryFunnelSteps {
+		return fmt.Errorf("skyd.QueryFunnel: Invalid steps: %v", obj["steps"])
+	}
+	f.Steps = []*QueryFunnelStep{}
+	names := map[string]bool{}
+	for _, step := range steps {
+		stepMap, ok := step.(map[string]interface{})
+		if !ok {
+			return fmt.Errorf("skyd.QueryFunnel: Invalid step: %v", step)
+		}
+		s := NewQueryFunnelStep("", "")
+		if err := s.Deserialize(stepMap); err != nil {
+			return err
+		}
+		if names[s.Name] {
+			return fmt.Errorf("skyd.QueryFunnel: Duplicate step name: %s", s.Name)
+		}
+		names[s.Name] = true
+		f.Steps = append(f.Steps, s)
+	}
+
+	return nil
+}
+
+//--------------------------------------
+// Code Generation
+//--------------------------------------
+
+// Generates Lua code for the funnel. Each event is tested against every step
+// expression and the resulting bitmask is pushed to the native matcher. The
+// funnel consumes the rest of the object's events, stopping its checks early
+// once the last step is reached.
+func (f *QueryFunnel) CodegenAggregateFunction() (string, error) {
+	buffer := new(bytes.Buffer)
+
+	// Validate the dimension.
+	if f.Dimension != "" && f.query.table.propertyFile.GetPropertyByName(f.Dimension) == nil {
+		return "", fmt.Errorf("skyd.QueryFunnel: Property not found: %s", f.Dimension)
+	}
+
+	// Create the matcher with each step's window.
+	fmt.Fprintf(buffer, "%s_funnel = sky_funnel(%d, {", f.FunctionName(), len(f.Steps))
+	for i, step := range f.Steps {
+		if i > 0 && step.Bounded() {
+			unit := 0
+			if step.WithinUnits == QueryConditionUnitSeconds {
+				unit = 1
+			}
+			fmt.Fprintf(buffer, "{%d, %d, %d, %d},", i, unit, step.WithinRangeStart, step.WithinRangeEnd)
+		}
+	}
+	fmt.Fprintln(buffer, "})")
+
+	// Generate main function.
+	fmt.Fprintf(buffer, "function %s(cursor, data)\n", f.FunctionName())
+	fmt.Fprintf(buffer, "  local funnel = %s_funnel\n", f.FunctionName())
+	fmt.Fprintf(buffer, "  funnel:reset()\n")
+	if f.Dimension != "" {
+		fmt.Fprintf(buffer, "  local dimension = nil\n")
+	}
+	fmt.Fprintf(buffer, "  repeat\n")
+	fmt.Fprintf(buffer, "    local mask = 0\n")
+	for i, step := range f.Steps {
+		code, err := codegenConditionExpression(f.query, step.Expression)
+		if err != nil {
+			return "", err
+		}
+		fmt.Fprintf(buffer, "    if %s then mask = mask + %d end\n", code, uint32(1)<<uint(i))
+	}
+	fmt.Fprintf(buffer, "    funnel:push(mask, cursor.event.timestamp)\n")
+	if f.Dimension != "" {
+		fmt.Fprintf(buffer, "    if dimension == nil and funnel.depth > 0 then dimension = cursor.event:%s() end\n", f.Dimension)
+	}
+	fmt.Fprintf(buffer, "    if funnel.depth == %d then\n", len(f.Steps))
+	fmt.Fprintf(buffer, "      while cursor:next() do end\n")
+	fmt.Fprintf(buffer, "      break\n")
+	fmt.Fprintf(buffer, "    end\n")
+	fmt.Fprintf(buffer, "  until not cursor:next()\n")
+
+	// Count the object at each step it reached.
+	fmt.Fprintf(buffer, "  local depth = funnel.depth\n")
+	fmt.Fprintf(buffer, "  if depth == 0 then return end\n")
+	if f.Name != "" {
+		fmt.Fprintf(buffer, "  if data[%q] == nil then data[%q] = {} end\n", f.Name, f.Name)
+		fmt.Fprintf(buffer, "  data = data[%q]\n", f.Name)
+	}
+	if f.Dimension != "" {
+		fmt.Fprintf(buffer, "  if data.%s == nil then data.%s = {} end\n", f.Dimension, f.Dimension)
+		fmt.Fprintf(buffer, "  if data.%s[dimension] == nil then data.%s[dimension] = {} end\n", f.Dimension, f.Dimension)
+		fmt.Fprintf(buffer, "  data = data.%s[dimension]\n", f.Dimension)
+	}
+	for i, step := range f.Steps {
+		fmt.Fprintf(buffer, "  if depth >= %d then data[%q] = (data[%q] or 0) + 1 end\n", i+1, step.Name, step.Name)
+	}
+	fmt.Fprintln(buffer, "end")
+
+	return buffer.String(), nil
+}
+
+// Generates Lua code to merge the funnel counts.
+func (f *QueryFunnel) CodegenMergeFunction() (string, error) {
+	buffer := new(bytes.Buffer)
+
+	// Generate the leaf merge.
+	fmt.Fprintf(buffer, "function %sn(result, data)\n", f.MergeFunctionName())
+	for _, step := range f.Steps {
+		fmt.Fprintf(buffer, "  result[%q] = (result[%q] or 0) + (data[%q] or 0)\n", step.Name, step.Name, step.Name)
+	}
+	fmt.Fprintln(buffer, "end")
+
+	// Generate main function.
+	fmt.Fprintf(buffer, "function %s(result, data)\n", f.MergeFunctionName())
+	if f.Name != "" {
+		fmt.Fprintf(buffer, "  if data[%q] == nil then return end\n", f.Name)
+		fmt.Fprintf(buffer, "  if result[%q] == nil then result[%q] = {} end\n", f.Name, f.Name)
+		fmt.Fprintf(buffer, "  result, data = result[%q], data[%q]\n", f.Name, f.Name)
+	}
+	if f.Dimension != "" {
+		fmt.Fprintf(buffer, "  if data.%s == nil then return end\n", f.Dimension)
+		fmt.Fprintf(buffer, "  if result.%s == nil then result.%s = {} end\n", f.Dimension, f.Dimension)
+		fmt.Fprintf(buffer, "  for k,v in pairs(data.%s) do\n", f.Dimension)
+		fmt.Fprintf(buffer, "    if result.%s[k] == nil then result.%s[k] = {} end\n", f.Dimension, f.Dimension)
+		fmt.Fprintf(buffer, "    %sn(result.%s[k], v)\n", f.MergeFunctionName(), f.Dimension)
+		fmt.Fprintf(buffer, "  end\n")
+	} else {
+		fmt.Fprintf(buffer, "  %sn(result, data)\n", f.MergeFunctionName())
+	}
+	fmt.Fprintln(buffer, "end")
+
+	return buffer.String(), nil
+}
+
+//--------------------------------------
+// Results
+//--------------------------------------
+
+// Retrieves the result map for the funnel, drilling into named funnels.
+func (f *QueryFunnel) results(data interface{}) (map[interface{}]interface{}, bool) {
+	m, ok := data.(map[interface{}]interface{})
+	if !ok {
+		return nil, false
+	}
+	if f.Name != "" {
+		m, ok = m[f.Name].(map[interface{}]interface{})
+	}
+	return m, ok
+}
+
+// Retrieves the maps holding the step counts.
+func (f *QueryFunnel) leaves(data map[interface{}]interface{}) []map[interface{}]interface{} {
+	if f.Dimension == "" {
+		return []map[interface{}]interface{}{data}
+	}
+	leaves := []map[interface{}]interface{}{}
+	if outer, ok := data[f.Dimension].(map[interface{}]interface{}); ok {
+		for _, v := range outer {
+			if inner, ok := v.(map[interface{}]interface{}); ok {
+				leaves = append(leaves, inner)
+			}
+		}
+	}
+	return leaves
+}
+
+//--------------------------------------
+// Factorization
+//--------------------------------------
+
+// Converts factorized dimension values back to their original strings.
+func (f *QueryFunnel) Defactorize(data interface{}) error {
+	m, ok := f.results(data)
+	if !ok || f.Dimension == "" {
+		return nil
+	}
+	property := f.query.table.propertyFile.GetPropertyByName(f.Dimension)
+	if property == nil {
+		return fmt.Errorf("skyd.QueryFunnel: Property not found: %s", f.Dimension)
+	}
+	if property.DataType != FactorDataType {
+		return nil
+	}
+
+	if outer, ok := m[f.Dimension].(map[interface{}]interface{}); ok {
+		copy := map[interface{}]interface{}{}
+		for k, v := range outer {
+			sequence, ok := normalize(k).(int64)
+			if !ok {
+				return fmt.Errorf("Invalid factor sequence: %v", k)
+			}
+			stringValue, err := f.query.factors.Defactorize(f.query.table.Name, f.Dimension, uint64(sequence))
+			if err != nil {
+				return err
+			}
+			copy[stringValue] = v
+		}
+		m[f.Dimension] = copy
+	}
+	return nil
+}
+
+//--------------------------------------
+// Pruning
+//--------------------------------------
+
+// Funnels have no limit so their results are never pruned.
+func (f *QueryFunnel) Prune(data interface{}, partitions int) error {
+	return nil
+}
+
+//--------------------------------------
+// Finalization
+//--------------------------------------
+
+// Fills in steps that no object reached and scales sampled counts up to the
+// full table.
+func (f *QueryFunnel) Finalize(data interface{}) error {
+	m, ok := data.(map[interface{}]interface{})
+	if !ok {
+		return nil
+	}
+	if f.Name != "" {
+		if m2, ok := m[f.Name].(map[interface{}]interface{}); ok {
+			m = m2
+		} else {
+			m2 = map[interface{}]interface{}{}
+			m[f.Name] = m2
+			m = m2
+		}
+	}
+	for _, leaf := range f.leaves(m) {
+		for _, step := range f.Steps {
+			count, _ := normalize(leaf[step.Name]).(int64)
+			if value, ok := normalize(leaf[step.Name]).(float64); ok {
+				count = int64(value)
+			}
+			if f.query.Sampled() {
+				leaf[step.Name] = float64(count) / f.query.Sample
+			} else {
+				leaf[step.Name] = count
+			}
+		}
+	}
+	return nil
+}
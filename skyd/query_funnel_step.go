@@ -0,0 +1,129 @@
+package skyd
+
+import (
+	"errors"
+	"fmt"
+)
+
+//------------------------------------------------------------------------------
+//
+// Typedefs
+//
+//------------------------------------------------------------------------------
+
+// A single step of a funnel. Each step after the first must match within a
+// window after the event that matched the previous step. Without a window
+// any later event can match.
+type QueryFunnelStep struct {
+	Name             string
+	Expression       string
+	WithinRangeStart int
+	WithinRangeEnd   int
+	WithinUnits      string
+}
+
+//------------------------------------------------------------------------------
+//
+// Constructors
+//
+//------------------------------------------------------------------------------
+
+// Creates a new funnel step.
+func NewQueryFunnelStep(name string, expression string) *QueryFunnelStep {
+	return &QueryFunnelStep{
+		Name:             name,
+		Expression:       expression,
+		WithinRangeStart: 1,
+		WithinRangeEnd:   -1,
+		WithinUnits:      QueryConditionUnitSteps,
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+// Accessors
+//
+//------------------------------------------------------------------------------
+
+// Checks if the step has an upper bound on how far after the previous step
+// it can match.
+func (s *QueryFunnelStep) Bounded() bool {
+	return s.WithinRangeEnd >= 0
+}
+
+//------------------------------------------------------------------------------
+//
+// Methods
+//
+//------------------------------------------------------------------------------
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Encodes a funnel step into an untyped map.
+func (s *QueryFunnelStep) Serialize() map[string]interface{} {
+	obj := map[string]interface{}{
+		"name":       s.Name,
+		"expression": s.Expression,
+	}
+	if s.Bounded() {
+		obj["within"] = []int{s.WithinRangeStart, s.WithinRangeEnd}
+		obj["withinUnits"] = s.WithinUnits
+	}
+	return obj
+}
+
+// Decodes a funnel step from an untyped map.
+func (s *QueryFunnelStep) Deserialize(obj map[string]interface{}) error {
+	if obj == nil {
+		return errors.New("skyd.QueryFunnelStep: Unable to deserialize nil.")
+	}
+
+	// Deserialize "name".
+	if name, ok := obj["name"].(string); ok && len(name) > 0 {
+		s.Name = name
+	} else {
+		return fmt.Errorf("skyd.QueryFunnelStep: Invalid name: %v", obj["name"])
+	}
+
+	// Deserialize "expression".
+	if expression, ok := obj["expression"].(string); ok && len(expression) > 0 {
+		s.Expression = expression
+	} else {
+		return fmt.Errorf("skyd.QueryFunnelStep: Invalid expression: %v", obj["expression"])
+	}
+
+	// Deserialize "within" range.
+	if withinRange, ok := obj["within"].([]interface{}); ok && len(withinRange) == 2 {
+		start, ok1 := withinRange[0].(float64)
+		end, ok2 := withinRange[1].(float64)
+		if !ok1 || !ok2 || start < 0 || start > end {
+			return fmt.Errorf("skyd.QueryFunnelStep: Invalid 'within' range: %v", obj["within"])
+		}
+		s.WithinRangeStart = int(start)
+		s.WithinRangeEnd = int(end)
+	} else if obj["within"] == nil {
+		s.WithinRangeStart = 1
+		s.WithinRangeEnd = -1
+	} else {
+		return fmt.Errorf("skyd.QueryFunnelStep: Invalid 'within' range: %v", obj["within"])
+	}
+
+	// Deserialize "within units". Funnels run within a single session when
+	// the query is sessionized so only steps and seconds are allowed.
+	if withinUnits, ok := obj["withinUnits"].(string); ok {
+		switch withinUnits {
+		case QueryConditionUnitSteps, QueryConditionUnitSeconds:
+			s.WithinUnits = withinUnits
+		default:
+			return fmt.Errorf("skyd.QueryFunnelStep: Invalid 'within units': %v", withinUnits)
+		}
+	} else if obj["withinUnits"] == nil {
+		s.WithinUnits = QueryConditionUnitSteps
+	} else {
+		return fmt.Errorf("skyd.QueryFunnelStep: Invalid 'within units': %v", obj["withinUnits"])
+	}
+
+	return nil
+}
@@ -0,0 +1,331 @@
+package skyd
+
+import (
+	"bytes"
+	"errors"
+	"fmt"
+)
+
+//------------------------------------------------------------------------------
+//
+// Constants
+//
+//------------------------------------------------------------------------------
+
+const (
+	QueryPathsDirectionNext     = "next"
+	QueryPathsDirectionPrevious = "previous"
+)
+
+// The default and maximum number of values in each path.
+const DefaultQueryPathsSteps = 3
+const MaxQueryPathsSteps = 8
+
+// The default and maximum number of paths returned.
+const DefaultQueryPathsLimit = 10
+const MaxQueryPathsLimit = 256
+
+// The number of heavy hitters tracked for each path returned and the minimum
+// number tracked. Tracking extra paths keeps the top paths accurate when
+// partial results are merged.
+const QueryPathsCapacityFactor = 4
+const QueryPathsCapacityMinimum = 64
+
+//------------------------------------------------------------------------------
+//
+// Typedefs
+//
+//------------------------------------------------------------------------------
+
+// A paths step finds the most frequent sequences of a property's values that
+// follow or lead up to anchor events, such as the next three actions after an
+// item is added to a cart. Paths are counted natively in a count-min sketch
+// with a bounded list of the most frequent paths so memory does not grow with
+// the number of distinct paths. When the query has a session idle time the
+// step runs once per session so paths end at session boundaries.
+type QueryPaths struct {
+	query             *Query
+	functionName      string
+	mergeFunctionName string
+	Name              string
+	Expression        string
+	Property          string
+	Direction         string
+	Steps             int
+	Limit             int
+}
+
+//------------------------------------------------------------------------------
+//
+// Constructors
+//
+//------------------------------------------------------------------------------
+
+// Creates a new paths step.
+func NewQueryPaths(query *Query) *QueryPaths {
+	id := query.NextIdentifier()
+	return &QueryPaths{
+		query:             query,
+		functionName:      fmt.Sprintf("a%d", id),
+		mergeFunctionName: fmt.Sprintf("m%d", id),
+		Direction:         QueryPathsDirectionNext,
+		Steps:             DefaultQueryPathsSteps,
+		Limit:             DefaultQueryPathsLimit,
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+// Accessors
+//
+//------------------------------------------------------------------------------
+
+// Retrieves the query this step is associated with.
+func (p *QueryPaths) Query() *Query {
+	return p.query
+}
+
+// Retrieves the function name used during codegen.
+func (p *QueryPaths) FunctionName() string {
+	return p.functionName
+}
+
+// Retrieves the merge function name used during codegen.
+func (p *QueryPaths) MergeFunctionName() string {
+	return p.mergeFunctionName
+}
+
+// Retrieves the child steps.
+func (p *QueryPaths) GetSteps() QueryStepList {
+	return []QueryStep{}
+}
+
+// Retrieves the number of most frequent paths tracked by each counter.
+func (p *QueryPaths) capacity() int {
+	capacity := p.Limit * QueryPathsCapacityFactor
+	if capacity < QueryPathsCapacityMinimum {
+		capacity = QueryPathsCapacityMinimum
+	}
+	return capacity
+}
+
+//------------------------------------------------------------------------------
+//
+// Methods
+//
+//------------------------------------------------------------------------------
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Encodes a paths step into an untyped map.
+func (p *QueryPaths) Serialize() map[string]interface{} {
+	return map[string]interface{}{
+		"type":       QueryStepTypePaths,
+		"name":       p.Name,
+		"expression": p.Expression,
+		"property":   p.Property,
+		"direction":  p.Direction,
+		"steps":      p.Steps,
+		"limit":      p.Limit,
+	}
+}
+
+// Decodes a paths step from an untyped map.
+func (p *QueryPaths) Deserialize(obj map[string]interface{}) error {
+	if obj == nil {
+		return errors.New("skyd.QueryPaths: Unable to deserialize nil.")
+	}
+	if obj["type"] != QueryStepTypePaths {
+		return fmt.Errorf("skyd.QueryPaths: Invalid step type: %v", obj["type"])
+	}
+
+	// Deserialize "name". The paths are stored under the name so it is required.
+	if name, ok := obj["name"].(string); ok && len(name) > 0 {
+		p.Name = name
+	} else {
+		return fmt.Errorf("skyd.QueryPaths: Invalid name: %v", obj["name"])
+	}
+
+	// Deserialize the anchor "expression".
+	if expression, ok := obj["expression"].(string); ok && len(expression) > 0 {
+		p.Expression = expression
+	} else {
+		return fmt.Errorf("skyd.QueryPaths: Invalid expression: %v", obj["expression"])
+	}
+
+	// Deserialize "property".
+	if property, ok := obj["property"].(string); ok && len(property) > 0 {
+		p.Property = property
+	} else {
+		return fmt.Errorf("skyd.QueryPaths: Invalid property: %v", obj["property"])
+	}
+
+	// Deserialize "direction".
+	if direction, ok := obj["direction"].(string); ok && (direction == QueryPathsDirectionNext || direction == QueryPathsDirectionPrevious) {
+		p.Direction = direction
+	} else if obj["direction"] == nil {
+		p.Direction = QueryPathsDirectionNext
+	} else {
+		return fmt.Errorf("skyd.QueryPaths: Invalid direction: %v", obj["direction"])
+	}
+
+	// Deserialize "steps".
+	if steps, ok := obj["steps"].(float64); ok && steps >= 1 && steps <= MaxQueryPathsSteps && steps == float64(int(steps)) {
+		p.Steps = int(steps)
+	} else if obj["steps"] == nil {
+		p.Steps = DefaultQueryPathsSteps
+	} else {
+		return fmt.Errorf("skyd.QueryPaths: Invalid steps: %v", obj["steps"])
+	}
+
+	// Deserialize "limit".
+	if limit, ok := obj["limit"].(float64); ok && limit >= 1 && limit <= MaxQueryPathsLimit && limit == float64(int(limit)) {
+		p.Limit = int(limit)
+	} else if obj["limit"] == nil {
+		p.Limit = DefaultQueryPathsLimit
+	} else {
+		return fmt.Errorf("skyd.QueryPaths: Invalid limit: %v", obj["limit"])
+	}
+
+	return nil
+}
+
+//--------------------------------------
+// Code Generation
+//--------------------------------------
+
+// Generates Lua code for the paths step. The step consumes the rest of the
+// object's events and passes each event's value to the counter along with
+// whether it is an anchor event.
+func (p *QueryPaths) CodegenAggregateFunction() (string, error) {
+	buffer := new(bytes.Buffer)
+
+	// Paths are made of numeric values so string properties are not allowed.
+	if GetVirtualProperty(p.Property) == nil && p.query.table != nil {
+		property, err := p.query.table.GetPropertyByName(p.Property)
+		if err != nil || property == nil {
+			return "", fmt.Errorf("skyd.QueryPaths: Property not found: %s", p.Property)
+		}
+		if property.DataType == StringDataType {
+			return "", fmt.Errorf("skyd.QueryPaths: String properties cannot be used in paths: %s", p.Property)
+		}
+	}
+
+	anchor, err := codegenConditionExpression(p.query, p.Expression)
+	if err != nil {
+		return "", err
+	}
+	direction := 0
+	if p.Direction == QueryPathsDirectionPrevious {
+		direction = 1
+	}
+
+	fmt.Fprintf(buffer, "function %s(cursor, data)\n", p.FunctionName())
+	fmt.Fprintf(buffer, "  local paths = data[%q]\n", p.Name)
+	fmt.Fprintf(buffer, "  if paths == nil then\n")
+	fmt.Fprintf(buffer, "    paths = sky_paths(%d, %d, %d)\n", p.Steps, direction, p.capacity())
+	fmt.Fprintf(buffer, "    data[%q] = paths\n", p.Name)
+	fmt.Fprintf(buffer, "  end\n")
+	fmt.Fprintf(buffer, "  paths:begin()\n")
+	fmt.Fprintf(buffer, "  repeat\n")
+	fmt.Fprintf(buffer, "    paths:push((%s) and true or false, %s)\n", anchor, codegenEventValue(p.Property))
+	fmt.Fprintf(buffer, "  until not cursor:next()\n")
+	fmt.Fprintf(buffer, "  paths:finish()\n")
+	fmt.Fprintln(buffer, "end")
+
+	return buffer.String(), nil
+}
+
+// Generates Lua code to merge path counters.
+func (p *QueryPaths) CodegenMergeFunction() (string, error) {
+	buffer := new(bytes.Buffer)
+	fmt.Fprintf(buffer, "function %s(result, data)\n", p.MergeFunctionName())
+	fmt.Fprintf(buffer, "  result[%q] = sky_paths_merge(result[%q], data[%q])\n", p.Name, p.Name, p.Name)
+	fmt.Fprintln(buffer, "end")
+	return buffer.String(), nil
+}
+
+//--------------------------------------
+// Factorization
+//--------------------------------------
+
+// Paths are serialized until they are finalized so factors are converted
+// during finalization.
+func (p *QueryPaths) Defactorize(data interface{}) error {
+	return nil
+}
+
+//--------------------------------------
+// Pruning
+//--------------------------------------
+
+// Path counters are already bounded so they are never pruned.
+func (p *QueryPaths) Prune(data interface{}, partitions int) error {
+	return nil
+}
+
+//--------------------------------------
+// Finalization
+//--------------------------------------
+
+// Converts the serialized counter into a list of the most frequent paths and
+// their counts. Factor values are converted to strings and sampled counts are
+// scaled up to the full table.
+func (p *QueryPaths) Finalize(data interface{}) error {
+	m, ok := data.(map[interface{}]interface{})
+	if !ok {
+		return nil
+	}
+
+	var b []byte
+	switch v := m[p.Name].(type) {
+	case []byte:
+		b = v
+	case string:
+		b = []byte(v)
+	default:
+		m[p.Name] = []interface{}{}
+		return nil
+	}
+	counts, err := PathCounts(b)
+	if err != nil {
+		return err
+	}
+
+	// Determine if the values need to be defactorized.
+	factorized := false
+	if p.query.table != nil && p.query.table.propertyFile != nil {
+		if property := p.query.table.propertyFile.GetPropertyByName(p.Property); property != nil {
+			factorized = (property.DataType == FactorDataType)
+		}
+	}
+
+	paths := []interface{}{}
+	for _, count := range counts {
+		if len(paths) >= p.Limit {
+			break
+		}
+		values := make([]interface{}, len(count.Values))
+		for i, value := range count.Values {
+			if factorized {
+				if values[i], err = p.query.factors.Defactorize(p.query.table.Name, p.Property, uint64(value)); err != nil {
+					return err
+				}
+			} else {
+				values[i] = value
+			}
+		}
+
+		path := map[interface{}]interface{}{"path": values}
+		if p.query.Sampled() {
+			path["count"] = float64(count.Count) / p.query.Sample
+		} else {
+			path["count"] = count.Count
+		}
+		paths = append(paths, path)
+	}
+	m[p.Name] = paths
+	return nil
+}
@@ -0,0 +1,295 @@
+package skyd
+
+import (
+	"bytes"
+	"errors"
+	"fmt"
+	"time"
+)
+
+//------------------------------------------------------------------------------
+//
+// Constants
+//
+//------------------------------------------------------------------------------
+
+const (
+	QueryRetentionPeriodHour = "hour"
+	QueryRetentionPeriodDay  = "day"
+	QueryRetentionPeriodWeek = "week"
+)
+
+// The default number of periods tracked after the start of each cohort.
+const DefaultQueryRetentionPeriods = 8
+
+// The maximum number of periods tracked after the start of each cohort.
+const MaxQueryRetentionPeriods = 1024
+
+//------------------------------------------------------------------------------
+//
+// Typedefs
+//
+//------------------------------------------------------------------------------
+
+// A retention step builds a cohort by period matrix in a single pass over
+// each object. An object joins the cohort of the period containing its first
+// event that matches the cohort expression. Each row then counts the objects
+// of a cohort with an event matching the activity expression in each of the
+// following periods.
+type QueryRetention struct {
+	query             *Query
+	functionName      string
+	mergeFunctionName string
+	Name              string
+	Cohort            string
+	Activity          string
+	Period            string
+	Periods           int
+}
+
+//------------------------------------------------------------------------------
+//
+// Constructors
+//
+//------------------------------------------------------------------------------
+
+// Creates a new retention step.
+func NewQueryRetention(query *Query) *QueryRetention {
+	id := query.NextIdentifier()
+	return &QueryRetention{
+		query:             query,
+		functionName:      fmt.Sprintf("a%d", id),
+		mergeFunctionName: fmt.Sprintf("m%d", id),
+		Cohort:            "true",
+		Activity:          "true",
+		Period:            QueryRetentionPeriodDay,
+		Periods:           DefaultQueryRetentionPeriods,
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+// Accessors
+//
+//------------------------------------------------------------------------------
+
+// Retrieves the query this step is associated with.
+func (r *QueryRetention) Query() *Query {
+	return r.query
+}
+
+// Retrieves the function name used during codegen.
+func (r *QueryRetention) FunctionName() string {
+	return r.functionName
+}
+
+// Retrieves the merge function name used during codegen.
+func (r *QueryRetention) MergeFunctionName() string {
+	return r.mergeFunctionName
+}
+
+// Retrieves the child steps.
+func (r *QueryRetention) GetSteps() QueryStepList {
+	return []QueryStep{}
+}
+
+// Retrieves the length of each period and the offset from the epoch that
+// periods are aligned to, in seconds. Weeks start on Monday.
+func (r *QueryRetention) periodSeconds() (int, int) {
+	switch r.Period {
+	case QueryRetentionPeriodHour:
+		return 3600, 0
+	case QueryRetentionPeriodWeek:
+		return 7 * 86400, 4 * 86400
+	}
+	return 86400, 0
+}
+
+//------------------------------------------------------------------------------
+//
+// Methods
+//
+//------------------------------------------------------------------------------
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Encodes a retention step into an untyped map.
+func (r *QueryRetention) Serialize() map[string]interface{} {
+	return map[string]interface{}{
+		"type":     QueryStepTypeRetention,
+		"name":     r.Name,
+		"cohort":   r.Cohort,
+		"activity": r.Activity,
+		"period":   r.Period,
+		"periods":  r.Periods,
+	}
+}
+
+// Decodes a retention step from an untyped map.
+func (r *QueryRetention) Deserialize(obj map[string]interface{}) error {
+	if obj == nil {
+		return errors.New("skyd.QueryRetention: Unable to deserialize nil.")
+	}
+	if obj["type"] != QueryStepTypeRetention {
+		return fmt.Errorf("skyd.QueryRetention: Invalid step type: %v", obj["type"])
+	}
+
+	// Deserialize "name". The matrix is stored under the name so it is required.
+	if name, ok := obj["name"].(string); ok && len(name) > 0 {
+		r.Name = name
+	} else {
+		return fmt.Errorf("skyd.QueryRetention: Invalid name: %v", obj["name"])
+	}
+
+	// Deserialize "cohort" and "activity" expressions.
+	if cohort, ok := obj["cohort"].(string); ok && len(cohort) > 0 {
+		r.Cohort = cohort
+	} else if obj["cohort"] == nil {
+		r.Cohort = "true"
+	} else {
+		return fmt.Errorf("skyd.QueryRetention: Invalid cohort: %v", obj["cohort"])
+	}
+	if activity, ok := obj["activity"].(string); ok && len(activity) > 0 {
+		r.Activity = activity
+	} else if obj["activity"] == nil {
+		r.Activity = "true"
+	} else {
+		return fmt.Errorf("skyd.QueryRetention: Invalid activity: %v", obj["activity"])
+	}
+
+	// Deserialize "period".
+	if period, ok := obj["period"].(string); ok {
+		switch period {
+		case QueryRetentionPeriodHour, QueryRetentionPeriodDay, QueryRetentionPeriodWeek:
+			r.Period = period
+		default:
+			return fmt.Errorf("skyd.QueryRetention: Invalid period: %v", period)
+		}
+	} else if obj["period"] == nil {
+		r.Period = QueryRetentionPeriodDay
+	} else {
+		return fmt.Errorf("skyd.QueryRetention: Invalid period: %v", obj["period"])
+	}
+
+	// Deserialize "periods".
+	if periods, ok := obj["periods"].(float64); ok && periods >= 1 && periods <= MaxQueryRetentionPeriods && periods == float64(int(periods)) {
+		r.Periods = int(periods)
+	} else if obj["periods"] == nil {
+		r.Periods = DefaultQueryRetentionPeriods
+	} else {
+		return fmt.Errorf("skyd.QueryRetention: Invalid periods: %v", obj["periods"])
+	}
+
+	return nil
+}
+
+//--------------------------------------
+// Code Generation
+//--------------------------------------
+
+// Generates Lua code for the retention step. The step consumes the rest of
+// the object's events and then adds the object to its cohort's row.
+func (r *QueryRetention) CodegenAggregateFunction() (string, error) {
+	buffer := new(bytes.Buffer)
+
+	cohort, err := codegenConditionExpression(r.query, r.Cohort)
+	if err != nil {
+		return "", err
+	}
+	activity, err := codegenConditionExpression(r.query, r.Activity)
+	if err != nil {
+		return "", err
+	}
+	period, offset := r.periodSeconds()
+
+	fmt.Fprintf(buffer, "function %s(cursor, data)\n", r.FunctionName())
+	fmt.Fprintf(buffer, "  local retention = data[%q]\n", r.Name)
+	fmt.Fprintf(buffer, "  if retention == nil then\n")
+	fmt.Fprintf(buffer, "    retention = sky_retention(%d, %d, %d)\n", period, offset, r.Periods)
+	fmt.Fprintf(buffer, "    data[%q] = retention\n", r.Name)
+	fmt.Fprintf(buffer, "  end\n")
+	fmt.Fprintf(buffer, "  retention:begin()\n")
+	fmt.Fprintf(buffer, "  repeat\n")
+	fmt.Fprintf(buffer, "    local flags = 0\n")
+	fmt.Fprintf(buffer, "    if %s then flags = flags + 1 end\n", cohort)
+	fmt.Fprintf(buffer, "    if %s then flags = flags + 2 end\n", activity)
+	fmt.Fprintf(buffer, "    retention:push(flags, cursor.event.timestamp)\n")
+	fmt.Fprintf(buffer, "  until not cursor:next()\n")
+	fmt.Fprintf(buffer, "  retention:finish()\n")
+	fmt.Fprintln(buffer, "end")
+
+	return buffer.String(), nil
+}
+
+// Generates Lua code to merge retention matrices.
+func (r *QueryRetention) CodegenMergeFunction() (string, error) {
+	buffer := new(bytes.Buffer)
+	fmt.Fprintf(buffer, "function %s(result, data)\n", r.MergeFunctionName())
+	fmt.Fprintf(buffer, "  result[%q] = sky_retention_merge(result[%q], data[%q])\n", r.Name, r.Name, r.Name)
+	fmt.Fprintln(buffer, "end")
+	return buffer.String(), nil
+}
+
+//--------------------------------------
+// Factorization
+//--------------------------------------
+
+// Retention matrices have no factorized values.
+func (r *QueryRetention) Defactorize(data interface{}) error {
+	return nil
+}
+
+//--------------------------------------
+// Pruning
+//--------------------------------------
+
+// Retention matrices are never pruned.
+func (r *QueryRetention) Prune(data interface{}, partitions int) error {
+	return nil
+}
+
+//--------------------------------------
+// Finalization
+//--------------------------------------
+
+// Converts the serialized matrix into a map of cohort start times to the
+// number of objects active in each period. Sampled counts are scaled up to
+// the full table.
+func (r *QueryRetention) Finalize(data interface{}) error {
+	m, ok := data.(map[interface{}]interface{})
+	if !ok {
+		return nil
+	}
+
+	var b []byte
+	switch v := m[r.Name].(type) {
+	case []byte:
+		b = v
+	case string:
+		b = []byte(v)
+	default:
+		m[r.Name] = map[interface{}]interface{}{}
+		return nil
+	}
+	rows, err := RetentionRows(b)
+	if err != nil {
+		return err
+	}
+
+	matrix := map[interface{}]interface{}{}
+	for _, row := range rows {
+		counts := make([]interface{}, len(row.Counts))
+		for i, count := range row.Counts {
+			if r.query.Sampled() {
+				counts[i] = float64(count) / r.query.Sample
+			} else {
+				counts[i] = count
+			}
+		}
+		matrix[row.Cohort.Format(time.RFC3339)] = counts
+	}
+	m[r.Name] = matrix
+	return nil
+}
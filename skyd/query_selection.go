@@ -4,6 +4,24 @@ import (
 	"bytes"
 	"errors"
 	"fmt"
+	"math"
+	"regexp"
+	"sort"
+	"strings"
+	"time"
+)
+
+//------------------------------------------------------------------------------
+//
+// Constants
+//
+//------------------------------------------------------------------------------
+
+// The number of extra candidate cells that each partition keeps for every
+// cell in the limit of an ordered selection when pruning cannot be exact.
+const (
+	PruneCandidateFactor  = 2
+	PruneCandidateMinimum = 10
 )
 
 //------------------------------------------------------------------------------
@@ -20,6 +38,16 @@ type QuerySelection struct {
 	Name              string
 	Dimensions        []string
 	Fields            []*QuerySelectionField
+	OrderBy           string
+	Limit             int
+
+	// Set when pruning dropped cells that could have added to the merged
+	// values. pruneError is the sum of the largest value dropped from each
+	// partition's results and only bounds the error of a count or sum order
+	// field when pruneUnbounded is not set.
+	pruned         bool
+	pruneError     float64
+	pruneUnbounded bool
 }
 
 //------------------------------------------------------------------------------
@@ -87,6 +115,12 @@ func (s *QuerySelection) Serialize() map[string]interface{} {
 		"dimensions": s.Dimensions,
 		"fields":     fields,
 	}
+	if s.OrderBy != "" {
+		obj["orderBy"] = s.OrderBy
+	}
+	if s.Limit > 0 {
+		obj["limit"] = s.Limit
+	}
 	return obj
 }
 
@@ -112,7 +146,7 @@ func (s *QuerySelection) Deserialize(obj map[string]interface{}) error {
 	if dimensions, ok := obj["dimensions"].([]interface{}); ok {
 		s.Dimensions = []string{}
 		for _, dimension := range dimensions {
-			if str, ok := dimension.(string); ok {
+			if str, ok := dimension.(string); ok && (!strings.HasPrefix(str, "@") || GetVirtualProperty(str) != nil) && str != StatePropertyPrefix {
 				s.Dimensions = append(s.Dimensions, str)
 			} else {
 				return fmt.Errorf("skyd.QuerySelection: Invalid dimension: %v", dimension)
@@ -146,9 +180,59 @@ func (s *QuerySelection) Deserialize(obj map[string]interface{}) error {
 		}
 	}
 
+	// Deserialize "orderBy".
+	if orderBy, ok := obj["orderBy"].(string); ok {
+		s.OrderBy = orderBy
+	} else if obj["orderBy"] == nil {
+		s.OrderBy = ""
+	} else {
+		return fmt.Errorf("skyd.QuerySelection: Invalid order by: %v", obj["orderBy"])
+	}
+	if s.OrderBy != "" {
+		if field, _, err := s.order(); err != nil {
+			return err
+		} else if field == nil {
+			return fmt.Errorf("skyd.QuerySelection: Order by field not found: %v", s.OrderBy)
+		}
+	}
+
+	// Deserialize "limit".
+	if limit, ok := normalize(obj["limit"]).(int64); ok && limit >= 0 {
+		s.Limit = int(limit)
+	} else if limit, ok := obj["limit"].(float64); ok && limit >= 0 && limit == math.Floor(limit) {
+		s.Limit = int(limit)
+	} else if obj["limit"] == nil {
+		s.Limit = 0
+	} else {
+		return fmt.Errorf("skyd.QuerySelection: Invalid limit: %v", obj["limit"])
+	}
+	if s.Limit > 0 && s.OrderBy == "" {
+		return errors.New("skyd.QuerySelection: Limit requires an order by field")
+	}
+
 	return nil
 }
 
+//--------------------------------------
+// Ordering
+//--------------------------------------
+
+// Retrieves the field that cells are ordered by and whether the order is
+// descending. The order is descending unless it is followed by "asc".
+func (s *QuerySelection) order() (*QuerySelectionField, bool, error) {
+	r, _ := regexp.Compile(`^ *(\w+)(?: +(asc|desc))? *$`)
+	m := r.FindStringSubmatch(s.OrderBy)
+	if m == nil {
+		return nil, false, fmt.Errorf("skyd.QuerySelection: Invalid order by: %q", s.OrderBy)
+	}
+	for _, field := range s.Fields {
+		if field.Name == m[1] {
+			return field, m[2] != "asc", nil
+		}
+	}
+	return nil, false, nil
+}
+
 //--------------------------------------
 // Code Generation
 //--------------------------------------
@@ -157,6 +241,11 @@ func (s *QuerySelection) Deserialize(obj map[string]interface{}) error {
 func (s *QuerySelection) CodegenAggregateFunction() (string, error) {
 	buffer := new(bytes.Buffer)
 
+	// Group by dimensions with a native hash table.
+	if len(s.Dimensions) > 0 {
+		return s.CodegenGroupAggregateFunction()
+	}
+
 	// Generate main function.
 	fmt.Fprintf(buffer, "function %s(cursor, data)\n", s.FunctionName())
 
@@ -166,14 +255,6 @@ func (s *QuerySelection) CodegenAggregateFunction() (string, error) {
 		fmt.Fprintf(buffer, "  data = data[\"%s\"]\n\n", s.Name)
 	}
 
-	// Group by dimension.
-	for _, dimension := range s.Dimensions {
-		fmt.Fprintf(buffer, "  dimension = cursor.event:%s()\n", dimension)
-		fmt.Fprintf(buffer, "  if data.%s == nil then data.%s = {} end\n", dimension, dimension)
-		fmt.Fprintf(buffer, "  if data.%s[dimension] == nil then data.%s[dimension] = {} end\n", dimension, dimension)
-		fmt.Fprintf(buffer, "  data = data.%s[dimension]\n\n", dimension)
-	}
-
 	// Select fields.
 	for _, field := range s.Fields {
 		exp, err := field.CodegenExpression()
@@ -181,6 +262,118 @@ func (s *QuerySelection) CodegenAggregateFunction() (string, error) {
 			return "", err
 		}
 		fmt.Fprintln(buffer, "  "+exp)
+
+		// Track per-object totals for sampled error bounds.
+		if s.query.Sampled() {
+			buffer.WriteString(field.CodegenSampleExpression())
+		}
+	}
+
+	// End function definition.
+	fmt.Fprintln(buffer, "end")
+
+	return buffer.String(), nil
+}
+
+// Generates Lua code for a selection with dimensions. Each event is grouped
+// with a single probe of a native hash table keyed by all dimension values.
+// Counts, sums, minimums and maximums are kept in the group's fixed-width
+// slot and all other fields in a per-group table. The groups are written into
+// the usual nested result tables once the aggregation is complete.
+func (s *QuerySelection) CodegenGroupAggregateFunction() (string, error) {
+	buffer := new(bytes.Buffer)
+
+	// State dimensions are read from the object's state which only holds
+	// permanent properties.
+	for _, dimension := range s.Dimensions {
+		if name, ok := statePropertyName(dimension); ok && s.query.table != nil {
+			property, err := s.query.table.GetPropertyByName(name)
+			if err != nil || property == nil {
+				return "", fmt.Errorf("skyd.QuerySelection: Property not found: %s", name)
+			}
+			if property.Transient {
+				return "", fmt.Errorf("skyd.QuerySelection: Transient properties cannot be used as state dimensions: %s", name)
+			}
+		}
+	}
+
+	// Assign slots to fields.
+	slots := make(map[*QuerySelectionField]int)
+	initial := []string{}
+	extras := s.query.Sampled()
+	for _, field := range s.Fields {
+		if value, ok := field.SlotInitialValue(); ok {
+			slots[field] = len(initial)
+			initial = append(initial, value)
+		} else {
+			extras = true
+		}
+	}
+	width := len(initial)
+	fmt.Fprintf(buffer, "%s_initial = ffi.new('double[?]', %d, {%s})\n\n", s.FunctionName(), width, strings.Join(initial, ", "))
+
+	// Generate the function that writes the groups into the results.
+	code, err := s.CodegenGroupFlushFunction(slots)
+	if err != nil {
+		return "", err
+	}
+	buffer.WriteString(code)
+
+	// Generate main function.
+	fmt.Fprintf(buffer, "function %s(cursor, data)\n", s.FunctionName())
+	if s.Name != "" {
+		fmt.Fprintf(buffer, "  if data[\"%s\"] == nil then data[\"%s\"] = {} end\n", s.Name, s.Name)
+		fmt.Fprintf(buffer, "  data = data[\"%s\"]\n\n", s.Name)
+	}
+	fmt.Fprintf(buffer, "  local state = data.__%s\n", s.FunctionName())
+	fmt.Fprintf(buffer, "  if state == nil then state = sky_groups(%d, %s_initial, %s_flush); data.__%s = state end\n", width, s.FunctionName(), s.FunctionName(), s.FunctionName())
+
+	// Build the key from the dimension values and find the group.
+	fmt.Fprintln(buffer, "  local groups = state.groups")
+	fmt.Fprintln(buffer, "  groups:reset()")
+	values := []string{}
+	for _, dimension := range s.Dimensions {
+		if s.isStringProperty(dimension) {
+			field := codegenEventField(dimension)
+			fmt.Fprintf(buffer, "  groups:add_string(%s.data, %s.length)\n", field, field)
+		} else {
+			fmt.Fprintf(buffer, "  groups:add(%s)\n", codegenEventValue(dimension))
+		}
+		values = append(values, codegenEventValue(dimension))
+	}
+	fmt.Fprintln(buffer, "  local index = groups:lookup()")
+	fmt.Fprintf(buffer, "  if state.keys[index] == nil then state.keys[index] = {%s} end\n", strings.Join(values, ", "))
+
+	// Update slot fields.
+	if width > 0 {
+		fmt.Fprintf(buffer, "  local values = groups.values + index * %d\n", width)
+	}
+	for _, field := range s.Fields {
+		if slot, ok := slots[field]; ok {
+			exp, err := field.CodegenSlotExpression(fmt.Sprintf("values[%d]", slot))
+			if err != nil {
+				return "", err
+			}
+			fmt.Fprintln(buffer, "  "+exp)
+		}
+	}
+
+	// Update all other fields in the group's table.
+	if extras {
+		fmt.Fprintln(buffer, "  data = state.extras[index]")
+		fmt.Fprintln(buffer, "  if data == nil then data = {}; state.extras[index] = data end")
+		for _, field := range s.Fields {
+			if _, ok := slots[field]; !ok {
+				exp, err := field.CodegenExpression()
+				if err != nil {
+					return "", err
+				}
+				fmt.Fprintln(buffer, "  "+exp)
+			}
+			if s.query.Sampled() {
+				buffer.WriteString(field.CodegenSampleExpression())
+			}
+		}
 	}
 
 	// End function definition.
@@ -189,6 +382,80 @@ func (s *QuerySelection) CodegenAggregateFunction() (string, error) {
 	return buffer.String(), nil
 }
 
+// Generates the function that writes each group into nested result tables
+// keyed by dimension. The group's slot values are copied into its table and
+// the table is merged into the results with the fields' merge expressions.
+func (s *QuerySelection) CodegenGroupFlushFunction(slots map[*QuerySelectionField]int) (string, error) {
+	buffer := new(bytes.Buffer)
+
+	fmt.Fprintf(buffer, "function %s_flush(state, root)\n", s.FunctionName())
+	fmt.Fprintln(buffer, "  local groups = state.groups")
+	fmt.Fprintln(buffer, "  for index = 0, groups.count - 1 do")
+	fmt.Fprintln(buffer, "    local key = state.keys[index]")
+	fmt.Fprintln(buffer, "    local data = state.extras[index] or {}")
+	for _, field := range s.Fields {
+		if slot, ok := slots[field]; ok {
+			fmt.Fprintf(buffer, "    data.%s = groups.values[index * %d + %d]\n", field.Name, len(slots), slot)
+		}
+	}
+
+	// Find the nested result table for the group.
+	fmt.Fprintln(buffer, "    local result = root")
+	for i, dimension := range s.Dimensions {
+		fmt.Fprintf(buffer, "    if result[%q] == nil then result[%q] = {} end\n", dimension, dimension)
+		fmt.Fprintf(buffer, "    if result[%q][key[%d]] == nil then result[%q][key[%d]] = {} end\n", dimension, i+1, dimension, i+1)
+		fmt.Fprintf(buffer, "    result = result[%q][key[%d]]\n", dimension, i+1)
+	}
+
+	// Merge fields.
+	for _, field := range s.Fields {
+		exp, err := field.CodegenMergeExpression()
+		if err != nil {
+			return "", err
+		}
+		fmt.Fprintln(buffer, "    "+exp)
+		if s.query.Sampled() {
+			buffer.WriteString("  " + field.CodegenSampleMergeExpression())
+		}
+	}
+	fmt.Fprintln(buffer, "  end")
+	fmt.Fprintln(buffer, "end")
+	fmt.Fprintln(buffer, "")
+
+	return buffer.String(), nil
+}
+
+// Checks if any dimension or field depends on other events of the object,
+// either by reading from the object's state or from a session property.
+func (s *QuerySelection) readsOtherEvents() bool {
+	names := append([]string{}, s.Dimensions...)
+	for _, field := range s.Fields {
+		if _, property, _, err := field.parse(); err == nil {
+			names = append(names, property)
+		}
+	}
+	for _, name := range names {
+		if _, ok := statePropertyName(name); ok {
+			return true
+		}
+		if p := GetVirtualProperty(name); p != nil && p.Kind == VirtualPropertySession {
+			return true
+		}
+	}
+	return false
+}
+
+// Checks if a dimension is a string property. String dimensions are added to
+// group keys straight from the event's data without creating a Lua string.
+func (s *QuerySelection) isStringProperty(name string) bool {
+	if s.query.table == nil {
+		return false
+	}
+	name, _ = statePropertyName(name)
+	property, err := s.query.table.GetPropertyByName(name)
+	return err == nil && property != nil && property.DataType == StringDataType
+}
+
 // Generates Lua code for the selection merge.
 func (s *QuerySelection) CodegenMergeFunction() (string, error) {
 	buffer := new(bytes.Buffer)
@@ -231,11 +498,11 @@ func (s *QuerySelection) CodegenInnerMergeFunction(index int) (string, error) {
 	fmt.Fprintf(buffer, "function %sn%d(result, data)\n", s.MergeFunctionName(), index)
 	if index < len(s.Dimensions) {
 		dimension := s.Dimensions[index]
-		fmt.Fprintf(buffer, "  if data ~= nil and data.%s ~= nil then\n", dimension)
-		fmt.Fprintf(buffer, "    if result.%s == nil then result.%s = {} end\n", dimension, dimension)
-		fmt.Fprintf(buffer, "    for k,v in pairs(data.%s) do\n", dimension)
-		fmt.Fprintf(buffer, "      if result.%s[k] == nil then result.%s[k] = {} end\n", dimension, dimension)
-		fmt.Fprintf(buffer, "      %sn%d(result.%s[k], v)\n", s.MergeFunctionName(), (index + 1), dimension)
+		fmt.Fprintf(buffer, "  if data ~= nil and data[%q] ~= nil then\n", dimension)
+		fmt.Fprintf(buffer, "    if result[%q] == nil then result[%q] = {} end\n", dimension, dimension)
+		fmt.Fprintf(buffer, "    for k,v in pairs(data[%q]) do\n", dimension)
+		fmt.Fprintf(buffer, "      if result[%q][k] == nil then result[%q][k] = {} end\n", dimension, dimension)
+		fmt.Fprintf(buffer, "      %sn%d(result[%q][k], v)\n", s.MergeFunctionName(), (index + 1), dimension)
 		fmt.Fprintf(buffer, "    end\n")
 		fmt.Fprintf(buffer, "  end\n")
 	} else {
@@ -246,6 +513,9 @@ func (s *QuerySelection) CodegenInnerMergeFunction(index int) (string, error) {
 				return "", err
 			}
 			fmt.Fprintln(buffer, "  "+exp)
+			if s.query.Sampled() {
+				buffer.WriteString(field.CodegenSampleMergeExpression())
+			}
 		}
 	}
 	fmt.Fprintf(buffer, "end\n")
@@ -287,11 +557,30 @@ func (s *QuerySelection) defactorize(data interface{}, index int) error {
 		return nil
 	}
 
-	// Retrieve property.
+	// Virtual properties holding times are converted to times in the query's
+	// timezone.
 	dimension := s.Dimensions[index]
-	property := s.query.table.propertyFile.GetPropertyByName(dimension)
+	if virtual := GetVirtualProperty(dimension); virtual != nil {
+		if outer, ok := inner[dimension].(map[interface{}]interface{}); ok {
+			copy := map[interface{}]interface{}{}
+			for k, v := range outer {
+				if seconds, ok := normalize(k).(int64); ok && virtual.Timestamp {
+					copy[time.Unix(seconds, 0).In(s.query.Location()).Format(time.RFC3339)] = v
+				} else {
+					copy[k] = v
+				}
+				s.defactorize(v, index+1)
+			}
+			inner[dimension] = copy
+		}
+		return nil
+	}
+
+	// Retrieve property. State dimensions use the values of the property.
+	name, _ := statePropertyName(dimension)
+	property := s.query.table.propertyFile.GetPropertyByName(name)
 	if property == nil {
-		return fmt.Errorf("skyd.QuerySelection: Property not found: %s", dimension)
+		return fmt.Errorf("skyd.QuerySelection: Property not found: %s", name)
 	}
 
 	// Defactorize.
@@ -300,7 +589,7 @@ func (s *QuerySelection) defactorize(data interface{}, index int) error {
 		for k, v := range outer {
 			if property.DataType == FactorDataType {
 				if sequence, ok := normalize(k).(int64); ok {
-					stringValue, err := s.query.factors.Defactorize(s.query.table.Name, dimension, uint64(sequence))
+					stringValue, err := s.query.factors.Defactorize(s.query.table.Name, name, uint64(sequence))
 					if err != nil {
 						return err
 					}
@@ -320,3 +609,220 @@ func (s *QuerySelection) defactorize(data interface{}, index int) error {
 
 	return nil
 }
+
+//--------------------------------------
+// Pruning
+//--------------------------------------
+
+// Drops the cells of a single partition's results that cannot make it into
+// the selection's limit. Pruning is exact when there is only one partition.
+// Ordering by a maximum descending or a minimum ascending keeps the order
+// field exact since a cell's merged value then equals its value in one of the
+// partitions, but the other fields of a cell may miss the values of another
+// partition that dropped it. Counts and sums keep extra candidates in each
+// partition so the final ordering is approximate. The finalized results are
+// marked as approximate when any cells were dropped from more than one
+// partition. Other fields are only limited after finalization.
+func (s *QuerySelection) Prune(data interface{}, partitions int) error {
+	if s.Limit == 0 || len(s.Dimensions) == 0 {
+		return nil
+	}
+	field, descending, err := s.order()
+	if err != nil || field == nil {
+		return err
+	}
+	fn, _, _, _ := field.parse()
+
+	limit, exact := 0, false
+	switch {
+	case fn != "count" && fn != "sum" && fn != "min" && fn != "max":
+		return nil
+	case partitions <= 1, fn == "max" && descending, fn == "min" && !descending:
+		limit, exact = s.Limit, true
+	default:
+		limit = s.Limit*PruneCandidateFactor + PruneCandidateMinimum
+	}
+
+	if m, ok := s.results(data); ok {
+		threshold, dropped := s.truncate(m, field.Name, descending, limit)
+		if dropped && !exact {
+			// A cell dropped from this partition added at most the value
+			// of the last cell kept to its merged total.
+			s.pruned = true
+			if fn != "count" && fn != "sum" {
+				s.pruneUnbounded = true
+			} else if !math.IsInf(threshold, 0) {
+				s.pruneError += math.Max(threshold, 0)
+			}
+		} else if dropped && partitions > 1 && len(s.Fields) > 1 {
+			s.pruned, s.pruneUnbounded = true, true
+		}
+	}
+	return nil
+}
+
+// Retrieves the result map for the selection, drilling into named selections.
+func (s *QuerySelection) results(data interface{}) (map[interface{}]interface{}, bool) {
+	m, ok := data.(map[interface{}]interface{})
+	if !ok {
+		return nil, false
+	}
+	if s.Name != "" {
+		m, ok = m[s.Name].(map[interface{}]interface{})
+	}
+	return m, ok
+}
+
+// A single cell of a dimensioned result.
+type queryCell struct {
+	parent map[interface{}]interface{}
+	key    interface{}
+	path   string
+	value  float64
+}
+
+// Keeps only the top cells of the results by the value of a field. Cells
+// without a numeric value are ordered last and ties are broken by the cell's
+// dimension values so that the cells kept are deterministic. Returns the
+// value of the last cell kept and whether any cells were dropped.
+func (s *QuerySelection) truncate(data map[interface{}]interface{}, name string, descending bool, limit int) (float64, bool) {
+	cells := s.cells(data, 0, "", name, []*queryCell{})
+	if len(cells) <= limit {
+		return 0, false
+	}
+
+	missing := math.Inf(-1)
+	if !descending {
+		missing = math.Inf(1)
+	}
+	for _, cell := range cells {
+		if math.IsNaN(cell.value) {
+			cell.value = missing
+		}
+	}
+	sort.Slice(cells, func(i, j int) bool {
+		if cells[i].value != cells[j].value {
+			return (cells[i].value > cells[j].value) == descending
+		}
+		return cells[i].path < cells[j].path
+	})
+
+	for _, cell := range cells[limit:] {
+		delete(cell.parent, cell.key)
+	}
+	s.compact(data, 0)
+
+	if limit == 0 {
+		return 0, true
+	}
+	return cells[limit-1].value, true
+}
+
+// Recursively collects the leaf cells of the results.
+func (s *QuerySelection) cells(data map[interface{}]interface{}, index int, path string, name string, cells []*queryCell) []*queryCell {
+	outer, ok := data[s.Dimensions[index]].(map[interface{}]interface{})
+	if !ok {
+		return cells
+	}
+	for k, v := range outer {
+		inner, ok := v.(map[interface{}]interface{})
+		if !ok {
+			continue
+		}
+		p := fmt.Sprintf("%s\x00%v", path, k)
+		if index < len(s.Dimensions)-1 {
+			cells = s.cells(inner, index+1, p, name, cells)
+		} else {
+			value := math.NaN()
+			switch n := normalize(inner[name]).(type) {
+			case int64:
+				value = float64(n)
+			case float64:
+				value = n
+			}
+			cells = append(cells, &queryCell{parent: outer, key: k, path: p, value: value})
+		}
+	}
+	return cells
+}
+
+// Removes dimension values that no longer have any cells beneath them.
+// Returns true if the results are empty.
+func (s *QuerySelection) compact(data map[interface{}]interface{}, index int) bool {
+	dimension := s.Dimensions[index]
+	outer, ok := data[dimension].(map[interface{}]interface{})
+	if !ok {
+		return false
+	}
+	if index < len(s.Dimensions)-1 {
+		for k, v := range outer {
+			if inner, ok := v.(map[interface{}]interface{}); ok && s.compact(inner, index+1) {
+				delete(outer, k)
+			}
+		}
+	}
+	if len(outer) == 0 {
+		delete(data, dimension)
+	}
+	return len(data) == 0
+}
+
+//--------------------------------------
+// Finalization
+//--------------------------------------
+
+// Finalizes the fields at each leaf of the merged results and then applies
+// the selection's limit.
+func (s *QuerySelection) Finalize(data interface{}) error {
+	if m, ok := s.results(data); ok {
+		if err := s.finalize(m, 0); err != nil {
+			return err
+		}
+		if s.Limit > 0 && len(s.Dimensions) > 0 {
+			field, descending, err := s.order()
+			if err != nil || field == nil {
+				return err
+			}
+			s.truncate(m, field.Name, descending, s.Limit)
+
+			// Merged values may be missing the contributions of cells that
+			// a partition dropped. Ordered descending by a count or sum,
+			// each value is understated by at most the error.
+			if s.pruned {
+				m["approximate"] = true
+				if descending && !s.pruneUnbounded {
+					m["approximate_error"] = s.pruneError
+				}
+			}
+		}
+	}
+	s.pruned, s.pruneError, s.pruneUnbounded = false, 0, false
+	return nil
+}
+
+// Recursively walks dimensions and finalizes fields at the leaves.
+func (s *QuerySelection) finalize(data interface{}, index int) error {
+	inner, ok := data.(map[interface{}]interface{})
+	if !ok {
+		return nil
+	}
+
+	// Finalize the fields once all dimensions have been walked.
+	if index >= len(s.Dimensions) {
+		for _, field := range s.Fields {
+			if err := field.Finalize(inner, s.query.Sample); err != nil {
+				return err
+			}
+		}
+		return nil
+	}
+
+	if outer, ok := inner[s.Dimensions[index]].(map[interface{}]interface{}); ok {
+		for _, v := range outer {
+			if err := s.finalize(v, index+1); err != nil {
+				return err
+			}
+		}
+	}
+	return nil
+}
@@ -1,9 +1,13 @@
 package skyd
 
 import (
+	"bytes"
 	"errors"
 	"fmt"
+	"math"
 	"regexp"
+	"strconv"
+	"strings"
 )
 
 //------------------------------------------------------------------------------
@@ -74,48 +78,276 @@ func (f *QuerySelectionField) Deserialize(obj map[string]interface{}) error {
 // Code Generation
 //--------------------------------------
 
-// Generates Lua code for the expression.
-func (f *QuerySelectionField) CodegenExpression() (string, error) {
-	r, _ := regexp.Compile(`^ *(?:count\(\)|(sum|min|max)\((\w+)\)|(\w+)) *$`)
-	if m := r.FindStringSubmatch(f.Expression); m != nil {
-		if len(m[1]) > 0 { // sum()/min()/max()
-			switch m[1] {
-			case "sum":
-				return fmt.Sprintf("data.%s = (data.%s or 0) + cursor.event:%s()", f.Name, f.Name, m[2]), nil
-			case "min":
-				return fmt.Sprintf("if(data.%s == nil or data.%s > cursor.event:%s()) then data.%s = cursor.event:%s() end", f.Name, f.Name, m[2], f.Name, m[2]), nil
-			case "max":
-				return fmt.Sprintf("if(data.%s == nil or data.%s < cursor.event:%s()) then data.%s = cursor.event:%s() end", f.Name, f.Name, m[2], f.Name, m[2]), nil
-			}
-		} else if len(m[3]) > 0 { // assignment
-			return fmt.Sprintf("data.%s = cursor.event:%s()", f.Name, m[3]), nil
-		} else { // count()
-			return fmt.Sprintf("data.%s = (data.%s or 0) + 1", f.Name, f.Name), nil
+// Splits the expression into its aggregate function, the property it
+// operates on and any numeric arguments. Plain property assignments have a
+// blank function.
+func (f *QuerySelectionField) parse() (string, string, []float64, error) {
+	r, _ := regexp.Compile(`^ *(?:(count|count_objects)\(\)|(sum|min|max|count_distinct|percentile|quantiles)\((@?\w+)((?: *, *[0-9.]+)*) *\)|(@?\w+)) *$`)
+	m := r.FindStringSubmatch(f.Expression)
+	if m == nil || (strings.HasPrefix(m[3]+m[5], "@") && GetVirtualProperty(m[3]+m[5]) == nil) {
+		return "", "", nil, fmt.Errorf("skyd.QuerySelectionField: Invalid expression: %q", f.Expression)
+	}
+	if len(m[1]) > 0 {
+		return m[1], "", nil, nil
+	} else if len(m[5]) > 0 {
+		return "", m[5], nil, nil
+	}
+
+	// Parse the numeric arguments after the property.
+	args := []float64{}
+	for _, str := range strings.Split(m[4], ",")[1:] {
+		arg, err := strconv.ParseFloat(strings.TrimSpace(str), 64)
+		if err != nil {
+			return "", "", nil, fmt.Errorf("skyd.QuerySelectionField: Invalid argument: %q", f.Expression)
 		}
+		args = append(args, arg)
 	}
 
-	return "", fmt.Errorf("skyd.QuerySelectionField: Invalid expression: %q", f.Expression)
+	// Validate the arguments for each function.
+	valid := false
+	switch m[2] {
+	case "percentile":
+		valid = (len(args) == 1 || len(args) == 2) && args[0] >= 0 && args[0] <= 1
+	case "quantiles":
+		valid = len(args) <= 1
+	default:
+		valid = len(args) == 0
+	}
+	if valid {
+		compression := f.compression(m[2], args)
+		valid = compression >= MinTDigestCompression && compression <= MaxTDigestCompression
+	}
+	if !valid {
+		return "", "", nil, fmt.Errorf("skyd.QuerySelectionField: Invalid arguments: %q", f.Expression)
+	}
+	return m[2], m[3], args, nil
+}
+
+// Retrieves the t-digest compression from the optional last argument of a
+// percentile or quantiles expression.
+func (f *QuerySelectionField) compression(fn string, args []float64) float64 {
+	if (fn == "percentile" && len(args) == 2) || (fn == "quantiles" && len(args) == 1) {
+		return args[len(args)-1]
+	}
+	return DefaultTDigestCompression
+}
+
+// Generates Lua code for the expression.
+func (f *QuerySelectionField) CodegenExpression() (string, error) {
+	fn, property, args, err := f.parse()
+	if err != nil {
+		return "", err
+	}
+	switch fn {
+	case "count":
+		return fmt.Sprintf("data.%s = (data.%s or 0) + 1", f.Name, f.Name), nil
+	case "sum":
+		return fmt.Sprintf("data.%s = (data.%s or 0) + %s", f.Name, f.Name, codegenEventValue(property)), nil
+	case "min":
+		return fmt.Sprintf("if(data.%s == nil or data.%s > %s) then data.%s = %s end", f.Name, f.Name, codegenEventValue(property), f.Name, codegenEventValue(property)), nil
+	case "max":
+		return fmt.Sprintf("if(data.%s == nil or data.%s < %s) then data.%s = %s end", f.Name, f.Name, codegenEventValue(property), f.Name, codegenEventValue(property)), nil
+	case "count_distinct":
+		return fmt.Sprintf("if(data.%s == nil) then data.%s = sky_hll(%d) end data.%s:add(%s)", f.Name, f.Name, HLLPrecision, f.Name, codegenEventValue(property)), nil
+	case "count_objects":
+		return fmt.Sprintf("if(data.%s == nil) then data.%s = sky_hll(%d) end data.%s:add_object(cursor)", f.Name, f.Name, HLLPrecision, f.Name), nil
+	case "percentile", "quantiles":
+		return fmt.Sprintf("if(data.%s == nil) then data.%s = sky_tdigest(%v) end data.%s:add(%s)", f.Name, f.Name, f.compression(fn, args), f.Name, codegenEventValue(property)), nil
+	}
+	return fmt.Sprintf("data.%s = %s", f.Name, codegenEventValue(property)), nil
 }
 
 // Generates Lua code for the merge expression.
 func (f *QuerySelectionField) CodegenMergeExpression() (string, error) {
-	r, _ := regexp.Compile(`^ *(?:count\(\)|(sum|min|max)\((\w+)\)|(\w+)) *$`)
-	if m := r.FindStringSubmatch(f.Expression); m != nil {
-		if len(m[1]) > 0 { // sum()/min()/max()
-			switch m[1] {
-			case "sum":
-				return fmt.Sprintf("result.%s = (result.%s or 0) + (data.%s or 0)", f.Name, f.Name, f.Name), nil
-			case "min":
-				return fmt.Sprintf("if(result.%s == nil or result.%s > data.%s) then result.%s = data.%s end", f.Name, f.Name, f.Name, f.Name, f.Name), nil
-			case "max":
-				return fmt.Sprintf("if(result.%s == nil or result.%s < data.%s) then result.%s = data.%s end", f.Name, f.Name, f.Name, f.Name, f.Name), nil
+	fn, _, _, err := f.parse()
+	if err != nil {
+		return "", fmt.Errorf("skyd.QuerySelectionField: Invalid merge expression: %q", f.Expression)
+	}
+	switch fn {
+	case "count", "sum":
+		return fmt.Sprintf("result.%s = (result.%s or 0) + (data.%s or 0)", f.Name, f.Name, f.Name), nil
+	case "min":
+		return fmt.Sprintf("if(result.%s == nil or result.%s > data.%s) then result.%s = data.%s end", f.Name, f.Name, f.Name, f.Name, f.Name), nil
+	case "max":
+		return fmt.Sprintf("if(result.%s == nil or result.%s < data.%s) then result.%s = data.%s end", f.Name, f.Name, f.Name, f.Name, f.Name), nil
+	case "count_distinct", "count_objects":
+		return fmt.Sprintf("result.%s = sky_hll_merge(result.%s, data.%s)", f.Name, f.Name, f.Name), nil
+	case "percentile", "quantiles":
+		return fmt.Sprintf("result.%s = sky_tdigest_merge(result.%s, data.%s)", f.Name, f.Name, f.Name), nil
+	}
+	return fmt.Sprintf("result.%s = data.%s", f.Name, f.Name), nil
+}
+
+// Retrieves the initial value of the field when it is stored in a numeric
+// slot of a group-by table. Only counts, sums, minimums and maximums can be
+// stored in a slot.
+func (f *QuerySelectionField) SlotInitialValue() (string, bool) {
+	fn, _, _, _ := f.parse()
+	switch fn {
+	case "count", "sum":
+		return "0", true
+	case "min":
+		return "math.huge", true
+	case "max":
+		return "-math.huge", true
+	}
+	return "", false
+}
+
+// Generates Lua code to update the field's numeric slot in a group-by table.
+func (f *QuerySelectionField) CodegenSlotExpression(slot string) (string, error) {
+	fn, property, _, err := f.parse()
+	if err != nil {
+		return "", err
+	}
+	switch fn {
+	case "count":
+		return fmt.Sprintf("%s = %s + 1", slot, slot), nil
+	case "sum":
+		return fmt.Sprintf("%s = %s + %s", slot, slot, codegenEventValue(property)), nil
+	case "min":
+		return fmt.Sprintf("do local v = %s; if v < %s then %s = v end end", codegenEventValue(property), slot, slot), nil
+	case "max":
+		return fmt.Sprintf("do local v = %s; if v > %s then %s = v end end", codegenEventValue(property), slot, slot), nil
+	}
+	return "", fmt.Errorf("skyd.QuerySelectionField: Expression cannot be stored in a slot: %q", f.Expression)
+}
+
+// Generates the value an event contributes to a count or sum field. Other
+// fields cannot be scaled from a sample and return a blank string.
+func (f *QuerySelectionField) sampleValue() string {
+	fn, property, _, _ := f.parse()
+	switch fn {
+	case "count":
+		return "1"
+	case "sum":
+		return codegenEventValue(property)
+	}
+	return ""
+}
+
+// Generates Lua code to track the sum of squared per-object totals for a
+// sampled field. This is used to estimate the variance of the scaled value.
+func (f *QuerySelectionField) CodegenSampleExpression() string {
+	value := f.sampleValue()
+	if value == "" {
+		return ""
+	}
+	buffer := new(bytes.Buffer)
+	fmt.Fprintln(buffer, "  do")
+	fmt.Fprintf(buffer, "    local v = %s\n", value)
+	fmt.Fprintf(buffer, "    if data.__%s_o ~= sky_object_index then data.__%s_o = sky_object_index; data.__%s_c = 0 end\n", f.Name, f.Name, f.Name)
+	fmt.Fprintf(buffer, "    data.__%s_sq = (data.__%s_sq or 0) + (2 * data.__%s_c + v) * v\n", f.Name, f.Name, f.Name)
+	fmt.Fprintf(buffer, "    data.__%s_c = data.__%s_c + v\n", f.Name, f.Name)
+	fmt.Fprintln(buffer, "  end")
+	return buffer.String()
+}
+
+// Generates Lua code to merge the sum of squared per-object totals.
+func (f *QuerySelectionField) CodegenSampleMergeExpression() string {
+	if f.sampleValue() == "" {
+		return ""
+	}
+	return fmt.Sprintf("  result.__%s_sq = (result.__%s_sq or 0) + (data.__%s_sq or 0)\n", f.Name, f.Name, f.Name)
+}
+
+//--------------------------------------
+// Finalization
+//--------------------------------------
+
+// Converts sketches to their estimates. Percentile fields are replaced by the
+// value at their quantile and quantiles fields by a map of common quantiles.
+// Sampled distinct object counts are
+// scaled up by the sampling rate. Distinct value counts are not scaled since
+// values are usually shared between sampled and unsampled objects.
+//
+// Sampled counts and sums are scaled up to the full table and a 95%
+// confidence interval is added as "<name>_ci". Objects are sampled
+// independently so the variance of the scaled total is (1-p)/p^2 times the
+// sum of squared object totals.
+func (f *QuerySelectionField) Finalize(data map[interface{}]interface{}, sample float64) error {
+	fn, _, args, _ := f.parse()
+	switch fn {
+	case "percentile", "quantiles":
+		var b []byte
+		switch v := data[f.Name].(type) {
+		case []byte:
+			b = v
+		case string:
+			b = []byte(v)
+		default:
+			return nil
+		}
+		if fn == "percentile" {
+			values, err := TDigestQuantiles(b, args[:1])
+			if err != nil {
+				return err
 			}
-		} else if len(m[3]) > 0 { // assignment
-			return fmt.Sprintf("result.%s = data.%s", f.Name, f.Name), nil
-		} else { // count()
-			return fmt.Sprintf("result.%s = (result.%s or 0) + (data.%s or 0)", f.Name, f.Name, f.Name), nil
+			data[f.Name] = nanToNil(values[0])
+		} else {
+			values, err := TDigestQuantiles(b, QuantilesFieldQuantiles)
+			if err != nil {
+				return err
+			}
+			m := make(map[interface{}]interface{})
+			for i, name := range QuantilesFieldNames {
+				m[name] = nanToNil(values[i])
+			}
+			data[f.Name] = m
+		}
+		return nil
+
+	case "count_distinct", "count_objects":
+		var b []byte
+		switch v := data[f.Name].(type) {
+		case []byte:
+			b = v
+		case string:
+			b = []byte(v)
+		default:
+			return nil
+		}
+		estimate, err := EstimateHLL(b)
+		if err != nil {
+			return err
+		}
+		if fn == "count_objects" && sample > 0 {
+			data[f.Name] = estimate / sample
+		} else {
+			data[f.Name] = int64(math.Floor(estimate + 0.5))
+		}
+		return nil
+	}
+
+	key := fmt.Sprintf("__%s_sq", f.Name)
+	sq, ok := normalize(data[key]).(float64)
+	if !ok {
+		if i, ok := normalize(data[key]).(int64); ok {
+			sq = float64(i)
+		} else {
+			return nil
 		}
 	}
+	delete(data, key)
 
-	return "", fmt.Errorf("skyd.QuerySelectionField: Invalid merge expression: %q", f.Expression)
+	var value float64
+	switch v := normalize(data[f.Name]).(type) {
+	case int64:
+		value = float64(v)
+	case float64:
+		value = v
+	}
+	estimate := value / sample
+	stderr := math.Sqrt((1 - sample) / (sample * sample) * sq)
+	data[f.Name] = estimate
+	data[f.Name+"_ci"] = []interface{}{estimate - 1.96*stderr, estimate + 1.96*stderr}
+	return nil
+}
+
+// Converts NaN values to nil since they cannot be encoded as JSON.
+func nanToNil(value float64) interface{} {
+	if math.IsNaN(value) {
+		return nil
+	}
+	return value
 }
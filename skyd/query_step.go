@@ -14,6 +14,9 @@ import (
 const (
 	QueryStepTypeCondition = "condition"
 	QueryStepTypeSelection = "selection"
+	QueryStepTypeFunnel    = "funnel"
+	QueryStepTypeRetention = "retention"
+	QueryStepTypePaths     = "paths"
 )
 
 //------------------------------------------------------------------------------
@@ -31,6 +34,8 @@ type QueryStep interface {
 	CodegenAggregateFunction() (string, error)
 	CodegenMergeFunction() (string, error)
 	Defactorize(data interface{}) error
+	Prune(data interface{}, partitions int) error
+	Finalize(data interface{}) error
 }
 
 type QueryStepList []QueryStep
@@ -66,6 +71,12 @@ func DeserializeQueryStepList(obj interface{}, q *Query) (QueryStepList, error)
 					step = NewQueryCondition(q)
 				case QueryStepTypeSelection:
 					step = NewQuerySelection(q)
+				case QueryStepTypeFunnel:
+					step = NewQueryFunnel(q)
+				case QueryStepTypeRetention:
+					step = NewQueryRetention(q)
+				case QueryStepTypePaths:
+					step = NewQueryPaths(q)
 				default:
 					return nil, fmt.Errorf("Invalid query step type: %v", s["type"])
 				}
@@ -146,3 +157,33 @@ func (l QueryStepList) Defactorize(data interface{}) error {
 	}
 	return nil
 }
+
+//--------------------------------------
+// Pruning
+//--------------------------------------
+
+// Prunes the results of a single partition for all steps.
+func (l QueryStepList) Prune(data interface{}, partitions int) error {
+	for _, step := range l {
+		err := step.Prune(data, partitions)
+		if err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+//--------------------------------------
+// Finalization
+//--------------------------------------
+
+// Finalizes merged results for all steps.
+func (l QueryStepList) Finalize(data interface{}) error {
+	for _, step := range l {
+		err := step.Finalize(data)
+		if err != nil {
+			return err
+		}
+	}
+	return nil
+}
@@ -2,6 +2,7 @@ package skyd
 
 import (
 	"bytes"
+	"fmt"
 	"testing"
 )
 
@@ -28,3 +29,100 @@ func TestQueryEncodeDecode(t *testing.T) {
 		t.Fatalf("Query encoding error:\nexp: %s\ngot: %s", json, buffer.String())
 	}
 }
+
+// Ensure that pruned counts are marked as approximate with an error bound.
+func TestQueryPruneApproximate(t *testing.T) {
+	table := createTempTable(t)
+	table.Open()
+	defer table.Close()
+
+	q := NewQuery(table, nil)
+	json := `{"steps":[{"type":"selection","dimensions":["page"],"orderBy":"count","limit":1,"fields":[{"name":"count","expression":"count()"}]}]}`
+	if err := q.Decode(bytes.NewBufferString(json)); err != nil {
+		t.Fatalf("Query decoding error: %v", err)
+	}
+
+	// Each partition keeps 12 candidates for a limit of one.
+	data := func(n int) map[interface{}]interface{} {
+		cells := map[interface{}]interface{}{}
+		for i := 0; i < n; i++ {
+			cells[fmt.Sprintf("/%02d", i)] = map[interface{}]interface{}{"count": int64(100 - i)}
+		}
+		return map[interface{}]interface{}{"page": cells}
+	}
+
+	results := data(20)
+	if err := q.Prune(results, 2); err != nil {
+		t.Fatalf("Prune error: %v", err)
+	}
+	if err := q.Finalize(results); err != nil {
+		t.Fatalf("Finalize error: %v", err)
+	}
+	if results["approximate"] != true || results["approximate_error"] != float64(89) {
+		t.Fatalf("Expected an approximate result: %v", results)
+	}
+	if len(results["page"].(map[interface{}]interface{})) != 1 {
+		t.Fatalf("Expected a single cell: %v", results)
+	}
+
+	// Nothing is dropped when every cell is a candidate.
+	results = data(12)
+	q.Prune(results, 2)
+	q.Finalize(results)
+	if _, ok := results["approximate"]; ok {
+		t.Fatalf("Unexpected approximate result: %v", results)
+	}
+}
+
+// Ensure that pruning by an exact order field marks the other fields as
+// approximate.
+func TestQueryPruneExactOrderApproximate(t *testing.T) {
+	table := createTempTable(t)
+	table.Open()
+	defer table.Close()
+
+	decode := func(json string) *Query {
+		q := NewQuery(table, nil)
+		if err := q.Decode(bytes.NewBufferString(json)); err != nil {
+			t.Fatalf("Query decoding error: %v", err)
+		}
+		return q
+	}
+	data := func() map[interface{}]interface{} {
+		cells := map[interface{}]interface{}{}
+		for i := 0; i < 4; i++ {
+			cells[fmt.Sprintf("/%02d", i)] = map[interface{}]interface{}{"top": float64(100 - i), "count": int64(i + 1)}
+		}
+		return map[interface{}]interface{}{"page": cells}
+	}
+
+	// The count of a kept cell may be missing another partition's events.
+	q := decode(`{"steps":[{"type":"selection","dimensions":["page"],"orderBy":"top","limit":1,"fields":[{"name":"top","expression":"max(price)"},{"name":"count","expression":"count()"}]}]}`)
+	results := data()
+	q.Prune(results, 2)
+	q.Finalize(results)
+	if results["approximate"] != true {
+		t.Fatalf("Expected an approximate result: %v", results)
+	}
+	if _, ok := results["approximate_error"]; ok {
+		t.Fatalf("Unexpected error bound: %v", results)
+	}
+
+	// The order field alone is exact.
+	q = decode(`{"steps":[{"type":"selection","dimensions":["page"],"orderBy":"top","limit":1,"fields":[{"name":"top","expression":"max(price)"}]}]}`)
+	results = data()
+	q.Prune(results, 2)
+	q.Finalize(results)
+	if _, ok := results["approximate"]; ok {
+		t.Fatalf("Unexpected approximate result: %v", results)
+	}
+
+	// So is a single partition.
+	q = decode(`{"steps":[{"type":"selection","dimensions":["page"],"orderBy":"top","limit":1,"fields":[{"name":"top","expression":"max(price)"},{"name":"count","expression":"count()"}]}]}`)
+	results = data()
+	q.Prune(results, 1)
+	q.Finalize(results)
+	if _, ok := results["approximate"]; ok {
+		t.Fatalf("Unexpected approximate result: %v", results)
+	}
+}
@@ -0,0 +1,45 @@
+package skyd
+
+/*
+#cgo LDFLAGS: -lcsky -lm
+#include <stdlib.h>
+#include <sky/retention.h>
+*/
+import "C"
+
+import (
+	"errors"
+	"time"
+	"unsafe"
+)
+
+// A row of a retention matrix. The first count is the size of the cohort.
+type RetentionRow struct {
+	Cohort time.Time
+	Counts []int64
+}
+
+// Decodes the rows of a serialized retention matrix, ordered by cohort.
+func RetentionRows(data []byte) ([]*RetentionRow, error) {
+	if len(data) == 0 {
+		return nil, errors.New("skyd: Invalid retention matrix")
+	}
+	retention := C.sky_retention_unpack(unsafe.Pointer(&data[0]), (C.size_t)(len(data)))
+	if retention == nil {
+		return nil, errors.New("skyd: Invalid retention matrix")
+	}
+	defer C.sky_retention_free(retention)
+
+	rows := make([]*RetentionRow, 0, int(retention.row_count))
+	for i := C.uint32_t(0); i < retention.row_count; i++ {
+		row := &RetentionRow{
+			Cohort: time.Unix(int64(C.sky_retention_cohort_timestamp(retention, i)), 0).UTC(),
+			Counts: make([]int64, int(retention.periods)),
+		}
+		for j := C.uint32_t(0); j < retention.periods; j++ {
+			row.Counts[j] = int64(C.sky_retention_count(retention, i, j))
+		}
+		rows = append(rows, row)
+	}
+	return rows, nil
+}
@@ -17,6 +17,8 @@ import (
 	"os"
 	"regexp"
 	"runtime"
+	"sort"
+	"sync"
 	"time"
 )
 
@@ -36,7 +38,27 @@ type Server struct {
 	servlets        []*Servlet
 	tables          map[string]*Table
 	factors         *Factors
+	expiry          *Expiry
 	shutdownChannel chan bool
+	queryMutex      sync.Mutex
+	queryQueues     map[string]*queryQueue
+	queryCache      *QueryCache
+}
+
+// A queryQueue holds the queries waiting to run against a single table.
+type queryQueue struct {
+	pending []*queryRequest
+	running bool
+}
+
+// A queryRequest is a single query waiting on a batched execution.
+type queryRequest struct {
+	query  *Query
+	result interface{}
+	err    error
+	leader bool
+	done   bool
+	wake   chan bool
 }
 
 //------------------------------------------------------------------------------
@@ -68,11 +90,13 @@ func (e *TextPlainContentTypeError) Error() string {
 func NewServer(port uint, path string) *Server {
 	r := mux.NewRouter()
 	s := &Server{
-		httpServer: &http.Server{Addr: fmt.Sprintf(":%d", port), Handler: r},
-		router:     r,
-		logger:     log.New(os.Stdout, "", log.LstdFlags),
-		path:       path,
-		tables:     make(map[string]*Table),
+		httpServer:  &http.Server{Addr: fmt.Sprintf(":%d", port), Handler: r},
+		router:      r,
+		logger:      log.New(os.Stdout, "", log.LstdFlags),
+		path:        path,
+		tables:      make(map[string]*Table),
+		queryQueues: make(map[string]*queryQueue),
+		queryCache:  NewQueryCache(DefaultQueryCacheSize),
 	}
 
 	s.router.HandleFunc("/debug/pprof", pprof.Index)
@@ -85,6 +109,7 @@ func NewServer(port uint, path string) *Server {
 	s.addPropertyHandlers()
 	s.addEventHandlers()
 	s.addQueryHandlers()
+	s.addViewHandlers()
 
 	return s
 }
@@ -120,6 +145,11 @@ func (s *Server) FactorsPath() string {
 	return fmt.Sprintf("%v/factors", s.path)
 }
 
+// The cache of query results.
+func (s *Server) QueryCache() *QueryCache {
+	return s.queryCache
+}
+
 //------------------------------------------------------------------------------
 //
 // Methods
@@ -198,6 +228,28 @@ func (s *Server) open() error {
 		return err
 	}
 
+	// Expire events from tables with a retention period as they compact.
+	s.expiry = NewExpiry()
+	if s.expiry == nil {
+		s.close()
+		return errors.New("skyd.Server: Unable to create expiry")
+	}
+	tables, err := s.GetAllTables()
+	if err != nil {
+		s.close()
+		return err
+	}
+	for _, table := range tables {
+		if err = table.LoadSettings(); err != nil {
+			s.close()
+			return err
+		}
+		if err = s.expiry.SetRetention(table.Name, table.Retention); err != nil {
+			s.close()
+			return err
+		}
+	}
+
 	// Create servlets from child directories with numeric names.
 	infos, err := ioutil.ReadDir(s.DataPath())
 	if err != nil {
@@ -206,7 +258,7 @@ func (s *Server) open() error {
 	for _, info := range infos {
 		match, _ := regexp.MatchString("^\\d$", info.Name())
 		if info.IsDir() && match {
-			s.servlets = append(s.servlets, NewServlet(fmt.Sprintf("%s/%s", s.DataPath(), info.Name()), s.factors))
+			s.servlets = append(s.servlets, NewServlet(fmt.Sprintf("%s/%s", s.DataPath(), info.Name()), s.factors, s.expiry))
 		}
 	}
 
@@ -214,7 +266,7 @@ func (s *Server) open() error {
 	if len(s.servlets) == 0 {
 		cpuCount := runtime.NumCPU()
 		for i := 0; i < cpuCount; i++ {
-			s.servlets = append(s.servlets, NewServlet(fmt.Sprintf("%s/%v", s.DataPath(), i), s.factors))
+			s.servlets = append(s.servlets, NewServlet(fmt.Sprintf("%s/%v", s.DataPath(), i), s.factors, s.expiry))
 		}
 	}
 
@@ -240,6 +292,12 @@ func (s *Server) close() {
 		s.servlets = nil
 	}
 
+	// Release the expiry once no servlet uses it.
+	if s.expiry != nil {
+		s.expiry.Close()
+		s.expiry = nil
+	}
+
 	// Close factors database.
 	if s.factors != nil {
 		s.factors.Close()
@@ -440,6 +498,20 @@ func (s *Server) OpenTable(name string) (*Table, error) {
 	return table, nil
 }
 
+// Sets the number of seconds that a table's events are kept for. Older
+// events are removed as the servlets compact. A retention of zero keeps
+// every event.
+func (s *Server) SetTableRetention(table *Table, retention int64) error {
+	if retention < 0 {
+		return fmt.Errorf("Invalid retention: %v", retention)
+	}
+	table.Retention = retention
+	if err := table.SaveSettings(); err != nil {
+		return err
+	}
+	return s.expiry.SetRetention(table.Name, retention)
+}
+
 // Deletes a table.
 func (s *Server) DeleteTable(name string) error {
 	// Return an error if the table doesn't exist.
@@ -457,52 +529,301 @@ func (s *Server) DeleteTable(name string) error {
 		return err
 	}
 
-	// Delete data from each servlet.
+	// Delete data from each servlet with a single range deletion.
+	end := prefixSuccessor(prefix)
+	if end == nil {
+		return fmt.Errorf("Invalid table prefix: %s", name)
+	}
+	wo := levigo.NewWriteOptions()
+	defer wo.Close()
 	for _, servlet := range s.servlets {
 		servlet.Lock()
-		defer servlet.Unlock()
-
-		// Delete the data from disk.
-		ro := levigo.NewReadOptions()
-		defer ro.Close()
-		wo := levigo.NewWriteOptions()
-		defer wo.Close()
-		iterator := servlet.db.NewIterator(ro)
-		defer iterator.Close()
-
-		iterator.Seek(prefix)
-		for iterator = iterator; iterator.Valid(); iterator.Next() {
-			key := iterator.Key()
-			if bytes.HasPrefix(key, prefix) {
-				err := servlet.db.Delete(wo, key)
-				if err != nil {
-					return err
-				}
-			} else {
-				break
-			}
+		err := deleteRange(servlet.db, wo, prefix, end)
+		servlet.Unlock()
+		if err != nil {
+			return err
 		}
 	}
 
 	// Remove the table from the lookup and remove it's schema.
+	if err = s.expiry.SetRetention(table.Name, 0); err != nil {
+		return err
+	}
+	table.IncrementVersion()
+	s.queryCache.Purge(name)
 	delete(s.tables, name)
 	return table.Delete()
 }
 
+//--------------------------------------
+// Views
+//--------------------------------------
+
+// Retrieves the finalized results of a view. The results are recomputed with
+// a full scan if they have been invalidated since the last read.
+func (s *Server) GetViewResult(table *Table, view *View) (interface{}, error) {
+	result, err := s.getViewResult(table, view)
+	if err != nil {
+		return nil, err
+	}
+
+	// Finalize a copy so the view keeps its mergeable results.
+	result = CopyResult(result)
+	if err = view.Query().Finalize(result); err != nil {
+		return nil, err
+	}
+	return result, nil
+}
+
+// Retrieves the unfinalized results of a view, rebuilding them if needed.
+func (s *Server) getViewResult(table *Table, view *View) (interface{}, error) {
+	if result, ok := view.Result(); ok {
+		return result, nil
+	}
+
+	// Only allow one rebuild of a view at a time.
+	view.buildMutex.Lock()
+	defer view.buildMutex.Unlock()
+	if result, ok := view.Result(); ok {
+		return result, nil
+	}
+
+	// Lock all servlets so that the iterators and the start of the build
+	// represent the same point in time.
+	for _, servlet := range s.servlets {
+		servlet.Lock()
+	}
+	view.beginBuild()
+	iterators := s.newIterators()
+	for _, servlet := range s.servlets {
+		servlet.Unlock()
+	}
+
+	// Recompute the results and resume incremental updates.
+	var result interface{}
+	results, err := s.runQueries(table, []*Query{view.Query()}, iterators, false)
+	if err == nil {
+		result = results[0]
+	}
+	if err = view.endBuild(result, err); err != nil {
+		return nil, err
+	}
+	if r, ok := view.Result(); ok {
+		return r, nil
+	}
+	return result, nil
+}
+
 //--------------------------------------
 // Query
 //--------------------------------------
 
-// Runs a query against a table.
+// Runs a query against a table. Results are served from the query cache
+// while the table is unchanged. Queries that arrive for a table while another
+// batch is scanning it are queued and executed together as a single batch
+// once the current batch finishes.
 func (s *Server) RunQuery(table *Table, query *Query) (interface{}, error) {
+	// Check the cache first. The version is read before the query runs so
+	// that any write during the scan invalidates the result.
+	version := table.Version()
+	key, err := s.queryCache.Key(query)
+	if err != nil {
+		return nil, err
+	}
+	if result, ok := s.queryCache.Get(table, key, version); ok {
+		return result, nil
+	}
+
+	result, err := s.runQuery(table, query)
+	if err == nil {
+		s.queryCache.Put(table, key, version, result)
+	}
+	return result, err
+}
+
+// Runs a query through the table's batch queue.
+func (s *Server) runQuery(table *Table, query *Query) (interface{}, error) {
+	r := &queryRequest{query: query, wake: make(chan bool, 1)}
+
+	// Add the request to the table's queue. The first request on an idle
+	// queue becomes the leader and runs the batch.
+	s.queryMutex.Lock()
+	q := s.queryQueues[table.Name]
+	if q == nil {
+		q = &queryQueue{}
+		s.queryQueues[table.Name] = q
+	}
+	q.pending = append(q.pending, r)
+	if !q.running {
+		q.running = true
+		r.leader = true
+	}
+	s.queryMutex.Unlock()
+
+	// Wait until the request is either finished or promoted to leader.
+	if !r.leader {
+		<-r.wake
+	}
+	if r.done {
+		return r.result, r.err
+	}
+
+	// Take as many pending requests as fit into a single batch. Queries in a
+	// batch share a scan so they must use the same sample, timezone and
+	// objects.
+	s.queryMutex.Lock()
+	requests := make([]*queryRequest, 0)
+	remaining := make([]*queryRequest, 0)
+	for _, req := range q.pending {
+		if len(requests) < MaxQueryBatchSize && req.query.Sample == r.query.Sample && req.query.Timezone == r.query.Timezone && req.query.SameObjects(r.query) {
+			requests = append(requests, req)
+		} else {
+			remaining = append(remaining, req)
+		}
+	}
+	q.pending = remaining
+	s.queryMutex.Unlock()
+
+	s.runQueryRequests(table, requests)
+
+	// Hand leadership off to the next pending request.
+	s.queryMutex.Lock()
+	if len(q.pending) > 0 {
+		q.pending[0].leader = true
+		q.pending[0].wake <- true
+	} else {
+		q.running = false
+	}
+	s.queryMutex.Unlock()
+
+	// Notify the other requests in the batch.
+	for _, req := range requests {
+		if req != r {
+			req.wake <- true
+		}
+	}
+
+	return r.result, r.err
+}
+
+// Executes a set of queued query requests as a single batch.
+func (s *Server) runQueryRequests(table *Table, requests []*queryRequest) {
+	// Generate code for each query separately first so that an invalid query
+	// does not fail the rest of the batch.
+	queries := make([]*Query, 0, len(requests))
+	valid := make([]*queryRequest, 0, len(requests))
+	for _, r := range requests {
+		r.done = true
+		if _, err := r.query.Codegen(); err != nil {
+			r.err = err
+			continue
+		}
+		queries = append(queries, r.query)
+		valid = append(valid, r)
+	}
+	if len(queries) == 0 {
+		return
+	}
+
+	results, err := s.RunQueries(table, queries)
+	for i, r := range valid {
+		if err != nil {
+			r.err = err
+		} else {
+			r.result = results[i]
+		}
+	}
+}
+
+// Runs several queries against a table with a single scan over each servlet.
+// The results are returned in the same order as the queries.
+func (s *Server) RunQueries(table *Table, queries []*Query) ([]interface{}, error) {
+	results, err := s.runQueries(table, queries, s.newIterators(), true)
+	if err != nil {
+		return nil, err
+	}
+	if err = NewQueryBatch(table, queries).Finalize(results); err != nil {
+		return nil, err
+	}
+	return results, nil
+}
+
+// Creates an iterator over each servlet. Servlets should be locked by the
+// caller if the iterators need to represent a consistent point in time.
+func (s *Server) newIterators() []*levigo.Iterator {
+	iterators := make([]*levigo.Iterator, 0, len(s.servlets))
+	for _, servlet := range s.servlets {
+		iterators = append(iterators, servlet.newScanIterator())
+	}
+	return iterators
+}
+
+// Encodes a list of object identifiers and groups the keys by the servlet
+// that stores each object. The keys for each servlet are sorted and unique
+// so they can be read in order.
+func (s *Server) objectKeys(table *Table, objectIds []string) ([][][]byte, error) {
+	keys := make([][][]byte, len(s.servlets))
+	for index := range keys {
+		keys[index] = [][]byte{}
+	}
+	for _, objectId := range objectIds {
+		index, err := s.GetObjectServletIndex(table, objectId)
+		if err != nil {
+			return nil, err
+		}
+		key, err := table.EncodeObjectId(objectId)
+		if err != nil {
+			return nil, err
+		}
+		keys[index] = append(keys[index], key)
+	}
+	for index, k := range keys {
+		sort.Sort(KeyList(k))
+		unique := k[:0]
+		for i, key := range k {
+			if i == 0 || !bytes.Equal(key, k[i-1]) {
+				unique = append(unique, key)
+			}
+		}
+		keys[index] = unique
+	}
+	return keys, nil
+}
+
+// Runs several queries with a single scan over a set of servlet iterators.
+// The engines take ownership of the iterators. The results are merged but not
+// finalized so that they can still be merged with other results. Each
+// servlet's results are pruned to the limits of the queries before merging
+// unless every cell needs to be kept.
+func (s *Server) runQueries(table *Table, queries []*Query, iterators []*levigo.Iterator, prune bool) ([]interface{}, error) {
 	var engine *ExecutionEngine
 	engines := make([]*ExecutionEngine, 0)
+	batch := NewQueryBatch(table, queries)
+	sample, err := batch.Sample()
+	if err != nil {
+		return nil, err
+	}
+	location, err := batch.Location()
+	if err != nil {
+		return nil, err
+	}
+	objectIds, err := batch.ObjectIds()
+	if err != nil {
+		return nil, err
+	}
+
+	// Close any iterators that were not handed off to an engine.
+	defer func() {
+		for _, iterator := range iterators[len(engines):] {
+			iterator.Close()
+		}
+	}()
 
 	// Create a channel to receive aggregate responses.
 	rchannel := make(chan interface{}, len(s.servlets))
 
 	// Generate the query source code.
-	source, err := query.Codegen()
+	source, err := batch.Codegen()
 	if err != nil {
 		return nil, err
 	}
@@ -515,8 +836,16 @@ func (s *Server) RunQuery(table *Table, query *Query) (interface{}, error) {
 	defer engine.Destroy()
 	//fmt.Println(engine.FullAnnotatedSource())
 
+	// Group the keys of a subset of objects by servlet.
+	var objectKeys [][][]byte
+	if objectIds != nil {
+		if objectKeys, err = s.objectKeys(table, objectIds); err != nil {
+			return nil, err
+		}
+	}
+
 	// Initialize one execution engine for each servlet.
-	for _, servlet := range s.servlets {
+	for index, _ := range s.servlets {
 		// Create an engine for each servlet.
 		e, err := NewExecutionEngine(table, source)
 		if err != nil {
@@ -524,14 +853,19 @@ func (s *Server) RunQuery(table *Table, query *Query) (interface{}, error) {
 		}
 
 		// Initialize iterator.
-		ro := levigo.NewReadOptions()
-		iterator := servlet.db.NewIterator(ro)
-		err = e.SetIterator(iterator)
-		if err != nil {
+		e.SetSample(sample)
+		if err = e.SetLocation(location); err != nil {
+			e.Destroy()
 			return nil, err
 		}
-
+		err = e.SetIterator(iterators[index])
 		engines = append(engines, e)
+		if err != nil {
+			return nil, err
+		}
+		if objectKeys != nil {
+			e.SetObjectKeys(objectKeys[index])
+		}
 	}
 
 	// Execute servlets asynchronously and retrieve responses outside
@@ -558,11 +892,18 @@ func (s *Server) RunQuery(table *Table, query *Query) (interface{}, error) {
 			servletError = err
 		} else {
 			// Defactorize aggregate results.
-			err = query.Defactorize(ret)
+			err = batch.Defactorize(ret)
 			if err != nil {
 				return nil, err
 			}
 
+			// Drop cells that cannot make it into a limit.
+			if prune {
+				if err = batch.Prune(ret, len(s.servlets)); err != nil {
+					return nil, err
+				}
+			}
+
 			// Merge results.
 			if ret != nil {
 				result, err = engine.Merge(result, ret)
@@ -580,6 +921,9 @@ func (s *Server) RunQuery(table *Table, query *Query) (interface{}, error) {
 	for _, e := range engines {
 		e.Destroy()
 	}
+	if err != nil {
+		return nil, err
+	}
 
-	return result, err
+	return batch.Demultiplex(result)
 }
@@ -8,9 +8,17 @@ func (s *Server) addHandlers() {
 	s.ApiHandleFunc("/ping", func(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
 		return s.pingHandler(w, req, params)
 	}).Methods("GET")
+	s.ApiHandleFunc("/cache/stats", func(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
+		return s.cacheStatsHandler(w, req, params)
+	}).Methods("GET")
 }
 
 // GET /ping
 func (s *Server) pingHandler(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
 	return map[string]interface{}{"message": "ok"}, nil
 }
+
+// GET /cache/stats
+func (s *Server) cacheStatsHandler(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
+	return s.queryCache.Stats(), nil
+}
@@ -1,6 +1,8 @@
 package skyd
 
 import (
+	"errors"
+	"fmt"
 	"github.com/gorilla/mux"
 	"net/http"
 )
@@ -12,6 +14,9 @@ func (s *Server) addQueryHandlers() {
 	s.ApiHandleFunc("/tables/{name}/query", func(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
 		return s.queryHandler(w, req, params)
 	}).Methods("POST")
+	s.ApiHandleFunc("/tables/{name}/queries", func(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
+		return s.queriesHandler(w, req, params)
+	}).Methods("POST")
 	s.ApiHandleFunc("/tables/{name}/query/codegen", func(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
 		return s.queryCodegenHandler(w, req, params)
 	}).Methods("POST")
@@ -56,6 +61,39 @@ func (s *Server) queryHandler(w http.ResponseWriter, req *http.Request, params m
 	return s.RunQuery(table, query)
 }
 
+// POST /tables/:name/queries
+func (s *Server) queriesHandler(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
+	vars := mux.Vars(req)
+
+	table, err := s.OpenTable(vars["name"])
+	if err != nil {
+		return nil, err
+	}
+
+	// Deserialize each query.
+	items, ok := params["queries"].([]interface{})
+	if !ok || len(items) == 0 {
+		return nil, errors.New("skyd.Server: At least one query is required")
+	}
+	if len(items) > MaxQueryBatchSize {
+		return nil, fmt.Errorf("skyd.Server: Too many queries: %d (max %d)", len(items), MaxQueryBatchSize)
+	}
+	queries := make([]*Query, 0, len(items))
+	for _, item := range items {
+		obj, ok := item.(map[string]interface{})
+		if !ok {
+			return nil, fmt.Errorf("skyd.Server: Invalid query: %v", item)
+		}
+		query := NewQuery(table, s.factors)
+		if err = query.Deserialize(obj); err != nil {
+			return nil, err
+		}
+		queries = append(queries, query)
+	}
+
+	return s.RunQueries(table, queries)
+}
+
 // POST /tables/:name/query/codegen
 func (s *Server) queryCodegenHandler(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
 	vars := mux.Vars(req)
@@ -1,6 +1,10 @@
 package skyd
 
 import (
+	"encoding/json"
+	"fmt"
+	"math"
+	"sync"
 	"testing"
 )
 
@@ -36,6 +40,220 @@ func TestServerSimpleCountQuery(t *testing.T) {
 	})
 }
 
+// Ensure that multiple queries can be run with a single request.
+func TestServerMultipleQueries(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "fruit", true, "string")
+		setupTestProperty("foo", "num", true, "float")
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-01T00:00:00Z", `{"data":{"fruit":"apple","num":1}}`},
+			[]string{"a1", "2012-01-01T00:00:00Z", `{"data":{"fruit":"grape","num":2}}`},
+			[]string{"a1", "2012-01-01T00:00:01Z", `{"data":{"fruit":"apple","num":3}}`},
+			[]string{"a2", "2012-01-01T00:00:00Z", `{"data":{"fruit":"orange","num":4}}`},
+		})
+
+		// Run queries.
+		query := `{
+			"queries":[
+				{"steps":[{"type":"selection","dimensions":[],"fields":[{"name":"count","expression":"count()"}]}]},
+				{"steps":[{"type":"selection","dimensions":["fruit"],"fields":[{"name":"total","expression":"sum(num)"}]}]},
+				{"steps":[{"type":"condition","expression":"fruit == 'apple'","steps":[{"type":"selection","dimensions":[],"fields":[{"name":"count","expression":"count()"}]}]}]}
+			]
+		}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/queries", "application/json", query)
+		assertResponse(t, resp, 200, `[{"count":4},{"fruit":{"apple":{"total":4},"grape":{"total":2},"orange":{"total":4}}},{"count":2}]`+"\n", "POST /tables/:name/queries failed.")
+	})
+}
+
+// Ensure that concurrent queries on the same table return their own results.
+func TestServerConcurrentQueries(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "num", true, "float")
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-01T00:00:00Z", `{"data":{"num":1}}`},
+			[]string{"a1", "2012-01-01T00:00:00Z", `{"data":{"num":2}}`},
+			[]string{"a2", "2012-01-01T00:00:00Z", `{"data":{"num":3}}`},
+		})
+
+		// Run the same queries concurrently.
+		count := `{"steps":[{"type":"selection","dimensions":[],"fields":[{"name":"count","expression":"count()"}]}]}`
+		sum := `{"steps":[{"type":"selection","dimensions":[],"fields":[{"name":"sum","expression":"sum(num)"}]}]}`
+		var wg sync.WaitGroup
+		for i := 0; i < 10; i++ {
+			wg.Add(2)
+			go func() {
+				defer wg.Done()
+				resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", count)
+				assertResponse(t, resp, 200, `{"count":3}`+"\n", "POST /tables/:name/query failed.")
+			}()
+			go func() {
+				defer wg.Done()
+				resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", sum)
+				assertResponse(t, resp, 200, `{"sum":6}`+"\n", "POST /tables/:name/query failed.")
+			}()
+		}
+		wg.Wait()
+	})
+}
+
+// Ensure that repeated queries are served from the cache until the data changes.
+func TestServerCachedQuery(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "fruit", true, "string")
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-01T00:00:00Z", `{"data":{"fruit":"apple"}}`},
+		})
+
+		query := `{"steps":[{"type":"selection","dimensions":[],"fields":[{"name":"count","expression":"count()"}]}]}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"count":1}`+"\n", "POST /tables/:name/query failed.")
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"count":1}`+"\n", "POST /tables/:name/query failed.")
+
+		// Adding data should invalidate the cached result.
+		setupTestData(t, "foo", [][]string{
+			[]string{"a1", "2012-01-01T00:00:00Z", `{"data":{"fruit":"grape"}}`},
+		})
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"count":2}`+"\n", "POST /tables/:name/query failed.")
+
+		resp, _ = sendTestHttpRequest("GET", "http://localhost:8586/cache/stats", "application/json", "")
+		assertResponse(t, resp, 200, `{"count":1,"evictions":0,"hits":1,"maxSize":67108864,"misses":2,"size":140}`+"\n", "GET /cache/stats failed.")
+	})
+}
+
+// Ensure that sampled queries scale counts and sums and report error bounds.
+func TestServerSampledQuery(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "num", true, "float")
+		items := make([][]string, 0)
+		for i := 0; i < 200; i++ {
+			items = append(items, []string{fmt.Sprintf("o%d", i), "2012-01-01T00:00:00Z", `{"data":{"num":2}}`})
+			items = append(items, []string{fmt.Sprintf("o%d", i), "2012-01-01T00:00:01Z", `{"data":{"num":3}}`})
+		}
+		setupTestData(t, "foo", items)
+
+		query := `{"sample":0.5,"steps":[{"type":"selection","dimensions":[],"fields":[{"name":"count","expression":"count()"},{"name":"total","expression":"sum(num)"},{"name":"hi","expression":"max(num)"}]}]}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		defer resp.Body.Close()
+		var result map[string]interface{}
+		if err := json.NewDecoder(resp.Body).Decode(&result); err != nil {
+			t.Fatalf("Unable to decode response: %v", err)
+		}
+
+		// Objects are sampled as a whole so every count is a multiple of 2 events / 0.5.
+		count, total := result["count"].(float64), result["total"].(float64)
+		if count == 0 || count == 400 || int(count)%4 != 0 || total != count*2.5 {
+			t.Fatalf("Unexpected scaled values: %v", result)
+		}
+		ci := result["count_ci"].([]interface{})
+		if ci[0].(float64) > 400 || ci[1].(float64) < 400 {
+			t.Fatalf("Confidence interval does not contain the true count: %v", ci)
+		}
+		if result["hi"] != float64(3) || result["hi_ci"] != nil || result["__count_sq"] != nil {
+			t.Fatalf("Unexpected unscaled values: %v", result)
+		}
+	})
+}
+
+// Ensure that we can count distinct values and objects with sketches.
+func TestServerDistinctCountQuery(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "fruit", true, "string")
+		setupTestProperty("foo", "num", true, "float")
+		fruits := []string{"apple", "grape", "orange", "pear", "kiwi"}
+		items := make([][]string, 0)
+		for i := 0; i < 100; i++ {
+			for j := 0; j < 3; j++ {
+				timestamp := fmt.Sprintf("2012-01-01T00:00:0%dZ", j)
+				data := fmt.Sprintf(`{"data":{"fruit":"%s","num":%d}}`, fruits[(i+j)%5], (i*3+j)%37)
+				items = append(items, []string{fmt.Sprintf("o%d", i), timestamp, data})
+			}
+		}
+		setupTestData(t, "foo", items)
+
+		// Estimates are within a few percent of the exact counts.
+		assertNear := func(name string, value float64, expected float64) {
+			if math.Abs(value-expected) > expected*0.03 {
+				t.Fatalf("Unexpected %s estimate: %v (expected %v)", name, value, expected)
+			}
+		}
+
+		query := `{"steps":[{"type":"selection","dimensions":[],"fields":[{"name":"fruits","expression":"count_distinct(fruit)"},{"name":"nums","expression":"count_distinct(num)"},{"name":"objects","expression":"count_objects()"}]}]}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		var total map[string]float64
+		if err := json.NewDecoder(resp.Body).Decode(&total); err != nil {
+			t.Fatalf("Unable to decode response: %v", err)
+		}
+		resp.Body.Close()
+		assertNear("fruits", total["fruits"], 5)
+		assertNear("nums", total["nums"], 37)
+		assertNear("objects", total["objects"], 100)
+
+		query = `{"steps":[{"type":"selection","dimensions":["fruit"],"fields":[{"name":"fruits","expression":"count_distinct(fruit)"},{"name":"objects","expression":"count_objects()"},{"name":"count","expression":"count()"}]}]}`
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		defer resp.Body.Close()
+		var result map[string]map[string]map[string]float64
+		if err := json.NewDecoder(resp.Body).Decode(&result); err != nil {
+			t.Fatalf("Unable to decode response: %v", err)
+		}
+		if len(result["fruit"]) != 5 {
+			t.Fatalf("Unexpected results: %v", result)
+		}
+		for fruit, data := range result["fruit"] {
+			assertNear(fruit+" fruits", data["fruits"], 1)
+			assertNear(fruit+" objects", data["objects"], 60)
+			assertNear(fruit+" count", data["count"], 60)
+		}
+	})
+}
+
+// Ensure that we can estimate percentiles of a numeric property.
+func TestServerPercentileQuery(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "amount", true, "float")
+		items := make([][]string, 0)
+		for i := 0; i < 1000; i++ {
+			timestamp := fmt.Sprintf("2012-01-01T00:00:%02dZ", i/100)
+			items = append(items, []string{fmt.Sprintf("o%d", i%100), timestamp, fmt.Sprintf(`{"data":{"amount":%d}}`, (i*7)%1000+1)})
+		}
+		setupTestData(t, "foo", items)
+
+		query := `{"steps":[{"type":"selection","dimensions":[],"fields":[{"name":"median","expression":"percentile(amount, 0.5)"},{"name":"p95","expression":"percentile(amount, 0.95, 200)"},{"name":"q","expression":"quantiles(amount)"}]}]}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		defer resp.Body.Close()
+		var result map[string]interface{}
+		if err := json.NewDecoder(resp.Body).Decode(&result); err != nil {
+			t.Fatalf("Unable to decode response: %v", err)
+		}
+
+		assertNear := func(name string, value interface{}, expected float64) {
+			if v, ok := value.(float64); !ok || math.Abs(v-expected) > 10 {
+				t.Fatalf("Unexpected %s estimate: %v (expected %v)", name, value, expected)
+			}
+		}
+		assertNear("median", result["median"], 500.5)
+		assertNear("p95", result["p95"], 950.5)
+		q := result["q"].(map[string]interface{})
+		assertNear("min", q["min"], 1)
+		assertNear("p99", q["p99"], 990.5)
+		assertNear("max", q["max"], 1000)
+
+		// Percentiles must be between 0 and 1.
+		query = `{"steps":[{"type":"selection","dimensions":[],"fields":[{"name":"p","expression":"percentile(amount, 95)"}]}]}`
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		if resp.StatusCode != 500 {
+			t.Fatalf("Expected invalid percentile to fail: %v", resp.StatusCode)
+		}
+	})
+}
+
 // Ensure that we can query the server for a count of events with a single dimension.
 func TestServerOneDimensionCountQuery(t *testing.T) {
 	runTestServer(func(s *Server) {
@@ -98,6 +316,167 @@ func TestServerMultiDimensionalQuery(t *testing.T) {
 	})
 }
 
+// Ensure that we can limit dimensioned results to the top cells.
+func TestServerTopKQuery(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "page", true, "string")
+		setupTestProperty("foo", "price", true, "float")
+		setupTestData(t, "foo", [][]string{
+			[]string{"c0", "2012-01-01T00:00:00Z", `{"data":{"page":"/a", "price":10}}`},
+			[]string{"c0", "2012-01-01T00:00:01Z", `{"data":{"page":"/a", "price":20}}`},
+			[]string{"c0", "2012-01-01T00:00:02Z", `{"data":{"page":"/b", "price":5}}`},
+			[]string{"c1", "2012-01-01T00:00:00Z", `{"data":{"page":"/a", "price":30}}`},
+			[]string{"c1", "2012-01-01T00:00:01Z", `{"data":{"page":"/c", "price":40}}`},
+			[]string{"c2", "2012-01-01T00:00:00Z", `{"data":{"page":"/b", "price":1}}`},
+			[]string{"c2", "2012-01-01T00:00:01Z", `{"data":{"page":"/d", "price":2}}`},
+		})
+
+		// Most visited pages.
+		query := `{"steps":[{"type":"selection","dimensions":["page"],"orderBy":"count","limit":2,"fields":[{"name":"count","expression":"count()"}]}]}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"page":{"/a":{"count":3},"/b":{"count":2}}}`+"\n", "POST /tables/:name/query failed.")
+
+		// Cheapest maximum price.
+		query = `{"steps":[{"type":"selection","dimensions":["page"],"orderBy":"maximum asc","limit":1,"fields":[{"name":"maximum","expression":"max(price)"}]}]}`
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"page":{"/d":{"maximum":2}}}`+"\n", "POST /tables/:name/query failed.")
+
+		// A limit requires an order.
+		query = `{"steps":[{"type":"selection","dimensions":["page"],"limit":1,"fields":[{"name":"count","expression":"count()"}]}]}`
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		if resp.StatusCode != 500 {
+			t.Fatalf("Expected a limit without an order to fail: %v", resp.StatusCode)
+		}
+	})
+}
+
+// Ensure that we can group by time buckets computed by the cursor.
+func TestServerTimeBucketQuery(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "price", false, "float")
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-01T03:00:00Z", `{"data":{"price":10}}`},
+			[]string{"a0", "2012-01-01T23:30:00Z", `{"data":{"price":20}}`},
+			[]string{"a1", "2012-01-02T05:00:00Z", `{"data":{"price":30}}`},
+			[]string{"a1", "2012-02-10T00:00:00Z", `{"data":{"price":40}}`},
+		})
+
+		// Daily totals in UTC.
+		query := `{"steps":[{"type":"selection","dimensions":["@day"],"fields":[{"name":"total","expression":"sum(price)"}]}]}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"@day":{"2012-01-01T00:00:00Z":{"total":30},"2012-01-02T00:00:00Z":{"total":30},"2012-02-10T00:00:00Z":{"total":40}}}`+"\n", "POST /tables/:name/query failed.")
+
+		// Daily and monthly totals in New York.
+		query = `{"timezone":"America/New_York","steps":[{"type":"selection","dimensions":["@month","@day"],"fields":[{"name":"total","expression":"sum(price)"}]}]}`
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"@month":{"2011-12-01T00:00:00-05:00":{"@day":{"2011-12-31T00:00:00-05:00":{"total":10}}},"2012-01-01T00:00:00-05:00":{"@day":{"2012-01-01T00:00:00-05:00":{"total":20},"2012-01-02T00:00:00-05:00":{"total":30}}},"2012-02-01T00:00:00-05:00":{"@day":{"2012-02-09T00:00:00-05:00":{"total":40}}}}}`+"\n", "POST /tables/:name/query failed.")
+
+		// Unknown buckets are rejected.
+		query = `{"steps":[{"type":"selection","dimensions":["@year"],"fields":[{"name":"count","expression":"count()"}]}]}`
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		if resp.StatusCode != 500 {
+			t.Fatalf("Expected an unknown time bucket to fail: %v", resp.StatusCode)
+		}
+	})
+}
+
+// Ensure that we can select session fields computed by the cursor.
+func TestServerSessionFieldQuery(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "price", false, "float")
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-01T00:00:00Z", `{"data":{"price":10}}`},
+			[]string{"a0", "2012-01-01T00:00:30Z", `{"data":{"price":20}}`},
+			[]string{"a0", "2012-01-01T00:01:00Z", `{"data":{"price":30}}`},
+			[]string{"a0", "2012-01-01T02:00:00Z", `{"data":{"price":40}}`},
+			[]string{"a1", "2012-01-01T00:00:00Z", `{"data":{"price":50}}`},
+			[]string{"a1", "2012-01-01T00:00:10Z", `{"data":{"price":60}}`},
+		})
+
+		// Session lengths and event counts by the index of the session.
+		query := `{"sessionIdleTime":3600,"steps":[{"type":"selection","dimensions":["@session_index"],"fields":[{"name":"count","expression":"count()"},{"name":"length","expression":"max(@session_length)"},{"name":"gap","expression":"max(@since_previous)"}]}]}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"@session_index":{"0":{"count":5,"gap":30,"length":60},"1":{"count":1,"gap":7140,"length":0}}}`+"\n", "POST /tables/:name/query failed.")
+
+		// Session start times.
+		query = `{"sessionIdleTime":3600,"steps":[{"type":"selection","dimensions":["@session_start"],"fields":[{"name":"count","expression":"count()"}]}]}`
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"@session_start":{"2012-01-01T00:00:00Z":{"count":5},"2012-01-01T02:00:00Z":{"count":1}}}`+"\n", "POST /tables/:name/query failed.")
+	})
+}
+
+// Ensure that we can query the current state of objects.
+func TestServerStateQuery(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "plan", false, "factor")
+		setupTestProperty("foo", "action", true, "factor")
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-01T00:00:00Z", `{"data":{"plan":"free","action":"signup"}}`},
+			[]string{"a0", "2012-01-01T00:00:01Z", `{"data":{"plan":"pro","action":"upgrade"}}`},
+			[]string{"a1", "2012-01-01T00:00:00Z", `{"data":{"plan":"free","action":"signup"}}`},
+			[]string{"a2", "2012-01-01T00:00:00Z", `{"data":{"plan":"pro","action":"signup"}}`},
+		})
+
+		// Objects by their current plan.
+		query := `{"stateOnly":true,"steps":[{"type":"selection","dimensions":["plan"],"fields":[{"name":"count","expression":"count()"}]}]}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"plan":{"free":{"count":1},"pro":{"count":2}}}`+"\n", "POST /tables/:name/query failed.")
+
+		// Objects on a plan.
+		query = `{"stateOnly":true,"steps":[{"type":"condition","expression":"plan == 'pro'","steps":[{"type":"selection","fields":[{"name":"count","expression":"count()"}]}]}]}`
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"count":2}`+"\n", "POST /tables/:name/query failed.")
+
+		// Events by the current plan of their object.
+		query = `{"steps":[{"type":"selection","dimensions":["state.plan","action"],"fields":[{"name":"count","expression":"count()"}]}]}`
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"state.plan":{"free":{"action":{"signup":{"count":1}}},"pro":{"action":{"signup":{"count":2},"upgrade":{"count":1}}}}}`+"\n", "POST /tables/:name/query failed.")
+
+		// State-only queries cannot use steps that read other events.
+		query = `{"stateOnly":true,"steps":[{"type":"funnel","name":"f","steps":[{"expression":"action == 'signup'"}]}]}`
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		if resp.StatusCode != 500 {
+			t.Fatalf("Expected a state-only funnel to fail: %v", resp.StatusCode)
+		}
+
+		// Transient properties are not part of the state.
+		query = `{"steps":[{"type":"selection","dimensions":["state.action"],"fields":[{"name":"count","expression":"count()"}]}]}`
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		if resp.StatusCode != 500 {
+			t.Fatalf("Expected a transient state dimension to fail: %v", resp.StatusCode)
+		}
+	})
+}
+
+// Ensure that we can query a list of objects.
+func TestServerObjectSubsetQuery(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "price", false, "float")
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-01T00:00:00Z", `{"data":{"price":10}}`},
+			[]string{"a0", "2012-01-01T00:00:01Z", `{"data":{"price":20}}`},
+			[]string{"a1", "2012-01-01T00:00:00Z", `{"data":{"price":30}}`},
+			[]string{"a2", "2012-01-01T00:00:00Z", `{"data":{"price":40}}`},
+			[]string{"a3", "2012-01-01T00:00:00Z", `{"data":{"price":50}}`},
+		})
+
+		// Missing and duplicate objects are ignored.
+		query := `{"objectIds":["a2","a0","missing","a0"],"steps":[{"type":"selection","fields":[{"name":"count","expression":"count()"},{"name":"sum","expression":"sum(price)"}]}]}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"count":3,"sum":70}`+"\n", "POST /tables/:name/query failed.")
+
+		// An empty list matches no objects.
+		query = `{"objectIds":[],"steps":[{"type":"selection","fields":[{"name":"count","expression":"count()"}]}]}`
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"count":0}`+"\n", "POST /tables/:name/query failed.")
+	})
+}
+
 // Ensure that we can perform a non-sessionized funnel analysis.
 func TestServerFunnelAnalysisQuery(t *testing.T) {
 	runTestServer(func(s *Server) {
@@ -137,6 +516,158 @@ func TestServerFunnelAnalysisQuery(t *testing.T) {
 	})
 }
 
+// Ensure that we can count conversions with a native funnel.
+func TestServerNativeFunnelQuery(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "gender", false, "string")
+		setupTestProperty("foo", "action", true, "factor")
+		setupTestData(t, "foo", [][]string{
+			// Completes the funnel on a later attempt.
+			[]string{"a0", "2012-01-01T00:00:00Z", `{"data":{"gender":"m", "action":"view"}}`},
+			[]string{"a0", "2012-01-01T00:00:01Z", `{"data":{"action":"cart"}}`},
+			[]string{"a0", "2012-01-01T02:00:00Z", `{"data":{"action":"view"}}`},
+			[]string{"a0", "2012-01-01T02:00:01Z", `{"data":{"action":"cart"}}`},
+			[]string{"a0", "2012-01-01T02:00:02Z", `{"data":{"action":"buy"}}`},
+
+			// Buys too long after adding to the cart.
+			[]string{"a1", "2012-01-01T00:00:00Z", `{"data":{"gender":"f", "action":"view"}}`},
+			[]string{"a1", "2012-01-01T00:00:01Z", `{"data":{"action":"cart"}}`},
+			[]string{"a1", "2012-01-01T02:00:00Z", `{"data":{"action":"buy"}}`},
+
+			// Adds to the cart before viewing.
+			[]string{"a2", "2012-01-01T00:00:00Z", `{"data":{"gender":"m", "action":"cart"}}`},
+			[]string{"a2", "2012-01-01T00:00:01Z", `{"data":{"action":"view"}}`},
+
+			// Never enters the funnel.
+			[]string{"a3", "2012-01-01T00:00:00Z", `{"data":{"gender":"f", "action":"buy"}}`},
+		})
+
+		query := `{
+			"steps":[
+				{"type":"funnel","name":"checkout","steps":[
+					{"name":"view","expression":"action == 'view'"},
+					{"name":"cart","expression":"action == 'cart'","within":[1,1]},
+					{"name":"buy","expression":"action == 'buy'","within":[0,60],"withinUnits":"seconds"}
+				]}
+			]
+		}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"checkout":{"buy":1,"cart":2,"view":3}}`+"\n", "POST /tables/:name/query failed.")
+
+		// Break down by the dimension at the start of the funnel.
+		query = `{
+			"steps":[
+				{"type":"funnel","dimension":"gender","steps":[
+					{"name":"view","expression":"action == 'view'"},
+					{"name":"cart","expression":"action == 'cart'"},
+					{"name":"buy","expression":"action == 'buy'"}
+				]}
+			]
+		}`
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"gender":{"f":{"buy":1,"cart":1,"view":1},"m":{"buy":1,"cart":1,"view":2}}}`+"\n", "POST /tables/:name/query failed.")
+	})
+}
+
+// Ensure that we can build a cohort retention matrix.
+func TestServerRetentionQuery(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "action", true, "factor")
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-01T10:00:00Z", `{"data":{"action":"signup"}}`},
+			[]string{"a0", "2012-01-02T10:00:00Z", `{"data":{"action":"login"}}`},
+			[]string{"a0", "2012-01-03T10:00:00Z", `{"data":{"action":"login"}}`},
+
+			[]string{"a1", "2012-01-01T23:00:00Z", `{"data":{"action":"signup"}}`},
+			[]string{"a1", "2012-01-03T01:00:00Z", `{"data":{"action":"login"}}`},
+			[]string{"a1", "2012-01-09T01:00:00Z", `{"data":{"action":"login"}}`},
+
+			[]string{"a2", "2012-01-01T23:00:00Z", `{"data":{"action":"login"}}`},
+			[]string{"a2", "2012-01-02T00:00:00Z", `{"data":{"action":"signup"}}`},
+			[]string{"a2", "2012-01-02T01:00:00Z", `{"data":{"action":"login"}}`},
+		})
+
+		query := `{
+			"steps":[
+				{"type":"retention","name":"daily","cohort":"action == 'signup'","activity":"action == 'login'","period":"day","periods":3}
+			]
+		}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"daily":{"2012-01-01T00:00:00Z":[2,1,2],"2012-01-02T00:00:00Z":[1,0,0]}}`+"\n", "POST /tables/:name/query failed.")
+
+		// Cohorts span the whole object so retention cannot be sessionized.
+		query = `{
+			"sessionIdleTime":3600,
+			"steps":[
+				{"type":"condition","expression":"true","steps":[
+					{"type":"retention","name":"daily","cohort":"action == 'signup'","activity":"action == 'login'","period":"day","periods":3}
+				]}
+			]
+		}`
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		if resp.StatusCode != 500 {
+			t.Fatalf("Expected a sessionized retention query to fail: %v", resp.StatusCode)
+		}
+	})
+}
+
+// Ensure that we can find the most frequent paths after an anchor event.
+func TestServerPathsQuery(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "action", true, "factor")
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-01T00:00:00Z", `{"data":{"action":"view"}}`},
+			[]string{"a0", "2012-01-01T00:00:01Z", `{"data":{"action":"cart"}}`},
+			[]string{"a0", "2012-01-01T00:00:02Z", `{"data":{"action":"checkout"}}`},
+			[]string{"a0", "2012-01-01T00:00:03Z", `{"data":{"action":"buy"}}`},
+
+			[]string{"a1", "2012-01-01T00:00:00Z", `{"data":{"action":"cart"}}`},
+			[]string{"a1", "2012-01-01T00:00:01Z", `{"data":{"action":"checkout"}}`},
+			[]string{"a1", "2012-01-01T00:00:02Z", `{"data":{"action":"buy"}}`},
+			[]string{"a1", "2012-01-01T00:00:03Z", `{"data":{"action":"cart"}}`},
+			[]string{"a1", "2012-01-01T00:00:04Z", `{"data":{"action":"view"}}`},
+
+			[]string{"a2", "2012-01-01T00:00:00Z", `{"data":{"action":"cart"}}`},
+			[]string{"a2", "2012-01-01T00:00:01Z", `{"data":{"action":"view"}}`},
+			[]string{"a2", "2012-01-01T00:00:02Z", `{"data":{"action":"view"}}`},
+		})
+
+		// The next two actions after adding to the cart.
+		query := `{"steps":[{"type":"paths","name":"after","expression":"action == 'cart'","property":"action","steps":2,"limit":2}]}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"after":[{"count":2,"path":["checkout","buy"]},{"count":1,"path":["view"]}]}`+"\n", "POST /tables/:name/query failed.")
+
+		// The action before buying.
+		query = `{"steps":[{"type":"paths","name":"before","expression":"action == 'buy'","property":"action","direction":"previous","steps":1}]}`
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"before":[{"count":2,"path":["checkout"]}]}`+"\n", "POST /tables/:name/query failed.")
+	})
+}
+
+// Ensure that paths do not cross session boundaries.
+func TestServerSessionizedPathsQuery(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "action", true, "factor")
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-01T00:00:00Z", `{"data":{"action":"cart"}}`},
+			[]string{"a0", "2012-01-01T00:00:01Z", `{"data":{"action":"checkout"}}`},
+			[]string{"a0", "2012-01-01T03:00:00Z", `{"data":{"action":"buy"}}`},
+		})
+
+		query := `{"steps":[{"type":"paths","name":"after","expression":"action == 'cart'","property":"action","steps":2}]}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"after":[{"count":1,"path":["checkout","buy"]}]}`+"\n", "POST /tables/:name/query failed.")
+
+		query = `{"sessionIdleTime":7200,"steps":[{"type":"paths","name":"after","expression":"action == 'cart'","property":"action","steps":2}]}`
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, `{"after":[{"count":1,"path":["checkout"]}]}`+"\n", "POST /tables/:name/query failed.")
+	})
+}
+
 // Ensure that we can perform a sessionized funnel analysis.
 func TestServerSessionizedFunnelAnalysisQuery(t *testing.T) {
 	runTestServer(func(s *Server) {
@@ -16,9 +16,28 @@ func (s *Server) addTableHandlers() {
 	s.ApiHandleFunc("/tables", func(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
 		return s.createTableHandler(w, req, params)
 	}).Methods("POST")
+	s.ApiHandleFunc("/tables/{name}", func(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
+		return s.updateTableHandler(w, req, params)
+	}).Methods("PATCH")
 	s.ApiHandleFunc("/tables/{name}", func(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
 		return s.deleteTableHandler(w, req, params)
 	}).Methods("DELETE")
+	s.ApiHandleFunc("/tables/{name}/expiry/stats", func(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
+		return s.getTableExpiryStatsHandler(w, req, params)
+	}).Methods("GET")
+}
+
+// Reads the optional retention period, in seconds, from table parameters.
+func tableRetentionParam(params map[string]interface{}) (int64, bool, error) {
+	value, ok := params["retention"]
+	if !ok || value == nil {
+		return 0, false, nil
+	}
+	retention, ok := value.(float64)
+	if !ok || retention < 0 || retention != float64(int64(retention)) {
+		return 0, false, errors.New("Invalid retention.")
+	}
+	return int64(retention), true, nil
 }
 
 // GET /tables
@@ -40,6 +59,11 @@ func (s *Server) createTableHandler(w http.ResponseWriter, req *http.Request, pa
 		return nil, errors.New("Table name required.")
 	}
 
+	retention, hasRetention, err := tableRetentionParam(params)
+	if err != nil {
+		return nil, err
+	}
+
 	// Return an error if the table already exists.
 	table, err := s.OpenTable(tableName)
 	if table != nil {
@@ -52,6 +76,32 @@ func (s *Server) createTableHandler(w http.ResponseWriter, req *http.Request, pa
 	if err != nil {
 		return nil, err
 	}
+	if hasRetention {
+		if err = s.SetTableRetention(table, retention); err != nil {
+			return nil, err
+		}
+	}
+
+	return table, nil
+}
+
+// PATCH /tables/:name
+func (s *Server) updateTableHandler(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
+	vars := mux.Vars(req)
+	table, err := s.OpenTable(vars["name"])
+	if err != nil {
+		return nil, err
+	}
+
+	retention, hasRetention, err := tableRetentionParam(params)
+	if err != nil {
+		return nil, err
+	}
+	if hasRetention {
+		if err = s.SetTableRetention(table, retention); err != nil {
+			return nil, err
+		}
+	}
 
 	return table, nil
 }
@@ -63,3 +113,13 @@ func (s *Server) deleteTableHandler(w http.ResponseWriter, req *http.Request, pa
 
 	return nil, s.DeleteTable(tableName)
 }
+
+// GET /tables/:name/expiry/stats
+func (s *Server) getTableExpiryStatsHandler(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
+	vars := mux.Vars(req)
+	table, err := s.OpenTable(vars["name"])
+	if err != nil {
+		return nil, err
+	}
+	return s.expiry.Stats(table.Name), nil
+}
@@ -51,6 +51,27 @@ func TestServerCreateTable(t *testing.T) {
 	})
 }
 
+// Ensure that we can set a table's retention period through the server.
+func TestServerUpdateTableRetention(t *testing.T) {
+	runTestServer(func(s *Server) {
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables", "application/json", `{"name":"foo","retention":86400}`)
+		assertResponse(t, resp, 200, `{"name":"foo","retention":86400}`+"\n", "POST /tables failed.")
+		resp, _ = sendTestHttpRequest("GET", "http://localhost:8586/tables/foo", "application/json", ``)
+		assertResponse(t, resp, 200, `{"name":"foo","retention":86400}`+"\n", "GET /tables/:name failed.")
+
+		resp, _ = sendTestHttpRequest("PATCH", "http://localhost:8586/tables/foo", "application/json", `{"retention":-1}`)
+		if resp.StatusCode != 500 {
+			t.Fatalf("PATCH /tables/:name accepted a negative retention.")
+		}
+		resp.Body.Close()
+		resp, _ = sendTestHttpRequest("PATCH", "http://localhost:8586/tables/foo", "application/json", `{"retention":0}`)
+		assertResponse(t, resp, 200, `{"name":"foo"}`+"\n", "PATCH /tables/:name failed.")
+
+		resp, _ = sendTestHttpRequest("GET", "http://localhost:8586/tables/foo/expiry/stats", "application/json", ``)
+		assertResponse(t, resp, 200, `{"trimmedBytes":0,"trimmedEvents":0}`+"\n", "GET /tables/:name/expiry/stats failed.")
+	})
+}
+
 // Ensure that we can delete a table through the server.
 func TestServerDeleteTable(t *testing.T) {
 	runTestServer(func(s *Server) {
@@ -64,11 +85,20 @@ func TestServerDeleteTable(t *testing.T) {
 			t.Fatalf("POST /tables did not create table.")
 		}
 
+		setupTestProperty("foo", "bar", false, "string")
+		resp, _ = sendTestHttpRequest("PUT", "http://localhost:8586/tables/foo/objects/xyz/events/2012-01-01T02:00:00Z", "application/json", `{"data":{"bar":"myValue"}}`)
+		assertResponse(t, resp, 200, "", "PUT /tables/:name/objects/:objectId/events failed.")
+
 		// Delete table.
 		resp, _ = sendTestHttpRequest("DELETE", "http://localhost:8586/tables/foo", "application/json", ``)
 		assertResponse(t, resp, 200, "", "DELETE /tables/:name failed.")
 		if _, err := os.Stat(fmt.Sprintf("%v/tables/foo", s.Path())); !os.IsNotExist(err) {
 			t.Fatalf("DELETE /tables/:name did not delete table.")
 		}
+
+		// A new table with the same name has no events.
+		setupTestTable("foo")
+		resp, _ = sendTestHttpRequest("GET", "http://localhost:8586/tables/foo/objects/xyz/events", "application/json", "")
+		assertResponse(t, resp, 200, "[]\n", "GET /tables/:name/objects/:objectId/events failed.")
 	})
 }
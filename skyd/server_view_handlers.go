@@ -0,0 +1,106 @@
+package skyd
+
+import (
+	"errors"
+	"fmt"
+	"github.com/gorilla/mux"
+	"net/http"
+)
+
+func (s *Server) addViewHandlers() {
+	s.ApiHandleFunc("/tables/{name}/views", func(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
+		return s.getViewsHandler(w, req, params)
+	}).Methods("GET")
+	s.ApiHandleFunc("/tables/{name}/views", func(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
+		return s.createViewHandler(w, req, params)
+	}).Methods("POST")
+
+	s.ApiHandleFunc("/tables/{name}/views/{viewName}", func(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
+		return s.getViewHandler(w, req, params)
+	}).Methods("GET")
+	s.ApiHandleFunc("/tables/{name}/views/{viewName}", func(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
+		return s.deleteViewHandler(w, req, params)
+	}).Methods("DELETE")
+}
+
+// GET /tables/:name/views
+func (s *Server) getViewsHandler(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
+	vars := mux.Vars(req)
+	table, err := s.OpenTable(vars["name"])
+	if err != nil {
+		return nil, err
+	}
+
+	views := []interface{}{}
+	for _, view := range table.GetViews() {
+		views = append(views, view.Serialize())
+	}
+	return views, nil
+}
+
+// POST /tables/:name/views
+func (s *Server) createViewHandler(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
+	vars := mux.Vars(req)
+	table, err := s.OpenTable(vars["name"])
+	if err != nil {
+		return nil, err
+	}
+
+	// Deserialize the query.
+	name, _ := params["name"].(string)
+	if name == "" {
+		return nil, errors.New("View name required.")
+	}
+	obj, ok := params["query"].(map[string]interface{})
+	if !ok {
+		return nil, fmt.Errorf("Invalid view query: %v", params["query"])
+	}
+	query := NewQuery(table, s.factors)
+	if err = query.Deserialize(obj); err != nil {
+		return nil, err
+	}
+	if _, err = query.Codegen(); err != nil {
+		return nil, err
+	}
+	if query.Sampled() {
+		return nil, errors.New("Views cannot be sampled.")
+	}
+
+	// Add the view and compute its initial results.
+	view := NewView(name, query)
+	if err = table.AddView(view); err != nil {
+		return nil, err
+	}
+	if _, err = s.GetViewResult(table, view); err != nil {
+		table.DeleteView(name)
+		return nil, err
+	}
+
+	return view.Serialize(), nil
+}
+
+// GET /tables/:name/views/:viewName
+func (s *Server) getViewHandler(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
+	vars := mux.Vars(req)
+	table, err := s.OpenTable(vars["name"])
+	if err != nil {
+		return nil, err
+	}
+
+	view := table.GetView(vars["viewName"])
+	if view == nil {
+		return nil, errors.New("View does not exist.")
+	}
+	return s.GetViewResult(table, view)
+}
+
+// DELETE /tables/:name/views/:viewName
+func (s *Server) deleteViewHandler(w http.ResponseWriter, req *http.Request, params map[string]interface{}) (interface{}, error) {
+	vars := mux.Vars(req)
+	table, err := s.OpenTable(vars["name"])
+	if err != nil {
+		return nil, err
+	}
+
+	return nil, table.DeleteView(vars["viewName"])
+}
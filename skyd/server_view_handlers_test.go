@@ -0,0 +1,188 @@
+package skyd
+
+import (
+	"testing"
+)
+
+// Ensure that a view is updated incrementally as events are appended.
+func TestServerViewIncremental(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "gender", false, "factor")
+		setupTestProperty("foo", "fruit", true, "string")
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-01T00:00:00Z", `{"data":{"gender":"m","fruit":"apple"}}`},
+			[]string{"a1", "2012-01-01T00:00:00Z", `{"data":{"gender":"f","fruit":"grape"}}`},
+		})
+
+		// Create the view.
+		view := `{"name":"v","query":{"steps":[{"type":"selection","dimensions":["gender"],"fields":[{"name":"count","expression":"count()"}]}]}}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/views", "application/json", view)
+		assertResponse(t, resp, 200, `{"name":"v","query":{"sessionIdleTime":0,"steps":[{"dimensions":["gender"],"fields":[{"expression":"count()","name":"count"}],"name":"","type":"selection"}]}}`+"\n", "POST /tables/:name/views failed.")
+		resp, _ = sendTestHttpRequest("GET", "http://localhost:8586/tables/foo/views/v", "application/json", "")
+		assertResponse(t, resp, 200, `{"gender":{"f":{"count":1},"m":{"count":1}}}`+"\n", "GET /tables/:name/views/:viewName failed.")
+
+		// Append events. The permanent 'gender' property carries over from the object's state.
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-02T00:00:00Z", `{"data":{"fruit":"orange"}}`},
+			[]string{"a2", "2012-01-02T00:00:00Z", `{"data":{"gender":"f"}}`},
+		})
+		if _, ok := s.GetTable("foo").GetView("v").Result(); !ok {
+			t.Fatalf("Expected view to be updated incrementally")
+		}
+		resp, _ = sendTestHttpRequest("GET", "http://localhost:8586/tables/foo/views/v", "application/json", "")
+		assertResponse(t, resp, 200, `{"gender":{"f":{"count":2},"m":{"count":2}}}`+"\n", "GET /tables/:name/views/:viewName failed.")
+
+		// Insert an event out of order which forces a rebuild.
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2011-01-01T00:00:00Z", `{"data":{"gender":"f"}}`},
+		})
+		if _, ok := s.GetTable("foo").GetView("v").Result(); ok {
+			t.Fatalf("Expected view to be invalidated")
+		}
+		resp, _ = sendTestHttpRequest("GET", "http://localhost:8586/tables/foo/views/v", "application/json", "")
+		assertResponse(t, resp, 200, `{"gender":{"f":{"count":3},"m":{"count":2}}}`+"\n", "GET /tables/:name/views/:viewName failed.")
+	})
+}
+
+// Ensure that views with conditions are recomputed after appends.
+func TestServerViewCondition(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "action", true, "string")
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-01T00:00:00Z", `{"data":{"action":"A"}}`},
+		})
+
+		view := `{"name":"v","query":{"steps":[{"type":"condition","expression":"action == 'A'","steps":[{"type":"condition","expression":"action == 'B'","within":[1,1],"steps":[{"type":"selection","fields":[{"name":"count","expression":"count()"}]}]}]}]}}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/views", "application/json", view)
+		resp.Body.Close()
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-02T00:00:00Z", `{"data":{"action":"B"}}`},
+		})
+		resp, _ = sendTestHttpRequest("GET", "http://localhost:8586/tables/foo/views/v", "application/json", "")
+		assertResponse(t, resp, 200, `{"count":1}`+"\n", "GET /tables/:name/views/:viewName failed.")
+
+		resp, _ = sendTestHttpRequest("DELETE", "http://localhost:8586/tables/foo/views/v", "application/json", "")
+		assertResponse(t, resp, 200, "", "DELETE /tables/:name/views/:viewName failed.")
+		resp, _ = sendTestHttpRequest("GET", "http://localhost:8586/tables/foo/views", "application/json", "")
+		assertResponse(t, resp, 200, `[]`+"\n", "GET /tables/:name/views failed.")
+	})
+}
+
+// Ensure that distinct object counts in a view are not inflated by appends to
+// objects that have already been counted.
+func TestServerViewDistinctCount(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "fruit", true, "string")
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-01T00:00:00Z", `{"data":{"fruit":"apple"}}`},
+			[]string{"a1", "2012-01-01T00:00:00Z", `{"data":{"fruit":"grape"}}`},
+		})
+
+		view := `{"name":"v","query":{"steps":[{"type":"selection","dimensions":[],"fields":[{"name":"objects","expression":"count_objects()"},{"name":"fruits","expression":"count_distinct(fruit)"}]}]}}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/views", "application/json", view)
+		resp, _ = sendTestHttpRequest("GET", "http://localhost:8586/tables/foo/views/v", "application/json", "")
+		assertResponse(t, resp, 200, `{"fruits":2,"objects":2}`+"\n", "GET /tables/:name/views/:viewName failed.")
+
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-02T00:00:00Z", `{"data":{"fruit":"grape"}}`},
+			[]string{"a1", "2012-01-02T00:00:00Z", `{"data":{"fruit":"orange"}}`},
+			[]string{"a2", "2012-01-02T00:00:00Z", `{"data":{"fruit":"apple"}}`},
+		})
+		if _, ok := s.GetTable("foo").GetView("v").Result(); !ok {
+			t.Fatalf("Expected view to be updated incrementally")
+		}
+		resp, _ = sendTestHttpRequest("GET", "http://localhost:8586/tables/foo/views/v", "application/json", "")
+		assertResponse(t, resp, 200, `{"fruits":3,"objects":3}`+"\n", "GET /tables/:name/views/:viewName failed.")
+	})
+}
+
+// Ensure that state-only views are recomputed after appends.
+func TestServerViewStateOnly(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "plan", false, "factor")
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-01T00:00:00Z", `{"data":{"plan":"free"}}`},
+			[]string{"a1", "2012-01-01T00:00:00Z", `{"data":{"plan":"free"}}`},
+		})
+
+		view := `{"name":"v","query":{"stateOnly":true,"steps":[{"type":"selection","dimensions":["plan"],"fields":[{"name":"count","expression":"count()"}]}]}}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/views", "application/json", view)
+		resp.Body.Close()
+		if s.GetTable("foo").GetView("v").Incremental() {
+			t.Fatalf("Expected state-only view not to be incremental")
+		}
+		resp, _ = sendTestHttpRequest("GET", "http://localhost:8586/tables/foo/views/v", "application/json", "")
+		assertResponse(t, resp, 200, `{"plan":{"free":{"count":2}}}`+"\n", "GET /tables/:name/views/:viewName failed.")
+
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-02T00:00:00Z", `{"data":{"plan":"pro"}}`},
+		})
+		resp, _ = sendTestHttpRequest("GET", "http://localhost:8586/tables/foo/views/v", "application/json", "")
+		assertResponse(t, resp, 200, `{"plan":{"free":{"count":1},"pro":{"count":1}}}`+"\n", "GET /tables/:name/views/:viewName failed.")
+	})
+}
+
+// Ensure that views grouped by the object's state are recomputed after
+// appends.
+func TestServerViewStateDimension(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "plan", false, "factor")
+		setupTestProperty("foo", "action", true, "factor")
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-01T00:00:00Z", `{"data":{"plan":"free","action":"signup"}}`},
+		})
+
+		view := `{"name":"v","query":{"steps":[{"type":"selection","dimensions":["state.plan"],"fields":[{"name":"count","expression":"count()"}]}]}}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/views", "application/json", view)
+		resp.Body.Close()
+		if s.GetTable("foo").GetView("v").Incremental() {
+			t.Fatalf("Expected state dimension view not to be incremental")
+		}
+		resp, _ = sendTestHttpRequest("GET", "http://localhost:8586/tables/foo/views/v", "application/json", "")
+		assertResponse(t, resp, 200, `{"state.plan":{"free":{"count":1}}}`+"\n", "GET /tables/:name/views/:viewName failed.")
+
+		// The upgrade moves the object's earlier events to the new plan too.
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-02T00:00:00Z", `{"data":{"plan":"pro","action":"upgrade"}}`},
+		})
+		resp, _ = sendTestHttpRequest("GET", "http://localhost:8586/tables/foo/views/v", "application/json", "")
+		assertResponse(t, resp, 200, `{"state.plan":{"pro":{"count":2}}}`+"\n", "GET /tables/:name/views/:viewName failed.")
+	})
+}
+
+// Ensure that views that read session properties match a full query after
+// appends.
+func TestServerViewSessionFields(t *testing.T) {
+	runTestServer(func(s *Server) {
+		setupTestTable("foo")
+		setupTestProperty("foo", "price", false, "float")
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-01T00:00:00Z", `{"data":{"price":10}}`},
+			[]string{"a0", "2012-01-01T00:00:30Z", `{"data":{"price":20}}`},
+		})
+
+		query := `{"steps":[{"type":"selection","dimensions":["@session_event_index"],"fields":[{"name":"count","expression":"count()"},{"name":"length","expression":"max(@session_length)"},{"name":"gap","expression":"max(@since_previous)"}]}]}`
+		resp, _ := sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/views", "application/json", `{"name":"v","query":`+query+`}`)
+		resp.Body.Close()
+		if s.GetTable("foo").GetView("v").Incremental() {
+			t.Fatalf("Expected session field view not to be incremental")
+		}
+		resp, _ = sendTestHttpRequest("GET", "http://localhost:8586/tables/foo/views/v", "application/json", "")
+		assertResponse(t, resp, 200, `{"@session_event_index":{"0":{"count":1,"gap":0,"length":30},"1":{"count":1,"gap":30,"length":30}}}`+"\n", "GET /tables/:name/views/:viewName failed.")
+
+		// The appended event extends the session of the earlier events.
+		setupTestData(t, "foo", [][]string{
+			[]string{"a0", "2012-01-01T00:01:00Z", `{"data":{"price":30}}`},
+		})
+		expected := `{"@session_event_index":{"0":{"count":1,"gap":0,"length":60},"1":{"count":1,"gap":30,"length":60},"2":{"count":1,"gap":30,"length":60}}}` + "\n"
+		resp, _ = sendTestHttpRequest("POST", "http://localhost:8586/tables/foo/query", "application/json", query)
+		assertResponse(t, resp, 200, expected, "POST /tables/:name/query failed.")
+		resp, _ = sendTestHttpRequest("GET", "http://localhost:8586/tables/foo/views/v", "application/json", "")
+		assertResponse(t, resp, 200, expected, "GET /tables/:name/views/:viewName failed.")
+	})
+}
@@ -1,5 +1,11 @@
 package skyd
 
+/*
+#cgo LDFLAGS: -lleveldb
+#include <leveldb/c.h>
+*/
+import "C"
+
 import (
 	"bytes"
 	"errors"
@@ -12,8 +18,16 @@ import (
 	"sort"
 	"sync"
 	"time"
+	"unsafe"
 )
 
+// Object values of at least this many bytes are stored in LevelDB blob
+// files so compactions rewrite keys instead of whole event histories.
+const BlobThreshold = 64 * 1024
+
+// The number of data blocks that query scans read ahead of the cursor.
+const ScanReadaheadBlocks = 16
+
 //------------------------------------------------------------------------------
 //
 // Typedefs
@@ -25,6 +39,7 @@ type Servlet struct {
 	path    string
 	db      *levigo.DB
 	factors *Factors
+	expiry  *Expiry
 	mutex   sync.Mutex
 }
 
@@ -35,10 +50,12 @@ type Servlet struct {
 //------------------------------------------------------------------------------
 
 // NewServlet returns a new Servlet with a data shard stored at a given path.
-func NewServlet(path string, factors *Factors) *Servlet {
+// Events are expired during compactions if an expiry is given.
+func NewServlet(path string, factors *Factors, expiry *Expiry) *Servlet {
 	return &Servlet{
 		path:    path,
 		factors: factors,
+		expiry:  expiry,
 	}
 }
 
@@ -61,6 +78,13 @@ func (s *Servlet) Open() error {
 
 	opts := levigo.NewOptions()
 	opts.SetCreateIfMissing(true)
+	C.leveldb_options_set_min_blob_size((*C.leveldb_options_t)(unsafe.Pointer(opts.Opt)), C.size_t(BlobThreshold))
+	// A CLOCK block cache keeps query scans from evicting the blocks used
+	// by event inserts.
+	C.leveldb_options_set_cache_type((*C.leveldb_options_t)(unsafe.Pointer(opts.Opt)), C.leveldb_clock_cache)
+	if s.expiry != nil {
+		s.expiry.setOptions(opts)
+	}
 	db, err := levigo.Open(s.path, opts)
 	if err != nil {
 		panic(fmt.Sprintf("skyd.Servlet: Unable to open LevelDB database: %v", err))
@@ -77,6 +101,19 @@ func (s *Servlet) Close() {
 	}
 }
 
+// Creates an iterator for scanning the whole servlet. Blocks read by the
+// scan are cached with low priority so they are evicted before the blocks
+// used by point lookups, and the following blocks are read in the
+// background while the current one is processed.
+func (s *Servlet) newScanIterator() *levigo.Iterator {
+	ro := levigo.NewReadOptions()
+	C.leveldb_readoptions_set_low_priority((*C.leveldb_readoptions_t)(unsafe.Pointer(ro.Opt)), 1)
+	C.leveldb_readoptions_set_readahead_blocks((*C.leveldb_readoptions_t)(unsafe.Pointer(ro.Opt)), C.int(ScanReadaheadBlocks))
+	iterator := s.db.NewIterator(ro)
+	ro.Close()
+	return iterator
+}
+
 //--------------------------------------
 // Lock Management
 //--------------------------------------
@@ -157,6 +194,7 @@ func (s *Servlet) PutEvent(table *Table, objectId string, event *Event, replace
 	if err != nil {
 		return err
 	}
+	table.InvalidateViews()
 
 	return nil
 }
@@ -178,7 +216,24 @@ func (s *Servlet) appendEvent(table *Table, objectId string, event *Event, state
 	}
 
 	// Write everything to the database.
-	return s.SetRawEvents(table, objectId, buffer.Bytes(), state)
+	if err := s.SetRawEvents(table, objectId, buffer.Bytes(), state); err != nil {
+		return err
+	}
+
+	// Update views with the event and the object's permanent state.
+	if views := table.GetViews(); len(views) > 0 {
+		key, err := table.EncodeObjectId(objectId)
+		if err != nil {
+			return err
+		}
+		full := &Event{Timestamp: event.Timestamp, Data: map[int64]interface{}{}}
+		full.Merge(state)
+		full.Merge(event)
+		for _, view := range views {
+			view.Append(key, full)
+		}
+	}
+	return nil
 }
 
 // Retrieves an event for a given object at a single point in time.
@@ -229,6 +284,7 @@ func (s *Servlet) DeleteEvent(table *Table, objectId string, timestamp time.Time
 	if err != nil {
 		return err
 	}
+	table.InvalidateViews()
 
 	return nil
 }
@@ -350,29 +406,123 @@ func (s *Servlet) SetRawEvents(table *Table, objectId string, data []byte, state
 		return err
 	}
 
+	value, err := encodeRawObject(data, state)
+	if err != nil {
+		return err
+	}
+
+	// Write bytes to the database.
+	wo := levigo.NewWriteOptions()
+	defer wo.Close()
+	if err = s.db.Put(wo, encodedObjectId, value); err != nil {
+		return err
+	}
+	table.IncrementVersion()
+	return nil
+}
+
+// Encodes the value stored for an object: its state followed by its raw events.
+func encodeRawObject(data []byte, state *Event) ([]byte, error) {
 	// Encode the state at the beginning.
 	buffer := new(bytes.Buffer)
 	var b []byte
+	var err error
 	if state != nil {
 		if b, err = state.MarshalRaw(); err != nil {
-			return err
+			return nil, err
 		}
 	} else {
 		b = []byte{}
 	}
 	b2, err := msgpack.Marshal(b)
 	if err != nil {
-		return err
+		return nil, err
 	}
 	buffer.Write(b2)
 
 	// Encode the rest of the data.
 	buffer.Write(data)
+	return buffer.Bytes(), nil
+}
 
-	// Write bytes to the database.
-	wo := levigo.NewWriteOptions()
-	defer wo.Close()
-	return s.db.Put(wo, encodedObjectId, buffer.Bytes())
+// Bulk loads the events of objects that are not in the servlet yet. The
+// objects are written into a table file that is moved into the database
+// instead of being written through the log and memtable. Events with the
+// same timestamp are merged. Nothing is loaded if any of the objects
+// already exist in the table.
+func (s *Servlet) LoadEvents(table *Table, objects map[string][]*Event) error {
+	s.Lock()
+	defer s.Unlock()
+
+	// Make sure the servlet is open.
+	if s.db == nil {
+		return fmt.Errorf("Servlet is not open: %v", s.path)
+	}
+	if len(objects) == 0 {
+		return nil
+	}
+
+	// Encode each object the same way appending its events one by one would.
+	type object struct {
+		key   []byte
+		value []byte
+	}
+	encoded := make([]object, 0, len(objects))
+	for objectId, events := range objects {
+		key, err := table.EncodeObjectId(objectId)
+		if err != nil {
+			return err
+		}
+		sort.Sort(EventList(events))
+		state := &Event{Data: map[int64]interface{}{}}
+		buffer := new(bytes.Buffer)
+		for i := 0; i < len(events); i++ {
+			event := &Event{Timestamp: events[i].Timestamp, Data: map[int64]interface{}{}}
+			event.Merge(events[i])
+			for ; i+1 < len(events) && events[i+1].Timestamp.Equal(event.Timestamp); i++ {
+				event.Merge(events[i+1])
+			}
+			event.Dedupe(state)
+			state.MergePermanent(event)
+			state.Timestamp = event.Timestamp
+			if err := event.EncodeRaw(buffer); err != nil {
+				return err
+			}
+		}
+		if len(events) == 0 {
+			state = nil
+		}
+		value, err := encodeRawObject(buffer.Bytes(), state)
+		if err != nil {
+			return err
+		}
+		encoded = append(encoded, object{key, value})
+	}
+	sort.Slice(encoded, func(i, j int) bool {
+		return bytes.Compare(encoded[i].key, encoded[j].key) < 0
+	})
+	keys, values := make([][]byte, len(encoded)), make([][]byte, len(encoded))
+	for i := range encoded {
+		keys[i], values[i] = encoded[i].key, encoded[i].value
+	}
+
+	// Build the table next to the database and move it in.
+	f, err := ioutil.TempFile(s.path, "load")
+	if err != nil {
+		return err
+	}
+	path := f.Name()
+	f.Close()
+	defer os.Remove(path)
+	if err = writeTable(path, keys, values); err != nil {
+		return err
+	}
+	if err = ingestExternalFiles(s.db, []string{path}); err != nil {
+		return err
+	}
+	table.IncrementVersion()
+	table.InvalidateViews()
+	return nil
 }
 
 // Deletes all events for a given object in a table.
@@ -392,6 +542,8 @@ func (s *Servlet) DeleteEvents(table *Table, objectId string) error {
 	wo := levigo.NewWriteOptions()
 	err = s.db.Delete(wo, encodedObjectId)
 	wo.Close()
+	table.IncrementVersion()
+	table.InvalidateViews()
 
 	return nil
 }
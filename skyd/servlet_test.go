@@ -1,9 +1,12 @@
 package skyd
 
 import (
+	"github.com/jmhodges/levigo"
 	"io/ioutil"
 	"os"
+	"sort"
 	"testing"
+	"time"
 )
 
 // Ensure that we can open and close a servlet.
@@ -11,7 +14,7 @@ func TestOpen(t *testing.T) {
 	path, err := ioutil.TempDir("", "")
 	defer os.RemoveAll(path)
 
-	servlet := NewServlet(path, nil)
+	servlet := NewServlet(path, nil, nil)
 	defer servlet.Close()
 	err = servlet.Open()
 	if err != nil {
@@ -25,7 +28,7 @@ func TestServletPutEvent(t *testing.T) {
 	path, err := ioutil.TempDir("", "")
 	defer os.RemoveAll(path)
 	table := NewTable("test", "/tmp/test")
-	servlet := NewServlet(path, nil)
+	servlet := NewServlet(path, nil, nil)
 	defer servlet.Close()
 	_ = servlet.Open()
 
@@ -67,3 +70,120 @@ func TestServletPutEvent(t *testing.T) {
 		}
 	}
 }
+
+// Ensure that bulk loaded objects read back the same as objects whose events
+// were added one by one in order.
+func TestServletLoadEvents(t *testing.T) {
+	path, err := ioutil.TempDir("", "")
+	defer os.RemoveAll(path)
+	table := NewTable("test", "/tmp/test")
+	servlet := NewServlet(path+"/load", nil, nil)
+	defer servlet.Close()
+	_ = servlet.Open()
+	expected := NewServlet(path+"/put", nil, nil)
+	defer expected.Close()
+	_ = expected.Open()
+
+	newEvents := func() map[string][]*Event {
+		return map[string][]*Event{
+			"bob": []*Event{
+				NewEvent("2012-01-02T00:00:00Z", map[int64]interface{}{-1: 20, 1: "foo", 3: "baz"}),
+				NewEvent("2012-01-01T00:00:00Z", map[int64]interface{}{-1: 20, 2: "bar", 3: "baz"}),
+				NewEvent("2012-01-03T00:00:00Z", map[int64]interface{}{-1: 20, 1: "foo", 3: "baz"}),
+			},
+			"susy": []*Event{
+				NewEvent("2012-01-01T00:00:00Z", map[int64]interface{}{1: "foo"}),
+				NewEvent("2012-01-01T00:00:00Z", map[int64]interface{}{-1: 30}),
+			},
+		}
+	}
+	if err = servlet.LoadEvents(table, newEvents()); err != nil {
+		t.Fatalf("Unable to load events: %v", err)
+	}
+	for objectId, events := range newEvents() {
+		sort.Sort(EventList(events))
+		for _, e := range events {
+			if err = expected.PutEvent(table, objectId, e, false); err != nil {
+				t.Fatalf("Unable to add event: %v", err)
+			}
+		}
+	}
+
+	for _, objectId := range []string{"bob", "susy"} {
+		exp, expState, _ := expected.GetEvents(table, objectId)
+		output, state, err := servlet.GetEvents(table, objectId)
+		if err != nil {
+			t.Fatalf("Unable to retrieve events: %v", err)
+		}
+		if !expState.Equal(state) {
+			t.Fatalf("Incorrect state.\nexp: %v\ngot: %v", expState, state)
+		}
+		if len(output) != len(exp) {
+			t.Fatalf("Expected %v events, received %v", len(exp), len(output))
+		}
+		for i := range output {
+			if !exp[i].Equal(output[i]) {
+				t.Fatalf("Events not equal:\n  EXP: %v\n  OUT: %v", exp[i], output[i])
+			}
+		}
+	}
+
+	// Loaded objects can be appended to but not loaded again.
+	if err = servlet.PutEvent(table, "bob", NewEvent("2012-01-04T00:00:00Z", map[int64]interface{}{-1: 40}), true); err != nil {
+		t.Fatalf("Unable to add event: %v", err)
+	}
+	if events, _, _ := servlet.GetEvents(table, "bob"); len(events) != 4 {
+		t.Fatalf("Expected 4 events, received %v", len(events))
+	}
+	if err = servlet.LoadEvents(table, map[string][]*Event{"bob": newEvents()["bob"]}); err == nil {
+		t.Fatalf("Expected an error when loading an existing object")
+	}
+}
+
+// Ensure that events older than a table's retention period are removed as the
+// servlet compacts.
+func TestServletExpireEvents(t *testing.T) {
+	path, err := ioutil.TempDir("", "")
+	defer os.RemoveAll(path)
+	table := NewTable("test", "/tmp/test")
+	expiry := NewExpiry()
+	defer expiry.Close()
+	servlet := NewServlet(path, nil, expiry)
+	defer servlet.Close()
+	_ = servlet.Open()
+	if err = expiry.SetRetention("test", 86400*365); err != nil {
+		t.Fatalf("Unable to set retention: %v", err)
+	}
+
+	now := time.Now().UTC()
+	input := make([]*Event, 3)
+	input[0] = NewEvent("2000-01-01T00:00:00Z", map[int64]interface{}{1: "foo"})
+	input[1] = NewEvent(now.Add(-time.Hour).Format(time.RFC3339), map[int64]interface{}{1: "bar"})
+	input[2] = NewEvent(now.Format(time.RFC3339), map[int64]interface{}{1: "baz"})
+
+	// Compact the first two events into a table and then compact the object
+	// again so that it is rewritten.
+	for i, e := range input {
+		if err = servlet.PutEvent(table, "bob", e, true); err != nil {
+			t.Fatalf("Unable to add event: %v", err)
+		}
+		if i > 0 {
+			servlet.db.CompactRange(levigo.Range{})
+		}
+	}
+
+	output, state, err := servlet.GetEvents(table, "bob")
+	if err != nil {
+		t.Fatalf("Unable to retrieve events: %v", err)
+	}
+	if len(output) != 2 || !output[0].Timestamp.Equal(input[1].Timestamp) {
+		t.Fatalf("Expired events not removed: %v", output)
+	}
+	if state == nil || state.Data[1] != "baz" {
+		t.Fatalf("Incorrect state: %v", state)
+	}
+	stats := expiry.Stats("test")
+	if stats["trimmedEvents"] != uint64(1) || stats["trimmedBytes"].(uint64) == 0 {
+		t.Fatalf("Incorrect expiry stats: %v", stats)
+	}
+}
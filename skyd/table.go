@@ -1,11 +1,15 @@
 package skyd
 
 import (
+	"encoding/json"
 	"errors"
 	"fmt"
 	"github.com/ugorji/go-msgpack"
+	"io/ioutil"
 	"os"
 	"path/filepath"
+	"sync"
+	"sync/atomic"
 	"time"
 )
 
@@ -17,9 +21,13 @@ import (
 
 // A Table is a collection of objects.
 type Table struct {
+	version      uint64
 	Name         string `json:"name"`
+	Retention    int64  `json:"retention,omitempty"`
 	path         string
 	propertyFile *PropertyFile
+	views        map[string]*View
+	viewsMutex   sync.RWMutex
 }
 
 //------------------------------------------------------------------------------
@@ -36,8 +44,9 @@ func NewTable(name string, path string) *Table {
 	}
 
 	return &Table{
-		Name: name,
-		path: path,
+		Name:  name,
+		path:  path,
+		views: make(map[string]*View),
 	}
 }
 
@@ -52,6 +61,17 @@ func (t *Table) Path() string {
 	return t.path
 }
 
+// Retrieves the data version of the table. The version changes whenever the
+// table's events or properties change.
+func (t *Table) Version() uint64 {
+	return atomic.LoadUint64(&t.version)
+}
+
+// Marks the table's data as changed.
+func (t *Table) IncrementVersion() {
+	atomic.AddUint64(&t.version, 1)
+}
+
 //------------------------------------------------------------------------------
 //
 // Methods
@@ -100,9 +120,15 @@ func (t *Table) Open() error {
 		return errors.New("Table does not exist")
 	}
 
+	// Load settings.
+	err := t.LoadSettings()
+	if err != nil {
+		return err
+	}
+
 	// Load property file.
 	t.propertyFile = NewPropertyFile(fmt.Sprintf("%v/%v", t.path, "properties"))
-	err := t.propertyFile.Open()
+	err = t.propertyFile.Open()
 	if err != nil {
 		t.Close()
 		return err
@@ -117,6 +143,14 @@ func (t *Table) Close() {
 		t.propertyFile.Close()
 	}
 	t.propertyFile = nil
+
+	// Release the views.
+	t.viewsMutex.Lock()
+	for _, view := range t.views {
+		view.Close()
+	}
+	t.views = make(map[string]*View)
+	t.viewsMutex.Unlock()
 }
 
 // Checks if the table is currently open.
@@ -142,6 +176,36 @@ func TablePrefix(tableName string) ([]byte, error) {
 	return prefix[0 : len(prefix)-1], nil
 }
 
+//--------------------------------------
+// Settings
+//--------------------------------------
+
+// The path to the file that stores the table's settings.
+func (t *Table) settingsPath() string {
+	return fmt.Sprintf("%v/%v", t.path, "settings")
+}
+
+// Reads the table's settings. Tables without a settings file keep the
+// defaults.
+func (t *Table) LoadSettings() error {
+	data, err := ioutil.ReadFile(t.settingsPath())
+	if os.IsNotExist(err) {
+		return nil
+	} else if err != nil {
+		return err
+	}
+	return json.Unmarshal(data, t)
+}
+
+// Writes the table's settings.
+func (t *Table) SaveSettings() error {
+	data, err := json.Marshal(map[string]interface{}{"retention": t.Retention})
+	if err != nil {
+		return err
+	}
+	return ioutil.WriteFile(t.settingsPath(), data, 0600)
+}
+
 //--------------------------------------
 // Property Management
 //--------------------------------------
@@ -163,6 +227,7 @@ func (t *Table) CreateProperty(name string, transient bool, dataType string) (*P
 	if err != nil {
 		return nil, err
 	}
+	t.IncrementVersion()
 
 	return property, err
 }
@@ -197,6 +262,8 @@ func (t *Table) DeleteProperty(property *Property) error {
 		return errors.New("Table is not open")
 	}
 	t.propertyFile.DeleteProperty(property)
+	t.IncrementVersion()
+	t.InvalidateViews()
 	return nil
 }
 
@@ -205,6 +272,8 @@ func (t *Table) SavePropertyFile() error {
 	if !t.IsOpen() {
 		return errors.New("Table is not open")
 	}
+	t.IncrementVersion()
+	t.InvalidateViews()
 	return t.propertyFile.Save()
 }
 
@@ -218,6 +287,59 @@ func (t *Table) DenormalizeMap(m map[int64]interface{}) (map[string]interface{},
 	return t.propertyFile.DenormalizeMap(m)
 }
 
+//--------------------------------------
+// View Management
+//--------------------------------------
+
+// Adds a view to the table.
+func (t *Table) AddView(view *View) error {
+	t.viewsMutex.Lock()
+	defer t.viewsMutex.Unlock()
+	if t.views[view.Name] != nil {
+		return fmt.Errorf("View already exists: %v", view.Name)
+	}
+	t.views[view.Name] = view
+	return nil
+}
+
+// Retrieves a single view by name.
+func (t *Table) GetView(name string) *View {
+	t.viewsMutex.RLock()
+	defer t.viewsMutex.RUnlock()
+	return t.views[name]
+}
+
+// Retrieves a list of all views on the table.
+func (t *Table) GetViews() []*View {
+	t.viewsMutex.RLock()
+	defer t.viewsMutex.RUnlock()
+	views := make([]*View, 0, len(t.views))
+	for _, view := range t.views {
+		views = append(views, view)
+	}
+	return views
+}
+
+// Removes a view from the table.
+func (t *Table) DeleteView(name string) error {
+	t.viewsMutex.Lock()
+	defer t.viewsMutex.Unlock()
+	view := t.views[name]
+	if view == nil {
+		return fmt.Errorf("View does not exist: %v", name)
+	}
+	view.Close()
+	delete(t.views, name)
+	return nil
+}
+
+// Marks the results of all views on the table as out of date.
+func (t *Table) InvalidateViews() {
+	for _, view := range t.GetViews() {
+		view.Invalidate()
+	}
+}
+
 //--------------------------------------
 // Event Encoding
 //--------------------------------------
@@ -0,0 +1,46 @@
+package skyd
+
+/*
+#cgo LDFLAGS: -lcsky -lm
+#include <stdlib.h>
+#include <sky/tdigest.h>
+*/
+import "C"
+
+import (
+	"errors"
+	"unsafe"
+)
+
+// The default accuracy of the t-digests used by percentile fields. Each
+// digest keeps at most about 2 * compression centroids.
+const DefaultTDigestCompression = 100
+
+// The allowed range of t-digest compressions.
+const (
+	MinTDigestCompression = 10
+	MaxTDigestCompression = 1000
+)
+
+// The quantiles calculated for a "quantiles()" field and their names.
+var QuantilesFieldQuantiles = []float64{0, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 1}
+var QuantilesFieldNames = []string{"min", "p25", "p50", "p75", "p90", "p95", "p99", "max"}
+
+// Estimates the values at several quantiles of a serialized t-digest. The
+// values are NaN if the digest is empty.
+func TDigestQuantiles(data []byte, quantiles []float64) ([]float64, error) {
+	if len(data) == 0 {
+		return nil, errors.New("skyd: Invalid t-digest")
+	}
+	tdigest := C.sky_tdigest_unpack(unsafe.Pointer(&data[0]), (C.size_t)(len(data)))
+	if tdigest == nil {
+		return nil, errors.New("skyd: Invalid t-digest")
+	}
+	defer C.sky_tdigest_free(tdigest)
+
+	values := make([]float64, len(quantiles))
+	for i, q := range quantiles {
+		values[i] = float64(C.sky_tdigest_quantile(tdigest, C.double(q)))
+	}
+	return values, nil
+}
@@ -1,9 +1,22 @@
 package skyd
 
 import (
+	"math"
+	"sync"
 	"time"
 )
 
+// The timezone transition tables that have already been computed, by name.
+var timezoneTransitions = map[string]*TimezoneTransitions{}
+var timezoneTransitionsMutex sync.Mutex
+
+// A list of the times at which a location's offset from UTC changes. Each
+// start is paired with the offset in effect from then on, in seconds.
+type TimezoneTransitions struct {
+	Starts  []int64
+	Offsets []int32
+}
+
 // Shifts a Go time into Sky timestamp format.
 func ShiftTime(value time.Time) int64 {
 	timestamp := value.UnixNano() / 1000
@@ -18,3 +31,45 @@ func UnshiftTime(value int64) time.Time {
 	sec := value >> 20
 	return time.Unix(sec, usec*1000)
 }
+
+// Computes the offset transitions of a location over the range of event
+// timestamps so the cursor can align time buckets without the timezone
+// database. Offsets are sampled daily and each change is then narrowed down
+// to the second. Tables are cached by location name.
+func GetTimezoneTransitions(location *time.Location) *TimezoneTransitions {
+	timezoneTransitionsMutex.Lock()
+	defer timezoneTransitionsMutex.Unlock()
+	if t := timezoneTransitions[location.String()]; t != nil {
+		return t
+	}
+
+	offsetAt := func(seconds int64) int32 {
+		_, offset := time.Unix(seconds, 0).In(location).Zone()
+		return int32(offset)
+	}
+	t := &TimezoneTransitions{
+		Starts:  []int64{math.MinInt64},
+		Offsets: []int32{offsetAt(0)},
+	}
+	for seconds := int64(0); seconds < math.MaxUint32; seconds += 86400 {
+		offset := offsetAt(seconds + 86400)
+		if offset == t.Offsets[len(t.Offsets)-1] {
+			continue
+		}
+
+		// Find the first second with the new offset.
+		min, max := seconds, seconds+86400
+		for max-min > 1 {
+			mid := (min + max) / 2
+			if offsetAt(mid) == offset {
+				max = mid
+			} else {
+				min = mid
+			}
+		}
+		t.Starts = append(t.Starts, max)
+		t.Offsets = append(t.Offsets, offset)
+	}
+	timezoneTransitions[location.String()] = t
+	return t
+}
@@ -64,3 +64,21 @@ func TestUnshiftOneAndAHalfSecondsAfterEpoch(t *testing.T) {
 		t.Fatalf("Invalid time unshift: %v", value)
 	}
 }
+
+func TestTimezoneTransitions(t *testing.T) {
+	location, err := time.LoadLocation("America/New_York")
+	if err != nil {
+		t.Skip("Timezone database not available")
+	}
+	transitions := GetTimezoneTransitions(location)
+	start := time.Date(2013, 3, 10, 7, 0, 0, 0, time.UTC).Unix()
+	for i, s := range transitions.Starts {
+		if s == start {
+			if transitions.Offsets[i] != -14400 || transitions.Offsets[i-1] != -18000 {
+				t.Fatalf("Invalid offsets: %v, %v", transitions.Offsets[i-1], transitions.Offsets[i])
+			}
+			return
+		}
+	}
+	t.Fatalf("Transition not found: %v", start)
+}
@@ -5,7 +5,8 @@ import (
 	"os"
 )
 
-// Converts untyped map to a map[string]interface{} if passed a map.
+// Converts untyped map to a map[string]interface{} if passed a map. Slices
+// have each of their elements converted.
 func ConvertToStringKeys(value interface{}) interface{} {
 	if m, ok := value.(map[interface{}]interface{}); ok {
 		ret := make(map[string]interface{})
@@ -14,6 +15,34 @@ func ConvertToStringKeys(value interface{}) interface{} {
 		}
 		return ret
 	}
+	if a, ok := value.([]interface{}); ok {
+		ret := make([]interface{}, len(a))
+		for i, v := range a {
+			ret[i] = ConvertToStringKeys(v)
+		}
+		return ret
+	}
+
+	return value
+}
+
+// Creates a deep copy of untyped maps and slices so that the copy can be
+// modified without affecting the original.
+func CopyResult(value interface{}) interface{} {
+	if m, ok := value.(map[interface{}]interface{}); ok {
+		ret := make(map[interface{}]interface{}, len(m))
+		for k, v := range m {
+			ret[k] = CopyResult(v)
+		}
+		return ret
+	}
+	if a, ok := value.([]interface{}); ok {
+		ret := make([]interface{}, len(a))
+		for i, v := range a {
+			ret[i] = CopyResult(v)
+		}
+		return ret
+	}
 
 	return value
 }
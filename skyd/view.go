@@ -0,0 +1,247 @@
+package skyd
+
+import (
+	"bytes"
+	"errors"
+	"sync"
+)
+
+//------------------------------------------------------------------------------
+//
+// Typedefs
+//
+//------------------------------------------------------------------------------
+
+// A View is a query whose results are kept up to date as events are added
+// to its table. Events appended to the end of an object are aggregated on
+// their own and merged into the current results. Any other change to the
+// table invalidates the results so that they are recomputed on the next
+// read.
+type View struct {
+	Name        string `json:"name"`
+	query       *Query
+	mutex       sync.Mutex
+	buildMutex  sync.Mutex
+	engine      *ExecutionEngine
+	result      interface{}
+	valid       bool
+	building    bool
+	invalidated bool
+	pendingKeys [][]byte
+	pending     [][]byte
+}
+
+//------------------------------------------------------------------------------
+//
+// Constructors
+//
+//------------------------------------------------------------------------------
+
+// NewView returns a new View for a query.
+func NewView(name string, query *Query) *View {
+	return &View{
+		Name:  name,
+		query: query,
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+// Accessors
+//
+//------------------------------------------------------------------------------
+
+// Retrieves the query the view is based on.
+func (v *View) Query() *Query {
+	return v.query
+}
+
+// Checks if the view's query can be updated one event at a time. This is
+// only possible when the query has no sessions, is not restricted to a list
+// of objects and only contains top-level selections since conditions depend
+// on earlier events of the object. Selections cannot read the object's state
+// or session properties either since an append changes the values seen by
+// the object's earlier events, and state-only queries count each object
+// once.
+func (v *View) Incremental() bool {
+	if v.query.SessionIdleTime != 0 || v.query.Subset() || v.query.StateOnly {
+		return false
+	}
+	for _, step := range v.query.Steps {
+		selection, ok := step.(*QuerySelection)
+		if !ok || selection.readsOtherEvents() {
+			return false
+		}
+	}
+	return true
+}
+
+//------------------------------------------------------------------------------
+//
+// Methods
+//
+//------------------------------------------------------------------------------
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Releases the engine used for incremental updates.
+func (v *View) Close() {
+	v.mutex.Lock()
+	defer v.mutex.Unlock()
+	v.close()
+}
+
+func (v *View) close() {
+	if v.engine != nil {
+		v.engine.Destroy()
+		v.engine = nil
+	}
+	v.valid = false
+}
+
+//--------------------------------------
+// Results
+//--------------------------------------
+
+// Retrieves the current results of the view if they are up to date.
+func (v *View) Result() (interface{}, bool) {
+	v.mutex.Lock()
+	defer v.mutex.Unlock()
+	return v.result, v.valid
+}
+
+// Marks the start of a full recomputation. Appends that arrive after this
+// point are buffered and applied once the recomputation finishes. This should
+// be called while the table's servlets are locked so that it lines up with
+// the iterators used to recompute the results.
+func (v *View) beginBuild() {
+	v.mutex.Lock()
+	defer v.mutex.Unlock()
+	v.building = true
+	v.invalidated = false
+	v.pendingKeys, v.pending = nil, nil
+}
+
+// Completes a full recomputation. The results are only kept if nothing has
+// invalidated them while they were being computed.
+func (v *View) endBuild(result interface{}, err error) error {
+	v.mutex.Lock()
+	defer v.mutex.Unlock()
+	v.building = false
+	pendingKeys, pending := v.pendingKeys, v.pending
+	v.pendingKeys, v.pending = nil, nil
+	if err != nil || v.invalidated {
+		return err
+	}
+
+	// Recreate the engine in case the table's properties have changed.
+	v.close()
+	source, err := v.query.Codegen()
+	if err != nil {
+		return err
+	}
+	if v.engine, err = NewExecutionEngine(v.query.table, source); err != nil {
+		return err
+	}
+	if err = v.engine.SetLocation(v.query.Location()); err != nil {
+		return err
+	}
+
+	// Apply any appends that occurred during the build.
+	v.result = result
+	v.valid = true
+	if len(pending) > 0 {
+		if err := v.apply(pendingKeys, pending); err != nil {
+			v.valid = false
+			return err
+		}
+	}
+	return nil
+}
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Encodes a view into an untyped map.
+func (v *View) Serialize() map[string]interface{} {
+	return map[string]interface{}{
+		"name":  v.Name,
+		"query": v.query.Serialize(),
+	}
+}
+
+//--------------------------------------
+// Updates
+//--------------------------------------
+
+// Adds a single event for an object to the results. The event should contain
+// both the permanent state of the object and the event's own data. The key is
+// the encoded object identifier.
+func (v *View) Append(key []byte, event *Event) {
+	v.mutex.Lock()
+	defer v.mutex.Unlock()
+
+	// Nothing needs to be done if the results will be rebuilt anyway.
+	if !v.valid && !v.building {
+		return
+	}
+	if !v.Incremental() {
+		v.invalidate()
+		return
+	}
+
+	// Serialize the event as a single-event object.
+	buffer := new(bytes.Buffer)
+	if err := event.EncodeRaw(buffer); err != nil {
+		v.invalidate()
+		return
+	}
+
+	// Buffer the event until the build completes or apply it immediately.
+	if v.building {
+		v.pendingKeys = append(v.pendingKeys, key)
+		v.pending = append(v.pending, buffer.Bytes())
+	} else if err := v.apply([][]byte{key}, [][]byte{buffer.Bytes()}); err != nil {
+		v.invalidate()
+	}
+}
+
+// Marks the results as out of date.
+func (v *View) Invalidate() {
+	v.mutex.Lock()
+	defer v.mutex.Unlock()
+	v.invalidate()
+}
+
+func (v *View) invalidate() {
+	v.valid = false
+	if v.building {
+		v.invalidated = true
+	}
+}
+
+// Aggregates a set of serialized objects and merges them into the results.
+func (v *View) apply(keys [][]byte, objects [][]byte) error {
+	if v.engine == nil {
+		return errors.New("skyd.View: Engine not initialized")
+	}
+	if err := v.engine.SetObjects(keys, objects); err != nil {
+		return err
+	}
+	delta, err := v.engine.Aggregate()
+	if err != nil {
+		return err
+	}
+	if err = v.query.Defactorize(delta); err != nil {
+		return err
+	}
+	result, err := v.engine.Merge(v.result, delta)
+	if err != nil {
+		return err
+	}
+	v.result = result
+	return nil
+}
@@ -0,0 +1,152 @@
+package skyd
+
+import (
+	"fmt"
+	"regexp"
+	"strings"
+)
+
+//------------------------------------------------------------------------------
+//
+// Constants
+//
+//------------------------------------------------------------------------------
+
+// The kinds of values computed by the cursor.
+const (
+	VirtualPropertyTimeBucket = iota
+	VirtualPropertySession
+)
+
+//------------------------------------------------------------------------------
+//
+// Typedefs
+//
+//------------------------------------------------------------------------------
+
+// A VirtualProperty is computed by the cursor for each event instead of being
+// stored with it. Virtual properties are referenced by queries with an "@"
+// prefix and are read from the "__" prefixed field of the same name on the
+// event. The index matches the field's SKY_TIME_BUCKET_* or SKY_SESSION_FIELD_*
+// constant in csky.
+type VirtualProperty struct {
+	Name      string
+	Kind      int
+	Index     int
+	Timestamp bool
+}
+
+// The properties that the cursor can compute.
+var VirtualProperties = []*VirtualProperty{
+	{"minute", VirtualPropertyTimeBucket, 0, true},
+	{"hour", VirtualPropertyTimeBucket, 1, true},
+	{"day", VirtualPropertyTimeBucket, 2, true},
+	{"week", VirtualPropertyTimeBucket, 3, true},
+	{"month", VirtualPropertyTimeBucket, 4, true},
+	{"session_index", VirtualPropertySession, 0, false},
+	{"session_event_index", VirtualPropertySession, 1, false},
+	{"session_start", VirtualPropertySession, 2, true},
+	{"since_previous", VirtualPropertySession, 3, false},
+	{"session_length", VirtualPropertySession, 4, false},
+}
+
+// Matches references to virtual property fields in generated Lua.
+var virtualPropertyPattern = regexp.MustCompile(`\bevent\.__(\w+)`)
+
+// State properties are referenced by queries with a "state." prefix and are
+// read from the object's current state instead of the current event.
+const StatePropertyPrefix = "state."
+
+// Matches references to the state data object in generated Lua.
+var statePattern = regexp.MustCompile(`\bcursor\.state\b`)
+
+//------------------------------------------------------------------------------
+//
+// Functions
+//
+//------------------------------------------------------------------------------
+
+// Retrieves a virtual property by its "@" prefixed name or nil if the name is
+// not a virtual property.
+func GetVirtualProperty(name string) *VirtualProperty {
+	if !strings.HasPrefix(name, "@") {
+		return nil
+	}
+	for _, p := range VirtualProperties {
+		if p.Name == name[1:] {
+			return p
+		}
+	}
+	return nil
+}
+
+// Retrieves the name of the property read by a "state." prefixed name and
+// whether the name refers to the object's state.
+func statePropertyName(name string) (string, bool) {
+	if strings.HasPrefix(name, StatePropertyPrefix) {
+		return name[len(StatePropertyPrefix):], true
+	}
+	return name, false
+}
+
+// Generates the Lua expression for the value of a regular, virtual or state
+// property on the current event.
+func codegenEventValue(name string) string {
+	if strings.HasPrefix(name, "@") {
+		return fmt.Sprintf("cursor.event.__%s", name[1:])
+	}
+	if property, ok := statePropertyName(name); ok {
+		return fmt.Sprintf("cursor.state:%s()", property)
+	}
+	return fmt.Sprintf("cursor.event:%s()", name)
+}
+
+// Generates the Lua expression for the raw struct field of a regular or state
+// property on the current event.
+func codegenEventField(name string) string {
+	if property, ok := statePropertyName(name); ok {
+		return fmt.Sprintf("cursor.state._%s", property)
+	}
+	return fmt.Sprintf("cursor.event._%s", name)
+}
+
+// Generates the event struct fields of the virtual properties.
+func virtualPropertyStructDef() string {
+	defs := []string{}
+	for _, p := range VirtualProperties {
+		defs = append(defs, fmt.Sprintf("uint32_t __%s;", p.Name))
+	}
+	return strings.Join(defs, "\n  ")
+}
+
+// Generates the calls that enable each virtual property referenced by a
+// script. Properties that are not referenced are never computed.
+func virtualPropertyDescriptorDefs(source string) string {
+	refs := map[string]bool{}
+	for _, m := range virtualPropertyPattern.FindAllStringSubmatch(source, -1) {
+		refs[m[1]] = true
+	}
+
+	defs := []string{}
+	for _, p := range VirtualProperties {
+		if !refs[p.Name] {
+			continue
+		}
+		switch p.Kind {
+		case VirtualPropertyTimeBucket:
+			defs = append(defs, fmt.Sprintf("cursor:set_time_bucket_offset(%d, ffi.offsetof('sky_lua_event_t', '__%s'))", p.Index, p.Name))
+		case VirtualPropertySession:
+			defs = append(defs, fmt.Sprintf("cursor:set_session_field_offset(%d, ffi.offsetof('sky_lua_event_t', '__%s'))", p.Index, p.Name))
+		}
+	}
+	return strings.Join(defs, "\n  ")
+}
+
+// Generates the call that enables decoding of each object's state if the
+// script references it.
+func stateDescriptorDef(source string) string {
+	if statePattern.MatchString(source) {
+		return "cursor:enable_state()"
+	}
+	return ""
+}